@@ -0,0 +1,284 @@
+// Micro-benchmarks for the server-side storage and timestamp paths.
+// Drives ABDProtocol and BlockingProtocol directly (no gRPC, no network) from
+// 1..N threads, so changes to the store, slab or clock can be measured
+// before they reach a cluster. Built with `make bench`; run e.g.
+//   ./build/bench_storage --benchmark_filter='ABD' --benchmark_min_time=0.5
+//
+// Store benchmarks take Args({keys, value_bytes}) (plus the read percentage
+// for the mixed one). The store is built and filled once per configuration,
+// before the threads start; every thread then picks keys uniformly with its
+// own PRNG.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/common/hlc.h"
+#include "../src/protocol/abd.h"
+#include "../src/protocol/blocking.h"
+#include "../src/protocol/ordered_index.h"
+
+using namespace kvstore;
+
+namespace {
+
+std::vector<std::string> keys;
+std::unique_ptr<ABDProtocol> abd;
+std::unique_ptr<BlockingProtocol> blocking;
+std::unique_ptr<OrderedIndex> key_index;
+std::set<std::string> key_set;
+
+void MakeKeys(size_t count) {
+    keys.clear();
+    keys.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        keys.push_back("bench_key_" + std::to_string(i));
+    }
+}
+
+// Setup: a fresh ABD store holding every key with a value of range(1) bytes.
+void SetupABD(const benchmark::State& state) {
+    MakeKeys(static_cast<size_t>(state.range(0)));
+    abd = std::make_unique<ABDProtocol>();
+    std::string value(static_cast<size_t>(state.range(1)), 'v');
+    for (const auto& key : keys) {
+        abd->Write(key, value, 0);
+    }
+}
+
+void TeardownABD(const benchmark::State&) {
+    abd.reset();
+}
+
+// Setup: as SetupABD, keeping range(2) superseded versions per key.
+void SetupABDVersions(const benchmark::State& state) {
+    SetupABD(state);
+    abd->SetVersionRetention({static_cast<size_t>(state.range(2)), std::chrono::milliseconds(10000)});
+}
+
+// Setup: a fresh Blocking store with every key written once.
+void SetupBlocking(const benchmark::State& state) {
+    MakeKeys(static_cast<size_t>(state.range(0)));
+    blocking = std::make_unique<BlockingProtocol>();
+    std::string value(static_cast<size_t>(state.range(1)), 'v');
+    for (const auto& key : keys) {
+        blocking->AcquireLock(key, 1);
+        blocking->Write(key, value, 0, 1);
+        blocking->ReleaseLock(key, 1);
+    }
+}
+
+void TeardownBlocking(const benchmark::State&) {
+    blocking.reset();
+}
+
+// Setup: range(0) keys in an OrderedIndex and, for comparison, a std::set.
+void SetupIndex(const benchmark::State& state) {
+    MakeKeys(static_cast<size_t>(state.range(0)));
+    key_index = std::make_unique<OrderedIndex>();
+    for (const auto& key : keys) {
+        key_index->Insert(key);
+    }
+    key_set = std::set<std::string>(keys.begin(), keys.end());
+}
+
+void TeardownIndex(const benchmark::State&) {
+    key_index.reset();
+    key_set.clear();
+}
+
+std::mt19937_64 ThreadRng(const benchmark::State& state) {
+    return std::mt19937_64(0x9E3779B97F4A7C15ull * (state.thread_index() + 1));
+}
+
+void BM_ABDRead(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    for (auto _ : state) {
+        auto result = abd->Read(keys[rng() % keys.size()], 0);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(1));
+}
+
+void BM_ABDWrite(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    std::string value(static_cast<size_t>(state.range(1)), 'w');
+    for (auto _ : state) {
+        auto result = abd->Write(keys[rng() % keys.size()], value, 0);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(1));
+}
+
+// One Scan page of range(2) keys from a random start
+void BM_ABDScan(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    size_t page = static_cast<size_t>(state.range(2));
+    for (auto _ : state) {
+        bool more = false;
+        bool too_old = false;
+        auto entries = abd->Scan(keys[rng() % keys.size()], "", page, SIZE_MAX, 0, more, too_old);
+        benchmark::DoNotOptimize(entries);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+
+// range(1) keys in order from a random start: the B+-tree's leaf pages...
+void BM_IndexRange(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    size_t count = static_cast<size_t>(state.range(1));
+    for (auto _ : state) {
+        auto range = key_index->Range(keys[rng() % keys.size()], "", count);
+        benchmark::DoNotOptimize(range);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+// ...against a red-black tree walk
+void BM_SetRange(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    size_t count = static_cast<size_t>(state.range(1));
+    for (auto _ : state) {
+        std::vector<std::string> range;
+        range.reserve(count);
+        for (auto it = key_set.lower_bound(keys[rng() % keys.size()]);
+             it != key_set.end() && range.size() < count; ++it) {
+            range.push_back(*it);
+        }
+        benchmark::DoNotOptimize(range);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+// range(2) percent of the operations are reads, the rest writes
+void BM_ABDMixed(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    std::string value(static_cast<size_t>(state.range(1)), 'w');
+    uint64_t read_pct = static_cast<uint64_t>(state.range(2));
+    for (auto _ : state) {
+        uint64_t r = rng();
+        const std::string& key = keys[(r >> 8) % keys.size()];
+        if (r % 100 < read_pct) {
+            auto result = abd->Read(key, 0);
+            benchmark::DoNotOptimize(result);
+        } else {
+            auto result = abd->Write(key, value, 0);
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Lock then unlock a random key. With few keys and several threads some
+// attempts find the key held; those count too (that is the contended path).
+void BM_BlockingLockUnlock(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    int32_t client_id = state.thread_index() + 1;
+    int64_t granted = 0;
+    for (auto _ : state) {
+        const std::string& key = keys[rng() % keys.size()];
+        if (blocking->AcquireLock(key, client_id).granted) {
+            blocking->ReleaseLock(key, client_id);
+            granted++;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["granted"] = benchmark::Counter(static_cast<double>(granted),
+                                                   benchmark::Counter::kIsRate);
+}
+
+// A full blocking write at one server: lock, write, unlock.
+void BM_BlockingLockWriteUnlock(benchmark::State& state) {
+    auto rng = ThreadRng(state);
+    int32_t client_id = state.thread_index() + 1;
+    std::string value(static_cast<size_t>(state.range(1)), 'w');
+    for (auto _ : state) {
+        const std::string& key = keys[rng() % keys.size()];
+        if (blocking->AcquireLock(key, client_id).granted) {
+            blocking->Write(key, value, 0, client_id);
+            blocking->ReleaseLock(key, client_id);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// The servers' timestamp path (GenerateTimestamp) is Now() then Observe()
+// on one shared clock; clients call After() on theirs.
+HybridClock shared_clock(hlc::ServerWriterId(0));
+
+void BM_ClockNow(benchmark::State& state) {
+    for (auto _ : state) {
+        int64_t ts = shared_clock.Now();
+        shared_clock.Observe(ts);
+        benchmark::DoNotOptimize(ts);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ClockAfter(benchmark::State& state) {
+    int64_t seen = shared_clock.Last();
+    for (auto _ : state) {
+        seen = shared_clock.After(seen);
+        benchmark::DoNotOptimize(seen);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+int MaxThreads() {
+    return static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+}
+
+void StoreArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t key_count : {1000, 100000, 1000000}) {
+        for (int64_t value_bytes : {8, 100, 1024}) {
+            b->Args({key_count, value_bytes});
+        }
+    }
+    b->ArgNames({"keys", "value"});
+}
+
+void MixedArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t key_count : {1000, 100000}) {
+        for (int64_t read_pct : {50, 90, 99}) {
+            b->Args({key_count, 100, read_pct});
+        }
+    }
+    b->ArgNames({"keys", "value", "read_pct"});
+}
+
+} // namespace
+
+BENCHMARK(BM_ABDRead)->Apply(StoreArgs)->Setup(SetupABD)->Teardown(TeardownABD)
+    ->ThreadRange(1, MaxThreads())->UseRealTime();
+BENCHMARK(BM_ABDWrite)->Apply(StoreArgs)->Setup(SetupABD)->Teardown(TeardownABD)
+    ->ThreadRange(1, MaxThreads())->UseRealTime();
+BENCHMARK(BM_ABDMixed)->Apply(MixedArgs)->Setup(SetupABD)->Teardown(TeardownABD)
+    ->ThreadRange(1, MaxThreads())->UseRealTime();
+BENCHMARK(BM_ABDScan)->Args({100000, 100, 100})->ArgNames({"keys", "value", "page"})
+    ->Setup(SetupABD)->Teardown(TeardownABD)->ThreadRange(1, MaxThreads())->UseRealTime();
+// Overwrites with and without a version chain
+BENCHMARK(BM_ABDWrite)->Args({100000, 100, 0})->Args({100000, 100, 4})->ArgNames({"keys", "value", "versions"})
+    ->Setup(SetupABDVersions)->Teardown(TeardownABD)->ThreadRange(1, MaxThreads())->UseRealTime();
+BENCHMARK(BM_IndexRange)->Args({1000000, 100})->Args({1000000, 1000})->ArgNames({"keys", "count"})
+    ->Setup(SetupIndex)->Teardown(TeardownIndex);
+BENCHMARK(BM_SetRange)->Args({1000000, 100})->Args({1000000, 1000})->ArgNames({"keys", "count"})
+    ->Setup(SetupIndex)->Teardown(TeardownIndex);
+BENCHMARK(BM_BlockingLockUnlock)->Args({16, 8})->Args({100000, 8})->ArgNames({"keys", "value"})
+    ->Setup(SetupBlocking)->Teardown(TeardownBlocking)->ThreadRange(1, MaxThreads())->UseRealTime();
+BENCHMARK(BM_BlockingLockWriteUnlock)->Args({100000, 100})->Args({100000, 1024})
+    ->ArgNames({"keys", "value"})->Setup(SetupBlocking)->Teardown(TeardownBlocking)
+    ->ThreadRange(1, MaxThreads())->UseRealTime();
+BENCHMARK(BM_ClockNow)->ThreadRange(1, MaxThreads())->UseRealTime();
+BENCHMARK(BM_ClockAfter)->ThreadRange(1, MaxThreads())->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -9,12 +9,20 @@
 #include <algorithm>
 #include <mutex>
 #include <cstdlib>
+#include <grpcpp/grpcpp.h>
+#include "kvstore.grpc.pb.h"
 #include "../src/client/abd_client.h"
 #include "../src/client/blocking_client.h"
 #include "../src/common/config.h"
 
 using namespace kvstore;
 
+// Every client also writes this key every SHARED_KEY_EVERY operations. When
+// the blocking client crashes it leaves its locks on this key behind, the way
+// a client dying halfway through an operation would.
+const std::string SHARED_KEY = "crash_test_shared_key";
+constexpr int SHARED_KEY_EVERY = 10;
+
 struct CrashStats {
     std::atomic<int64_t> ops_before_crash{0};
     std::atomic<int64_t> ops_after_crash{0};
@@ -54,6 +62,40 @@ struct CrashStats {
 
 CrashStats global_crash_stats;
 std::atomic<bool> crash_occurred{false};
+std::chrono::steady_clock::time_point crash_time_point;
+std::atomic<int64_t> shared_key_recovery_ms{-1};   // First shared-key success after the crash
+
+void note_crash() {
+    crash_time_point = std::chrono::steady_clock::now();
+    crash_occurred.store(true);
+}
+
+// Record that the shared key is usable again (first time after the crash only).
+void note_shared_key_success() {
+    if (!crash_occurred.load() || shared_key_recovery_ms.load() >= 0) {
+        return;
+    }
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - crash_time_point).count();
+    int64_t unset = -1;
+    shared_key_recovery_ms.compare_exchange_strong(unset, elapsed);
+}
+
+// Lock the shared key on every server as `client_id` and never release it.
+void abandon_shared_key_locks(const Config& config, int32_t client_id) {
+    for (const auto& server : config.GetServers()) {
+        auto stub = BlockingService::NewStub(
+            grpc::CreateChannel(server.GetAddress(), grpc::InsecureChannelCredentials()));
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(5));
+        BlockingLockRequest request;
+        request.set_key(SHARED_KEY);
+        request.set_client_id(client_id);
+        request.set_lease_ms(config.GetLockLeaseMs());
+        BlockingLockResponse reply;
+        stub->AcquireLock(&context, request, &reply);
+    }
+}
 
 void worker_thread_abd(ABDClient& client, int client_id, 
                        int crash_after_sec, int total_duration_sec,
@@ -68,7 +110,7 @@ void worker_thread_abd(ABDClient& client, int client_id,
         // Simulate crash: stop this client after crash_time
         if (is_crash_client && std::chrono::steady_clock::now() >= crash_time) {
             if (!crash_occurred.load()) {
-                crash_occurred.store(true);
+                note_crash();
                 std::cout << "[Client " << client_id << "] CRASHED at " 
                           << crash_after_sec << " seconds" << std::endl;
             }
@@ -77,7 +119,8 @@ void worker_thread_abd(ABDClient& client, int client_id,
         
         bool is_before_crash = !crash_occurred.load();
         
-        std::string key = "crash_test_key_" + std::to_string(key_counter);
+        bool shared = key_counter % SHARED_KEY_EVERY == SHARED_KEY_EVERY - 1;   // Always a write
+        std::string key = shared ? SHARED_KEY : "crash_test_key_" + std::to_string(key_counter);
         auto op_start = std::chrono::high_resolution_clock::now();
         
         // Alternate between read and write
@@ -89,6 +132,9 @@ void worker_thread_abd(ABDClient& client, int client_id,
                 op_end - op_start).count();
             
             if (success) {
+                if (shared) {
+                    note_shared_key_success();
+                }
                 if (is_before_crash) {
                     global_crash_stats.ops_before_crash++;
                     global_crash_stats.add_latency_before(latency_us);
@@ -111,6 +157,9 @@ void worker_thread_abd(ABDClient& client, int client_id,
                 op_end - op_start).count();
             
             if (success) {
+                if (shared) {
+                    note_shared_key_success();
+                }
                 if (is_before_crash) {
                     global_crash_stats.ops_before_crash++;
                     global_crash_stats.add_latency_before(latency_us);
@@ -132,7 +181,7 @@ void worker_thread_abd(ABDClient& client, int client_id,
     }
 }
 
-void worker_thread_blocking(BlockingClient& client, int client_id,
+void worker_thread_blocking(BlockingClient& client, const Config& config, int client_id,
                             int crash_after_sec, int total_duration_sec,
                             bool is_crash_client) {
     auto start_time = std::chrono::steady_clock::now();
@@ -144,16 +193,20 @@ void worker_thread_blocking(BlockingClient& client, int client_id,
     while (std::chrono::steady_clock::now() < end_time) {
         if (is_crash_client && std::chrono::steady_clock::now() >= crash_time) {
             if (!crash_occurred.load()) {
-                crash_occurred.store(true);
+                // Die in the middle of an operation on the shared key
+                abandon_shared_key_locks(config, client_id + 1);
+                note_crash();
                 std::cout << "[Client " << client_id << "] CRASHED at " 
-                          << crash_after_sec << " seconds" << std::endl;
+                          << crash_after_sec << " seconds holding the locks on '"
+                          << SHARED_KEY << "'" << std::endl;
             }
             break;
         }
         
         bool is_before_crash = !crash_occurred.load();
         
-        std::string key = "crash_test_key_" + std::to_string(key_counter);
+        bool shared = key_counter % SHARED_KEY_EVERY == SHARED_KEY_EVERY - 1;   // Always a write
+        std::string key = shared ? SHARED_KEY : "crash_test_key_" + std::to_string(key_counter);
         auto op_start = std::chrono::high_resolution_clock::now();
         
         if (key_counter % 2 == 0) {
@@ -164,6 +217,9 @@ void worker_thread_blocking(BlockingClient& client, int client_id,
                 op_end - op_start).count();
             
             if (success) {
+                if (shared) {
+                    note_shared_key_success();
+                }
                 if (is_before_crash) {
                     global_crash_stats.ops_before_crash++;
                     global_crash_stats.add_latency_before(latency_us);
@@ -186,6 +242,9 @@ void worker_thread_blocking(BlockingClient& client, int client_id,
                 op_end - op_start).count();
             
             if (success) {
+                if (shared) {
+                    note_shared_key_success();
+                }
                 if (is_before_crash) {
                     global_crash_stats.ops_before_crash++;
                     global_crash_stats.add_latency_before(latency_us);
@@ -253,11 +312,17 @@ void print_crash_results(const std::string& protocol, int num_servers,
     std::cout << "Impact:" << std::endl;
     std::cout << "  Throughput Change: " << throughput_change << "%" << std::endl;
     std::cout << "  Latency Change:    " << latency_change << "%" << std::endl;
+    if (shared_key_recovery_ms.load() >= 0) {
+        std::cout << "  Shared Key Recovered: " << shared_key_recovery_ms.load()
+                  << " ms after the crash" << std::endl;
+    } else {
+        std::cout << "  Shared Key Recovered: never" << std::endl;
+    }
 }
 
 int main(int argc, char** argv) {
     if (argc < 6) {
-        std::cerr << "Usage: " << argv[0] << " <config_file> <protocol> <num_clients> <crash_after_sec> <total_duration_sec>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <config_file> <protocol> <num_clients> <crash_after_sec> <total_duration_sec> [--lease-ms <ms>]" << std::endl;
         return 1;
     }
     
@@ -266,6 +331,16 @@ int main(int argc, char** argv) {
     int num_clients = std::stoi(argv[3]);
     int crash_after_sec = std::stoi(argv[4]);
     int total_duration_sec = std::stoi(argv[5]);
+    int32_t lease_ms = 0;   // 0 = keep the config's lock lease
+    for (int i = 6; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--lease-ms" && i + 1 < argc) {
+            lease_ms = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "Error: Unknown option '" << arg << "'" << std::endl;
+            return 1;
+        }
+    }
     
     if (protocol != "abd" && protocol != "blocking") {
         std::cerr << "Error: Protocol must be 'abd' or 'blocking'" << std::endl;
@@ -283,6 +358,10 @@ int main(int argc, char** argv) {
         return 1;
     }
     
+    if (lease_ms > 0) {
+        config.SetLockLeaseMs(lease_ms);
+    }
+    
     int num_servers = static_cast<int>(config.GetServers().size());
     
     std::cout << "Starting crash impact evaluation..." << std::endl;
@@ -291,6 +370,9 @@ int main(int argc, char** argv) {
     std::cout << "Servers: " << num_servers << std::endl;
     std::cout << "Clients: " << num_clients << " (1 will crash after " << crash_after_sec << " seconds)" << std::endl;
     std::cout << "Duration: " << total_duration_sec << " seconds" << std::endl;
+    if (protocol == "blocking") {
+        std::cout << "Lock Lease: " << config.GetLockLeaseMs() << " ms" << std::endl;
+    }
     std::cout << std::endl;
     
     // Print server addresses from config
@@ -307,13 +389,14 @@ int main(int argc, char** argv) {
     global_crash_stats.latencies_before.clear();
     global_crash_stats.latencies_after.clear();
     crash_occurred.store(false);
+    shared_key_recovery_ms.store(-1);
     
     // Start worker threads
     std::vector<std::thread> threads;
     
     if (protocol == "abd") {
         for (int i = 0; i < num_clients; i++) {
-            ABDClient* client = new ABDClient(config);
+            ABDClient* client = new ABDClient(config, i + 1);
             bool is_crash_client = (i == 0);  // First client crashes
             threads.emplace_back(worker_thread_abd, std::ref(*client), i,
                                 crash_after_sec, total_duration_sec, is_crash_client);
@@ -322,7 +405,7 @@ int main(int argc, char** argv) {
         for (int i = 0; i < num_clients; i++) {
             BlockingClient* client = new BlockingClient(config, i + 1);
             bool is_crash_client = (i == 0);
-            threads.emplace_back(worker_thread_blocking, std::ref(*client), i,
+            threads.emplace_back(worker_thread_blocking, std::ref(*client), std::cref(config), i,
                                 crash_after_sec, total_duration_sec, is_crash_client);
         }
     }
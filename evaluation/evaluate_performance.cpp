@@ -10,9 +10,20 @@
 #include <cmath>
 #include <mutex>
 #include <cstdlib>
+#include <memory>
+#include <array>
+#include <cstdio>
+#include <random>
+#include <sstream>
 #include "../src/client/abd_client.h"
 #include "../src/client/blocking_client.h"
 #include "../src/common/config.h"
+#include "../src/common/histogram.h"
+#include "../src/common/phase_timer.h"
+#include "../src/common/profile_interceptor.h"
+#include "../src/common/profiler.h"
+#include "results_json.h"
+#include "workload.h"
 
 using namespace kvstore;
 
@@ -21,147 +32,159 @@ struct Stats {
     std::atomic<int64_t> total_gets{0};
     std::atomic<int64_t> total_puts{0};
     std::atomic<int64_t> failed_ops{0};
+};
+
+// Latencies recorded by one worker thread (in microseconds). Each thread
+// owns one, so recording never takes a lock; they are merged at the end.
+struct ThreadLatency {
+    LatencyHistogram get;
+    LatencyHistogram put;
+    std::array<LatencyHistogram, kNumPhases> phases;   // Per protocol phase
     
-    // Latency measurements (in microseconds)
-    std::vector<int64_t> get_latencies;
-    std::vector<int64_t> put_latencies;
-    
-    std::mutex latency_mutex;
-    
-    void add_get_latency(int64_t latency_us) {
-        std::lock_guard<std::mutex> lock(latency_mutex);
-        get_latencies.push_back(latency_us);
-    }
-    
-    void add_put_latency(int64_t latency_us) {
-        std::lock_guard<std::mutex> lock(latency_mutex);
-        put_latencies.push_back(latency_us);
-    }
-    
-    void compute_percentiles(const std::vector<int64_t>& latencies, 
-                             int64_t& median, int64_t& p95) {
-        if (latencies.empty()) {
-            median = 0;
-            p95 = 0;
-            return;
+    void Merge(const ThreadLatency& other) {
+        get.Merge(other.get);
+        put.Merge(other.put);
+        for (size_t p = 0; p < kNumPhases; p++) {
+            phases[p].Merge(other.phases[p]);
         }
-        
-        std::vector<int64_t> sorted = latencies;
-        std::sort(sorted.begin(), sorted.end());
-        
-        median = sorted[sorted.size() / 2];
-        p95 = sorted[static_cast<size_t>(sorted.size() * 0.95)];
     }
 };
 
 // Global stats
 Stats global_stats;
 
-// Worker thread for ABD Protocol
-void worker_thread_abd(ABDClient& client, double get_ratio, 
-                       int duration_sec, int client_id) {
-    auto start_time = std::chrono::steady_clock::now();
-    auto end_time = start_time + std::chrono::seconds(duration_sec);
-    
-    int key_counter = client_id * 10000;
-    
-    while (std::chrono::steady_clock::now() < end_time) {
-        double rand_val = static_cast<double>(rand()) / RAND_MAX;
-        bool is_get = (rand_val < get_ratio);
-        
-        std::string key = "perf_key_" + std::to_string(key_counter);
-        auto op_start = std::chrono::high_resolution_clock::now();
-        
-        if (is_get) {
-            std::string value;
-            bool success = client.Read(key, value);
-            auto op_end = std::chrono::high_resolution_clock::now();
-            auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
-                op_end - op_start).count();
-            
-            if (success) {
-                global_stats.total_gets++;
-                global_stats.add_get_latency(latency_us);
-            } else {
-                global_stats.failed_ops++;
-            }
-        } else {
-            std::string value = "value_" + std::to_string(key_counter);
-            bool success = client.Write(key, value);
-            auto op_end = std::chrono::high_resolution_clock::now();
-            auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
-                op_end - op_start).count();
-            
-            if (success) {
-                global_stats.total_puts++;
-                global_stats.add_put_latency(latency_us);
-            } else {
-                global_stats.failed_ops++;
-            }
+// Read `count` consecutive keys starting at `first` (a YCSB scan).
+bool scan_keys(ABDClient& client, uint64_t first, int count) {
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    for (int i = 0; i < count; i++) {
+        keys.push_back(WorkloadKey(first + i));
+    }
+    return client.MultiRead(keys, values);
+}
+
+bool scan_keys(BlockingClient& client, uint64_t first, int count) {
+    std::string value;
+    for (int i = 0; i < count; i++) {
+        if (!client.Read(WorkloadKey(first + i), value)) {
+            return false;
         }
-        
-        global_stats.total_ops++;
-        key_counter++;
     }
+    return true;
 }
 
-// Worker thread for Blocking Protocol
-void worker_thread_blocking(BlockingClient& client, double get_ratio,
-                            int duration_sec, int client_id) {
+// Run one generated operation.
+template <typename Client>
+bool run_op(Client& client, const WorkloadGenerator::Op& op) {
+    std::string key = WorkloadKey(op.key_number);
+    std::string value;
+    switch (op.type) {
+        case OpType::READ:
+            return client.Read(key, value);
+        case OpType::UPDATE:
+        case OpType::INSERT:
+            return client.Write(key, WorkloadGenerator::MakeValue(op.key_number, op.value_bytes));
+        case OpType::READ_MODIFY_WRITE:
+            return client.Read(key, value) &&
+                   client.Write(key, WorkloadGenerator::MakeValue(op.key_number, op.value_bytes));
+        case OpType::SCAN:
+            return scan_keys(client, op.key_number, op.scan_length);
+    }
+    return false;
+}
+
+// Worker thread: runs the workload's operations against one client (ABD or
+// Blocking) until the duration is over. Closed loop by default; with a rate
+// the thread follows its own Poisson schedule and each latency is measured
+// from the operation's scheduled start, so time spent queued behind a slow
+// operation counts.
+// @param ops_per_sec This thread's share of the offered load (0 = closed loop)
+template <typename Client>
+void worker_thread(Client& client, WorkloadState& workload, double ops_per_sec, int duration_sec,
+                   uint64_t seed, ThreadLatency& latency) {
     auto start_time = std::chrono::steady_clock::now();
     auto end_time = start_time + std::chrono::seconds(duration_sec);
     
-    int key_counter = client_id * 10000;
+    WorkloadGenerator generator(workload, seed);
+    PoissonArrivals arrivals(ops_per_sec > 0 ? ops_per_sec : 1, start_time);
+    PhaseTrace trace;
+    SetThreadPhaseTrace(&trace);
     
     while (std::chrono::steady_clock::now() < end_time) {
-        double rand_val = static_cast<double>(rand()) / RAND_MAX;
-        bool is_get = (rand_val < get_ratio);
+        auto op_start = std::chrono::steady_clock::now();
+        if (ops_per_sec > 0) {
+            op_start = arrivals.Next(generator.Rng());
+            if (op_start >= end_time) {
+                break;
+            }
+            std::this_thread::sleep_until(op_start);
+        }
+        WorkloadGenerator::Op op = generator.Next();
+        bool is_get = op.type == OpType::READ || op.type == OpType::SCAN;
+        trace.Reset();
+        profile::AllocationMark allocations = profile::ThreadAllocations();
         
-        std::string key = "perf_key_" + std::to_string(key_counter);
-        auto op_start = std::chrono::high_resolution_clock::now();
+        bool success = run_op(client, op);
+        if (profile::Enabled()) {
+            profile::RecordRequest(allocations);
+        }
+        auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - op_start).count();
         
-        if (is_get) {
-            std::string value;
-            bool success = client.Read(key, value);
-            auto op_end = std::chrono::high_resolution_clock::now();
-            auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
-                op_end - op_start).count();
-            
-            if (success) {
-                global_stats.total_gets++;
-                global_stats.add_get_latency(latency_us);
-            } else {
-                global_stats.failed_ops++;
+        if (success) {
+            (is_get ? global_stats.total_gets : global_stats.total_puts)++;
+            (is_get ? latency.get : latency.put).Record(latency_us);
+            for (size_t p = 0; p < kNumPhases; p++) {
+                if (trace.us[p] >= 0) {
+                    latency.phases[p].Record(trace.us[p]);
+                }
             }
         } else {
-            std::string value = "value_" + std::to_string(key_counter);
-            bool success = client.Write(key, value);
-            auto op_end = std::chrono::high_resolution_clock::now();
-            auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
-                op_end - op_start).count();
-            
-            if (success) {
-                global_stats.total_puts++;
-                global_stats.add_put_latency(latency_us);
-            } else {
-                global_stats.failed_ops++;
-            }
+            global_stats.failed_ops++;
         }
         
         global_stats.total_ops++;
-        key_counter++;
     }
+    SetThreadPhaseTrace(nullptr);
+}
+
+// Print the percentiles of one latency distribution, one per line.
+void print_percentiles(const LatencyHistogram& histogram) {
+    std::cout << "  Median:         " << histogram.Percentile(0.50) << " microseconds" << std::endl;
+    std::cout << "  90th Percentile: " << histogram.Percentile(0.90) << " microseconds" << std::endl;
+    std::cout << "  95th Percentile: " << histogram.Percentile(0.95) << " microseconds" << std::endl;
+    std::cout << "  99th Percentile: " << histogram.Percentile(0.99) << " microseconds" << std::endl;
+    std::cout << "  99.9th Percentile: " << histogram.Percentile(0.999) << " microseconds" << std::endl;
+    std::cout << "  Max:            " << histogram.Max() << " microseconds" << std::endl;
 }
 
 void print_results(const std::string& protocol, int num_servers, 
-                   int num_clients, double get_ratio, int duration_sec) {
+                   int num_clients, double get_ratio, int duration_sec,
+                   bool use_pool, int coalesce_window_us, TransportType transport,
+                   const WorkloadSpec& workload, double offered_rate,
+                   const ThreadLatency& latency) {
     std::cout << std::endl;
     std::cout << "Performance Evaluation Results" << std::endl;
     std::cout << "Protocol:        " << protocol << std::endl;
+    std::cout << "Connection Pool: " << (use_pool ? "on" : "off") << std::endl;
+    std::cout << "Coalesce Window: " << coalesce_window_us << " microseconds" << std::endl;
+    std::cout << "Transport:       " << (transport == TransportType::STREAM ? "stream" : "unary")
+              << std::endl;
     std::cout << "Number of Servers: " << num_servers << std::endl;
     std::cout << "Number of Clients: " << num_clients << std::endl;
     std::cout << "Get Ratio:       " << (get_ratio * 100) << "%" << std::endl;
     std::cout << "Put Ratio:       " << ((1.0 - get_ratio) * 100) << "%" << std::endl;
+    std::cout << "Workload:        " << workload.name << " (keys=" << KeyDistributionName(workload.keys)
+              << ", records=" << workload.record_count << ", values=" << workload.min_value_bytes;
+    if (workload.max_value_bytes != workload.min_value_bytes) {
+        std::cout << "-" << workload.max_value_bytes;
+    }
+    std::cout << " bytes)" << std::endl;
+    if (offered_rate > 0) {
+        std::cout << "Offered Load:    " << offered_rate << " requests/sec (open loop)" << std::endl;
+    } else {
+        std::cout << "Offered Load:    closed loop" << std::endl;
+    }
     std::cout << "Duration:         " << duration_sec << " seconds" << std::endl;
     std::cout << std::endl;
     
@@ -174,17 +197,10 @@ void print_results(const std::string& protocol, int num_servers,
     std::cout << std::endl;
     
     // Latency statistics
-    int64_t get_median = 0, get_p95 = 0;
-    int64_t put_median = 0, put_p95 = 0;
-    
-    global_stats.compute_percentiles(global_stats.get_latencies, get_median, get_p95);
-    global_stats.compute_percentiles(global_stats.put_latencies, put_median, put_p95);
-    
     std::cout << "Latency (GET operations):" << std::endl;
     std::cout << "  Total GETs:     " << global_stats.total_gets << std::endl;
-    if (!global_stats.get_latencies.empty()) {
-        std::cout << "  Median:         " << get_median << " microseconds" << std::endl;
-        std::cout << "  95th Percentile: " << get_p95 << " microseconds" << std::endl;
+    if (latency.get.Count() > 0) {
+        print_percentiles(latency.get);
     } else {
         std::cout << "  No GET operations performed" << std::endl;
     }
@@ -192,17 +208,234 @@ void print_results(const std::string& protocol, int num_servers,
     
     std::cout << "Latency (PUT operations):" << std::endl;
     std::cout << "  Total PUTs:     " << global_stats.total_puts << std::endl;
-    if (!global_stats.put_latencies.empty()) {
-        std::cout << "  Median:         " << put_median << " microseconds" << std::endl;
-        std::cout << "  95th Percentile: " << put_p95 << " microseconds" << std::endl;
+    if (latency.put.Count() > 0) {
+        print_percentiles(latency.put);
     } else {
         std::cout << "  No PUT operations performed" << std::endl;
     }
+    
+    // Per-phase breakdown, for the phases this protocol goes through
+    std::cout << std::endl;
+    std::cout << "Latency by phase (microseconds):" << std::endl;
+    std::cout << "  phase            count       p50       p90       p99     p99.9       max"
+              << std::endl;
+    for (size_t p = 0; p < kNumPhases; p++) {
+        const LatencyHistogram& h = latency.phases[p];
+        if (h.Count() == 0) {
+            continue;
+        }
+        char line[128];
+        std::snprintf(line, sizeof(line), "  %-14s %7llu %9lld %9lld %9lld %9lld %9lld",
+                      PhaseName(static_cast<Phase>(p)),
+                      static_cast<unsigned long long>(h.Count()),
+                      static_cast<long long>(h.Percentile(0.50)),
+                      static_cast<long long>(h.Percentile(0.90)),
+                      static_cast<long long>(h.Percentile(0.99)),
+                      static_cast<long long>(h.Percentile(0.999)),
+                      static_cast<long long>(h.Max()));
+        std::cout << line << std::endl;
+    }
+}
+
+// Store one distribution's percentiles under `prefix` (e.g. "get_median").
+void record_percentiles(ResultsNode& entry, const std::string& prefix,
+                        const LatencyHistogram& histogram) {
+    entry[prefix + "_median"].Set(static_cast<double>(histogram.Percentile(0.50)));
+    entry[prefix + "_p90"].Set(static_cast<double>(histogram.Percentile(0.90)));
+    entry[prefix + "_p95"].Set(static_cast<double>(histogram.Percentile(0.95)));
+    entry[prefix + "_p99"].Set(static_cast<double>(histogram.Percentile(0.99)));
+    entry[prefix + "_p999"].Set(static_cast<double>(histogram.Percentile(0.999)));
+    entry[prefix + "_max"].Set(static_cast<double>(histogram.Max()));
+}
+
+// Merge this run into a results_data.json-style file, keyed by server
+// count, workload ("90%_GETs" / "90%_PUTs"), protocol and client count.
+// Open-loop runs go under "sweeps" instead, keyed by server count,
+// workload name, protocol and offered rate, one latency-vs-throughput
+// point each.
+// @return false if the file can't be read or written
+bool save_results_json(const std::string& path, const std::string& protocol, int num_servers,
+                       int num_clients, double get_ratio, int duration_sec,
+                       const WorkloadSpec& workload, double offered_rate,
+                       const ThreadLatency& latency) {
+    ResultsNode root;
+    if (!LoadResults(path, root)) {
+        std::cerr << "Error: Cannot parse " << path << std::endl;
+        return false;
+    }
+    ResultsNode* slot;
+    if (offered_rate > 0) {
+        char rate[32];
+        std::snprintf(rate, sizeof(rate), "%.15g", offered_rate);
+        slot = &root["sweeps"][std::to_string(num_servers)][workload.name][protocol][rate];
+    } else {
+        // Name the workload after its dominant operation, as the plots do
+        int get_pct = static_cast<int>(std::lround(get_ratio * 100));
+        std::string mix = get_pct >= 50 ? std::to_string(get_pct) + "%_GETs"
+                                        : std::to_string(100 - get_pct) + "%_PUTs";
+        slot = &root[std::to_string(num_servers)][mix][protocol][std::to_string(num_clients)];
+    }
+    ResultsNode& entry = *slot;
+    entry = ResultsNode();
+    
+    double throughput = static_cast<double>(global_stats.total_ops) / duration_sec;
+    entry["throughput"].Set(std::round(throughput * 100) / 100);
+    entry["failed_ops"].Set(static_cast<double>(global_stats.failed_ops));
+    if (offered_rate > 0) {
+        entry["offered_rate"].Set(offered_rate);
+    }
+    record_percentiles(entry, "get", latency.get);
+    record_percentiles(entry, "put", latency.put);
+    for (size_t p = 0; p < kNumPhases; p++) {
+        if (latency.phases[p].Count() > 0) {
+            record_percentiles(entry["phases"], PhaseName(static_cast<Phase>(p)), latency.phases[p]);
+        }
+    }
+    
+    if (!SaveResults(path, root)) {
+        std::cerr << "Error: Cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Write every record of the keyspace once, so reads find values of the
+// workload's sizes (ABD in MultiWrite batches, Blocking one key at a time).
+// @return false if a write fails
+bool load_records(const Config& config, const std::string& protocol, const WorkloadSpec& workload) {
+    constexpr uint64_t kBatch = 100;
+    std::cerr << "Loading " << workload.record_count << " records..." << std::endl;
+    std::mt19937_64 rng(workload.record_count);
+    size_t span = workload.max_value_bytes - workload.min_value_bytes + 1;
+    auto value_for = [&](uint64_t k) {
+        return WorkloadGenerator::MakeValue(k, workload.min_value_bytes + rng() % span);
+    };
+    if (protocol == "abd") {
+        ABDClient client(config, 0);
+        for (uint64_t first = 0; first < workload.record_count; first += kBatch) {
+            std::vector<std::string> keys;
+            std::vector<std::string> values;
+            for (uint64_t k = first; k < std::min(first + kBatch, workload.record_count); k++) {
+                keys.push_back(WorkloadKey(k));
+                values.push_back(value_for(k));
+            }
+            if (!client.MultiWrite(keys, values)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    BlockingClient client(config, 1);
+    for (uint64_t k = 0; k < workload.record_count; k++) {
+        if (!client.Write(WorkloadKey(k), value_for(k))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parse a comma-separated list of positive rates ("1000,2000,4000").
+bool parse_rates(const std::string& list, std::vector<double>& rates) {
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        double rate = std::stod(item);
+        if (rate <= 0) {
+            return false;
+        }
+        rates.push_back(rate);
+    }
+    return !rates.empty();
+}
+
+// Run one timed evaluation and print its results.
+// @param shared_client Run every ABD thread on one shared client, so that
+//                      concurrent operations can be coalesced into batches
+// @param workload Operation mix, keys and value sizes
+// @param offered_rate Total open-loop rate in operations/sec (0 = closed loop)
+// @param seed Base seed for the per-thread generators
+// @param json_path Results file to merge this run into (empty = don't)
+void run_evaluation(const Config& config, const std::string& protocol,
+                    int num_clients, double get_ratio, int duration_sec,
+                    bool shared_client, const WorkloadSpec& workload, double offered_rate,
+                    uint64_t seed, const std::string& json_path) {
+    int num_servers = static_cast<int>(config.GetServers().size());
+    
+    std::cerr << "Starting test (connection pool "
+              << (config.UseConnectionPool() ? "on" : "off");
+    if (offered_rate > 0) {
+        std::cerr << ", " << offered_rate << " requests/sec offered";
+    }
+    std::cerr << ")..." << std::endl;
+    
+    WorkloadState state(workload);
+    double thread_rate = offered_rate / num_clients;
+    
+    global_stats.total_ops = 0;
+    global_stats.total_gets = 0;
+    global_stats.total_puts = 0;
+    global_stats.failed_ops = 0;
+    
+    // Start worker threads
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<ABDClient>> abd_clients;
+    std::vector<std::unique_ptr<BlockingClient>> blocking_clients;
+    std::vector<std::unique_ptr<ThreadLatency>> latencies;
+    for (int i = 0; i < num_clients; i++) {
+        latencies.push_back(std::make_unique<ThreadLatency>());
+    }
+    auto test_start = std::chrono::steady_clock::now();
+    
+    if (protocol == "abd") {
+        for (int i = 0; i < num_clients; i++) {
+            if (!shared_client || abd_clients.empty()) {
+                abd_clients.push_back(std::make_unique<ABDClient>(config, i + 1));
+            }
+            threads.emplace_back(worker_thread<ABDClient>, std::ref(*abd_clients.back()),
+                                 std::ref(state), thread_rate, duration_sec, seed + i,
+                                 std::ref(*latencies[i]));
+        }
+    } else {
+        for (int i = 0; i < num_clients; i++) {
+            blocking_clients.push_back(std::make_unique<BlockingClient>(config, i + 1));
+            threads.emplace_back(worker_thread<BlockingClient>, std::ref(*blocking_clients.back()),
+                                 std::ref(state), thread_rate, duration_sec, seed + i,
+                                 std::ref(*latencies[i]));
+        }
+    }
+    
+    // Wait for all threads to complete
+    for (auto& t : threads) {
+        t.join();
+    }
+    
+    auto test_end = std::chrono::steady_clock::now();
+    auto actual_duration = std::chrono::duration_cast<std::chrono::seconds>(
+        test_end - test_start).count();
+    
+    auto merged = std::make_unique<ThreadLatency>();
+    for (const auto& latency : latencies) {
+        merged->Merge(*latency);
+    }
+    
+    // Print results
+    print_results(protocol, num_servers, num_clients, get_ratio, actual_duration,
+                  config.UseConnectionPool(), config.GetCoalesceWindowUs(), config.GetTransport(),
+                  workload, offered_rate, *merged);
+    if (!json_path.empty()) {
+        save_results_json(json_path, protocol, num_servers, num_clients, get_ratio,
+                          actual_duration, workload, offered_rate, *merged);
+    }
 }
 
 int main(int argc, char** argv) {
     if (argc < 6) {
-        std::cerr << "Usage: " << argv[0] << " <config_file> <protocol> <num_clients> <get_ratio> <duration_sec>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <config_file> <protocol> <num_clients> <get_ratio> <duration_sec>"
+                  << " [--pool on|off|both] [--shared-client] [--coalesce <window_us>]"
+                  << " [--transport unary|stream|both] [--json <results_file>]"
+                  << " [--workload a-f] [--keys uniform|zipfian|hotspot|latest] [--records <n>]"
+                  << " [--zipf-theta <t>] [--value-size <bytes>|<min>-<max>] [--load]"
+                  << " [--rate <ops_per_sec>] [--sweep <rate,rate,...>] [--seed <n>] [--profile]" << std::endl;
         return 1;
     }
     
@@ -211,6 +444,61 @@ int main(int argc, char** argv) {
     int num_clients = std::stoi(argv[3]);
     double get_ratio = std::stod(argv[4]);
     int duration_sec = std::stoi(argv[5]);
+    std::string pool_mode = "";
+    bool shared_client = false;
+    int coalesce_window_us = -1;   // -1 = keep the config file's setting
+    std::string transport_mode = "";
+    std::string json_path = "";
+    WorkloadSpec workload;
+    workload.read_ratio = get_ratio;
+    workload.update_ratio = 1.0 - get_ratio;
+    std::string preset = "";
+    std::string keys_name = "";
+    bool load = false;
+    std::vector<double> rates;      // Open-loop rates to run (empty = closed loop)
+    uint64_t seed = std::random_device{}();
+    bool profiling = false;
+    
+    // Parse optional flags
+    for (int i = 6; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--pool" && i + 1 < argc) {
+            pool_mode = argv[++i];
+        } else if (arg == "--shared-client") {
+            shared_client = true;
+        } else if (arg == "--coalesce" && i + 1 < argc) {
+            coalesce_window_us = std::stoi(argv[++i]);
+        } else if (arg == "--transport" && i + 1 < argc) {
+            transport_mode = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--workload" && i + 1 < argc) {
+            preset = argv[++i];
+        } else if (arg == "--keys" && i + 1 < argc) {
+            keys_name = argv[++i];
+        } else if (arg == "--records" && i + 1 < argc) {
+            workload.record_count = std::stoull(argv[++i]);
+        } else if (arg == "--zipf-theta" && i + 1 < argc) {
+            workload.zipf_theta = std::stod(argv[++i]);
+        } else if (arg == "--value-size" && i + 1 < argc) {
+            std::string sizes = argv[++i];
+            size_t dash = sizes.find('-');
+            workload.min_value_bytes = std::stoul(sizes.substr(0, dash));
+            workload.max_value_bytes = dash == std::string::npos ? workload.min_value_bytes
+                                                                 : std::stoul(sizes.substr(dash + 1));
+        } else if (arg == "--load") {
+            load = true;
+        } else if ((arg == "--rate" || arg == "--sweep") && i + 1 < argc) {
+            if (!parse_rates(argv[++i], rates)) {
+                std::cerr << "Error: " << arg << " takes positive rates" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--profile") {
+            profiling = true;
+        }
+    }
     
     if (protocol != "abd" && protocol != "blocking") {
         std::cerr << "Error: Protocol must be 'abd' or 'blocking'" << std::endl;
@@ -222,12 +510,50 @@ int main(int argc, char** argv) {
         return 1;
     }
     
+    if (!pool_mode.empty() && pool_mode != "on" && pool_mode != "off" && pool_mode != "both") {
+        std::cerr << "Error: --pool must be 'on', 'off' or 'both'" << std::endl;
+        return 1;
+    }
+    
+    if (!transport_mode.empty() && transport_mode != "unary" && transport_mode != "stream" &&
+        transport_mode != "both") {
+        std::cerr << "Error: --transport must be 'unary', 'stream' or 'both'" << std::endl;
+        return 1;
+    }
+    
+    if (!preset.empty()) {
+        if (!ApplyYcsbPreset(preset, workload)) {
+            std::cerr << "Error: --workload must be one of a-f" << std::endl;
+            return 1;
+        }
+        // Report the preset's share of reads (scans count as reads)
+        get_ratio = workload.read_ratio + workload.scan_ratio;
+    }
+    if (!keys_name.empty() && !ParseKeyDistribution(keys_name, workload.keys)) {
+        std::cerr << "Error: --keys must be 'uniform', 'zipfian', 'hotspot' or 'latest'" << std::endl;
+        return 1;
+    }
+    if (workload.record_count == 0 || workload.max_value_bytes < workload.min_value_bytes ||
+        workload.zipf_theta <= 0 || workload.zipf_theta >= 1) {
+        std::cerr << "Error: Invalid workload (records > 0, value sizes min <= max, 0 < zipf-theta < 1)"
+                  << std::endl;
+        return 1;
+    }
+    
     Config config;
     if (!config.LoadFromFile(config_file)) {
         std::cerr << "Error: Failed to load config file: " << config_file << std::endl;
         return 1;
     }
     
+    if (coalesce_window_us >= 0) {
+        config.SetCoalesceWindowUs(coalesce_window_us);
+    }
+    // Coalescing only merges operations issued through the same client
+    if (config.GetCoalesceWindowUs() > 0) {
+        shared_client = true;
+    }
+    
     int num_servers = static_cast<int>(config.GetServers().size());
     
     // Print startup info to stderr (so it can be filtered out)
@@ -247,45 +573,59 @@ int main(int argc, char** argv) {
     }
     std::cerr << std::endl;
     
-    std::cerr << "Starting test..." << std::endl;
-    
-    global_stats.total_ops = 0;
-    global_stats.total_gets = 0;
-    global_stats.total_puts = 0;
-    global_stats.failed_ops = 0;
-    global_stats.get_latencies.clear();
-    global_stats.put_latencies.clear();
-    
-    // Start worker threads
-    std::vector<std::thread> threads;
-    auto test_start = std::chrono::steady_clock::now();
+    // "both" runs the same workload with and without the connection pool
+    // so the per-operation connection cost can be compared directly.
+    std::vector<bool> pool_settings;
+    if (pool_mode == "both") {
+        pool_settings = {true, false};
+    } else if (pool_mode.empty()) {
+        pool_settings = {config.UseConnectionPool()};
+    } else {
+        pool_settings = {pool_mode == "on"};
+    }
     
-    if (protocol == "abd") {
-        for (int i = 0; i < num_clients; i++) {
-            ABDClient* client = new ABDClient(config);
-            threads.emplace_back(worker_thread_abd, std::ref(*client), 
-                                get_ratio, duration_sec, i);
-        }
+    // Likewise "both" compares unary RPCs with per-replica streams (ABD only)
+    std::vector<TransportType> transports;
+    if (transport_mode == "both") {
+        transports = {TransportType::UNARY, TransportType::STREAM};
+    } else if (transport_mode.empty()) {
+        transports = {config.GetTransport()};
     } else {
-        for (int i = 0; i < num_clients; i++) {
-            BlockingClient* client = new BlockingClient(config, i + 1);
-            threads.emplace_back(worker_thread_blocking, std::ref(*client),
-                                get_ratio, duration_sec, i);
-        }
+        transports = {transport_mode == "stream" ? TransportType::STREAM : TransportType::UNARY};
     }
     
-    // Wait for all threads to complete
-    for (auto& t : threads) {
-        t.join();
+    // Before the first channel and the first client thread
+    std::unique_ptr<profile::SignalWindows> profile_windows;
+    if (profiling) {
+        profile::BlockSignals(false);
+        profile::Enable();
+        profile::RegisterClientProfiling();
+        profile_windows = std::make_unique<profile::SignalWindows>();
     }
     
-    auto test_end = std::chrono::steady_clock::now();
-    auto actual_duration = std::chrono::duration_cast<std::chrono::seconds>(
-        test_end - test_start).count();
+    if (load && !load_records(config, protocol, workload)) {
+        std::cerr << "Error: Loading the records failed" << std::endl;
+        return 1;
+    }
     
-    // Print results
-    print_results(protocol, num_servers, num_clients, get_ratio, actual_duration);
+    // A sweep runs every rate in turn: one latency-vs-throughput point each
+    if (rates.empty()) {
+        rates.push_back(0);
+    }
+    profile::Totals profile_start = profile::Capture();
+    for (TransportType transport : transports) {
+        config.SetTransport(transport);
+        for (bool use_pool : pool_settings) {
+            config.SetUseConnectionPool(use_pool);
+            for (double rate : rates) {
+                run_evaluation(config, protocol, num_clients, get_ratio, duration_sec, shared_client,
+                               workload, rate, seed, json_path);
+            }
+        }
+    }
+    if (profiling) {
+        profile::PrintReport("Client profile", profile_start, profile::Capture(), std::cout);
+    }
     
     return 0;
 }
-
@@ -0,0 +1,133 @@
+// Minimal reader/writer for results_data.json, the file generate_plots_conda.py
+// plots from. The file is nested objects with numeric leaves:
+//   {"<servers>": {"90%_GETs": {"<protocol>": {"<clients>": {"throughput": ...}}}}}
+// Evaluation runs merge their numbers into it, leaving every other entry alone.
+
+#pragma once
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace kvstore {
+
+struct ResultsNode {
+    std::map<std::string, ResultsNode> children;
+    bool is_number = false;
+    double number = 0;
+
+    ResultsNode& operator[](const std::string& key) { return children[key]; }
+
+    void Set(double value) {
+        children.clear();
+        is_number = true;
+        number = value;
+    }
+};
+
+namespace results_json_internal {
+
+inline void SkipSpace(const std::string& s, size_t& pos) {
+    while (pos < s.size() && std::isspace(static_cast<unsigned char>(s[pos]))) {
+        pos++;
+    }
+}
+
+inline bool ParseNode(const std::string& s, size_t& pos, ResultsNode& node) {
+    SkipSpace(s, pos);
+    if (pos >= s.size()) {
+        return false;
+    }
+    if (s[pos] != '{') {
+        size_t end = s.find_first_of(",}", pos);
+        std::string text = s.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        try {
+            node.Set(std::stod(text));
+        } catch (...) {
+            return false;
+        }
+        pos = end == std::string::npos ? s.size() : end;
+        return true;
+    }
+    pos++;
+    for (;;) {
+        SkipSpace(s, pos);
+        if (pos < s.size() && s[pos] == '}') {
+            pos++;
+            return true;
+        }
+        if (pos >= s.size() || s[pos] != '"') {
+            return false;
+        }
+        size_t key_end = s.find('"', pos + 1);
+        if (key_end == std::string::npos) {
+            return false;
+        }
+        std::string key = s.substr(pos + 1, key_end - pos - 1);
+        pos = s.find(':', key_end);
+        if (pos == std::string::npos) {
+            return false;
+        }
+        pos++;
+        if (!ParseNode(s, pos, node.children[key])) {
+            return false;
+        }
+        SkipSpace(s, pos);
+        if (pos < s.size() && s[pos] == ',') {
+            pos++;
+        }
+    }
+}
+
+inline void WriteNode(std::ostream& out, const ResultsNode& node, int indent) {
+    if (node.is_number) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.15g", node.number);
+        out << text;
+        return;
+    }
+    out << "{";
+    bool first = true;
+    for (const auto& [key, child] : node.children) {
+        out << (first ? "" : ",") << "\n" << std::string(indent + 2, ' ') << "\"" << key << "\": ";
+        WriteNode(out, child, indent + 2);
+        first = false;
+    }
+    if (!first) {
+        out << "\n" << std::string(indent, ' ');
+    }
+    out << "}";
+}
+
+} // namespace results_json_internal
+
+// Load a results file. A missing file loads as an empty object.
+// @return false if the file exists but can't be parsed
+inline bool LoadResults(const std::string& path, ResultsNode& root) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return true;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    size_t pos = 0;
+    return results_json_internal::ParseNode(text, pos, root) && !root.is_number;
+}
+
+// Write a results file (keys sorted, two-space indent).
+// @return false if the file can't be written
+inline bool SaveResults(const std::string& path, const ResultsNode& root) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        return false;
+    }
+    results_json_internal::WriteNode(out, root, 0);
+    out << "\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace kvstore
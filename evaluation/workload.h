@@ -0,0 +1,298 @@
+// Workload generation for evaluate_performance.
+// A WorkloadSpec describes the operation mix (reads, updates, inserts,
+// read-modify-writes, short scans), how keys are chosen over a keyspace of
+// record_count keys (uniform, Zipfian, hotspot, or skewed towards the latest
+// inserts), and the value sizes. The YCSB core workloads A-F are available as
+// presets. Each worker thread draws operations from its own WorkloadGenerator,
+// which has its own PRNG; the only state shared between threads is the
+// read-only Zipfian table and the insert counter.
+// PoissonArrivals paces an open-loop run: operations are scheduled at
+// exponentially distributed intervals whether or not earlier ones have
+// finished, so queueing delay shows up in the measured latency instead of
+// silently lowering the offered load (coordinated omission).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+
+namespace kvstore {
+
+enum class KeyDistribution {
+    UNIFORM,        // Every key equally likely
+    ZIPFIAN,        // Popularity follows a Zipf law; popular keys are scattered over the keyspace
+    HOTSPOT,        // hot_op_fraction of the operations go to the first hot_set_fraction of the keys
+    LATEST          // Zipfian over recency: the most recently inserted keys are the most popular
+};
+
+enum class OpType { READ, UPDATE, INSERT, READ_MODIFY_WRITE, SCAN };
+
+struct WorkloadSpec {
+    std::string name = "custom";
+    // Operation mix; need not sum to 1, the ratios are normalised
+    double read_ratio = 0.9;
+    double update_ratio = 0.1;
+    double insert_ratio = 0.0;
+    double rmw_ratio = 0.0;
+    double scan_ratio = 0.0;
+
+    KeyDistribution keys = KeyDistribution::UNIFORM;
+    uint64_t record_count = 100000;     // Keys that exist before the run
+    double zipf_theta = 0.99;           // Zipf skew (YCSB's default)
+    double hot_set_fraction = 0.2;      // HOTSPOT: share of the keys that are hot
+    double hot_op_fraction = 0.8;       // HOTSPOT: share of the operations that hit them
+
+    size_t min_value_bytes = 100;       // Value sizes are uniform in [min, max]
+    size_t max_value_bytes = 100;
+    int max_scan_length = 100;          // Scans read 1..max consecutive keys
+};
+
+inline bool ParseKeyDistribution(const std::string& name, KeyDistribution& keys) {
+    if (name == "uniform") {
+        keys = KeyDistribution::UNIFORM;
+    } else if (name == "zipfian") {
+        keys = KeyDistribution::ZIPFIAN;
+    } else if (name == "hotspot") {
+        keys = KeyDistribution::HOTSPOT;
+    } else if (name == "latest") {
+        keys = KeyDistribution::LATEST;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* KeyDistributionName(KeyDistribution keys) {
+    switch (keys) {
+        case KeyDistribution::UNIFORM: return "uniform";
+        case KeyDistribution::ZIPFIAN: return "zipfian";
+        case KeyDistribution::HOTSPOT: return "hotspot";
+        case KeyDistribution::LATEST: return "latest";
+    }
+    return "unknown";
+}
+
+// Set the mix and key distribution of a YCSB core workload ("a" - "f").
+// Keyspace size and value sizes are left alone.
+// @return false for an unknown preset
+inline bool ApplyYcsbPreset(const std::string& preset, WorkloadSpec& spec) {
+    std::string name = preset;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    spec.read_ratio = spec.update_ratio = spec.insert_ratio = spec.rmw_ratio = spec.scan_ratio = 0;
+    spec.keys = KeyDistribution::ZIPFIAN;
+    if (name == "a") {              // Update heavy
+        spec.read_ratio = 0.5;
+        spec.update_ratio = 0.5;
+    } else if (name == "b") {       // Read mostly
+        spec.read_ratio = 0.95;
+        spec.update_ratio = 0.05;
+    } else if (name == "c") {       // Read only
+        spec.read_ratio = 1.0;
+    } else if (name == "d") {       // Read latest
+        spec.read_ratio = 0.95;
+        spec.insert_ratio = 0.05;
+        spec.keys = KeyDistribution::LATEST;
+    } else if (name == "e") {       // Short ranges
+        spec.scan_ratio = 0.95;
+        spec.insert_ratio = 0.05;
+    } else if (name == "f") {       // Read-modify-write
+        spec.read_ratio = 0.5;
+        spec.rmw_ratio = 0.5;
+    } else {
+        return false;
+    }
+    spec.name = "ycsb_" + name;
+    return true;
+}
+
+// Zipfian rank generator over [0, n) (Gray et al., "Quickly generating
+// billion-record synthetic databases", as used by YCSB). The constants cost
+// O(n) to compute, so one table is built per run and shared by the threads.
+class ZipfianTable {
+public:
+    ZipfianTable(uint64_t n, double theta) : n_(std::max<uint64_t>(n, 1)), theta_(theta) {
+        for (uint64_t i = 1; i <= n_; i++) {
+            zetan_ += 1.0 / std::pow(static_cast<double>(i), theta_);
+        }
+        double zeta2 = 1.0 + std::pow(0.5, theta_);
+        alpha_ = 1.0 / (1.0 - theta_);
+        eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n_), 1.0 - theta_)) / (1.0 - zeta2 / zetan_);
+        half_pow_theta_ = std::pow(0.5, theta_);
+    }
+
+    // Rank for a uniform draw u in [0, 1): 0 is the most popular.
+    uint64_t Rank(double u) const {
+        double uz = u * zetan_;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + half_pow_theta_) {
+            return 1;
+        }
+        auto rank = static_cast<uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return std::min(rank, n_ - 1);
+    }
+
+    uint64_t Size() const { return n_; }
+
+private:
+    uint64_t n_;
+    double theta_;
+    double zetan_ = 0;
+    double alpha_ = 0;
+    double eta_ = 0;
+    double half_pow_theta_ = 0;
+};
+
+// State shared by the generators of one run.
+struct WorkloadState {
+    explicit WorkloadState(const WorkloadSpec& spec)
+        : spec(spec), key_count(spec.record_count) {
+        if (spec.keys == KeyDistribution::ZIPFIAN || spec.keys == KeyDistribution::LATEST) {
+            zipf = std::make_unique<ZipfianTable>(spec.record_count, spec.zipf_theta);
+        }
+    }
+
+    WorkloadSpec spec;
+    std::unique_ptr<ZipfianTable> zipf;     // Null unless the keys are Zipfian / latest
+    std::atomic<uint64_t> key_count;        // Keys that exist now (record_count + inserts)
+};
+
+inline std::string WorkloadKey(uint64_t key_number) {
+    return "perf_key_" + std::to_string(key_number);
+}
+
+// One thread's source of operations.
+class WorkloadGenerator {
+public:
+    struct Op {
+        OpType type;
+        uint64_t key_number;        // First key for a scan
+        size_t value_bytes;         // Value to write (UPDATE / INSERT / READ_MODIFY_WRITE)
+        int scan_length;            // Keys a SCAN reads
+    };
+
+    // @param state Shared run state; must outlive the generator
+    // @param seed Seed for this thread's PRNG (distinct per thread)
+    WorkloadGenerator(WorkloadState& state, uint64_t seed) : state_(state), rng_(seed) {
+        const WorkloadSpec& spec = state_.spec;
+        double total = spec.read_ratio + spec.update_ratio + spec.insert_ratio +
+                       spec.rmw_ratio + spec.scan_ratio;
+        total = total > 0 ? total : 1;
+        cumulative_[0] = spec.read_ratio / total;
+        cumulative_[1] = cumulative_[0] + spec.update_ratio / total;
+        cumulative_[2] = cumulative_[1] + spec.insert_ratio / total;
+        cumulative_[3] = cumulative_[2] + spec.rmw_ratio / total;
+    }
+
+    Op Next() {
+        const WorkloadSpec& spec = state_.spec;
+        Op op{OpType::SCAN, 0, 0, 0};
+        double u = Uniform();
+        if (u < cumulative_[0]) {
+            op.type = OpType::READ;
+        } else if (u < cumulative_[1]) {
+            op.type = OpType::UPDATE;
+        } else if (u < cumulative_[2]) {
+            op.type = OpType::INSERT;
+        } else if (u < cumulative_[3]) {
+            op.type = OpType::READ_MODIFY_WRITE;
+        }
+
+        if (op.type == OpType::INSERT) {
+            op.key_number = state_.key_count.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            op.key_number = ChooseKey();
+        }
+        if (op.type == OpType::SCAN) {
+            op.scan_length = 1 + static_cast<int>(rng_() % static_cast<uint64_t>(
+                std::max(spec.max_scan_length, 1)));
+        } else if (op.type != OpType::READ) {
+            size_t span = spec.max_value_bytes > spec.min_value_bytes
+                ? spec.max_value_bytes - spec.min_value_bytes + 1 : 1;
+            op.value_bytes = spec.min_value_bytes + static_cast<size_t>(rng_() % span);
+        }
+        return op;
+    }
+
+    // A value of the given size (contents vary with the key).
+    static std::string MakeValue(uint64_t key_number, size_t bytes) {
+        std::string value(bytes, 'v');
+        std::string tag = std::to_string(key_number);
+        std::copy_n(tag.begin(), std::min(tag.size(), bytes), value.begin());
+        return value;
+    }
+
+    std::mt19937_64& Rng() { return rng_; }
+
+private:
+    WorkloadState& state_;
+    std::mt19937_64 rng_;
+    double cumulative_[4];
+
+    double Uniform() { return std::uniform_real_distribution<double>(0.0, 1.0)(rng_); }
+
+    uint64_t ChooseKey() {
+        const WorkloadSpec& spec = state_.spec;
+        uint64_t count = std::max<uint64_t>(state_.key_count.load(std::memory_order_relaxed), 1);
+        switch (spec.keys) {
+            case KeyDistribution::UNIFORM:
+                return rng_() % count;
+            case KeyDistribution::ZIPFIAN: {
+                // Scramble the rank so the popular keys don't cluster
+                uint64_t rank = state_.zipf->Rank(Uniform());
+                return Mix(rank) % std::min(count, state_.zipf->Size());
+            }
+            case KeyDistribution::HOTSPOT: {
+                auto hot = std::max<uint64_t>(static_cast<uint64_t>(count * spec.hot_set_fraction), 1);
+                if (Uniform() < spec.hot_op_fraction || hot >= count) {
+                    return rng_() % hot;
+                }
+                return hot + rng_() % (count - hot);
+            }
+            case KeyDistribution::LATEST: {
+                uint64_t back = state_.zipf->Rank(Uniform());
+                return back < count ? count - 1 - back : count - 1;
+            }
+        }
+        return 0;
+    }
+
+    static uint64_t Mix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+};
+
+// Open-loop schedule: start times of a Poisson process at a given rate.
+class PoissonArrivals {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // @param ops_per_sec Mean rate of this schedule
+    // @param start Time of the first arrival
+    PoissonArrivals(double ops_per_sec, Clock::time_point start)
+        : mean_gap_us_(1e6 / ops_per_sec), next_(start) {}
+
+    // The next scheduled start time (the schedule never waits for the caller).
+    Clock::time_point Next(std::mt19937_64& rng) {
+        Clock::time_point at = next_;
+        double gap = std::exponential_distribution<double>(1.0)(rng) * mean_gap_us_;
+        next_ += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(gap));
+        return at;
+    }
+
+private:
+    double mean_gap_us_;
+    Clock::time_point next_;
+};
+
+} // namespace kvstore
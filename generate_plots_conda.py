@@ -83,6 +83,40 @@ def generate_plot(results, servers_list, workload_key, plot_type, title_suffix,
     plt.close()
     print(f"Generated: {filename}")
 
+def generate_sweep_plots(results):
+    """Plot latency against achieved throughput for each open-loop sweep."""
+    sweeps = results.get('sweeps', {})
+    count = 0
+    for servers, workloads in sorted(sweeps.items()):
+        for workload, protocols in sorted(workloads.items()):
+            fig, axes = plt.subplots(1, 2, figsize=(12, 5))
+            fig.suptitle(f'Latency vs Throughput ({workload}, {servers} Server(s))', fontsize=16, fontweight='bold')
+            for ax, op in zip(axes, ['get', 'put']):
+                for protocol, style, color in [('abd', 'o', '#4A90E2'), ('blocking', 's', '#7ED321')]:
+                    points = protocols.get(protocol, {})
+                    rates = sorted(points.keys(), key=float)
+                    if not rates or not any(points[r].get(f'{op}_median', 0) for r in rates):
+                        continue
+                    throughput = [points[r].get('throughput', 0) for r in rates]
+                    medians = [points[r].get(f'{op}_median', 0) / 1000.0 for r in rates]
+                    p99s = [points[r].get(f'{op}_p99', 0) / 1000.0 for r in rates]
+                    name = 'ABD' if protocol == 'abd' else 'Blocking'
+                    ax.plot(throughput, medians, style + '-', label=f'{name} Median', linewidth=2, markersize=6, color=color)
+                    ax.plot(throughput, p99s, style + '--', label=f'{name} 99th', linewidth=2, markersize=6, color=color, alpha=0.6)
+                ax.set_xlabel('Achieved Throughput (ops/sec)', fontsize=12)
+                ax.set_ylabel('Latency (ms)', fontsize=12)
+                ax.set_title(f'{op.upper()} Latency', fontsize=14, fontweight='bold')
+                ax.set_yscale('log')
+                ax.legend(fontsize=9)
+                ax.grid(True, alpha=0.3)
+            plt.tight_layout()
+            filename = f'plot_sweep_{workload}_{servers}servers.png'
+            plt.savefig(filename, dpi=300, bbox_inches='tight')
+            plt.close()
+            print(f"Generated: {filename}")
+            count += 1
+    return count
+
 def main():
     if not HAS_MATPLOTLIB:
         return
@@ -121,6 +155,11 @@ def main():
                   'plot_put_latency_90pct_puts.png', allowed_clients)
     
     print("\nAll 6 plots generated successfully!")
+    
+    # Latency-vs-throughput curves from open-loop sweeps (--sweep), if any
+    sweep_plots = generate_sweep_plots(results)
+    if sweep_plots:
+        print(f"{sweep_plots} sweep plots generated")
 
 if __name__ == '__main__':
     main()
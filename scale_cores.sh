@@ -0,0 +1,105 @@
+#!/bin/bash
+
+# Script to measure how server throughput scales with the cores it may use
+# Starts the servers of a localhost config on this machine, pinned to the
+# first N CPUs (--cpus 0-(N-1)), for N = 1, 2, 4, ... up to 32 or the
+# machine's core count. The mode picks the thread model: sync (gRPC's sync
+# server with --cqs N), async (--async-cqs N, one thread per core) or owners
+# (async with --shard-owners 1).
+# Usage: ./scale_cores.sh <localhost_config_file> <protocol> <get_ratio> [clients] [duration] [mode]
+
+# Configuration
+CONFIG_FILE=$1
+PROTOCOL=$2
+GET_RATIO=$3
+CLIENTS=${4:-32}
+DURATION=${5:-30}
+MODE=${6:-sync}
+
+if [ -z "$CONFIG_FILE" ] || [ -z "$PROTOCOL" ] || [ -z "$GET_RATIO" ]; then
+    echo "Usage: $0 <localhost_config_file> <protocol> <get_ratio> [clients] [duration] [sync|async|owners]"
+    exit 1
+fi
+
+if [ ! -f "$CONFIG_FILE" ]; then
+    echo "Error: Config file not found: $CONFIG_FILE"
+    exit 1
+fi
+
+if [ "$PROTOCOL" != "abd" ] && [ "$PROTOCOL" != "blocking" ]; then
+    echo "Error: Protocol must be 'abd' or 'blocking'"
+    exit 1
+fi
+
+if [ "$MODE" != "sync" ] && [ "$MODE" != "async" ] && [ "$MODE" != "owners" ]; then
+    echo "Error: Mode must be 'sync', 'async' or 'owners'"
+    exit 1
+fi
+
+# Server ids and ports from the config file
+SERVER_IDS=($(grep -oE '"id"[[:space:]]*:[[:space:]]*[0-9]+' "$CONFIG_FILE" | grep -oE '[0-9]+$'))
+SERVER_PORTS=($(grep -oE '"port"[[:space:]]*:[[:space:]]*[0-9]+' "$CONFIG_FILE" | grep -oE '[0-9]+$'))
+MAX_CORES=$(nproc)
+
+CORE_COUNTS=()
+for cores in 1 2 4 8 16 32; do
+    if [ "$cores" -le "$MAX_CORES" ]; then
+        CORE_COUNTS+=("$cores")
+    fi
+done
+
+echo "Core Scaling"
+echo "Config:      $CONFIG_FILE"
+echo "Protocol:    $PROTOCOL"
+echo "Get Ratio:   $GET_RATIO"
+echo "Clients:     $CLIENTS"
+echo "Duration:    ${DURATION}s"
+echo "Mode:        $MODE"
+echo "Core counts: ${CORE_COUNTS[*]} (machine has $MAX_CORES)"
+echo ""
+
+RESULTS_DIR="results_cores_${PROTOCOL}_${GET_RATIO}_${MODE}"
+mkdir -p "$RESULTS_DIR"
+
+for cores in "${CORE_COUNTS[@]}"; do
+    echo "Testing with servers on $cores cores..."
+    case "$MODE" in
+        sync) THREAD_FLAGS=(--cqs "$cores") ;;
+        async) THREAD_FLAGS=(--async-cqs "$cores") ;;
+        owners) THREAD_FLAGS=(--async-cqs "$cores" --shard-owners 1) ;;
+    esac
+
+    PIDS=()
+    for i in "${!SERVER_IDS[@]}"; do
+        ./build/${PROTOCOL}_server --server-id "${SERVER_IDS[$i]}" --port "${SERVER_PORTS[$i]}" \
+            --cpus "0-$((cores - 1))" "${THREAD_FLAGS[@]}" > "$RESULTS_DIR/server_${i}.log" 2>&1 &
+        PIDS+=($!)
+    done
+    sleep 1
+
+    OUTPUT_FILE="$RESULTS_DIR/results_${cores}cores.txt"
+    ./build/evaluate_performance "$CONFIG_FILE" "$PROTOCOL" "$CLIENTS" "$GET_RATIO" "$DURATION" \
+        2>/dev/null | awk '/Performance Evaluation Results/,0' > "$OUTPUT_FILE"
+
+    kill "${PIDS[@]}" 2>/dev/null
+    wait "${PIDS[@]}" 2>/dev/null
+
+    THROUGHPUT=$(grep -E "^ +Throughput:" "$OUTPUT_FILE" | grep -oE "[0-9]+(\.[0-9]+)?" | head -1)
+    echo "  Throughput: $THROUGHPUT ops/sec"
+    echo ""
+    sleep 1
+done
+
+echo "Summary of results:"
+printf "%-10s %-15s %-10s\n" "Cores" "Throughput" "Speedup"
+BASE=""
+for cores in "${CORE_COUNTS[@]}"; do
+    OUTPUT_FILE="$RESULTS_DIR/results_${cores}cores.txt"
+    THROUGHPUT=$(grep -E "^ +Throughput:" "$OUTPUT_FILE" 2>/dev/null | grep -oE "[0-9]+(\.[0-9]+)?" | head -1)
+    if [ -n "$THROUGHPUT" ]; then
+        BASE=${BASE:-$THROUGHPUT}
+        SPEEDUP=$(awk -v t="$THROUGHPUT" -v b="$BASE" 'BEGIN { printf "%.2fx", t / b }')
+        printf "%-10s %-15s %-10s\n" "$cores" "$THROUGHPUT" "$SPEEDUP"
+    fi
+done
+echo ""
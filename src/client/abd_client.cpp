@@ -3,8 +3,8 @@
 
 namespace kvstore {
 
-ABDClient::ABDClient(const Config& config) 
-    : impl_(std::make_unique<ABDClientImpl>(config)) {
+ABDClient::ABDClient(const Config& config, int32_t client_id) 
+    : impl_(std::make_unique<ABDClientImpl>(config, client_id)) {
 }
 
 ABDClient::~ABDClient() {
@@ -18,6 +18,27 @@ bool ABDClient::Write(const std::string& key, const std::string& value) {
     return impl_->Write(key, value);
 }
 
+bool ABDClient::MultiRead(const std::vector<std::string>& keys, std::vector<std::string>& values) {
+    return impl_->MultiRead(keys, values);
+}
+
+bool ABDClient::MultiWrite(const std::vector<std::string>& keys, const std::vector<std::string>& values) {
+    return impl_->MultiWrite(keys, values);
+}
+
+bool ABDClient::Scan(const std::string& start_key, const std::string& end_key, size_t limit,
+                     std::vector<std::pair<std::string, std::string>>& entries, int64_t read_timestamp) {
+    return impl_->Scan(start_key, end_key, limit, entries, read_timestamp);
+}
+
+int64_t ABDClient::SnapshotTimestamp() {
+    return impl_->SnapshotTimestamp();
+}
+
+bool ABDClient::ReadAt(const std::string& key, int64_t read_timestamp, std::string& value) {
+    return impl_->ReadAt(key, read_timestamp, value);
+}
+
 int64_t ABDClient::GetCurrentTimestamp() const {
     return impl_->GetCurrentTimestamp();
 }
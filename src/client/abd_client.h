@@ -3,6 +3,8 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 #include <memory>
 #include <cstdint>
 #include "../common/config.h"
@@ -16,7 +18,9 @@ class ABDClient {
 public:
     // Create an ABD client with the given configuration.
     // @param config Configuration object containing server addresses and quorum sizes
-    ABDClient(const Config& config);
+    // @param client_id Unique identifier for this client, 0..2047 (the writer id
+    //                  in its timestamps); throws std::out_of_range otherwise
+    ABDClient(const Config& config, int32_t client_id);
     ~ABDClient();
     
     // Read the value for a key.
@@ -38,11 +42,66 @@ public:
     // @return true if write succeeded, false otherwise
     bool Write(const std::string& key, const std::string& value);
     
+    // Read several keys at once.
+    // Runs the ABD two-phase read for the whole batch: one MultiRead round
+    // trip per replica, then (only for keys whose latest value isn't yet on a
+    // write quorum) one MultiWrite write-back round trip.
+    // @param keys The keys to read
+    // @param values Output parameter - one value per key, in the same order
+    // @return true if every key was read from a quorum, false otherwise
+    bool MultiRead(const std::vector<std::string>& keys, std::vector<std::string>& values);
+    
+    // Write several keys at once.
+    // All writes share one new timestamp and go out in a single MultiWrite
+    // round trip per replica; the batch commits once a write quorum has
+    // acknowledged every write in it.
+    // @param keys The keys to write
+    // @param values The values to store, one per key
+    // @return true if the whole batch was committed, false otherwise
+    bool MultiWrite(const std::vector<std::string>& keys, const std::vector<std::string>& values);
+    
+    // Read the keys in [start_key, end_key) in key order.
+    // Every server is asked for the range a page at a time, and for each key
+    // the value with the highest timestamp among a read quorum of replies is
+    // kept (all servers when the cluster is partitioned). There is no
+    // write-back, so a scan returns every write completed before it started,
+    // but two scans may see a concurrent write in different orders.
+    // @param start_key First key of the range
+    // @param end_key End of the range, exclusive; empty = no upper bound
+    // @param limit Return at most this many keys
+    // @param entries Output parameter - (key, value) pairs in key order
+    // @param read_timestamp Read the snapshot at this timestamp, as ReadAt
+    //                       does (0 = current values)
+    // @return true if every page was read, false otherwise (also when the
+    //         snapshot is older than the servers' history)
+    bool Scan(const std::string& start_key, const std::string& end_key, size_t limit,
+              std::vector<std::pair<std::string, std::string>>& entries, int64_t read_timestamp = 0);
+    
+    // Take a timestamp for snapshot reads. It is a new timestamp from the
+    // client's clock, so the snapshot includes every write this client made
+    // or read before, and writes by others once the clock has passed them
+    // (that is, up to clock skew). Servers that answer a snapshot read stamp
+    // later writes above it, so reading the snapshot again gives the same
+    // values as long as the servers still keep them.
+    // @return Snapshot timestamp for ReadAt / Scan
+    int64_t SnapshotTimestamp();
+    
+    // Read the value a key had at a snapshot timestamp.
+    // Servers keep a few superseded versions of each key for a while (see
+    // the server's --versions and --version-retention-ms); the newest
+    // version at or below the timestamp among a read quorum is returned.
+    // There is no write-back and no lock.
+    // @param key The key to read
+    // @param read_timestamp Snapshot timestamp, from SnapshotTimestamp()
+    // @param value Output parameter - the value then (empty if the key didn't exist)
+    // @return true if a read quorum still had the version, false otherwise
+    bool ReadAt(const std::string& key, int64_t read_timestamp, std::string& value);
+    
     // Get the client's current logical timestamp.
-    // The client maintains a logical clock that is updated based on
-    // timestamps received from servers. This ensures the client's
-    // timestamps are always increasing.
-    // @return Current client timestamp
+    // The client keeps a hybrid logical clock (see common/hlc.h) that is
+    // advanced past every timestamp received from servers. This ensures the
+    // client's timestamps are always increasing.
+    // @return Largest timestamp issued or seen so far
     int64_t GetCurrentTimestamp() const;
 
 private:
@@ -1,16 +1,65 @@
 // ABD Client Implementation
 
 #include "abd_client_impl.h"
+#include "chunked_value.h"
 #include "../common/utils.h"
+#include "../common/logging.h"
+#include "../common/phase_timer.h"
 #include <algorithm>
-#include <future>
 #include <chrono>
-#include <iostream>
 
 namespace kvstore {
 
-ABDClientImpl::ABDClientImpl(const Config& config) 
-    : config_(config), client_timestamp_(GetCurrentTimestamp()) {
+namespace {
+
+// Wrap an RPC completion (called as done(status) or done(status, reply)) so
+// the reply's latency is recorded for `server`. A cancelled RPC still counts
+// as a sample: the replica was at least that slow.
+template <typename Done>
+Done TrackReply(const std::shared_ptr<ReplicaStats>& stats, size_t server, Done done) {
+    stats->OnSend(server);
+    auto start = ReplicaStats::Clock::now();
+    return [stats, server, start, done = std::move(done)](const grpc::Status& status,
+                                                          const auto&... reply) {
+        bool failed = !status.ok() && status.error_code() != grpc::StatusCode::CANCELLED;
+        stats->OnReply(server, ReplicaStats::Clock::now() - start, failed);
+        done(status, reply...);
+    };
+}
+
+} // namespace
+
+ABDClientImpl::ABDClientImpl(const Config& config, int32_t client_id) 
+    : config_(config), clock_(hlc::ClientWriterId(client_id)),
+      ring_(config.GetServers(), config.GetNumReplicas(), config.GetVirtualNodes()) {
+    if (config_.UseConnectionPool()) {
+        pool_ = std::make_unique<ChannelPool>(config_.GetServers());
+        stub_cache_ = std::make_unique<StubCache<ABDService>>(*pool_);
+    }
+    const auto& servers = config_.GetServers();
+    if (config_.GetTransport() == TransportType::STREAM) {
+        // Streams already avoid per-operation call setup; they take
+        // precedence over coalescing
+        for (size_t i = 0; i < servers.size(); i++) {
+            transports_.push_back(std::make_unique<ABDStreamTransport>(
+                [this, i] { return GetStub(i); }));
+        }
+    } else if (config_.GetCoalesceWindowUs() > 0) {
+        for (size_t i = 0; i < servers.size(); i++) {
+            transports_.push_back(std::make_unique<ABDCoalescer>(
+                [this, i] { return GetStub(i); },
+                std::chrono::microseconds(config_.GetCoalesceWindowUs()),
+                static_cast<size_t>(config_.GetCoalesceMaxBatch()),
+                std::chrono::duration_cast<std::chrono::milliseconds>(RPC_TIMEOUT)));
+        }
+    }
+    if (config_.GetReadCacheEntries() > 0) {
+        cache_ = std::make_unique<ReadCache>(static_cast<size_t>(config_.GetReadCacheEntries()));
+    }
+    if (config_.UseAdaptiveReads()) {
+        replica_stats_ = std::make_shared<ReplicaStats>(servers.size(),
+                                                        std::chrono::microseconds(config_.GetHedgeMinUs()));
+    }
 }
 
 ABDClientImpl::~ABDClientImpl() {
@@ -18,255 +67,864 @@ ABDClientImpl::~ABDClientImpl() {
 
 std::unique_ptr<ABDService::Stub> ABDClientImpl::CreateStub(const ServerInfo& server) {
     std::string address = server.GetAddress();
-    std::cerr << "[CLIENT] Creating connection to server " << server.id 
-              << " at " << address << std::endl;
+    LOG_DEBUG("[CLIENT] Creating connection to server " << server.id 
+              << " at " << address);
     
     auto channel = grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
     
     // Check channel state (non-blocking check)
     grpc_connectivity_state state = channel->GetState(true);
     if (state == GRPC_CHANNEL_SHUTDOWN) {
-        std::cerr << "[CLIENT] WARNING: Channel to " << address << " is in SHUTDOWN state" << std::endl;
+        LOG_WARN("[CLIENT] Channel to " << address << " is in SHUTDOWN state");
     }
     
     return ABDService::NewStub(channel);
 }
 
-ABDClientImpl::ReadResponse ABDClientImpl::ReadFromServer(
-    const std::string& key, 
-    std::unique_ptr<ABDService::Stub>& stub) {
-    
-    ReadResponse response;
-    response.success = false;
-    
-    grpc::ClientContext context;
-    // Set a 5-second timeout so RPCs don't hang forever
-    auto deadline = std::chrono::system_clock::now() + std::chrono::seconds(5);
-    context.set_deadline(deadline);
+std::shared_ptr<ABDService::Stub> ABDClientImpl::GetStub(size_t index) {
+    if (stub_cache_) {
+        return stub_cache_->Get(index);
+    }
+    return CreateStub(config_.GetServers()[index]);
+}
 
-    ABDReadRequest request;
-    ABDReadResponse reply;
-    
-    request.set_key(key);
-    request.set_timestamp(client_timestamp_);
-    
-    grpc::Status status = stub->Read(&context, request, &reply);
-    
-    if (status.ok()) {
-        response.value = reply.value();
-        response.timestamp = reply.timestamp();
-        response.success = reply.success();
-    } else {
-        // RPC failed (server down, network error, etc.)
-        std::cerr << "[CLIENT] Read RPC failed: " << status.error_code() 
-                  << " - " << status.error_message() << std::endl;
+std::vector<std::shared_ptr<ABDService::Stub>> ABDClientImpl::GetStubs(
+        const std::vector<size_t>& replicas) {
+    std::vector<std::shared_ptr<ABDService::Stub>> stubs;
+    stubs.reserve(replicas.size());
+    for (size_t server : replicas) {
+        stubs.push_back(GetStub(server));
     }
-    
-    return response;
+    return stubs;
 }
 
-bool ABDClientImpl::WriteToServer(const std::string& key, 
-                              const std::string& value, 
-                              int64_t timestamp,
-                              std::unique_ptr<ABDService::Stub>& stub) {
-    grpc::ClientContext context;
-    auto deadline = std::chrono::system_clock::now() + std::chrono::seconds(5);
-    context.set_deadline(deadline);
+void ABDClientImpl::SendReads(ReadCall& call, const std::string& key,
+                              const std::vector<size_t>& replicas,
+                              const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    for (size_t i = 0; i < replicas.size(); i++) {
+        SendRead(call, i, key, replicas[i], stubs[i]);
+    }
+}
 
-    ABDWriteRequest request;
-    ABDWriteResponse reply;
-    
+void ABDClientImpl::SendRead(ReadCall& call, size_t index, const std::string& key, size_t server,
+                             const std::shared_ptr<ABDService::Stub>& stub) {
+    int64_t timestamp = GetCurrentTimestamp();
+    // Large values come back as timestamps only; Read fetches the winner's
+    int64_t value_limit = config_.GetLargeValueBytes();
+    if (!transports_.empty()) {
+        ABDReplicaTransport::ReadDone done = call.Expect(index);
+        if (replica_stats_) {
+            done = TrackReply(replica_stats_, server, std::move(done));
+        }
+        transports_[server]->Read(key, timestamp, value_limit, std::move(done));
+        return;
+    }
+    ABDReadRequest request;
     request.set_key(key);
-    request.set_value(value);
     request.set_timestamp(timestamp);
-    
-    grpc::Status status = stub->Write(&context, request, &reply);
-    
-    if (status.ok() && reply.success()) {
-        // Update our timestamp based on server's response
-        UpdateTimestamp(reply.timestamp());
-        return true;
+    request.set_value_limit(value_limit);
+    call.Send(index, stub, std::move(request),
+        [stats = replica_stats_, server](ABDService::Stub* stub, grpc::ClientContext* context,
+                                         const ABDReadRequest* req, ABDReadResponse* reply,
+                                         RpcDoneCallback done) {
+            if (stats) {
+                done = TrackReply(stats, server, std::move(done));
+            }
+            stub->async()->Read(context, req, reply, std::move(done));
+        });
+}
+
+std::vector<size_t> ABDClientImpl::QueryReplicas(ReadCall& call, const std::string& key,
+                                                 const std::vector<size_t>& replicas,
+                                                 const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    auto accept = [](const ABDReadResponse& reply) { return reply.success(); };
+    size_t needed = static_cast<size_t>(config_.GetReadQuorum());
+    if (!replica_stats_) {
+        SendReads(call, key, replicas, stubs);
+        return call.Wait(needed, accept);
     }
     
-    if (!status.ok()) {
-        std::cerr << "[CLIENT] Write RPC failed: " << status.error_code() 
-                  << " - " << status.error_message() << std::endl;
+    std::vector<size_t> order = replica_stats_->Rank(replicas);
+    size_t sent = 0;
+    std::chrono::nanoseconds hedge_delay{0};
+    auto send_next = [&]() {
+        size_t i = order[sent++];
+        SendRead(call, i, key, replicas[i], stubs[i]);
+        hedge_delay = std::max(hedge_delay, replica_stats_->HedgeDelay(replicas[i]));
+    };
+    while (sent < needed) {
+        send_next();
     }
-    
-    return false;
+    while (sent < order.size()) {
+        std::vector<size_t> replied = call.WaitUntil(needed, accept,
+            std::chrono::steady_clock::now() + hedge_delay);
+        if (replied.size() >= needed) {
+            return replied;
+        }
+        LOG_DEBUG("[ABD READ Phase 1] Hedging key='" << key << "' to server " << replicas[order[sent]]);
+        send_next();
+    }
+    return call.Wait(needed, accept);
 }
 
-void ABDClientImpl::UpdateTimestamp(int64_t timestamp) {
-    std::lock_guard<std::mutex> lock(timestamp_mutex_);
-    // Keep client timestamp >= any timestamp we've seen from servers
-    if (timestamp > client_timestamp_) {
-        client_timestamp_ = timestamp;
+void ABDClientImpl::SendWrites(WriteCall& call, const std::string& key,
+                               const std::string& value, int64_t timestamp,
+                               const std::vector<size_t>& replicas,
+                               const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    size_t compress_above = static_cast<size_t>(config_.GetCompressAboveBytes());
+    bool compress = compress_above > 0 && value.size() > compress_above;
+    size_t large_value = static_cast<size_t>(config_.GetLargeValueBytes());
+    if (large_value > 0 && value.size() > large_value) {
+        // Every replica streams from one shared copy instead of its own request
+        auto shared = std::make_shared<const std::string>(value);
+        for (size_t i = 0; i < stubs.size(); i++) {
+            StartChunkedWrite(stubs[i], key, shared, timestamp,
+                              std::chrono::duration_cast<std::chrono::milliseconds>(RPC_TIMEOUT),
+                              compress, call.Expect(i));
+        }
+        return;
+    }
+    if (!transports_.empty() && !compress) {
+        for (size_t i = 0; i < replicas.size(); i++) {
+            transports_[replicas[i]]->Write(key, value, timestamp, call.Expect(i));
+        }
+        return;
+    }
+    for (size_t i = 0; i < stubs.size(); i++) {
+        ABDWriteRequest request;
+        request.set_key(key);
+        request.set_value(value);
+        request.set_timestamp(timestamp);
+        call.Send(i, stubs[i], std::move(request),
+            [compress](ABDService::Stub* stub, grpc::ClientContext* context,
+                       const ABDWriteRequest* req, ABDWriteResponse* reply, RpcDoneCallback done) {
+                if (compress) {
+                    context->set_compression_algorithm(GRPC_COMPRESS_GZIP);
+                }
+                stub->async()->Write(context, req, reply, std::move(done));
+            });
+    }
+}
+
+void ABDClientImpl::SendProbes(ProbeCall& call, const std::string& key,
+                               const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    for (size_t i = 0; i < stubs.size(); i++) {
+        ABDReadTimestampRequest request;
+        request.set_key(key);
+        call.Send(i, stubs[i], std::move(request),
+            [](ABDService::Stub* stub, grpc::ClientContext* context,
+               const ABDReadTimestampRequest* req, ABDReadTimestampResponse* reply,
+               RpcDoneCallback done) {
+                stub->async()->ReadTimestamp(context, req, reply, std::move(done));
+            });
+    }
+}
+
+void ABDClientImpl::SendMultiReads(MultiReadCall& call, const ABDMultiReadRequest& request,
+                                   const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    for (size_t i = 0; i < stubs.size(); i++) {
+        call.Send(i, stubs[i], request,
+            [](ABDService::Stub* stub, grpc::ClientContext* context,
+               const ABDMultiReadRequest* req, ABDMultiReadResponse* reply, RpcDoneCallback done) {
+                stub->async()->MultiRead(context, req, reply, std::move(done));
+            });
+    }
+}
+
+void ABDClientImpl::SendMultiWrites(MultiWriteCall& call, const ABDMultiWriteRequest& request,
+                                    const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    for (size_t i = 0; i < stubs.size(); i++) {
+        call.Send(i, stubs[i], request,
+            [](ABDService::Stub* stub, grpc::ClientContext* context,
+               const ABDMultiWriteRequest* req, ABDMultiWriteResponse* reply, RpcDoneCallback done) {
+                stub->async()->MultiWrite(context, req, reply, std::move(done));
+            });
     }
-    // Increment to ensure our next timestamp is unique
-    client_timestamp_++;
 }
 
 int64_t ABDClientImpl::GetCurrentTimestamp() const {
-    std::lock_guard<std::mutex> lock(timestamp_mutex_);
-    return client_timestamp_;
+    return clock_.Last();
+}
+
+bool ABDClientImpl::ReadCached(const std::string& key,
+                               const std::vector<std::shared_ptr<ABDService::Stub>>& stubs,
+                               std::string& value) {
+    ReadCache::Entry cached;
+    if (!cache_->Get(key, cached)) {
+        return false;
+    }
+    int32_t read_quorum = config_.GetReadQuorum();
+    ProbeCall probe(stubs.size(), RPC_TIMEOUT);
+    std::vector<size_t> replied;
+    {
+        ScopedPhase timer(Phase::ABD_PROBE);
+        SendProbes(probe, key, stubs);
+        replied = probe.Wait(read_quorum,
+            [](const ABDReadTimestampResponse& reply) { return reply.success(); });
+    }
+    if (static_cast<int32_t>(replied.size()) < read_quorum) {
+        return false;
+    }
+    bool current = true;
+    for (size_t i : replied) {
+        int64_t timestamp = probe.GetReply(i).timestamp();
+        clock_.Observe(timestamp);
+        current = current && timestamp <= cached.timestamp;
+    }
+    if (!current) {
+        LOG_DEBUG("[ABD READ] Cached value for key='" << key << "' is stale, reading it");
+        return false;
+    }
+    LOG_DEBUG("[ABD READ] Served key='" << key << "' from cache (ts=" << cached.timestamp << ")");
+    value = *cached.value;
+    return true;
 }
 
 bool ABDClientImpl::Read(const std::string& key, std::string& value) {
     int32_t read_quorum = config_.GetReadQuorum();
-    const auto& servers = config_.GetServers();
+    std::vector<size_t> replicas = ring_.ReplicasFor(key);
     
-    std::cerr << "\n[ABD READ]" << std::endl;
-    std::cerr << "[ABD READ] Starting read for key='" << key << "'" << std::endl;
-    std::cerr << "[ABD READ] Need R=" << read_quorum << " responses from " 
-              << servers.size() << " servers" << std::endl;
+    LOG_DEBUG("[ABD READ] Starting read for key='" << key << "'");
+    LOG_DEBUG("[ABD READ] Need R=" << read_quorum << " responses from " 
+              << replicas.size() << " servers");
     
-    if (static_cast<size_t>(read_quorum) > servers.size()) {
-        std::cerr << "Error: Read quorum larger than number of servers" << std::endl;
+    if (static_cast<size_t>(read_quorum) > replicas.size()) {
+        LOG_ERROR("Error: Read quorum larger than replica set size");
         return false;
     }
     
     // Phase 1: Read from servers
-    std::cerr << "[ABD READ Phase 1] Sending read requests to " << servers.size() << " servers..." << std::endl;
-    
-    std::vector<std::unique_ptr<ABDService::Stub>> stubs;
-    for (const auto& server : servers) {
-        std::cerr << "[CLIENT] Connecting to server " << server.id 
-                  << " at " << server.GetAddress() << std::endl;
-        stubs.push_back(CreateStub(server));
-    }
-    
-    std::vector<std::future<ReadResponse>> futures;
-    for (size_t i = 0; i < servers.size(); i++) {
-        futures.push_back(std::async(std::launch::async, 
-            &ABDClientImpl::ReadFromServer, this, key, std::ref(stubs[i])));
-    }
-    
-    // Collect responses until we have a read quorum
-    std::vector<ReadResponse> responses;
-    for (size_t i = 0; i < futures.size(); i++) {
-        auto response = futures[i].get();
-        if (response.success) {
-            responses.push_back(response);
-            std::cerr << "[ABD READ Phase 1] Got response " << responses.size() 
-                      << "/" << read_quorum << " (server " << i 
-                      << ", ts=" << response.timestamp << ")" << std::endl;
-            if (static_cast<int32_t>(responses.size()) >= read_quorum) {
-                std::cerr << "[ABD READ Phase 1] Read quorum achieved! (" 
-                          << responses.size() << " responses)" << std::endl;
-                break;
-            }
-        } else {
-            std::cerr << "[ABD READ Phase 1] Server " << i << " failed or returned error" << std::endl;
+    LOG_DEBUG("[ABD READ Phase 1] Sending read requests to " << replicas.size() << " servers...");
+    
+    std::vector<std::shared_ptr<ABDService::Stub>> stubs = GetStubs(replicas);
+    
+    if (cache_ && ReadCached(key, stubs, value)) {
+        return true;
+    }
+    
+    // Replies are consumed in arrival order, so a slow server can't hold
+    // up the quorum once R others have answered.
+    ReadCall phase1(replicas.size(), RPC_TIMEOUT);
+    std::vector<size_t> replied;
+    {
+        ScopedPhase timer(Phase::ABD_QUERY);
+        replied = QueryReplicas(phase1, key, replicas, stubs);
+    }
+    
+    for (size_t i = 0; i < replicas.size(); i++) {
+        if (phase1.Done(i) && std::find(replied.begin(), replied.end(), i) == replied.end()) {
+            LOG_DEBUG("[ABD READ Phase 1] Server " << i << " failed or returned error");
         }
     }
     
-    if (static_cast<int32_t>(responses.size()) < read_quorum) {
-        std::cerr << "[ABD READ] Error: Only got " << responses.size() 
-                  << " responses, need " << read_quorum << std::endl;
+    if (static_cast<int32_t>(replied.size()) < read_quorum) {
+        LOG_WARN_EVERY(1000, "[ABD READ] Error: Only got " << replied.size() 
+                             << " responses, need " << read_quorum);
         return false;
     }
+    LOG_DEBUG("[ABD READ Phase 1] Read quorum achieved! (" 
+              << replied.size() << " responses)");
     
     // Find the response with the maximum timestamp
-    auto max_response = std::max_element(responses.begin(), responses.end(),
-        [](const ReadResponse& a, const ReadResponse& b) {
-            return a.timestamp < b.timestamp;
+    auto max_index = *std::max_element(replied.begin(), replied.end(),
+        [&phase1](size_t a, size_t b) {
+            return phase1.GetReply(a).timestamp() < phase1.GetReply(b).timestamp();
         });
     
-    std::string max_value = max_response->value;
-    int64_t max_timestamp = max_response->timestamp;
-    
-    std::cerr << "[ABD READ] Found max timestamp: " << max_timestamp 
-              << " (value='" << max_value << "')" << std::endl;
+    const std::string* max_value = &phase1.GetReply(max_index).value();
+    int64_t max_timestamp = phase1.GetReply(max_index).timestamp();
+    
+    // A large value was left out of phase 1; fetch it from that one replica
+    std::string fetched;
+    if (phase1.GetReply(max_index).value_omitted()) {
+        ScopedPhase timer(Phase::ABD_QUERY);
+        int64_t fetched_timestamp = 0;
+        grpc::Status status = ReadChunkedValue(*stubs[max_index], key,
+            std::chrono::duration_cast<std::chrono::milliseconds>(RPC_TIMEOUT),
+            fetched, fetched_timestamp);
+        if (!status.ok()) {
+            LOG_WARN_EVERY(1000, "[ABD READ] Error: Fetching large value failed: "
+                                 << status.error_message());
+            return false;
+        }
+        // A newer write may have landed since phase 1; it is just as current
+        max_timestamp = std::max(max_timestamp, fetched_timestamp);
+        max_value = &fetched;
+    }
+    clock_.Observe(max_timestamp);      // Our next write must order after what we read
     
-    // Phase 2: Write back the maximum value
-    int64_t write_timestamp = std::max(max_timestamp, GetCurrentTimestamp()) + 1;
-    UpdateTimestamp(write_timestamp);
+    LOG_DEBUG("[ABD READ] Found max timestamp: " << max_timestamp 
+              << " (value_size=" << max_value->size() << ")");
     
-    std::cerr << "[ABD READ Phase 2] Writing back max value to servers (W=" 
-              << config_.GetWriteQuorum() << ", ts=" << write_timestamp << ")..." << std::endl;
+    // Phase 2: Write back the maximum value under its own timestamp
+    // The write-back is only skipped when every server has answered and they
+    // all agree on the max timestamp. Adaptive reads ask only R replicas, so
+    // they always write back.
+    int32_t write_quorum = config_.GetWriteQuorum();
+    std::vector<size_t> answered = phase1.Arrived(
+        [](const ABDReadResponse& reply) { return reply.success(); });
+    auto agreeing = std::count_if(answered.begin(), answered.end(),
+        [&](size_t i) { return phase1.GetReply(i).timestamp() == max_timestamp; });
+    bool all_agree = answered.size() == replicas.size() &&
+                     static_cast<size_t>(agreeing) == answered.size();
+    
+    // Smallest timestamp the value is stored under at a write quorum
+    int64_t quorum_timestamp = max_timestamp;
+    if (all_agree) {
+        LOG_DEBUG("[ABD READ Phase 2] Skipped: all " << answered.size() 
+                  << " replicas already agree on ts=" << max_timestamp);
+    } else {
+        ScopedPhase timer(Phase::ABD_WRITE_BACK);
+        LOG_DEBUG("[ABD READ Phase 2] Writing back max value to servers (W=" 
+                  << write_quorum << ", ts=" << max_timestamp << ")...");
+        
+        // Same concurrent quorum path as Write: one RPC per server, done after W acks.
+        // A replica that already holds this timestamp or a newer one just acks.
+        WriteCall phase2(replicas.size(), RPC_TIMEOUT);
+        SendWrites(phase2, key, *max_value, max_timestamp, replicas, stubs);
+        std::vector<size_t> acked = phase2.Wait(write_quorum,
+            [](const ABDWriteResponse& reply) { return reply.success(); });
+        quorum_timestamp = AckedTimestamps(phase2, acked);
+        
+        int32_t written = static_cast<int32_t>(acked.size());
+        if (written < write_quorum) {
+            LOG_WARN_EVERY(1000, "[ABD READ] Error: Only wrote to " << written 
+                                 << " servers, need " << write_quorum);
+            return false;
+        }
+        
+        LOG_DEBUG("[ABD READ Phase 2] Write quorum achieved! (" << written << " writes)");
+    }
     
+    LOG_DEBUG("[ABD READ] Read complete, value_size=" << max_value->size());
+    if (cache_) {
+        cache_->Put(key, *max_value, quorum_timestamp);
+    }
+    value = max_value == &fetched ? std::move(fetched) : *max_value;
+    return true;
+}
+
+bool ABDClientImpl::Write(const std::string& key, const std::string& value) {
     int32_t write_quorum = config_.GetWriteQuorum();
-    int32_t written = 0;
+    std::vector<size_t> replicas = ring_.ReplicasFor(key);
     
-    for (size_t i = 0; i < stubs.size() && written < write_quorum; i++) {
-        if (WriteToServer(key, max_value, write_timestamp, stubs[i])) {
-            written++;
-            std::cerr << "[ABD READ Phase 2] Written to server " << i 
-                      << " (" << written << "/" << write_quorum << ")" << std::endl;
+    LOG_DEBUG("[ABD WRITE] Starting write for key='" << key << "'");
+    LOG_DEBUG("[ABD WRITE] Need W=" << write_quorum << " successful writes from " 
+              << replicas.size() << " servers");
+    
+    if (static_cast<size_t>(write_quorum) > replicas.size()) {
+        LOG_ERROR("Error: Write quorum larger than replica set size");
+        return false;
+    }
+    
+    if (WritesConditionally(value)) {
+        return ConditionalWrite(key, value, GetStubs(replicas));
+    }
+    
+    // Generate a new timestamp for this write
+    int64_t timestamp = clock_.Now();
+    std::vector<std::shared_ptr<ABDService::Stub>> stubs = GetStubs(replicas);
+    ScopedPhase timer(Phase::ABD_WRITE);
+    
+    // A replica holding a newer timestamp doesn't apply the write (our clock
+    // lags another writer's); it answers superseded with that timestamp, and
+    // the write is sent again above it until a write quorum has applied it
+    for (int round = 0; round < MAX_WRITE_ROUNDS; round++) {
+        LOG_DEBUG("[ABD WRITE] Sending ts=" << timestamp << " to " << replicas.size()
+                  << " servers (round " << round << ")");
+        WriteCall call(replicas.size(), RPC_TIMEOUT);
+        SendWrites(call, key, value, timestamp, replicas, stubs);
+        std::vector<size_t> acked = call.Wait(write_quorum,
+            [](const ABDWriteResponse& reply) { return reply.success() && !reply.superseded(); });
+        int64_t quorum_timestamp = AckedTimestamps(call, acked);
+        
+        if (static_cast<int32_t>(acked.size()) >= write_quorum) {
+            LOG_DEBUG("[ABD WRITE] Write quorum achieved! (" << acked.size() << " acknowledgments)");
+            if (cache_) {
+                cache_->Put(key, value, quorum_timestamp);
+            }
+            return true;
+        }
+        
+        int64_t winner = 0;
+        for (size_t i : call.Arrived([](const ABDWriteResponse& reply) {
+                 return reply.success() && reply.superseded(); })) {
+            winner = std::max(winner, call.GetReply(i).timestamp());
         }
+        if (winner == 0) {
+            LOG_WARN_EVERY(1000, "[ABD WRITE] Error: Only got " << acked.size()
+                                 << " acknowledgments, need " << write_quorum);
+            return false;
+        }
+        LOG_DEBUG("[ABD WRITE] Superseded: a replica holds ts=" << winner << ", retrying above it");
+        timestamp = clock_.After(winner);
     }
+    LOG_WARN_EVERY(1000, "[ABD WRITE] Error: Still superseded after " << MAX_WRITE_ROUNDS << " rounds");
+    return false;
+}
+
+bool ABDClientImpl::WritesConditionally(const std::string& value) const {
+    size_t large_value = static_cast<size_t>(config_.GetLargeValueBytes());
+    return config_.UseConditionalWrites() && (large_value == 0 || value.size() <= large_value);
+}
+
+bool ABDClientImpl::ConditionalWrite(const std::string& key, const std::string& value,
+                                     const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    size_t write_quorum = static_cast<size_t>(config_.GetWriteQuorum());
+    int64_t timestamp = clock_.Now();
+    ScopedPhase timer(Phase::ABD_WRITE);
+    for (int round = 0; round < MAX_WRITE_ROUNDS; round++) {
+        LOG_DEBUG("[ABD WRITE] WriteIfNewer key='" << key << "' ts=" << timestamp << " (round " << round << ")");
+        ConditionalWriteCall call(stubs.size(), RPC_TIMEOUT);
+        SendConditionalWrites(call, key, value, timestamp, stubs);
+        std::vector<size_t> accepted = call.Wait(write_quorum,
+            [](const ABDWriteIfNewerResponse& reply) { return reply.success() && reply.accepted(); });
+        if (accepted.size() >= write_quorum) {
+            LOG_DEBUG("[ABD WRITE] Write committed after " << (round + 1) << " round(s)");
+            if (cache_) {
+                cache_->Put(key, value, timestamp);
+            }
+            return true;
+        }
+        
+        int64_t winner = 0;
+        for (size_t i : call.Arrived([](const ABDWriteIfNewerResponse& reply) {
+                 return reply.success() && !reply.accepted(); })) {
+            winner = std::max(winner, call.GetReply(i).timestamp());
+        }
+        if (winner == 0) {
+            // Not a conflict: too few replicas answered
+            LOG_WARN_EVERY(1000, "[ABD WRITE] Error: Only got " << accepted.size()
+                                 << " acknowledgments, need " << write_quorum);
+            return false;
+        }
+        LOG_DEBUG("[ABD WRITE] Conflict: a replica holds ts=" << winner << ", retrying above it");
+        timestamp = clock_.After(winner);
+    }
+    LOG_WARN_EVERY(1000, "[ABD WRITE] Error: Still conflicting after " << MAX_WRITE_ROUNDS << " rounds");
+    return false;
+}
+
+void ABDClientImpl::SendConditionalWrites(ConditionalWriteCall& call, const std::string& key,
+                                          const std::string& value, int64_t timestamp,
+                                          const std::vector<std::shared_ptr<ABDService::Stub>>& stubs) {
+    size_t compress_above = static_cast<size_t>(config_.GetCompressAboveBytes());
+    bool compress = compress_above > 0 && value.size() > compress_above;
+    for (size_t i = 0; i < stubs.size(); i++) {
+        ABDWriteRequest request;
+        request.set_key(key);
+        request.set_value(value);
+        request.set_timestamp(timestamp);
+        call.Send(i, stubs[i], std::move(request),
+            [compress](ABDService::Stub* stub, grpc::ClientContext* context,
+                       const ABDWriteRequest* req, ABDWriteIfNewerResponse* reply, RpcDoneCallback done) {
+                if (compress) {
+                    context->set_compression_algorithm(GRPC_COMPRESS_GZIP);
+                }
+                stub->async()->WriteIfNewer(context, req, reply, std::move(done));
+            });
+    }
+}
+
+int64_t ABDClientImpl::AckedTimestamps(const WriteCall& call, const std::vector<size_t>& acked) {
+    int64_t smallest = 0;
+    for (size_t i : acked) {
+        int64_t timestamp = call.GetReply(i).timestamp();
+        // Later timestamps must order after whatever the server stored
+        clock_.Observe(timestamp);
+        smallest = smallest == 0 ? timestamp : std::min(smallest, timestamp);
+    }
+    return smallest;
+}
+
+std::vector<ABDClientImpl::KeyGroup> ABDClientImpl::GroupByReplicas(
+        const std::vector<std::string>& keys) const {
+    std::vector<KeyGroup> groups;
+    for (size_t k = 0; k < keys.size(); k++) {
+        std::vector<size_t> replicas = ring_.ReplicasFor(keys[k]);
+        auto it = std::find_if(groups.begin(), groups.end(),
+            [&](const KeyGroup& group) { return group.replicas == replicas; });
+        if (it == groups.end()) {
+            groups.push_back({std::move(replicas), {}});
+            it = groups.end() - 1;
+        }
+        it->positions.push_back(k);
+    }
+    return groups;
+}
+
+bool ABDClientImpl::MultiRead(const std::vector<std::string>& keys, std::vector<std::string>& values) {
+    if (!ring_.Partitioned()) {
+        return MultiReadOn(ring_.AllServers(), keys, values);
+    }
+    // Keys on different replica sets can't share a batch; read each set's
+    // keys as their own batch
+    std::vector<std::string> results(keys.size());
+    for (const auto& group : GroupByReplicas(keys)) {
+        std::vector<std::string> group_keys;
+        group_keys.reserve(group.positions.size());
+        for (size_t k : group.positions) {
+            group_keys.push_back(keys[k]);
+        }
+        std::vector<std::string> group_values;
+        if (!MultiReadOn(group.replicas, group_keys, group_values)) {
+            values.clear();
+            return false;
+        }
+        for (size_t g = 0; g < group.positions.size(); g++) {
+            results[group.positions[g]] = std::move(group_values[g]);
+        }
+    }
+    values = std::move(results);
+    return true;
+}
+
+bool ABDClientImpl::MultiReadOn(const std::vector<size_t>& replicas, const std::vector<std::string>& keys,
+                                std::vector<std::string>& values) {
+    int32_t read_quorum = config_.GetReadQuorum();
+    int32_t write_quorum = config_.GetWriteQuorum();
+    size_t count = keys.size();
+    
+    values.clear();
+    if (count == 0) {
+        return true;
+    }
+    
+    LOG_DEBUG("[ABD MULTIREAD] Starting read for " << count << " keys (R=" << read_quorum 
+              << ", " << replicas.size() << " servers)");
     
-    if (written < write_quorum) {
-        std::cerr << "[ABD READ] Error: Only wrote to " << written 
-                  << " servers, need " << write_quorum << std::endl;
+    if (static_cast<size_t>(read_quorum) > replicas.size()) {
+        LOG_ERROR("Error: Read quorum larger than replica set size");
         return false;
     }
     
-    std::cerr << "[ABD READ Phase 2] Write quorum achieved! (" << written << " writes)" << std::endl;
-    std::cerr << "[ABD READ] Read complete, value='" << max_value << "'" << std::endl;
-    value = max_value;
+    std::vector<std::shared_ptr<ABDService::Stub>> stubs = GetStubs(replicas);
+    
+    // Phase 1: one batched read per server
+    ABDMultiReadRequest request;
+    int64_t timestamp = GetCurrentTimestamp();
+    request.mutable_reads()->Reserve(static_cast<int>(count));
+    for (const auto& key : keys) {
+        auto* read = request.add_reads();
+        read->set_key(key);
+        read->set_timestamp(timestamp);
+    }
+    
+    MultiReadCall phase1(replicas.size(), RPC_TIMEOUT);
+    SendMultiReads(phase1, request, stubs);
+    auto complete = [count](const ABDMultiReadResponse& reply) {
+        return reply.success() && static_cast<size_t>(reply.results_size()) == count;
+    };
+    std::vector<size_t> replied = phase1.Wait(read_quorum, complete);
+    
+    if (static_cast<int32_t>(replied.size()) < read_quorum) {
+        LOG_WARN_EVERY(1000, "[ABD MULTIREAD] Error: Only got " << replied.size() 
+                             << " responses, need " << read_quorum);
+        return false;
+    }
+    
+    // For each key, find the reply with the maximum timestamp. As in Read,
+    // a key's write-back can only be skipped when every server has answered
+    // and they all agree on its max timestamp.
+    std::vector<size_t> answered = phase1.Arrived(complete);
+    bool all_answered = answered.size() == replicas.size();
+    
+    std::vector<size_t> max_reply(count);
+    ABDMultiWriteRequest write_back;
+    for (size_t k = 0; k < count; k++) {
+        size_t best = replied[0];
+        for (size_t i : replied) {
+            if (phase1.GetReply(i).results(k).timestamp() > phase1.GetReply(best).results(k).timestamp()) {
+                best = i;
+            }
+        }
+        max_reply[k] = best;
+        
+        const auto& max_result = phase1.GetReply(best).results(k);
+        bool all_agree = all_answered &&
+            std::all_of(answered.begin(), answered.end(),
+                [&](size_t i) { return phase1.GetReply(i).results(k).timestamp() == max_result.timestamp(); });
+        if (!all_agree) {
+            auto* write = write_back.add_writes();
+            write->set_key(keys[k]);
+            write->set_value(max_result.value());
+            write->set_timestamp(max_result.timestamp());
+        }
+    }
+    
+    // Phase 2: one batched write-back per server, only for the stale keys
+    if (write_back.writes_size() > 0) {
+        LOG_DEBUG("[ABD MULTIREAD Phase 2] Writing back " << write_back.writes_size() 
+                  << " keys (W=" << write_quorum << ")");
+        
+        size_t write_count = static_cast<size_t>(write_back.writes_size());
+        MultiWriteCall phase2(replicas.size(), RPC_TIMEOUT);
+        SendMultiWrites(phase2, write_back, stubs);
+        std::vector<size_t> acked = phase2.Wait(write_quorum,
+            [write_count](const ABDMultiWriteResponse& reply) {
+                return reply.success() && static_cast<size_t>(reply.results_size()) == write_count;
+            });
+        
+        if (static_cast<int32_t>(acked.size()) < write_quorum) {
+            LOG_WARN_EVERY(1000, "[ABD MULTIREAD] Error: Only wrote to " << acked.size() 
+                                 << " servers, need " << write_quorum);
+            return false;
+        }
+    } else {
+        LOG_DEBUG("[ABD MULTIREAD Phase 2] Skipped: all replicas already agree on every key");
+    }
+    
+    values.reserve(count);
+    for (size_t k = 0; k < count; k++) {
+        values.push_back(phase1.GetReply(max_reply[k]).results(k).value());
+    }
     return true;
 }
 
-bool ABDClientImpl::Write(const std::string& key, const std::string& value) {
+bool ABDClientImpl::MultiWrite(const std::vector<std::string>& keys, const std::vector<std::string>& values) {
+    if (values.size() != keys.size()) {
+        LOG_ERROR("Error: MultiWrite got " << keys.size() << " keys but " << values.size() << " values");
+        return false;
+    }
+    if (cache_) {
+        // Batched writes aren't cached; drop the values they replace
+        for (const auto& key : keys) {
+            cache_->Erase(key);
+        }
+    }
+    if (!ring_.Partitioned()) {
+        return MultiWriteOn(ring_.AllServers(), keys, values);
+    }
+    // One batch per replica set. A failure leaves the earlier groups
+    // written, as a failed batch already may on a single replica set.
+    for (const auto& group : GroupByReplicas(keys)) {
+        std::vector<std::string> group_keys;
+        std::vector<std::string> group_values;
+        group_keys.reserve(group.positions.size());
+        group_values.reserve(group.positions.size());
+        for (size_t k : group.positions) {
+            group_keys.push_back(keys[k]);
+            group_values.push_back(values[k]);
+        }
+        if (!MultiWriteOn(group.replicas, group_keys, group_values)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ABDClientImpl::MultiWriteOn(const std::vector<size_t>& replicas, const std::vector<std::string>& keys,
+                                 const std::vector<std::string>& values) {
     int32_t write_quorum = config_.GetWriteQuorum();
-    const auto& servers = config_.GetServers();
+    size_t count = keys.size();
     
-    std::cerr << "\n[ABD WRITE]" << std::endl;
-    std::cerr << "[ABD WRITE] Starting write for key='" << key << "'" << std::endl;
-    std::cerr << "[ABD WRITE] Need W=" << write_quorum << " successful writes from " 
-              << servers.size() << " servers" << std::endl;
+    if (values.size() != count) {
+        LOG_ERROR("Error: MultiWrite got " << count << " keys but " << values.size() << " values");
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
     
-    if (static_cast<size_t>(write_quorum) > servers.size()) {
-        std::cerr << "Error: Write quorum larger than number of servers" << std::endl;
+    LOG_DEBUG("[ABD MULTIWRITE] Starting write for " << count << " keys (W=" << write_quorum 
+              << ", " << replicas.size() << " servers)");
+    
+    if (static_cast<size_t>(write_quorum) > replicas.size()) {
+        LOG_ERROR("Error: Write quorum larger than replica set size");
         return false;
     }
     
-    // Generate a new timestamp for this write
-    int64_t timestamp = GetCurrentTimestamp() + 1;
-    UpdateTimestamp(timestamp);
-    
-    std::cerr << "[ABD WRITE] Generated timestamp: " << timestamp << std::endl;
-    std::cerr << "[ABD WRITE] Sending write requests to " << servers.size() << " servers..." << std::endl;
-    
-    std::vector<std::unique_ptr<ABDService::Stub>> stubs;
-    for (const auto& server : servers) {
-        std::cerr << "[CLIENT] Connecting to server " << server.id 
-                  << " at " << server.GetAddress() << std::endl;
-        stubs.push_back(CreateStub(server));
-    }
-    
-    std::vector<std::future<bool>> futures;
-    for (size_t i = 0; i < servers.size(); i++) {
-        futures.push_back(std::async(std::launch::async, 
-            &ABDClientImpl::WriteToServer, this, key, value, timestamp, std::ref(stubs[i])));
-    }
-    
-    // Wait for write quorum acknowledgments
-    int32_t written = 0;
-    for (size_t i = 0; i < futures.size(); i++) {
-        if (futures[i].get()) {
-            written++;
-            std::cerr << "[ABD WRITE] Got acknowledgment from server " << i 
-                      << " (" << written << "/" << write_quorum << ")" << std::endl;
-            if (written >= write_quorum) {
-                std::cerr << "[ABD WRITE] Write quorum achieved! (" 
-                          << written << " acknowledgments)" << std::endl;
+    // One new timestamp for the whole batch
+    int64_t timestamp = clock_.Now();
+    
+    ABDMultiWriteRequest request;
+    request.mutable_writes()->Reserve(static_cast<int>(count));
+    for (size_t k = 0; k < count; k++) {
+        auto* write = request.add_writes();
+        write->set_key(keys[k]);
+        write->set_value(values[k]);
+    }
+    
+    std::vector<std::shared_ptr<ABDService::Stub>> stubs = GetStubs(replicas);
+    
+    // As in Write, a batch a replica superseded any key of is sent again,
+    // whole, above the newest timestamp it was answered with
+    for (int round = 0; round < MAX_WRITE_ROUNDS; round++) {
+        for (auto& write : *request.mutable_writes()) {
+            write.set_timestamp(timestamp);
+        }
+        MultiWriteCall call(replicas.size(), RPC_TIMEOUT);
+        SendMultiWrites(call, request, stubs);
+        auto complete = [count](const ABDMultiWriteResponse& reply) {
+            return reply.success() && static_cast<size_t>(reply.results_size()) == count;
+        };
+        std::vector<size_t> acked = call.Wait(write_quorum, [&complete](const ABDMultiWriteResponse& reply) {
+            return complete(reply) && std::none_of(reply.results().begin(), reply.results().end(),
+                [](const ABDWriteResponse& result) { return result.superseded(); });
+        });
+        
+        int64_t winner = 0;
+        for (size_t i : call.Arrived(complete)) {
+            // Later timestamps must order after the largest one the server stored
+            for (const auto& result : call.GetReply(i).results()) {
+                clock_.Observe(result.timestamp());
+                if (result.superseded()) {
+                    winner = std::max(winner, result.timestamp());
+                }
+            }
+        }
+        
+        if (static_cast<int32_t>(acked.size()) >= write_quorum) {
+            LOG_DEBUG("[ABD MULTIWRITE] Write quorum achieved! (" << acked.size() << " acknowledgments)");
+            return true;
+        }
+        if (winner == 0) {
+            LOG_WARN_EVERY(1000, "[ABD MULTIWRITE] Error: Only got " << acked.size() 
+                                 << " acknowledgments, need " << write_quorum);
+            return false;
+        }
+        LOG_DEBUG("[ABD MULTIWRITE] Superseded: a replica holds ts=" << winner << ", retrying above it");
+        timestamp = clock_.After(winner);
+    }
+    LOG_WARN_EVERY(1000, "[ABD MULTIWRITE] Error: Still superseded after " << MAX_WRITE_ROUNDS << " rounds");
+    return false;
+}
+
+bool ABDClientImpl::Scan(const std::string& start_key, const std::string& end_key, size_t limit,
+                         std::vector<std::pair<std::string, std::string>>& entries, int64_t read_timestamp) {
+    entries.clear();
+    // A partitioned cluster keeps each key on a different replica set, so
+    // only every server together covers the whole range
+    std::vector<size_t> servers = ring_.AllServers();
+    size_t needed = ring_.Partitioned() ? servers.size() : static_cast<size_t>(config_.GetReadQuorum());
+    std::vector<std::shared_ptr<ABDService::Stub>> stubs = GetStubs(servers);
+    auto complete = [](const ABDScanResponse& reply) { return reply.success(); };
+    
+    std::string cursor = start_key;
+    while (entries.size() < limit) {
+        ABDScanRequest request;
+        request.set_start_key(cursor);
+        request.set_end_key(end_key);
+        request.set_limit(static_cast<int32_t>(std::min<size_t>(limit - entries.size(), INT32_MAX)));
+        request.set_read_timestamp(read_timestamp);
+        ScanCall call(servers.size(), RPC_TIMEOUT);
+        for (size_t i = 0; i < servers.size(); i++) {
+            call.Send(i, stubs[i], request,
+                [](ABDService::Stub* stub, grpc::ClientContext* context,
+                   const ABDScanRequest* req, ABDScanResponse* reply, RpcDoneCallback done) {
+                    stub->async()->Scan(context, req, reply, std::move(done));
+                });
+        }
+        std::vector<size_t> replied = call.Wait(needed, complete);
+        if (replied.size() < needed) {
+            LOG_WARN_EVERY(1000, "[ABD SCAN] Error: Only got " << replied.size()
+                                 << " responses, need " << needed);
+            entries.clear();
+            return false;
+        }
+        
+        // A page cut short only covers keys up to its last one; past the
+        // shortest such page another replica's keys could be missing
+        const std::string* bound = nullptr;
+        for (size_t r : replied) {
+            const ABDScanResponse& reply = call.GetReply(r);
+            if (reply.more() && reply.entries_size() > 0) {
+                const std::string& last = reply.entries(reply.entries_size() - 1).key();
+                if (bound == nullptr || last < *bound) {
+                    bound = &last;
+                }
+            }
+        }
+        
+        // Merge the sorted pages, keeping each key's newest version
+        std::vector<int> next(replied.size(), 0);
+        while (entries.size() < limit) {
+            const std::string* key = nullptr;
+            for (size_t r = 0; r < replied.size(); r++) {
+                const ABDScanResponse& reply = call.GetReply(replied[r]);
+                if (next[r] < reply.entries_size()) {
+                    const std::string& candidate = reply.entries(next[r]).key();
+                    if ((bound == nullptr || candidate <= *bound) && (key == nullptr || candidate < *key)) {
+                        key = &candidate;
+                    }
+                }
+            }
+            if (key == nullptr) {
                 break;
             }
-        } else {
-            std::cerr << "[ABD WRITE] Server " << i << " failed or returned error" << std::endl;
+            const ABDWriteRequest* newest = nullptr;
+            for (size_t r = 0; r < replied.size(); r++) {
+                const ABDScanResponse& reply = call.GetReply(replied[r]);
+                if (next[r] < reply.entries_size() && reply.entries(next[r]).key() == *key) {
+                    const ABDWriteRequest& entry = reply.entries(next[r]);
+                    if (newest == nullptr || entry.timestamp() > newest->timestamp()) {
+                        newest = &entry;
+                    }
+                    next[r]++;
+                }
+            }
+            // In a snapshot, a key created after it comes back with timestamp 0
+            if (newest->timestamp() == 0) {
+                continue;
+            }
+            clock_.Observe(newest->timestamp());
+            entries.emplace_back(newest->key(), newest->value());
+        }
+        
+        if (bound == nullptr) {
+            break;      // Every page reached the end of the range
         }
+        cursor = *bound + '\0';     // The smallest key after the bound
+    }
+    LOG_DEBUG("[ABD SCAN] Read " << entries.size() << " entries from '" << start_key << "'");
+    return true;
+}
+
+int64_t ABDClientImpl::SnapshotTimestamp() {
+    return clock_.Now();
+}
+
+bool ABDClientImpl::ReadAt(const std::string& key, int64_t read_timestamp, std::string& value) {
+    std::vector<size_t> replicas = ring_.ReplicasFor(key);
+    size_t needed = static_cast<size_t>(config_.GetReadQuorum());
+    if (needed > replicas.size()) {
+        LOG_ERROR("Error: Read quorum larger than replica set size");
+        return false;
     }
+    std::vector<std::shared_ptr<ABDService::Stub>> stubs = GetStubs(replicas);
     
-    if (written < write_quorum) {
-        std::cerr << "[ABD WRITE] Error: Only got " << written 
-                  << " acknowledgments, need " << write_quorum << std::endl;
+    ABDReadAtRequest request;
+    request.set_key(key);
+    request.set_read_timestamp(read_timestamp);
+    ReadAtCall call(replicas.size(), RPC_TIMEOUT);
+    for (size_t i = 0; i < replicas.size(); i++) {
+        call.Send(i, stubs[i], request,
+            [](ABDService::Stub* stub, grpc::ClientContext* context,
+               const ABDReadAtRequest* req, ABDReadAtResponse* reply, RpcDoneCallback done) {
+                stub->async()->ReadAt(context, req, reply, std::move(done));
+            });
+    }
+    // A replica that dropped the version might have held a newer one at or
+    // below the snapshot than the others, so only full answers count
+    std::vector<size_t> replied = call.Wait(needed, [](const ABDReadAtResponse& reply) {
+        return reply.success() && !reply.too_old();
+    });
+    if (replied.size() < needed) {
+        LOG_WARN_EVERY(1000, "[ABD READ AT] Error: Only got " << replied.size()
+                             << " responses with the version, need " << needed);
         return false;
     }
     
-    std::cerr << "[ABD WRITE] Write committed successfully" << std::endl;
+    // Every version at or below the snapshot that completed reached a write
+    // quorum, which overlaps this read quorum
+    size_t newest = *std::max_element(replied.begin(), replied.end(), [&call](size_t a, size_t b) {
+        return call.GetReply(a).timestamp() < call.GetReply(b).timestamp();
+    });
+    clock_.Observe(call.GetReply(newest).timestamp());
+    value = call.GetReply(newest).value();
+    LOG_DEBUG("[ABD READ AT] key='" << key << "' at ts=" << read_timestamp
+              << ": version ts=" << call.GetReply(newest).timestamp());
     return true;
 }
 
-}
+}
\ No newline at end of file
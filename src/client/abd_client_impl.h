@@ -5,10 +5,19 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <mutex>
 #include <cstdint>
+#include <chrono>
 #include <grpcpp/grpcpp.h>
 #include "../common/config.h"
+#include "../common/hash_ring.h"
+#include "../common/hlc.h"
+#include "channel_pool.h"
+#include "coalescer.h"
+#include "quorum_call.h"
+#include "read_cache.h"
+#include "replica_stats.h"
+#include "replica_transport.h"
+#include "stream_transport.h"
 
 // Proto headers
 #include "kvstore.grpc.pb.h"
@@ -19,7 +28,9 @@ namespace kvstore {
 // ABD Client Implementation
 class ABDClientImpl {
 public:
-    ABDClientImpl(const Config& config);
+    // @throws std::out_of_range if client_id is outside 0..hlc::kMaxClientId
+    //         (see hlc::ClientWriterId)
+    ABDClientImpl(const Config& config, int32_t client_id);
     ~ABDClientImpl();
     
     // Read a key using the ABD two-phase read protocol.
@@ -28,49 +39,178 @@ public:
     // Write a key-value pair using the ABD write protocol.
     bool Write(const std::string& key, const std::string& value);
     
-    // Get the client's current logical timestamp.
+    // Read a batch of keys with one round trip per replica per phase.
+    bool MultiRead(const std::vector<std::string>& keys, std::vector<std::string>& values);
+    
+    // Write a batch of key-value pairs with one round trip per replica.
+    bool MultiWrite(const std::vector<std::string>& keys, const std::vector<std::string>& values);
+    
+    // Read a key range in order, merging each page of the replicas' replies.
+    bool Scan(const std::string& start_key, const std::string& end_key, size_t limit,
+              std::vector<std::pair<std::string, std::string>>& entries, int64_t read_timestamp);
+    
+    // A new timestamp to read a snapshot at.
+    int64_t SnapshotTimestamp();
+    
+    // Read a key's version at a snapshot from a read quorum, without write-back.
+    bool ReadAt(const std::string& key, int64_t read_timestamp, std::string& value);
+    
+    // Get the largest timestamp the client has issued or seen.
     int64_t GetCurrentTimestamp() const;
 
 private:
     Config config_;  // Configuration (servers, quorums, etc.)
     
-    mutable std::mutex timestamp_mutex_;  // Protects client_timestamp_
-    int64_t client_timestamp_;            // Client's logical clock
+    HybridClock clock_;          // Source of write timestamps; tracks every timestamp seen
+    HashRing ring_;              // Picks each key's replica set
+    
+    std::unique_ptr<ChannelPool> pool_;                    // Null when pooling is disabled
+    std::unique_ptr<StubCache<ABDService>> stub_cache_;    // Stubs built on pool_
+    
+    // One transport per server for single-key operations: a stream session
+    // with the streaming transport, a coalescer when request coalescing is
+    // enabled, empty for plain unary RPCs. Declared after the stub cache so
+    // it is destroyed first.
+    std::vector<std::unique_ptr<ABDReplicaTransport>> transports_;
+    
+    std::unique_ptr<ReadCache> cache_;   // Null unless "read_cache_entries" is set
+    
+    // Latency of every server, for picking read replicas. Null unless
+    // "adaptive_reads" is set; shared with in-flight RPC callbacks.
+    std::shared_ptr<ReplicaStats> replica_stats_;
     
     // Create a gRPC stub for communicating with a server.
     // @param server Server information (host, port)
     // @return gRPC stub for this server
     std::unique_ptr<ABDService::Stub> CreateStub(const ServerInfo& server);
     
-    // Response from a read operation on a single server.
-    struct ReadResponse {
-        std::string value;      // Value returned by server
-        int64_t timestamp;      // Timestamp of the value
-        bool success;           // Whether the RPC succeeded
+    // Get the stub for a server: the pooled stub when pooling is enabled,
+    // otherwise a freshly created one (one connection per operation).
+    // @param index Position of the server in config_.GetServers()
+    std::shared_ptr<ABDService::Stub> GetStub(size_t index);
+    
+    // Stubs for a replica set, in the same order.
+    std::vector<std::shared_ptr<ABDService::Stub>> GetStubs(const std::vector<size_t>& replicas);
+    
+    // Keys of a batch that share a replica set.
+    struct KeyGroup {
+        std::vector<size_t> replicas;   // Server indices, ascending
+        std::vector<size_t> positions;  // Positions of the group's keys in the batch
     };
     
-    // Read a key from a single server.
+    // Split a batch by replica set, keeping batch order within each group.
+    std::vector<KeyGroup> GroupByReplicas(const std::vector<std::string>& keys) const;
+    
+    // MultiRead / MultiWrite for keys that all live on `replicas`.
+    bool MultiReadOn(const std::vector<size_t>& replicas, const std::vector<std::string>& keys,
+                     std::vector<std::string>& values);
+    bool MultiWriteOn(const std::vector<size_t>& replicas, const std::vector<std::string>& keys,
+                      const std::vector<std::string>& values);
+    
+    using ReadCall = QuorumCall<ABDReadRequest, ABDReadResponse>;
+    using WriteCall = QuorumCall<ABDWriteRequest, ABDWriteResponse>;
+    using MultiReadCall = QuorumCall<ABDMultiReadRequest, ABDMultiReadResponse>;
+    using MultiWriteCall = QuorumCall<ABDMultiWriteRequest, ABDMultiWriteResponse>;
+    using ProbeCall = QuorumCall<ABDReadTimestampRequest, ABDReadTimestampResponse>;
+    using ScanCall = QuorumCall<ABDScanRequest, ABDScanResponse>;
+    using ReadAtCall = QuorumCall<ABDReadAtRequest, ABDReadAtResponse>;
+    using ConditionalWriteCall = QuorumCall<ABDWriteRequest, ABDWriteIfNewerResponse>;
+    
+    // Deadline for every RPC sent to a server
+    static constexpr std::chrono::seconds RPC_TIMEOUT{5};
+    
+    // Rounds a write makes before giving up on replicas holding newer timestamps
+    static constexpr int MAX_WRITE_ROUNDS = 8;
+    
+    // Whether a value is written with WriteIfNewer: conditional_writes is on
+    // and the value is small enough for a unary RPC.
+    bool WritesConditionally(const std::string& value) const;
+    
+    // Write with conditional_writes: every replica is sent WriteIfNewer under
+    // a timestamp from our clock, and the write is done once a write quorum
+    // accepts it (one round when uncontended). Any write that finished before
+    // this one started holds a newer-or-equal timestamp at a write quorum,
+    // which overlaps ours, so acceptance by a quorum orders this write after
+    // it. A replica with a newer timestamp turns the write down; the next
+    // round goes above the largest timestamp turned down with.
+    // @param stubs One stub per replica
+    bool ConditionalWrite(const std::string& key, const std::string& value,
+                          const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
+    
+    // Send WriteIfNewer to every replica without waiting (always unary RPCs).
+    // @param stubs One stub per replica
+    void SendConditionalWrites(ConditionalWriteCall& call, const std::string& key, const std::string& value,
+                               int64_t timestamp, const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
+    
+    // Serve a read from the cache: probe a read quorum for the key's
+    // timestamp and use the cached value if no server has a newer one. Any
+    // write that completed after the cached value reached a write quorum
+    // under a larger timestamp, and every read quorum overlaps it.
+    // @param stubs One stub per replica
+    // @return false on a cache miss, a newer timestamp, or a failed probe
+    bool ReadCached(const std::string& key,
+                    const std::vector<std::shared_ptr<ABDService::Stub>>& stubs, std::string& value);
+    
+    // Observe the timestamps the acknowledging servers stored a write under.
+    // @return The smallest of them (0 if none acked)
+    int64_t AckedTimestamps(const WriteCall& call, const std::vector<size_t>& acked);
+    
+    // Send a timestamp-only read for a key to every replica without waiting.
+    // @param stubs One stub per replica
+    void SendProbes(ProbeCall& call, const std::string& key,
+                    const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
+    
+    // Send a read request for a key to every replica without waiting.
+    // With a replica transport the request goes out as a stream frame or
+    // joins each server's next batch.
+    // @param call Quorum call that collects the replies (indexed like replicas)
     // @param key Key to read
-    // @param stub gRPC stub for the server
-    // @return ReadResponse with value, timestamp, and success status
-    ReadResponse ReadFromServer(const std::string& key, 
-                                std::unique_ptr<ABDService::Stub>& stub);
+    // @param replicas The key's replica set
+    // @param stubs One stub per replica
+    void SendReads(ReadCall& call, const std::string& key, const std::vector<size_t>& replicas,
+                   const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
+    
+    // Send the read for one replica (see SendReads).
+    // @param index Position of the replica in the call
+    // @param server The replica's index in config_.GetServers()
+    void SendRead(ReadCall& call, size_t index, const std::string& key, size_t server,
+                  const std::shared_ptr<ABDService::Stub>& stub);
     
-    // Write a key-value pair to a single server.
+    // Phase 1 of a read: send it and wait for a read quorum of replies.
+    // Normally every replica is asked at once. With adaptive reads only the
+    // R fastest are; whenever the slowest of those has taken longer than its
+    // hedge delay (or one fails) the next fastest replica is added.
+    // @return Indices of the successful replies, in arrival order
+    std::vector<size_t> QueryReplicas(ReadCall& call, const std::string& key,
+                                      const std::vector<size_t>& replicas,
+                                      const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
+    
+    // Send a write request to every replica without waiting.
+    // With a replica transport the request goes out as a stream frame or
+    // joins each server's next batch.
+    // @param call Quorum call that collects the replies (indexed like replicas)
     // @param key Key to write
     // @param value Value to write
     // @param timestamp Timestamp for this write
-    // @param stub gRPC stub for the server
-    // @return true if write succeeded, false otherwise
-    bool WriteToServer(const std::string& key, const std::string& value, 
-                      int64_t timestamp,
-                      std::unique_ptr<ABDService::Stub>& stub);
-    
-    // Update the client's logical timestamp based on a server response.
-    // The client timestamp is always kept greater than or equal to any
-    // timestamp it has seen from servers. This ensures monotonicity.
-    // @param timestamp Timestamp received from a server
-    void UpdateTimestamp(int64_t timestamp);
+    // @param replicas The key's replica set
+    // @param stubs One stub per replica
+    void SendWrites(WriteCall& call, const std::string& key, const std::string& value,
+                    int64_t timestamp, const std::vector<size_t>& replicas,
+                    const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
+    
+    // Send the same batched read to every server without waiting.
+    // @param call Quorum call that collects the replies
+    // @param request Batch to send (copied for each server)
+    // @param stubs One stub per server
+    void SendMultiReads(MultiReadCall& call, const ABDMultiReadRequest& request,
+                        const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
+    
+    // Send the same batched write to every server without waiting.
+    // @param call Quorum call that collects the replies
+    // @param request Batch to send (copied for each server)
+    // @param stubs One stub per server
+    void SendMultiWrites(MultiWriteCall& call, const ABDMultiWriteRequest& request,
+                         const std::vector<std::shared_ptr<ABDService::Stub>>& stubs);
 };
 
 }
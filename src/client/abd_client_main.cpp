@@ -2,19 +2,29 @@
 
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 #include "abd_client.h"
 #include "../common/config.h"
+#include "../common/hlc.h"
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <config_file> [commands...]" << std::endl;
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <config_file> <client_id> [commands...]" << std::endl;
         std::cerr << "Commands:" << std::endl;
         std::cerr << "  read <key>" << std::endl;
         std::cerr << "  write <key> <value>" << std::endl;
+        std::cerr << "  scan <start_key> <end_key> <limit>  (end_key \"\" = no bound)" << std::endl;
         return 1;
     }
     
     std::string config_file = argv[1];
+    int32_t client_id = std::stoi(argv[2]);
+    if (!kvstore::hlc::ValidClientId(client_id)) {
+        std::cerr << "Error: client_id must be in 0.." << kvstore::hlc::kMaxClientId << std::endl;
+        return 1;
+    }
+    
     kvstore::Config config;
     
     if (!config.LoadFromFile(config_file)) {
@@ -22,11 +32,11 @@ int main(int argc, char** argv) {
         return 1;
     }
     
-    kvstore::ABDClient client(config);
+    kvstore::ABDClient client(config, client_id);
     
     // Interactive mode if no commands provided
-    if (argc == 2) {
-        std::cout << "ABD Client - Interactive Mode" << std::endl;
+    if (argc == 3) {
+        std::cout << "ABD Client (ID: " << client_id << ") - Interactive Mode" << std::endl;
         std::cout << "Commands: read <key>, write <key> <value>, quit" << std::endl;
         
         std::string command;
@@ -60,7 +70,7 @@ int main(int argc, char** argv) {
         }
     } else {
         // Command-line mode: parse commands from arguments
-        for (int i = 2; i < argc; i++) {
+        for (int i = 3; i < argc; i++) {
             std::string cmd = argv[i];
             if (cmd == "read" && i + 1 < argc) {
                 std::string key = argv[++i];
@@ -78,6 +88,18 @@ int main(int argc, char** argv) {
                     std::cerr << "Error: Write failed" << std::endl;
                     return 1;
                 }
+            } else if (cmd == "scan" && i + 3 < argc) {
+                std::string start_key = argv[++i];
+                std::string end_key = argv[++i];
+                size_t limit = std::stoul(argv[++i]);
+                std::vector<std::pair<std::string, std::string>> entries;
+                if (!client.Scan(start_key, end_key, limit, entries)) {
+                    std::cerr << "Error: Scan failed" << std::endl;
+                    return 1;
+                }
+                for (const auto& entry : entries) {
+                    std::cout << entry.first << "\t" << entry.second << std::endl;
+                }
             }
         }
     }
@@ -16,7 +16,9 @@ class BlockingClient {
 public:
     // Create a Blocking client with the given configuration and client ID.
     // @param config Configuration object containing server addresses and quorum sizes
-    // @param client_id Unique identifier for this client (used for lock ownership)
+    // @param client_id Unique identifier for this client, 0..2047 (used for lock
+    //                  ownership and as the writer id in its timestamps);
+    //                  throws std::out_of_range otherwise
     BlockingClient(const Config& config, int32_t client_id);
     ~BlockingClient();
     
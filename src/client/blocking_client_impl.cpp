@@ -2,15 +2,21 @@
 
 #include "blocking_client_impl.h"
 #include "../common/utils.h"
+#include "../common/logging.h"
+#include "../common/phase_timer.h"
 #include <algorithm>
-#include <future>
 #include <chrono>
-#include <iostream>
 
 namespace kvstore {
 
 BlockingClientImpl::BlockingClientImpl(const Config& config, int32_t client_id)
-    : config_(config), client_id_(client_id), client_timestamp_(GetCurrentTimestamp()) {
+    : config_(config), client_id_(client_id), lock_lease_(config.GetLockLeaseMs()),
+      clock_(hlc::ClientWriterId(client_id)),
+      ring_(config.GetServers(), config.GetNumReplicas(), config.GetVirtualNodes()) {
+    if (config_.UseConnectionPool()) {
+        pool_ = std::make_unique<ChannelPool>(config_.GetServers());
+        stub_cache_ = std::make_unique<StubCache<BlockingService>>(*pool_);
+    }
 }
 
 BlockingClientImpl::~BlockingClientImpl() {
@@ -22,310 +28,335 @@ std::unique_ptr<BlockingService::Stub> BlockingClientImpl::CreateStub(const Serv
     return BlockingService::NewStub(channel);
 }
 
-BlockingClientImpl::LockResponse BlockingClientImpl::AcquireLockFromServer(
-    const std::string& key,
-    std::unique_ptr<BlockingService::Stub>& stub) {
-    
-    LockResponse response;
-    response.granted = false;
-    
-    grpc::ClientContext context;
+std::shared_ptr<BlockingService::Stub> BlockingClientImpl::GetStub(size_t index) {
+    if (stub_cache_) {
+        return stub_cache_->Get(index);
+    }
+    return CreateStub(config_.GetServers()[index]);
+}
+
+BlockingClientImpl::StubList BlockingClientImpl::StubsFor(const std::string& key) {
+    // ReplicasFor() returns ascending server indices, so the lock order
+    // below is the same global server order for every client
+    StubList stubs;
+    for (size_t server : ring_.ReplicasFor(key)) {
+        stubs.push_back(GetStub(server));
+    }
+    return stubs;
+}
+
+BlockingLockRequest BlockingClientImpl::MakeLockRequest(const std::string& key,
+                                                        std::chrono::milliseconds wait) const {
     BlockingLockRequest request;
-    BlockingLockResponse reply;
-    
     request.set_key(key);
     request.set_client_id(client_id_);
-    
-    grpc::Status status = stub->AcquireLock(&context, request, &reply);
-    
-    if (status.ok()) {
-        response.granted = reply.granted();
-        response.timestamp = reply.timestamp();
+    request.set_wait_ms(static_cast<int32_t>(wait.count()));
+    request.set_lease_ms(static_cast<int32_t>(lock_lease_.count()));
+    return request;
+}
+
+void BlockingClientImpl::SendLocks(LockCall& call, const std::string& key, const StubList& stubs,
+                                   const std::vector<size_t>& targets, std::chrono::milliseconds wait) {
+    for (size_t i : targets) {
+        call.Send(i, stubs[i], MakeLockRequest(key, wait),
+            [](BlockingService::Stub* stub, grpc::ClientContext* context,
+               const BlockingLockRequest* req, BlockingLockResponse* reply, RpcDoneCallback done) {
+                stub->async()->AcquireLock(context, req, reply, std::move(done));
+            });
     }
-    
-    return response;
 }
 
-bool BlockingClientImpl::ReleaseLockFromServer(
-    const std::string& key,
-    std::unique_ptr<BlockingService::Stub>& stub) {
-    
-    grpc::ClientContext context;
-    BlockingUnlockRequest request;
-    BlockingUnlockResponse reply;
-    
-    request.set_key(key);
-    request.set_client_id(client_id_);
-    
-    grpc::Status status = stub->ReleaseLock(&context, request, &reply);
-    
-    return status.ok() && reply.success();
+void BlockingClientImpl::SendLocks(LockReadCall& call, const std::string& key, const StubList& stubs,
+                                   const std::vector<size_t>& targets, std::chrono::milliseconds wait) {
+    for (size_t i : targets) {
+        call.Send(i, stubs[i], MakeLockRequest(key, wait),
+            [](BlockingService::Stub* stub, grpc::ClientContext* context,
+               const BlockingLockRequest* req, BlockingLockReadResponse* reply, RpcDoneCallback done) {
+                stub->async()->LockAndRead(context, req, reply, std::move(done));
+            });
+    }
 }
 
-BlockingClientImpl::ReadResponse BlockingClientImpl::ReadFromServer(
-    const std::string& key,
-    std::unique_ptr<BlockingService::Stub>& stub) {
-    
-    ReadResponse response;
-    response.success = false;
-    
-    grpc::ClientContext context;
-    BlockingReadRequest request;
-    BlockingReadResponse reply;
-    
-    request.set_key(key);
-    request.set_client_id(client_id_);
-    
-    grpc::Status status = stub->Read(&context, request, &reply);
-    
-    if (status.ok()) {
-        response.value = reply.value();
-        response.timestamp = reply.timestamp();
-        response.success = reply.success();
+void BlockingClientImpl::SendRenewals(RenewCall& call, const std::string& key,
+                                      const StubList& stubs, const std::vector<size_t>& targets) {
+    for (size_t i : targets) {
+        BlockingRenewRequest request;
+        request.set_key(key);
+        request.set_client_id(client_id_);
+        request.set_lease_ms(static_cast<int32_t>(lock_lease_.count()));
+        call.Send(i, stubs[i], std::move(request),
+            [](BlockingService::Stub* stub, grpc::ClientContext* context,
+               const BlockingRenewRequest* req, BlockingRenewResponse* reply, RpcDoneCallback done) {
+                stub->async()->RenewLock(context, req, reply, std::move(done));
+            });
     }
-    
-    return response;
 }
 
-bool BlockingClientImpl::WriteToServer(const std::string& key,
-                                   const std::string& value,
-                                   int64_t timestamp,
-                                   std::unique_ptr<BlockingService::Stub>& stub) {
-    grpc::ClientContext context;
-    BlockingWriteRequest request;
-    BlockingWriteResponse reply;
-    
-    request.set_key(key);
-    request.set_value(value);
-    request.set_timestamp(timestamp);
-    request.set_client_id(client_id_);
-    
-    grpc::Status status = stub->Write(&context, request, &reply);
+void BlockingClientImpl::SendUnlocks(UnlockCall& call, const std::string& key,
+                                     const StubList& stubs, const std::vector<size_t>& targets) {
+    for (size_t i : targets) {
+        BlockingUnlockRequest request;
+        request.set_key(key);
+        request.set_client_id(client_id_);
+        call.Send(i, stubs[i], std::move(request),
+            [](BlockingService::Stub* stub, grpc::ClientContext* context,
+               const BlockingUnlockRequest* req, BlockingUnlockResponse* reply, RpcDoneCallback done) {
+                stub->async()->ReleaseLock(context, req, reply, std::move(done));
+            });
+    }
+}
+
+void BlockingClientImpl::SendWriteUnlocks(WriteCall& call, const std::string& key,
+                                          const std::string& value, int64_t timestamp,
+                                          const StubList& stubs,
+                                          const std::vector<size_t>& targets) {
+    for (size_t i : targets) {
+        BlockingWriteRequest request;
+        request.set_key(key);
+        request.set_value(value);
+        request.set_timestamp(timestamp);
+        request.set_client_id(client_id_);
+        call.Send(i, stubs[i], std::move(request),
+            [](BlockingService::Stub* stub, grpc::ClientContext* context,
+               const BlockingWriteRequest* req, BlockingWriteResponse* reply, RpcDoneCallback done) {
+                stub->async()->WriteAndUnlock(context, req, reply, std::move(done));
+            });
+    }
+}
+
+template <typename Call>
+std::unique_ptr<Call> BlockingClientImpl::AcquireLocks(const std::string& key, const StubList& stubs,
+                                                       size_t quorum, std::vector<size_t>& held,
+                                                       Clock::time_point& lease_start) {
+    ScopedPhase timer(Phase::LOCK);
+    auto granted = [](const auto& reply) { return reply.granted(); };
+    std::vector<size_t> all(stubs.size());
+    for (size_t i = 0; i < all.size(); i++) {
+        all[i] = i;
+    }
     
-    if (status.ok() && reply.success()) {
-        UpdateTimestamp(reply.timestamp());
-        return true;
+    // Ask every server at once; a server whose lock is taken says so at once
+    auto call = std::make_unique<Call>(stubs.size(), RPC_TIMEOUT);
+    lease_start = Clock::now();
+    SendLocks(*call, key, stubs, all, std::chrono::milliseconds(0));
+    held = call->WaitUntil(quorum, granted, Clock::now() + LOCK_REPLY_SLACK);
+    if (held.size() >= quorum) {
+        std::sort(held.begin(), held.end());
+        return call;
     }
     
-    return false;
+    // Contended: holding some locks while queueing for others out of order
+    // could deadlock, so give them back and queue in server order
+    ReleaseLocks(key, stubs, PossibleLockHolders(*call, stubs.size()));
+    call = std::make_unique<Call>(stubs.size(), RPC_TIMEOUT);
+    held.clear();
+    size_t sent = 0;
+    for (size_t i = 0; i < stubs.size() && held.size() < quorum; i++) {
+        if (held.size() + (stubs.size() - i) < quorum) {
+            break;      // Too few servers left to reach the quorum
+        }
+        if (held.empty()) {
+            lease_start = Clock::now();
+        } else {
+            // Queueing on the next server may take a while - keep the locks
+            // we already have from lapsing meanwhile
+            RenewLeases(key, stubs, held, lease_start);
+        }
+        // Only ever wait on a server while holding locks on lower ones
+        SendLocks(*call, key, stubs, {i}, LockWait());
+        call->WaitUntil(++sent, [](const auto&) { return true; },
+                        Clock::now() + LockWait() + LOCK_REPLY_SLACK);
+        // A server that hasn't answered is passed over; it may still grant
+        // the lock later and is released with the other possible holders
+        if (call->Done(i) && call->GetStatus(i).ok() && call->GetReply(i).granted()) {
+            held.push_back(i);
+        }
+    }
+    return call;
 }
 
-void BlockingClientImpl::UpdateTimestamp(int64_t timestamp) {
-    std::lock_guard<std::mutex> lock(timestamp_mutex_);
-    if (timestamp > client_timestamp_) {
-        client_timestamp_ = timestamp;
+void BlockingClientImpl::RenewLeases(const std::string& key, const StubList& stubs,
+                                     std::vector<size_t>& held, Clock::time_point& lease_start) {
+    auto now = Clock::now();
+    if (held.empty() || now - lease_start < lock_lease_ / 2) {
+        return;
     }
-    client_timestamp_++;
+    lease_start = now;
+    RenewCall call(stubs.size(), RPC_TIMEOUT);
+    SendRenewals(call, key, stubs, held);
+    held = call.Wait(held.size(),
+        [](const BlockingRenewResponse& reply) { return reply.renewed(); });
+    std::sort(held.begin(), held.end());
+}
+
+template <typename Call>
+std::vector<size_t> BlockingClientImpl::PossibleLockHolders(const Call& call,
+                                                            size_t num_servers) const {
+    std::vector<size_t> holders;
+    for (size_t i = 0; i < num_servers; i++) {
+        if (!call.Sent(i)) {
+            continue;
+        }
+        // Only an explicit denial proves the server doesn't hold our lock
+        bool denied = call.Done(i) && call.GetStatus(i).ok() && !call.GetReply(i).granted();
+        if (!denied) {
+            holders.push_back(i);
+        }
+    }
+    return holders;
+}
+
+size_t BlockingClientImpl::ReleaseLocks(const std::string& key, const StubList& stubs,
+                                        const std::vector<size_t>& targets) {
+    ScopedPhase timer(Phase::UNLOCK);
+    UnlockCall call(stubs.size(), RPC_TIMEOUT);
+    SendUnlocks(call, key, stubs, targets);
+    // Wait for every release - cancelling one would leave the lock held
+    return call.Wait(targets.size(),
+        [](const BlockingUnlockResponse& reply) { return reply.success(); }).size();
 }
 
 int64_t BlockingClientImpl::GetCurrentTimestamp() const {
-    std::lock_guard<std::mutex> lock(timestamp_mutex_);
-    return client_timestamp_;
+    return clock_.Last();
 }
 
 bool BlockingClientImpl::Read(const std::string& key, std::string& value) {
     int32_t read_quorum = config_.GetReadQuorum();
-    const auto& servers = config_.GetServers();
+    StubList stubs = StubsFor(key);
     
-    std::cerr << "\n[BLOCKING READ]" << std::endl;
-    std::cerr << "[BLOCKING READ] Starting read for key='" << key << "'" << std::endl;
-    std::cerr << "[BLOCKING READ] Need R=" << read_quorum << " locks from " 
-              << servers.size() << " servers" << std::endl;
+    LOG_DEBUG("[BLOCKING READ] Starting read for key='" << key << "'");
+    LOG_DEBUG("[BLOCKING READ] Need R=" << read_quorum << " locks from " 
+              << stubs.size() << " servers");
     
-    if (static_cast<size_t>(read_quorum) > servers.size()) {
-        std::cerr << "[BLOCKING READ] ✗ Error: Read quorum larger than number of servers" << std::endl;
+    if (static_cast<size_t>(read_quorum) > stubs.size()) {
+        LOG_ERROR("[BLOCKING READ] ✗ Error: Read quorum larger than replica set size");
         return false;
     }
     
-    // PHASE 1: Acquire locks
-    std::cerr << "[BLOCKING READ Phase 1] Requesting locks from " << servers.size() << " servers..." << std::endl;
-    
-    std::vector<std::unique_ptr<BlockingService::Stub>> stubs;
-    for (const auto& server : servers) {
-        stubs.push_back(CreateStub(server));
-    }
+    // PHASE 1: Acquire locks and read under them
+    LOG_DEBUG("[BLOCKING READ Phase 1] Requesting locks from up to " << stubs.size() << " servers...");
     
-    // Send lock requests to all servers in parallel
-    std::vector<std::future<LockResponse>> lock_futures;
-    for (size_t i = 0; i < servers.size(); i++) {
-        lock_futures.push_back(std::async(std::launch::async,
-            &BlockingClientImpl::AcquireLockFromServer, this, key, std::ref(stubs[i])));
-    }
-    
-    // Collect lock grants until we have a read quorum
+    // Take locks until we have a read quorum (see AcquireLocks). Each grant
+    // comes back with the server's value, so no separate read round is
+    // needed.
+    Clock::time_point lease_start;
     std::vector<size_t> locked_server_indices;
-    for (size_t i = 0; i < lock_futures.size(); i++) {
-        auto lock_response = lock_futures[i].get();
-        if (lock_response.granted) {
-            locked_server_indices.push_back(i);
-            std::cerr << "[BLOCKING READ Phase 1] Lock granted from server " << i 
-                      << " (" << locked_server_indices.size() << "/" << read_quorum << ")" << std::endl;
-            if (static_cast<int32_t>(locked_server_indices.size()) >= read_quorum) {
-                std::cerr << "[BLOCKING READ Phase 1] Lock quorum achieved! (" 
-                          << locked_server_indices.size() << " locks)" << std::endl;
-                break;
-            }
-        } else {
-            std::cerr << "[BLOCKING READ Phase 1] Lock denied from server " << i 
-                      << " (may be held by another client)" << std::endl;
-        }
-    }
+    std::unique_ptr<LockReadCall> locks =
+        AcquireLocks<LockReadCall>(key, stubs, read_quorum, locked_server_indices, lease_start);
+    std::vector<size_t> lock_holders = PossibleLockHolders(*locks, stubs.size());
     
     // If we didn't get enough locks, release what we got and fail
     if (static_cast<int32_t>(locked_server_indices.size()) < read_quorum) {
-        std::cerr << "[BLOCKING READ Phase 1] Only got " << locked_server_indices.size() 
-                  << " locks, need " << read_quorum << " - releasing locks..." << std::endl;
-        for (size_t idx : locked_server_indices) {
-            ReleaseLockFromServer(key, stubs[idx]);
-        }
-        std::cerr << "[BLOCKING READ] Failed: Could not acquire read quorum locks" << std::endl;
-        return false;
-    }
-    
-    // PHASE 2: Read from locked servers
-    std::cerr << "[BLOCKING READ Phase 2] Reading from " << locked_server_indices.size() 
-              << " locked servers..." << std::endl;
-    
-    std::vector<ReadResponse> responses;
-    for (size_t idx : locked_server_indices) {
-        auto response = ReadFromServer(key, stubs[idx]);
-        if (response.success) {
-            responses.push_back(response);
-            std::cerr << "[BLOCKING READ Phase 2] Read from server " << idx 
-                      << " (ts=" << response.timestamp << ")" << std::endl;
-        } else {
-            std::cerr << "[BLOCKING READ Phase 2] Read failed from server " << idx << std::endl;
-        }
-    }
-    
-    if (responses.empty()) {
-        std::cerr << "[BLOCKING READ Phase 2] No successful reads - releasing locks..." << std::endl;
-        for (size_t idx : locked_server_indices) {
-            ReleaseLockFromServer(key, stubs[idx]);
-        }
-        std::cerr << "[BLOCKING READ] Failed: Could not read from locked servers" << std::endl;
+        LOG_DEBUG("[BLOCKING READ Phase 1] Only got " << locked_server_indices.size() 
+                  << " locks, need " << read_quorum << " - releasing locks...");
+        ReleaseLocks(key, stubs, lock_holders);
+        LOG_WARN_EVERY(1000, "[BLOCKING READ] Failed: Could not acquire read quorum locks");
         return false;
     }
+    LOG_DEBUG("[BLOCKING READ Phase 1] Lock quorum achieved! (" 
+              << locked_server_indices.size() << " locks)");
     
-    // PHASE 3: Find maximum timestamp value
-    auto max_response = std::max_element(responses.begin(), responses.end(),
-        [](const ReadResponse& a, const ReadResponse& b) {
-            return a.timestamp < b.timestamp;
+    // PHASE 2: Find maximum timestamp value
+    size_t max_index = *std::max_element(locked_server_indices.begin(), locked_server_indices.end(),
+        [&locks](size_t a, size_t b) {
+            return locks->GetReply(a).value_timestamp() < locks->GetReply(b).value_timestamp();
         });
     
-    value = max_response->value;
-    std::cerr << "[BLOCKING READ Phase 3] Found max timestamp: " << max_response->timestamp 
-              << " (value='" << value << "')" << std::endl;
+    value = locks->GetReply(max_index).value();
+    clock_.Observe(locks->GetReply(max_index).value_timestamp());
+    LOG_DEBUG("[BLOCKING READ Phase 2] Found max timestamp: "
+              << locks->GetReply(max_index).value_timestamp()
+              << " (value_size=" << value.size() << ")");
     
-    // PHASE 4: Release locks
-    std::cerr << "[BLOCKING READ Phase 4] Releasing " << locked_server_indices.size() << " locks..." << std::endl;
-    for (size_t idx : locked_server_indices) {
-        if (ReleaseLockFromServer(key, stubs[idx])) {
-            std::cerr << "[BLOCKING READ Phase 4] Lock released from server " << idx << std::endl;
-        } else {
-            std::cerr << "[BLOCKING READ Phase 4] Failed to release lock from server " << idx << std::endl;
-        }
-    }
+    // PHASE 3: Release locks
+    LOG_DEBUG("[BLOCKING READ Phase 3] Releasing " << lock_holders.size() << " locks...");
+    size_t released = ReleaseLocks(key, stubs, lock_holders);
+    LOG_DEBUG("[BLOCKING READ Phase 3] Released " << released << "/" 
+              << lock_holders.size() << " locks");
     
-    std::cerr << "[BLOCKING READ] Read complete, value='" << value << "'" << std::endl;
+    LOG_DEBUG("[BLOCKING READ] Read complete, value_size=" << value.size());
     
     return true;
 }
 
 bool BlockingClientImpl::Write(const std::string& key, const std::string& value) {
     int32_t write_quorum = config_.GetWriteQuorum();
-    const auto& servers = config_.GetServers();
+    StubList stubs = StubsFor(key);
     
-    std::cerr << "\n[BLOCKING WRITE]" << std::endl;
-    std::cerr << "[BLOCKING WRITE] Starting write for key='" << key << "'" << std::endl;
-    std::cerr << "[BLOCKING WRITE] Need W=" << write_quorum << " locks from " 
-              << servers.size() << " servers" << std::endl;
+    LOG_DEBUG("[BLOCKING WRITE] Starting write for key='" << key << "'");
+    LOG_DEBUG("[BLOCKING WRITE] Need W=" << write_quorum << " locks from " 
+              << stubs.size() << " servers");
     
-    if (static_cast<size_t>(write_quorum) > servers.size()) {
-        std::cerr << "[BLOCKING WRITE] ✗ Error: Write quorum larger than number of servers" << std::endl;
+    if (static_cast<size_t>(write_quorum) > stubs.size()) {
+        LOG_ERROR("[BLOCKING WRITE] ✗ Error: Write quorum larger than replica set size");
         return false;
     }
     
     // PHASE 1: Acquire locks
-    std::cerr << "[BLOCKING WRITE Phase 1] Requesting locks from " << servers.size() << " servers..." << std::endl;
-    
-    std::vector<std::unique_ptr<BlockingService::Stub>> stubs;
-    for (const auto& server : servers) {
-        stubs.push_back(CreateStub(server));
-    }
-    
-    // Send lock requests to all servers in parallel
-    std::vector<std::future<LockResponse>> lock_futures;
-    for (size_t i = 0; i < servers.size(); i++) {
-        lock_futures.push_back(std::async(std::launch::async,
-            &BlockingClientImpl::AcquireLockFromServer, this, key, std::ref(stubs[i])));
-    }
+    LOG_DEBUG("[BLOCKING WRITE Phase 1] Requesting locks from up to " << stubs.size() << " servers...");
     
-    // Collect lock grants until we have a write quorum
+    // Take locks until we have a write quorum (see AcquireLocks)
+    Clock::time_point lease_start;
     std::vector<size_t> locked_server_indices;
-    for (size_t i = 0; i < lock_futures.size(); i++) {
-        auto lock_response = lock_futures[i].get();
-        if (lock_response.granted) {
-            locked_server_indices.push_back(i);
-            std::cerr << "[BLOCKING WRITE Phase 1] Lock granted from server " << i 
-                      << " (" << locked_server_indices.size() << "/" << write_quorum << ")" << std::endl;
-            if (static_cast<int32_t>(locked_server_indices.size()) >= write_quorum) {
-                std::cerr << "[BLOCKING WRITE Phase 1] Lock quorum achieved! (" 
-                          << locked_server_indices.size() << " locks)" << std::endl;
-                break;
-            }
-        } else {
-            std::cerr << "[BLOCKING WRITE Phase 1] Lock denied from server " << i 
-                      << " (may be held by another client)" << std::endl;
-        }
-    }
+    std::unique_ptr<LockCall> locks =
+        AcquireLocks<LockCall>(key, stubs, write_quorum, locked_server_indices, lease_start);
+    // The write is about to start - make sure its leases outlast it
+    RenewLeases(key, stubs, locked_server_indices, lease_start);
+    std::vector<size_t> lock_holders = PossibleLockHolders(*locks, stubs.size());
     
     // If we didn't get enough locks, release what we got and fail
     if (static_cast<int32_t>(locked_server_indices.size()) < write_quorum) {
-        std::cerr << "[BLOCKING WRITE Phase 1] Only got " << locked_server_indices.size() 
-                  << " locks, need " << write_quorum << " - releasing locks..." << std::endl;
-        for (size_t idx : locked_server_indices) {
-            ReleaseLockFromServer(key, stubs[idx]);
-        }
-        std::cerr << "[BLOCKING WRITE] Failed: Could not acquire write quorum locks" << std::endl;
+        LOG_DEBUG("[BLOCKING WRITE Phase 1] Only got " << locked_server_indices.size() 
+                  << " locks, need " << write_quorum << " - releasing locks...");
+        ReleaseLocks(key, stubs, lock_holders);
+        LOG_WARN_EVERY(1000, "[BLOCKING WRITE] Failed: Could not acquire write quorum locks");
         return false;
     }
-    
-    // PHASE 2: Write to locked servers
-    int64_t timestamp = GetCurrentTimestamp() + 1;
-    UpdateTimestamp(timestamp);
-    
-    std::cerr << "[BLOCKING WRITE Phase 2] Writing to " << locked_server_indices.size() 
-              << " locked servers (ts=" << timestamp << ")..." << std::endl;
-    
-    int32_t written = 0;
-    for (size_t idx : locked_server_indices) {
-        if (WriteToServer(key, value, timestamp, stubs[idx])) {
-            written++;
-            std::cerr << "[BLOCKING WRITE Phase 2] Write " << written << "/" << write_quorum 
-                      << " successful (server " << idx << ")" << std::endl;
-        } else {
-            std::cerr << "[BLOCKING WRITE Phase 2] Write failed (server " << idx << ")" << std::endl;
-        }
+    LOG_DEBUG("[BLOCKING WRITE Phase 1] Lock quorum achieved! (" 
+              << locked_server_indices.size() << " locks)");
+    
+    // PHASE 2: Write to locked servers, releasing each lock with the write
+    int64_t timestamp = clock_.Now();
+    
+    LOG_DEBUG("[BLOCKING WRITE Phase 2] Writing to " << locked_server_indices.size() 
+              << " locked servers (ts=" << timestamp << ")...");
+    
+    WriteCall writes(stubs.size(), RPC_TIMEOUT);
+    std::vector<size_t> acked;
+    {
+        ScopedPhase timer(Phase::WRITE);
+        SendWriteUnlocks(writes, key, value, timestamp, stubs, locked_server_indices);
+        acked = writes.Wait(locked_server_indices.size(),
+            [](const BlockingWriteResponse& reply) { return reply.success(); });
     }
-    
-    // PHASE 3: Release locks
-    std::cerr << "[BLOCKING WRITE Phase 3] Releasing " << locked_server_indices.size() << " locks..." << std::endl;
-    for (size_t idx : locked_server_indices) {
-        if (ReleaseLockFromServer(key, stubs[idx])) {
-            std::cerr << "[BLOCKING WRITE Phase 3] Lock released from server " << idx << std::endl;
-        } else {
-            std::cerr << "[BLOCKING WRITE Phase 3] Failed to release lock from server " << idx << std::endl;
+    for (size_t idx : acked) {
+        clock_.Observe(writes.GetReply(idx).timestamp());
+    }
+    int32_t written = static_cast<int32_t>(acked.size());
+    LOG_DEBUG("[BLOCKING WRITE Phase 2] " << written << "/" << write_quorum 
+              << " writes successful");
+    
+    // PHASE 3: Release locks the writes didn't (failed writes, late grants)
+    std::vector<size_t> leftover;
+    for (size_t i : lock_holders) {
+        if (std::find(acked.begin(), acked.end(), i) == acked.end()) {
+            leftover.push_back(i);
         }
     }
+    if (!leftover.empty()) {
+        LOG_DEBUG("[BLOCKING WRITE Phase 3] Releasing " << leftover.size() << " locks...");
+        size_t released = ReleaseLocks(key, stubs, leftover);
+        LOG_DEBUG("[BLOCKING WRITE Phase 3] Released " << released << "/" 
+                  << leftover.size() << " locks");
+    }
     
     if (written < write_quorum) {
-        std::cerr << "[BLOCKING WRITE] Failed: Only " << written << " writes succeeded, need " 
-                  << write_quorum << std::endl;
+        LOG_WARN_EVERY(1000, "[BLOCKING WRITE] Failed: Only " << written << " writes succeeded, need " 
+                             << write_quorum);
         return false;
     }
     
-    std::cerr << "[BLOCKING WRITE] Write committed successfully" << std::endl;
+    LOG_DEBUG("[BLOCKING WRITE] Write committed successfully");
     
     return true;
 }
@@ -2,13 +2,18 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
-#include <mutex>
 #include <cstdint>
+#include <chrono>
 #include <grpcpp/grpcpp.h>
 #include "../common/config.h"
+#include "../common/hash_ring.h"
+#include "../common/hlc.h"
+#include "channel_pool.h"
+#include "quorum_call.h"
 
 // Proto headers
 #include "kvstore.grpc.pb.h"
@@ -20,62 +25,123 @@ namespace kvstore {
 class BlockingClientImpl {
 public:
     // Create a Blocking client implementation with the given configuration and client ID.
+    // @throws std::out_of_range if client_id is outside 0..hlc::kMaxClientId
     BlockingClientImpl(const Config& config, int32_t client_id);
     ~BlockingClientImpl();
     
     // Read a key using the blocking protocol.
-    // Acquires locks, reads from quorum, then releases locks.
+    // Acquires locks (reading with each one), then releases locks.
     bool Read(const std::string& key, std::string& value);
     
     // Write a key-value pair using the blocking protocol.
-    // Acquires locks, writes to quorum, then releases locks.
+    // Acquires locks, then writes to the quorum, releasing each lock with its write.
     bool Write(const std::string& key, const std::string& value);
     
-    // Get the client's current logical timestamp.
+    // Get the largest timestamp the client has issued or seen.
     int64_t GetCurrentTimestamp() const;
 
 private:
+    using Clock = std::chrono::steady_clock;
+    
     Config config_;              // Configuration (servers, quorums, etc.)
     int32_t client_id_;          // Unique client identifier
+    std::chrono::milliseconds lock_lease_;   // Lease asked for on every lock
+    
+    HybridClock clock_;          // Source of write timestamps, tiebroken by client_id_
+    HashRing ring_;              // Picks each key's replica set
     
-    mutable std::mutex timestamp_mutex_;  // Protects client_timestamp_
-    int64_t client_timestamp_;            // Client's logical clock
+    std::unique_ptr<ChannelPool> pool_;                        // Null when pooling is disabled
+    std::unique_ptr<StubCache<BlockingService>> stub_cache_;   // Stubs built on pool_
     
     // Create a gRPC stub for communicating with a server.
     std::unique_ptr<BlockingService::Stub> CreateStub(const ServerInfo& server);
     
-    // Response from a lock acquisition request.
-    struct LockResponse {
-        bool granted;            // Whether the lock was granted
-        int64_t timestamp;       // Server timestamp
-    };
-    
-    // Request a lock from a server.
-    LockResponse AcquireLockFromServer(const std::string& key,
-                                       std::unique_ptr<BlockingService::Stub>& stub);
-    
-    // Release a lock on a server.
-    bool ReleaseLockFromServer(const std::string& key,
-                               std::unique_ptr<BlockingService::Stub>& stub);
-    
-    // Response from a read operation on a single server.
-    struct ReadResponse {
-        std::string value;
-        int64_t timestamp;
-        bool success;
-    };
-    
-    // Read a key from a single server (must hold lock first).
-    ReadResponse ReadFromServer(const std::string& key,
-                                std::unique_ptr<BlockingService::Stub>& stub);
-    
-    // Write a key-value pair to a single server (must hold lock first).
-    bool WriteToServer(const std::string& key, const std::string& value,
-                      int64_t timestamp,
-                      std::unique_ptr<BlockingService::Stub>& stub);
-    
-    // Update the client's logical timestamp.
-    void UpdateTimestamp(int64_t timestamp);
+    // Get the pooled stub for a server, or a fresh one if pooling is disabled.
+    std::shared_ptr<BlockingService::Stub> GetStub(size_t index);
+    
+    using LockCall = QuorumCall<BlockingLockRequest, BlockingLockResponse>;
+    using LockReadCall = QuorumCall<BlockingLockRequest, BlockingLockReadResponse>;
+    using UnlockCall = QuorumCall<BlockingUnlockRequest, BlockingUnlockResponse>;
+    using RenewCall = QuorumCall<BlockingRenewRequest, BlockingRenewResponse>;
+    using WriteCall = QuorumCall<BlockingWriteRequest, BlockingWriteResponse>;
+    
+    using StubList = std::vector<std::shared_ptr<BlockingService::Stub>>;
+    
+    // Stubs for a key's replica set, in server order. Indices in the calls
+    // below are positions in this list.
+    StubList StubsFor(const std::string& key);
+    
+    // Deadline for every RPC sent to a server
+    static constexpr std::chrono::seconds RPC_TIMEOUT{5};
+    
+    // How long a server may queue one of our lock requests behind another
+    // client's lock (kept well under RPC_TIMEOUT, and under half the lease)
+    static constexpr std::chrono::milliseconds LOCK_WAIT{2000};
+    std::chrono::milliseconds LockWait() const { return std::min(LOCK_WAIT, lock_lease_ / 2); }
+    
+    // How long to wait for a lock reply beyond the time the server may
+    // queue the request, before moving on without that server
+    static constexpr std::chrono::milliseconds LOCK_REPLY_SLACK{500};
+    
+    // Lock request for a key, with our lease and a queueing limit.
+    // @param wait How long the server may queue it (0 = answer at once)
+    BlockingLockRequest MakeLockRequest(const std::string& key, std::chrono::milliseconds wait) const;
+    
+    // Request a lock for a key from each target server.
+    void SendLocks(LockCall& call, const std::string& key, const StubList& stubs,
+                   const std::vector<size_t>& targets, std::chrono::milliseconds wait);
+    
+    // Request a lock for a key from each target server, reading the value
+    // once it is granted (LockAndRead).
+    void SendLocks(LockReadCall& call, const std::string& key, const StubList& stubs,
+                   const std::vector<size_t>& targets, std::chrono::milliseconds wait);
+    
+    // Renew our lease on a key's lock on each target server.
+    void SendRenewals(RenewCall& call, const std::string& key, const StubList& stubs,
+                      const std::vector<size_t>& targets);
+    
+    // Release the lock for a key on each target server.
+    void SendUnlocks(UnlockCall& call, const std::string& key, const StubList& stubs,
+                     const std::vector<size_t>& targets);
+    
+    // Write a key-value pair to each target server and release the lock
+    // there (WriteAndUnlock; must hold lock first).
+    void SendWriteUnlocks(WriteCall& call, const std::string& key, const std::string& value,
+                          int64_t timestamp, const StubList& stubs,
+                          const std::vector<size_t>& targets);
+    
+    // Lock a key on `quorum` servers. First every server is asked at once,
+    // without queueing; that is enough unless another client holds the key.
+    // Otherwise the grants are released and the servers are asked one at a
+    // time in server order, each allowed to queue the request. Every client
+    // takes queued locks in the same order, so clients waiting on each
+    // other's locks can never wait in a cycle. A server that doesn't answer
+    // in time is passed over rather than holding up the rest.
+    // @param held Set to the indices of the servers that granted the lock
+    // @param lease_start Set to when the leases on the held locks began
+    //                    (at the latest)
+    // @return The round that ended with `held` (its late grants are among
+    //         PossibleLockHolders); Call is LockCall, or LockReadCall to
+    //         read the value with each lock
+    template <typename Call>
+    std::unique_ptr<Call> AcquireLocks(const std::string& key, const StubList& stubs, size_t quorum,
+                                       std::vector<size_t>& held, Clock::time_point& lease_start);
+    
+    // Heartbeat: once half the lease has passed since `lease_start`, renew
+    // the leases on `held` and drop the servers that no longer grant them.
+    void RenewLeases(const std::string& key, const StubList& stubs, std::vector<size_t>& held,
+                     Clock::time_point& lease_start);
+    
+    // Servers that may hold our lock once a lock phase has ended: every
+    // server that granted it, plus stragglers whose reply had not arrived
+    // (they may still grant it after we stop waiting).
+    template <typename Call>
+    std::vector<size_t> PossibleLockHolders(const Call& call, size_t num_servers) const;
+    
+    // Release the lock on the given servers and wait for all of them.
+    // @return Number of servers that confirmed the release
+    size_t ReleaseLocks(const std::string& key, const StubList& stubs,
+                        const std::vector<size_t>& targets);
 };
 
 }
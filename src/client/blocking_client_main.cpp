@@ -4,6 +4,7 @@
 #include <string>
 #include "blocking_client.h"
 #include "../common/config.h"
+#include "../common/hlc.h"
 
 int main(int argc, char** argv) {
     if (argc < 3) {
@@ -16,6 +17,10 @@ int main(int argc, char** argv) {
     
     std::string config_file = argv[1];
     int32_t client_id = std::stoi(argv[2]);
+    if (!kvstore::hlc::ValidClientId(client_id)) {
+        std::cerr << "Error: client_id must be in 0.." << kvstore::hlc::kMaxClientId << std::endl;
+        return 1;
+    }
     
     kvstore::Config config;
     if (!config.LoadFromFile(config_file)) {
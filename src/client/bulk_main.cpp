@@ -0,0 +1,221 @@
+// Command-line tool for bulk loads and backups of an ABD cluster with
+// segment files (src/protocol/segment.h).
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "../common/config.h"
+#include "../common/hash_ring.h"
+#include "../common/hlc.h"
+#include "../common/utils.h"
+#include "../protocol/segment.h"
+
+// Proto headers
+#include "kvstore.grpc.pb.h"
+#include "kvstore.pb.h"
+
+namespace {
+
+using kvstore::ABDService;
+
+void Usage(const char* program) {
+    std::cerr << "Usage: " << program << " <command> ..." << std::endl;
+    std::cerr << "Commands:" << std::endl;
+    std::cerr << "  build <input.tsv> <segment> [--timestamp <ts>]" << std::endl;
+    std::cerr << "      Sort key<TAB>value lines into a segment, all under one new timestamp" << std::endl;
+    std::cerr << "  import <config> <segment> [--threads <n>]" << std::endl;
+    std::cerr << "      Have every server map <segment> (a name in its --segment-dir) and merge it" << std::endl;
+    std::cerr << "  export <config> <server_id> <segment>" << std::endl;
+    std::cerr << "      Have one server write its keys to <segment> (a name in its --segment-dir)" << std::endl;
+    std::cerr << "  verify <segment>" << std::endl;
+    std::cerr << "      Check every block's checksum" << std::endl;
+    std::cerr << "  dump <segment>" << std::endl;
+    std::cerr << "      Print the entries as key<TAB>value lines" << std::endl;
+}
+
+std::unique_ptr<ABDService::Stub> StubFor(const kvstore::ServerInfo& server) {
+    grpc::ChannelArguments args;
+    args.SetMaxReceiveMessageSize(-1);
+    return ABDService::NewStub(grpc::CreateCustomChannel(
+        kvstore::FormatAddress(server.host, server.port), grpc::InsecureChannelCredentials(), args));
+}
+
+int Build(const std::string& input_path, const std::string& segment_path, int64_t timestamp) {
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "Error: Cannot read " << input_path << std::endl;
+        return 1;
+    }
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::string line;
+    while (std::getline(input, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            continue;
+        }
+        entries.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+    }
+    // A repeated key keeps its last value
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    if (timestamp == 0) {
+        kvstore::HybridClock clock(kvstore::hlc::ClientWriterId(0));
+        timestamp = clock.Now();
+    }
+    kvstore::SegmentWriter writer(segment_path);
+    bool ok = writer.Open();
+    for (size_t i = 0; ok && i < entries.size(); i++) {
+        if (i + 1 < entries.size() && entries[i + 1].first == entries[i].first) {
+            continue;
+        }
+        ok = writer.Add(entries[i].first, entries[i].second, timestamp);
+    }
+    if (!ok || !writer.Finish()) {
+        std::cerr << "Error: " << writer.Error() << std::endl;
+        return 1;
+    }
+    std::cout << segment_path << ": " << writer.Entries() << " entries, " << writer.Bytes()
+              << " bytes, timestamp " << timestamp << std::endl;
+    return 0;
+}
+
+int Import(const kvstore::Config& config, const std::string& segment_path, int32_t threads) {
+    const auto& servers = config.GetServers();
+    kvstore::HashRing ring(servers, config.GetNumReplicas(), config.GetVirtualNodes());
+    std::vector<kvstore::ABDImportSegmentResponse> responses(servers.size());
+    std::vector<grpc::Status> statuses(servers.size());
+
+    // Servers import in parallel; each only takes the keys it replicates
+    std::vector<std::thread> imports;
+    for (size_t i = 0; i < servers.size(); i++) {
+        imports.emplace_back([&, i]() {
+            kvstore::ABDImportSegmentRequest request;
+            request.set_path(segment_path);
+            request.set_threads(threads);
+            if (ring.Partitioned()) {
+                for (const auto& range : ring.RangesOf(i)) {
+                    auto* added = request.add_ranges();
+                    added->set_start(range.start);
+                    added->set_end(range.end);
+                }
+            }
+            grpc::ClientContext context;
+            statuses[i] = StubFor(servers[i])->ImportSegment(&context, request, &responses[i]);
+        });
+    }
+    for (auto& import : imports) {
+        import.join();
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < servers.size(); i++) {
+        std::cout << "Server " << servers[i].id << ": ";
+        if (!statuses[i].ok() || !responses[i].success()) {
+            std::cout << "failed: " << (statuses[i].ok() ? responses[i].error() : statuses[i].error_message())
+                      << std::endl;
+            ok = false;
+            continue;
+        }
+        std::cout << responses[i].received() << " entries read, " << responses[i].applied()
+                  << " applied" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
+
+int Export(const kvstore::Config& config, int32_t server_id, const std::string& segment_path) {
+    kvstore::ServerInfo server = config.GetServer(server_id);
+    if (server.port == 0) {
+        std::cerr << "Error: No server " << server_id << " in the config" << std::endl;
+        return 1;
+    }
+    kvstore::ABDExportSegmentRequest request;
+    request.set_path(segment_path);
+    kvstore::ABDExportSegmentResponse response;
+    grpc::ClientContext context;
+    grpc::Status status = StubFor(server)->ExportSegment(&context, request, &response);
+    if (!status.ok() || !response.success()) {
+        std::cerr << "Error: " << (status.ok() ? response.error() : status.error_message()) << std::endl;
+        return 1;
+    }
+    std::cout << segment_path << ": " << response.entries() << " entries, " << response.bytes()
+              << " bytes" << std::endl;
+    return 0;
+}
+
+// Check (and with `print`, print) every block of a segment.
+int Read(const std::string& segment_path, bool print) {
+    kvstore::SegmentReader segment;
+    std::string error;
+    if (!segment.Open(segment_path, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    for (size_t block = 0; block < segment.NumBlocks(); block++) {
+        bool intact = segment.ForEachInBlock(block,
+            [print](std::string_view key, std::string_view value, int64_t) {
+                if (print) {
+                    std::cout << key << '\t' << value << '\n';
+                }
+            });
+        if (!intact) {
+            std::cerr << "Error: Block " << block << " (from '" << segment.FirstKey(block)
+                      << "') is corrupt" << std::endl;
+            return 1;
+        }
+    }
+    if (!print) {
+        std::cout << segment_path << ": " << segment.NumEntries() << " entries in "
+                  << segment.NumBlocks() << " blocks, all intact" << std::endl;
+    }
+    return 0;
+}
+
+bool LoadConfig(const std::string& path, kvstore::Config& config) {
+    if (!config.LoadFromFile(path)) {
+        std::cerr << "Error: Failed to load config file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        Usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    kvstore::Config config;
+    if (command == "build" && argc >= 4) {
+        int64_t timestamp = 0;
+        for (int i = 4; i + 1 < argc; i++) {
+            if (std::string(argv[i]) == "--timestamp") {
+                timestamp = std::stoll(argv[++i]);
+            }
+        }
+        return Build(argv[2], argv[3], timestamp);
+    } else if (command == "import" && argc >= 4) {
+        int32_t threads = 0;
+        for (int i = 4; i + 1 < argc; i++) {
+            if (std::string(argv[i]) == "--threads") {
+                threads = std::stoi(argv[++i]);
+            }
+        }
+        return LoadConfig(argv[2], config) ? Import(config, argv[3], threads) : 1;
+    } else if (command == "export" && argc >= 5) {
+        return LoadConfig(argv[2], config) ? Export(config, std::stoi(argv[3]), argv[4]) : 1;
+    } else if (command == "verify") {
+        return Read(argv[2], false);
+    } else if (command == "dump") {
+        return Read(argv[2], true);
+    }
+    Usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,96 @@
+// Channel pool implementation.
+
+#include "channel_pool.h"
+
+namespace kvstore {
+
+std::shared_ptr<grpc::Channel> CreateServerChannel(const ServerInfo& server, bool own_subchannels) {
+    grpc::ChannelArguments args;
+    // Keep reconnect attempts frequent; the default backoff grows to minutes,
+    // which would leave a recovered server unused for a long time.
+    args.SetInt(GRPC_ARG_INITIAL_RECONNECT_BACKOFF_MS, 100);
+    args.SetInt(GRPC_ARG_MIN_RECONNECT_BACKOFF_MS, 100);
+    args.SetInt(GRPC_ARG_MAX_RECONNECT_BACKOFF_MS, 1000);
+    if (own_subchannels) {
+        // Channels with the same target and arguments share subchannels
+        // through gRPC's global pool; a private pool gives this one a new
+        // connection attempt instead of the failed subchannel and its backoff
+        args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    }
+    return grpc::CreateCustomChannel(server.GetAddress(),
+                                     grpc::InsecureChannelCredentials(), args);
+}
+
+ChannelPool::ChannelPool(const std::vector<ServerInfo>& servers) {
+    entries_.resize(servers.size());
+    for (size_t i = 0; i < servers.size(); i++) {
+        entries_[i].server = servers[i];
+    }
+    watcher_ = std::thread(&ChannelPool::WatchLoop, this);
+}
+
+ChannelPool::~ChannelPool() {
+    stop_.store(true);
+    watch_cv_.notify_all();
+    if (watcher_.joinable()) {
+        watcher_.join();
+    }
+}
+
+std::shared_ptr<grpc::Channel> ChannelPool::GetChannel(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[index];
+    if (!entry.channel) {
+        entry.channel = CreateServerChannel(entry.server);
+        entry.generation++;
+        // Start connecting now rather than on the first RPC
+        entry.channel->GetState(true);
+    }
+    return entry.channel;
+}
+
+uint64_t ChannelPool::GetGeneration(size_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_[index].generation;
+}
+
+void ChannelPool::WatchLoop() {
+    while (!stop_.load()) {
+        {
+            std::unique_lock<std::mutex> lock(watch_mutex_);
+            watch_cv_.wait_for(lock, WATCH_INTERVAL, [this] { return stop_.load(); });
+        }
+        if (stop_.load()) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : entries_) {
+            if (!entry.channel) {
+                continue;  // Never used - nothing to keep alive
+            }
+            grpc_connectivity_state state = entry.channel->GetState(false);
+            if (state == GRPC_CHANNEL_TRANSIENT_FAILURE) {
+                if (!entry.failing) {
+                    entry.failing = true;
+                    entry.failing_since = now;
+                } else if (now - entry.failing_since >= RECONNECT_AFTER) {
+                    // Replace the channel; callers still holding the old one
+                    // keep it alive until their RPCs finish.
+                    entry.channel = CreateServerChannel(entry.server, true);
+                    entry.generation++;
+                    entry.channel->GetState(true);
+                    entry.failing = false;
+                }
+            } else {
+                entry.failing = false;
+                if (state == GRPC_CHANNEL_IDLE) {
+                    entry.channel->GetState(true);
+                }
+            }
+        }
+    }
+}
+
+} // namespace kvstore
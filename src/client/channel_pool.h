@@ -0,0 +1,123 @@
+// Long-lived gRPC channel/stub pool shared by all threads of one client.
+// Channels are created lazily, one per server, and reused for every operation
+// so requests don't pay channel creation, DNS resolution and the HTTP/2
+// handshake each time. A background thread watches channel state and replaces
+// channels that stay in TRANSIENT_FAILURE so they reconnect without waiting
+// for gRPC's exponential backoff.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "../common/config.h"
+
+namespace kvstore {
+
+// Create a channel to a server with the reconnect backoff settings
+// used by the pool (short backoff so a restarted server is found quickly).
+// @param own_subchannels Don't share subchannels with other channels to the
+//                        server (used when replacing a failed channel)
+std::shared_ptr<grpc::Channel> CreateServerChannel(const ServerInfo& server, bool own_subchannels = false);
+
+class ChannelPool {
+public:
+    // @param servers Servers this pool connects to; indexes into this list
+    //                are used to look up channels
+    explicit ChannelPool(const std::vector<ServerInfo>& servers);
+    ~ChannelPool();
+
+    ChannelPool(const ChannelPool&) = delete;
+    ChannelPool& operator=(const ChannelPool&) = delete;
+
+    // Get the channel for a server, creating it on first use.
+    // @param index Position of the server in the list given to the constructor
+    // @return Shared channel (stays valid even if the pool replaces it later)
+    std::shared_ptr<grpc::Channel> GetChannel(size_t index);
+
+    // Get how many times the channel for a server has been (re)created.
+    // Stub caches compare this to know when to rebuild their stubs.
+    uint64_t GetGeneration(size_t index) const;
+
+    size_t Size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        ServerInfo server;
+        std::shared_ptr<grpc::Channel> channel;   // null until first use
+        uint64_t generation = 0;                  // bumped on every (re)creation
+        bool failing = false;                     // in TRANSIENT_FAILURE at last check
+        std::chrono::steady_clock::time_point failing_since;
+    };
+
+    mutable std::mutex mutex_;                    // Protects entries_
+    std::vector<Entry> entries_;
+
+    std::atomic<bool> stop_{false};
+    std::mutex watch_mutex_;
+    std::condition_variable watch_cv_;
+    std::thread watcher_;                         // Background reconnect thread
+
+    // Poll channel states; replace channels stuck in TRANSIENT_FAILURE and
+    // nudge idle ones to connect so the next operation finds them ready.
+    void WatchLoop();
+
+    // How often the watcher checks channel states
+    static constexpr std::chrono::milliseconds WATCH_INTERVAL{200};
+    // How long a channel may stay in TRANSIENT_FAILURE before it is replaced
+    static constexpr std::chrono::milliseconds RECONNECT_AFTER{1000};
+};
+
+// Per-client cache of stubs built on top of a ChannelPool.
+// Stubs are thread-safe in gRPC, so one stub per server is shared by all
+// threads. A stub is rebuilt when the pool has replaced its channel.
+template <typename Service>
+class StubCache {
+public:
+    using Stub = typename Service::Stub;
+
+    explicit StubCache(ChannelPool& pool)
+        : pool_(pool), stubs_(pool.Size()) {}
+
+    // Get the stub for a server.
+    // @param index Position of the server in the pool's server list
+    std::shared_ptr<Stub> Get(size_t index) {
+        uint64_t generation = pool_.GetGeneration(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& slot = stubs_[index];
+            if (slot.stub && slot.generation == generation) {
+                return slot.stub;
+            }
+        }
+        // Build outside our lock; GetChannel may create the channel
+        auto channel = pool_.GetChannel(index);
+        generation = pool_.GetGeneration(index);
+        std::shared_ptr<Stub> stub(Service::NewStub(channel));
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& slot = stubs_[index];
+        if (!slot.stub || slot.generation != generation) {
+            slot.stub = stub;
+            slot.generation = generation;
+        }
+        return slot.stub;
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<Stub> stub;
+        uint64_t generation = 0;
+    };
+
+    ChannelPool& pool_;
+    std::mutex mutex_;                            // Protects stubs_
+    std::vector<Slot> stubs_;
+};
+
+} // namespace kvstore
@@ -0,0 +1,110 @@
+// Chunked value transfer implementation.
+
+#include "chunked_value.h"
+#include "../common/logging.h"
+#include <algorithm>
+#include <utility>
+
+namespace kvstore {
+
+namespace {
+
+// One WriteChunked call. Deletes itself once gRPC reports OnDone.
+class ChunkedWriter final : public grpc::ClientWriteReactor<ABDValueChunk> {
+public:
+    ChunkedWriter(std::shared_ptr<ABDService::Stub> stub, const std::string& key,
+                  std::shared_ptr<const std::string> value, int64_t timestamp,
+                  std::chrono::milliseconds timeout, bool compress, ChunkedWriteDone done)
+        : stub_(std::move(stub)), value_(std::move(value)), done_(std::move(done)) {
+        context_.set_deadline(std::chrono::system_clock::now() + timeout);
+        if (compress) {
+            context_.set_compression_algorithm(GRPC_COMPRESS_GZIP);
+        }
+        // The first chunk carries the metadata
+        chunk_.set_key(key);
+        chunk_.set_timestamp(timestamp);
+        chunk_.set_total_size(static_cast<int64_t>(value_->size()));
+    }
+
+    void Start() {
+        stub_->async()->WriteChunked(&context_, &response_, this);
+        WriteNext();
+        StartCall();
+    }
+
+    void OnWriteDone(bool ok) override {
+        if (!ok) {
+            return;         // The call has failed; OnDone reports it
+        }
+        if (offset_ < value_->size()) {
+            chunk_.Clear();
+            WriteNext();
+        } else {
+            StartWritesDone();
+        }
+    }
+
+    void OnDone(const grpc::Status& status) override {
+        done_(status, response_);
+        delete this;
+    }
+
+private:
+    std::shared_ptr<ABDService::Stub> stub_;
+    std::shared_ptr<const std::string> value_;
+    ChunkedWriteDone done_;
+    grpc::ClientContext context_;
+    ABDWriteResponse response_;
+    ABDValueChunk chunk_;           // Chunk being written
+    size_t offset_ = 0;             // Bytes of value_ handed to chunks so far
+
+    void WriteNext() {
+        size_t length = std::min(kValueChunkBytes, value_->size() - offset_);
+        chunk_.set_data(value_->data() + offset_, length);
+        offset_ += length;
+        StartWrite(&chunk_);
+    }
+};
+
+} // namespace
+
+void StartChunkedWrite(std::shared_ptr<ABDService::Stub> stub, const std::string& key,
+                       std::shared_ptr<const std::string> value, int64_t timestamp,
+                       std::chrono::milliseconds timeout, bool compress, ChunkedWriteDone done) {
+    auto* writer = new ChunkedWriter(std::move(stub), key, std::move(value), timestamp, timeout,
+                                     compress, std::move(done));
+    writer->Start();
+}
+
+grpc::Status ReadChunkedValue(ABDService::Stub& stub, const std::string& key,
+                              std::chrono::milliseconds timeout, std::string& value,
+                              int64_t& timestamp) {
+    grpc::ClientContext context;
+    context.set_deadline(std::chrono::system_clock::now() + timeout);
+    ABDReadRequest request;
+    request.set_key(key);
+    auto reader = stub.ReadChunked(&context, request);
+    
+    ABDValueChunk chunk;
+    size_t total_size = 0;
+    bool first = true;
+    value.clear();
+    while (reader->Read(&chunk)) {
+        if (first) {
+            timestamp = chunk.timestamp();
+            total_size = static_cast<size_t>(std::max<int64_t>(chunk.total_size(), 0));
+            value.reserve(total_size);
+            first = false;
+        }
+        value.append(chunk.data());
+    }
+    grpc::Status status = reader->Finish();
+    if (status.ok() && (first || value.size() != total_size)) {
+        LOG_WARN_EVERY(1000, "[CLIENT] ReadChunked for key='" << key << "' ended after "
+                             << value.size() << " of " << total_size << " bytes");
+        return grpc::Status(grpc::StatusCode::INTERNAL, "value stream ended early");
+    }
+    return status;
+}
+
+} // namespace kvstore
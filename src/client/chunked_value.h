@@ -0,0 +1,52 @@
+// Chunked transfer of single large ABD values.
+// Values above the client's "large_value_bytes" don't travel as one Write /
+// Read message: they are streamed to a replica as a sequence of
+// ABDValueChunk messages (WriteChunked) and fetched back the same way
+// (ReadChunked), so a multi-MB value never has to fit gRPC's message size
+// limit or sit in one huge protobuf on either side.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <grpcpp/grpcpp.h>
+
+#include "kvstore.grpc.pb.h"
+#include "kvstore.pb.h"
+
+namespace kvstore {
+
+// Size of the chunks values are streamed in
+constexpr size_t kValueChunkBytes = 1 << 20;
+
+using ChunkedWriteDone = std::function<void(const grpc::Status&, const ABDWriteResponse&)>;
+
+// Stream a value to one replica with WriteChunked, without blocking.
+// @param stub Stub for the replica; kept alive until the call completes
+// @param key Key to write
+// @param value Value to write; shared so every replica streams the same copy
+// @param timestamp Timestamp for the write
+// @param timeout Deadline for the whole transfer
+// @param compress Gzip the chunks on the wire
+// @param done Completion, called once from a gRPC thread
+void StartChunkedWrite(std::shared_ptr<ABDService::Stub> stub, const std::string& key,
+                       std::shared_ptr<const std::string> value, int64_t timestamp,
+                       std::chrono::milliseconds timeout, bool compress, ChunkedWriteDone done);
+
+// Fetch one replica's value for a key with ReadChunked, blocking until the
+// whole value has arrived.
+// @param stub Stub for the replica
+// @param key Key to read
+// @param timeout Deadline for the whole transfer
+// @param value Receives the value
+// @param timestamp Receives the value's timestamp
+// @return The call's status (INTERNAL if the stream ended short)
+grpc::Status ReadChunkedValue(ABDService::Stub& stub, const std::string& key,
+                              std::chrono::milliseconds timeout, std::string& value,
+                              int64_t& timestamp);
+
+} // namespace kvstore
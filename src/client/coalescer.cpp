@@ -0,0 +1,185 @@
+// ABD request coalescer implementation.
+
+#include "coalescer.h"
+#include <algorithm>
+#include <utility>
+
+namespace kvstore {
+
+namespace {
+
+// State of one batched RPC; owned by its completion callback.
+template <typename Request, typename Response, typename Done>
+struct BatchCall {
+    grpc::ClientContext context;
+    Request request;
+    Response response;
+    std::vector<Done> done;
+    std::shared_ptr<ABDService::Stub> stub;   // Keeps the stub alive until completion
+};
+
+// Hand each waiting operation its entry of a batched reply. A failed RPC, or
+// a reply that doesn't cover the whole batch, fails every operation in it.
+template <typename Call, typename Entry, typename Results>
+void CompleteBatch(Call& call, const grpc::Status& status, bool success, const Results& results) {
+    size_t count = call.done.size();
+    bool complete = status.ok() && success && static_cast<size_t>(results.size()) == count;
+    grpc::Status entry_status = status;
+    if (status.ok() && !complete) {
+        entry_status = grpc::Status(grpc::StatusCode::INTERNAL, "incomplete batch reply");
+    }
+    Entry empty;
+    for (size_t k = 0; k < count; k++) {
+        call.done[k](entry_status, complete ? results.Get(static_cast<int>(k)) : empty);
+    }
+}
+
+} // namespace
+
+ABDCoalescer::ABDCoalescer(StubFn get_stub, std::chrono::microseconds window, size_t max_batch,
+                           std::chrono::milliseconds timeout)
+    : get_stub_(std::move(get_stub)),
+      window_(window),
+      max_batch_(std::max<size_t>(max_batch, 1)),
+      timeout_(timeout) {
+    flusher_ = std::thread(&ABDCoalescer::FlushLoop, this);
+}
+
+ABDCoalescer::~ABDCoalescer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+}
+
+void ABDCoalescer::Read(const std::string& key, int64_t timestamp, int64_t value_limit,
+                        ReadDone done) {
+    ReadBatch full;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (reads_.done.empty()) {
+            // First op of a new batch starts the window
+            reads_deadline_ = std::chrono::steady_clock::now() + window_;
+            cv_.notify_one();
+        }
+        auto* read = reads_.request.add_reads();
+        read->set_key(key);
+        read->set_timestamp(timestamp);
+        read->set_value_limit(value_limit);
+        reads_.done.push_back(std::move(done));
+        if (reads_.done.size() < max_batch_) {
+            return;
+        }
+        full = std::exchange(reads_, ReadBatch{});
+    }
+    // Batch is full - send it from this thread rather than waiting for the window
+    SendReads(std::move(full));
+}
+
+void ABDCoalescer::Write(const std::string& key, const std::string& value, int64_t timestamp,
+                         WriteDone done) {
+    WriteBatch full;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (writes_.done.empty()) {
+            writes_deadline_ = std::chrono::steady_clock::now() + window_;
+            cv_.notify_one();
+        }
+        auto* write = writes_.request.add_writes();
+        write->set_key(key);
+        write->set_value(value);
+        write->set_timestamp(timestamp);
+        writes_.done.push_back(std::move(done));
+        if (writes_.done.size() < max_batch_) {
+            return;
+        }
+        full = std::exchange(writes_, WriteBatch{});
+    }
+    SendWrites(std::move(full));
+}
+
+void ABDCoalescer::FlushLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        bool have_reads = !reads_.done.empty();
+        bool have_writes = !writes_.done.empty();
+        if (!have_reads && !have_writes) {
+            if (stop_) {
+                break;
+            }
+            cv_.wait(lock);
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        auto next = std::chrono::steady_clock::time_point::max();
+        if (have_reads) {
+            next = std::min(next, reads_deadline_);
+        }
+        if (have_writes) {
+            next = std::min(next, writes_deadline_);
+        }
+        if (!stop_ && now < next) {
+            cv_.wait_until(lock, next);
+            continue;
+        }
+
+        // On shutdown everything pending goes out immediately
+        ReadBatch reads;
+        WriteBatch writes;
+        if (have_reads && (stop_ || reads_deadline_ <= now)) {
+            reads = std::exchange(reads_, ReadBatch{});
+        }
+        if (have_writes && (stop_ || writes_deadline_ <= now)) {
+            writes = std::exchange(writes_, WriteBatch{});
+        }
+        lock.unlock();
+        if (!reads.done.empty()) {
+            SendReads(std::move(reads));
+        }
+        if (!writes.done.empty()) {
+            SendWrites(std::move(writes));
+        }
+        lock.lock();
+    }
+}
+
+void ABDCoalescer::SendReads(ReadBatch batch) {
+    using Call = BatchCall<ABDMultiReadRequest, ABDMultiReadResponse, ReadDone>;
+    auto call = std::make_unique<Call>();
+    call->request = std::move(batch.request);
+    call->done = std::move(batch.done);
+    call->stub = get_stub_();
+    call->context.set_deadline(std::chrono::system_clock::now() + timeout_);
+
+    Call* raw = call.release();
+    raw->stub->async()->MultiRead(&raw->context, &raw->request, &raw->response,
+        [raw](grpc::Status status) {
+            std::unique_ptr<Call> owner(raw);
+            CompleteBatch<Call, ABDReadResponse>(*owner, status, owner->response.success(),
+                                                 owner->response.results());
+        });
+}
+
+void ABDCoalescer::SendWrites(WriteBatch batch) {
+    using Call = BatchCall<ABDMultiWriteRequest, ABDMultiWriteResponse, WriteDone>;
+    auto call = std::make_unique<Call>();
+    call->request = std::move(batch.request);
+    call->done = std::move(batch.done);
+    call->stub = get_stub_();
+    call->context.set_deadline(std::chrono::system_clock::now() + timeout_);
+
+    Call* raw = call.release();
+    raw->stub->async()->MultiWrite(&raw->context, &raw->request, &raw->response,
+        [raw](grpc::Status status) {
+            std::unique_ptr<Call> owner(raw);
+            CompleteBatch<Call, ABDWriteResponse>(*owner, status, owner->response.success(),
+                                                  owner->response.results());
+        });
+}
+
+} // namespace kvstore
@@ -0,0 +1,86 @@
+// Client-side request coalescing for the ABD protocol.
+// One coalescer sits in front of each replica. Reads and writes submitted by
+// concurrent callers within a short window (or until a size limit) are merged
+// into a single MultiRead / MultiWrite RPC; when the batched reply arrives,
+// each caller's completion gets its own entry of it. Trades a few
+// microseconds of latency for far fewer RPCs under concurrency.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+
+#include "kvstore.grpc.pb.h"
+#include "kvstore.pb.h"
+#include "replica_transport.h"
+
+namespace kvstore {
+
+class ABDCoalescer final : public ABDReplicaTransport {
+public:
+    using StubFn = std::function<std::shared_ptr<ABDService::Stub>()>;
+
+    // @param get_stub Returns the stub for this coalescer's replica
+    // @param window How long the first operation of a batch may wait for others
+    // @param max_batch Flush immediately once a batch has this many operations
+    // @param timeout Deadline applied to every batched RPC
+    ABDCoalescer(StubFn get_stub, std::chrono::microseconds window, size_t max_batch,
+                 std::chrono::milliseconds timeout);
+
+    // Sends whatever is still pending, then stops the flush thread.
+    // Batched RPCs already in flight complete on their own.
+    ~ABDCoalescer() override;
+
+    ABDCoalescer(const ABDCoalescer&) = delete;
+    ABDCoalescer& operator=(const ABDCoalescer&) = delete;
+
+    // Queue a read; `done` runs once with this key's part of the batched reply.
+    void Read(const std::string& key, int64_t timestamp, int64_t value_limit,
+              ReadDone done) override;
+
+    // Queue a write; `done` runs once with this write's part of the batched reply.
+    void Write(const std::string& key, const std::string& value, int64_t timestamp,
+               WriteDone done) override;
+
+private:
+    struct ReadBatch {
+        ABDMultiReadRequest request;
+        std::vector<ReadDone> done;
+    };
+
+    struct WriteBatch {
+        ABDMultiWriteRequest request;
+        std::vector<WriteDone> done;
+    };
+
+    StubFn get_stub_;
+    std::chrono::microseconds window_;
+    size_t max_batch_;
+    std::chrono::milliseconds timeout_;
+
+    std::mutex mutex_;                              // Protects the pending batches
+    std::condition_variable cv_;
+    ReadBatch reads_;
+    WriteBatch writes_;
+    std::chrono::steady_clock::time_point reads_deadline_;
+    std::chrono::steady_clock::time_point writes_deadline_;
+    bool stop_ = false;
+    std::thread flusher_;
+
+    // Flush thread: sends each batch once its window has expired.
+    void FlushLoop();
+
+    // Issue the batched RPCs (called without mutex_ held).
+    void SendReads(ReadBatch batch);
+    void SendWrites(WriteBatch batch);
+};
+
+} // namespace kvstore
@@ -0,0 +1,211 @@
+// Asynchronous quorum fan-out built on the gRPC callback API.
+// One QuorumCall sends the same kind of RPC to several replicas without
+// spawning threads, then lets the caller wait until enough replies have
+// arrived - in whatever order they come in. RPCs still outstanding when the
+// QuorumCall is destroyed are cancelled; their late replies are ignored.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+
+namespace kvstore {
+
+// Completion callback handed to the stub's async() method.
+using RpcDoneCallback = std::function<void(grpc::Status)>;
+
+template <typename Request, typename Reply>
+class QuorumCall {
+public:
+    // @param fanout Number of replicas that may be contacted (slot count)
+    // @param timeout Deadline applied to every RPC of this call
+    QuorumCall(size_t fanout, std::chrono::milliseconds timeout)
+        : state_(std::make_shared<State>()),
+          timeout_(timeout),
+          wait_deadline_(std::chrono::steady_clock::now() + timeout) {
+        state_->slots.resize(fanout);
+    }
+
+    // Cancel whatever is still in flight. Completion callbacks keep the shared
+    // state alive, so contexts and replies outlive the cancelled RPCs. The
+    // cancels run after the lock is released: a callback that runs inline
+    // during TryCancel takes the same lock.
+    ~QuorumCall() {
+        std::vector<grpc::ClientContext*> in_flight;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            for (auto& slot : state_->slots) {
+                if (slot && !slot->done && !slot->external) {
+                    in_flight.push_back(&slot->context);
+                }
+            }
+        }
+        // Slots are never removed, so the contexts stay valid; cancelling one
+        // that has completed since is a no-op
+        for (grpc::ClientContext* context : in_flight) {
+            context->TryCancel();
+        }
+    }
+
+    QuorumCall(const QuorumCall&) = delete;
+    QuorumCall& operator=(const QuorumCall&) = delete;
+
+    // Start the RPC for one replica.
+    // @param index Replica slot (0 <= index < fanout)
+    // @param stub Stub to call through; kept alive until the RPC completes
+    // @param request Request message (moved into the call)
+    // @param start Callable (Stub*, ClientContext*, const Request*, Reply*,
+    //              RpcDoneCallback) that issues the async RPC
+    template <typename Stub, typename StartFn>
+    void Send(size_t index, std::shared_ptr<Stub> stub, Request request, StartFn start) {
+        auto slot = std::make_unique<Slot>();
+        slot->request = std::move(request);
+        slot->keep_alive = stub;
+        slot->context.set_deadline(std::chrono::system_clock::now() + timeout_);
+        Slot* raw = slot.get();
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->slots[index] = std::move(slot);
+            state_->sent++;
+        }
+        std::shared_ptr<State> state = state_;
+        start(stub.get(), &raw->context, &raw->request, &raw->reply,
+              [state, raw, index](grpc::Status status) {
+                  std::lock_guard<std::mutex> lock(state->mutex);
+                  raw->status = std::move(status);
+                  raw->done = true;
+                  state->arrivals.push_back(index);
+                  state->cv.notify_all();
+              });
+    }
+
+    // Register a slot whose reply is produced outside this call - e.g. one
+    // entry of a batched RPC sent by a coalescer - instead of by Send().
+    // @param index Replica slot (0 <= index < fanout)
+    // @return Callable (const grpc::Status&, const Reply&) that completes the
+    //         slot. It may run after this QuorumCall is gone; it is then ignored.
+    std::function<void(const grpc::Status&, const Reply&)> Expect(size_t index) {
+        auto slot = std::make_unique<Slot>();
+        slot->external = true;
+        Slot* raw = slot.get();
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->slots[index] = std::move(slot);
+            state_->sent++;
+        }
+        std::shared_ptr<State> state = state_;
+        return [state, raw, index](const grpc::Status& status, const Reply& reply) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (raw->done) {
+                return;
+            }
+            raw->status = status;
+            raw->reply = reply;
+            raw->done = true;
+            state->arrivals.push_back(index);
+            state->cv.notify_all();
+        };
+    }
+    
+    // Block until `needed` replies accepted by `accept` have arrived, until
+    // every RPC sent so far has completed, or until the call's timeout has
+    // passed (external slots carry no gRPC deadline of their own).
+    // @param needed Number of accepted replies that ends the wait
+    // @param accept Predicate (const Reply&) applied to successful replies
+    // @return Indices of accepted replies, in arrival order
+    template <typename AcceptFn>
+    std::vector<size_t> Wait(size_t needed, AcceptFn accept) {
+        return WaitUntil(needed, accept, wait_deadline_);
+    }
+    
+    // Wait, but give up at `deadline` if that comes before the call's
+    // timeout - e.g. to send more RPCs and then wait again.
+    template <typename AcceptFn>
+    std::vector<size_t> WaitUntil(size_t needed, AcceptFn accept,
+                                  std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        std::vector<size_t> accepted;
+        size_t scanned = 0;
+        state_->cv.wait_until(lock, std::min(deadline, wait_deadline_), [&] {
+            // Only look at arrivals we haven't classified yet
+            for (; scanned < state_->arrivals.size(); scanned++) {
+                size_t i = state_->arrivals[scanned];
+                const Slot& slot = *state_->slots[i];
+                if (slot.status.ok() && accept(slot.reply)) {
+                    accepted.push_back(i);
+                }
+            }
+            return accepted.size() >= needed || state_->arrivals.size() >= state_->sent;
+        });
+        return accepted;
+    }
+
+    // Indices of the accepted replies that have arrived so far, including
+    // any that came in after Wait returned. Never blocks.
+    // @param accept Predicate (const Reply&) applied to successful replies
+    // @return Indices of accepted replies, in arrival order
+    template <typename AcceptFn>
+    std::vector<size_t> Arrived(AcceptFn accept) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        std::vector<size_t> accepted;
+        for (size_t i : state_->arrivals) {
+            const Slot& slot = *state_->slots[i];
+            if (slot.status.ok() && accept(slot.reply)) {
+                accepted.push_back(i);
+            }
+        }
+        return accepted;
+    }
+    
+    // Whether the RPC for a replica has completed.
+    bool Done(size_t index) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        const auto& slot = state_->slots[index];
+        return slot && slot->done;
+    }
+
+    // Whether an RPC was sent to a replica at all.
+    bool Sent(size_t index) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->slots[index] != nullptr;
+    }
+
+    // Reply from a replica. Only valid for indices returned by Wait (or for
+    // which Done() returned true) - completed replies are never modified.
+    const Reply& GetReply(size_t index) const { return state_->slots[index]->reply; }
+
+    // Final status of a completed RPC.
+    const grpc::Status& GetStatus(size_t index) const { return state_->slots[index]->status; }
+
+private:
+    struct Slot {
+        grpc::ClientContext context;
+        Request request;
+        Reply reply;
+        grpc::Status status;
+        std::shared_ptr<void> keep_alive;   // Stub (and its channel) used for the call
+        bool external = false;              // Completed via Expect() rather than an RPC
+        bool done = false;
+    };
+
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::vector<size_t> arrivals;       // Completed slot indices, in completion order
+        size_t sent = 0;
+    };
+
+    std::shared_ptr<State> state_;
+    std::chrono::milliseconds timeout_;
+    std::chrono::steady_clock::time_point wait_deadline_;
+};
+
+} // namespace kvstore
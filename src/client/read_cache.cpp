@@ -0,0 +1,55 @@
+// Client read cache implementation.
+
+#include "read_cache.h"
+
+namespace kvstore {
+
+ReadCache::ReadCache(size_t capacity) : capacity_(capacity) {
+}
+
+bool ReadCache::Get(const std::string& key, Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    entry = it->second->second;
+    return true;
+}
+
+void ReadCache::Put(const std::string& key, std::string_view value, int64_t timestamp) {
+    if (capacity_ == 0) {
+        return;
+    }
+    // Copy the value before taking the lock
+    auto shared = std::make_shared<const std::string>(value);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        Entry& entry = it->second->second;
+        if (entry.timestamp < timestamp) {
+            entry.value = std::move(shared);
+            entry.timestamp = timestamp;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+    lru_.emplace_front(key, Entry{std::move(shared), timestamp});
+    index_.emplace(key, lru_.begin());
+    if (lru_.size() > capacity_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+void ReadCache::Erase(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+}
+
+} // namespace kvstore
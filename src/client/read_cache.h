@@ -0,0 +1,53 @@
+// Client-side cache of values known to be stored at a write quorum.
+// A cached read only has to confirm, with a timestamp-only probe of a read
+// quorum (ReadTimestamp), that no server has anything newer than the cached
+// timestamp; the value itself never crosses the network again until the key
+// is written. Entries are evicted least-recently-used.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace kvstore {
+
+// Thread-safe; values are shared, so a hit copies no bytes under the lock.
+class ReadCache {
+public:
+    struct Entry {
+        std::shared_ptr<const std::string> value;
+        int64_t timestamp = 0;          // Stored at a write quorum under (at least) this
+    };
+
+    // @param capacity Maximum number of keys kept
+    explicit ReadCache(size_t capacity);
+
+    ReadCache(const ReadCache&) = delete;
+    ReadCache& operator=(const ReadCache&) = delete;
+
+    // Look up a key, marking it most recently used.
+    // @return false if the key isn't cached
+    bool Get(const std::string& key, Entry& entry);
+
+    // Cache a value, unless the entry already holds a newer one.
+    void Put(const std::string& key, std::string_view value, int64_t timestamp);
+
+    // Drop a key (its cached value is about to be superseded).
+    void Erase(const std::string& key);
+
+private:
+    using Item = std::pair<std::string, Entry>;
+
+    size_t capacity_;
+    std::mutex mutex_;
+    std::list<Item> lru_;        // Most recently used first
+    std::unordered_map<std::string, std::list<Item>::iterator> index_;
+};
+
+} // namespace kvstore
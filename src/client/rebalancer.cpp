@@ -0,0 +1,125 @@
+// Online rebalancing implementation.
+
+#include "rebalancer.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "../common/hash_ring.h"
+#include "../common/hlc.h"
+#include "../common/logging.h"
+
+// Proto headers
+#include "kvstore.grpc.pb.h"
+#include "kvstore.pb.h"
+
+namespace kvstore {
+
+namespace {
+
+void AddRanges(const std::vector<HashRing::Range>& ranges,
+               google::protobuf::RepeatedPtrField<HashRange>* out) {
+    for (const auto& range : ranges) {
+        HashRange* added = out->Add();
+        added->set_start(range.start);
+        added->set_end(range.end);
+    }
+}
+
+} // namespace
+
+Rebalancer::Rebalancer(const Config& from, const Config& to, const Options& options)
+    : from_(from), to_(to), options_(options) {
+}
+
+bool Rebalancer::Run(const std::function<bool()>& switch_over) {
+    int64_t copy_start = hlc::Pack(hlc::WallPhysical() - CLOCK_SLACK_MS, 0, 0);
+    
+    LOG_INFO("[REBALANCE] Copying gained ranges to the new layout...");
+    if (!CopyPass(0)) {
+        LOG_ERROR("[REBALANCE] Copy failed; the old layout stays in use");
+        return false;
+    }
+    
+    LOG_INFO("[REBALANCE] Copy done (" << stats_.received << " entries); switching over...");
+    if (!switch_over()) {
+        LOG_ERROR("[REBALANCE] Switch-over aborted; the old layout stays in use");
+        return false;
+    }
+    
+    // Writes that reached only old owners while the first pass ran
+    LOG_INFO("[REBALANCE] Copying writes made during the copy...");
+    if (!CopyPass(copy_start)) {
+        LOG_ERROR("[REBALANCE] Catch-up copy failed; rerun it to make the new owners complete");
+        return false;
+    }
+    LOG_INFO("[REBALANCE] Done: " << stats_.pulls << " pulls, " << stats_.received
+             << " entries copied, " << stats_.applied << " applied");
+    return true;
+}
+
+bool Rebalancer::CopyPass(int64_t min_timestamp) {
+    const auto& old_servers = from_.GetServers();
+    const auto& new_servers = to_.GetServers();
+    HashRing old_ring(old_servers, from_.GetNumReplicas(), from_.GetVirtualNodes());
+    HashRing new_ring(new_servers, to_.GetNumReplicas(), to_.GetVirtualNodes());
+    
+    bool ok = true;
+    for (size_t target = 0; target < new_servers.size(); target++) {
+        const ServerInfo& server = new_servers[target];
+        ABDPullRangeRequest request;
+        ABDMigrateRequest* range = request.mutable_range();
+        AddRanges(new_ring.RangesOf(target), range->mutable_ranges());
+        range->set_min_timestamp(min_timestamp);
+        range->set_chunk_bytes(options_.chunk_bytes);
+        range->set_rate_limit_bytes(options_.rate_limit_bytes);
+        
+        // What the server already stored under the old layout isn't copied again
+        bool had_everything = false;
+        for (size_t old_index = 0; old_index < old_servers.size(); old_index++) {
+            if (old_servers[old_index].id != server.id) {
+                request.add_sources(old_servers[old_index].GetAddress());
+                continue;
+            }
+            std::vector<HashRing::Range> held = old_ring.RangesOf(old_index);
+            had_everything = held.size() == 1 && held[0].start == held[0].end;
+            AddRanges(held, range->mutable_exclude());
+        }
+        if (had_everything || request.sources_size() == 0) {
+            continue;
+        }
+        
+        auto stub = ABDService::NewStub(
+            grpc::CreateChannel(server.GetAddress(), grpc::InsecureChannelCredentials()));
+        ABDPullRangeResponse response;
+        bool pulled = false;
+        for (int32_t attempt = 1; attempt <= std::max(options_.pull_attempts, 1) && !pulled; attempt++) {
+            // The server passes the deadline on to its MigrateRange streams,
+            // so a timed-out pull stops before the next one starts
+            grpc::ClientContext context;
+            context.set_deadline(std::chrono::system_clock::now() +
+                                 std::chrono::milliseconds(options_.pull_timeout_ms));
+            response.Clear();
+            grpc::Status status = stub->PullRange(&context, request, &response);
+            stats_.pulls++;
+            pulled = status.ok() && response.success();
+            if (!pulled) {
+                LOG_WARN("[REBALANCE] Pull into server " << server.id << " failed (attempt " << attempt
+                         << "): " << (status.ok() ? response.error() : status.error_message()));
+            }
+        }
+        if (!pulled) {
+            LOG_ERROR("[REBALANCE] Giving up on server " << server.id);
+            ok = false;
+            continue;
+        }
+        stats_.received += response.received();
+        stats_.applied += response.applied();
+        LOG_INFO("[REBALANCE] Server " << server.id << ": " << response.received()
+                 << " entries copied, " << response.applied() << " applied");
+    }
+    return ok;
+}
+
+} // namespace kvstore
@@ -0,0 +1,65 @@
+// Online rebalancing for a partitioned ABD cluster.
+// When servers join or leave, the keys a server gains under the new layout
+// are copied to it straight from the servers that held them before
+// (PullRange / MigrateRange), merging by max timestamp. The cluster keeps
+// serving the old layout until the copy is done; only then is the new layout
+// switched in, and a second, much smaller pass copies what was written
+// meanwhile.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "../common/config.h"
+
+namespace kvstore {
+
+class Rebalancer {
+public:
+    struct Options {
+        int64_t rate_limit_bytes = 0;   // Copy rate cap in bytes per second (0 = unlimited)
+        int32_t chunk_bytes = 0;        // Migration chunk size (0 = server default)
+        int64_t pull_timeout_ms = 600000;   // Deadline for one PullRange call
+        int32_t pull_attempts = 3;      // Tries per server before the pass fails
+    };
+    
+    // Totals over every pass so far.
+    struct Stats {
+        int64_t pulls = 0;              // PullRange calls made (retries included)
+        int64_t received = 0;           // Entries copied to new owners
+        int64_t applied = 0;            // Copied entries newer than the owner's own
+    };
+    
+    // @param from Layout the cluster serves now
+    // @param to Layout to move to; servers are matched to `from` by id
+    Rebalancer(const Config& from, const Config& to, const Options& options);
+    
+    // Move the cluster to the new layout: copy every gained range, call
+    // `switch_over` to make clients use the new layout, then copy again
+    // whatever was written since the first copy started.
+    // @param switch_over Publishes the new layout; false aborts the move
+    // @return true if every copy succeeded and the switch was made
+    bool Run(const std::function<bool()>& switch_over);
+    
+    // One copy pass: every server of the new layout pulls the ranges it
+    // gains from the servers of the old one. A pull that fails or runs past
+    // pull_timeout_ms is retried (merging again is harmless) up to
+    // pull_attempts times.
+    // @param min_timestamp Only copy entries newer than this (0 = all)
+    // @return true if every pull succeeded
+    bool CopyPass(int64_t min_timestamp);
+    
+    const Stats& GetStats() const { return stats_; }
+    
+    // How far back the catch-up pass starts before the first copy began,
+    // to cover writers whose clocks run behind ours
+    static constexpr int64_t CLOCK_SLACK_MS = 5000;
+
+private:
+    Config from_;
+    Config to_;
+    Options options_;
+    Stats stats_;
+};
+
+} // namespace kvstore
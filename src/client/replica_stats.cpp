@@ -0,0 +1,62 @@
+// Per-replica latency tracking implementation.
+
+#include "replica_stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace kvstore {
+
+ReplicaStats::ReplicaStats(size_t servers, std::chrono::microseconds min_hedge_delay)
+    : replicas_(new Replica[servers]), min_hedge_delay_(min_hedge_delay) {
+}
+
+void ReplicaStats::OnSend(size_t server) {
+    Replica& replica = replicas_[server];
+    std::lock_guard<std::mutex> lock(replica.mutex);
+    replica.outstanding++;
+}
+
+void ReplicaStats::OnReply(size_t server, std::chrono::nanoseconds latency, bool failed) {
+    Replica& replica = replicas_[server];
+    std::lock_guard<std::mutex> lock(replica.mutex);
+    replica.outstanding--;
+    double sample = static_cast<double>(failed ? std::chrono::nanoseconds(kFailurePenalty).count()
+                                               : latency.count());
+    if (replica.ewma_ns == 0) {
+        replica.ewma_ns = sample;
+        replica.deviation_ns = sample / 2;
+    } else {
+        replica.deviation_ns += kAlpha * (std::abs(sample - replica.ewma_ns) - replica.deviation_ns);
+        replica.ewma_ns += kAlpha * (sample - replica.ewma_ns);
+    }
+    replica.last_sample = Clock::now();
+}
+
+std::vector<size_t> ReplicaStats::Rank(const std::vector<size_t>& replicas) const {
+    auto now = Clock::now();
+    std::vector<double> cost(replicas.size());
+    for (size_t i = 0; i < replicas.size(); i++) {
+        const Replica& replica = replicas_[replicas[i]];
+        std::lock_guard<std::mutex> lock(replica.mutex);
+        if (replica.ewma_ns == 0 || now - replica.last_sample > kStaleAfter) {
+            cost[i] = 0;    // Unmeasured: try it
+        } else {
+            cost[i] = replica.ewma_ns * static_cast<double>(1 + std::max<int64_t>(replica.outstanding, 0));
+        }
+    }
+    std::vector<size_t> order(replicas.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cost[a] < cost[b]; });
+    return order;
+}
+
+std::chrono::nanoseconds ReplicaStats::HedgeDelay(size_t server) const {
+    const Replica& replica = replicas_[server];
+    std::lock_guard<std::mutex> lock(replica.mutex);
+    auto estimate = std::chrono::nanoseconds(static_cast<int64_t>(replica.ewma_ns + 2 * replica.deviation_ns));
+    return std::max(estimate, std::chrono::nanoseconds(min_hedge_delay_));
+}
+
+} // namespace kvstore
@@ -0,0 +1,72 @@
+// Per-replica latency tracking for adaptive ABD reads.
+// Every RPC a client sends is counted as outstanding until its reply comes
+// in; the reply's latency then updates the server's moving average (EWMA)
+// and mean deviation, the way TCP tracks round-trip times. Reads rank a key's
+// replicas by expected latency - the average scaled by the replica's queue of
+// outstanding requests - and go to the fastest R first. A replica that keeps
+// being passed over would never be measured again, so one without a recent
+// sample ranks first and gets re-measured.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace kvstore {
+
+// Thread-safe; one lock per server.
+class ReplicaStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // @param servers Number of servers tracked (indexed like Config::GetServers())
+    // @param min_hedge_delay Floor for HedgeDelay()
+    ReplicaStats(size_t servers, std::chrono::microseconds min_hedge_delay);
+
+    ReplicaStats(const ReplicaStats&) = delete;
+    ReplicaStats& operator=(const ReplicaStats&) = delete;
+
+    // An RPC to a server went out.
+    void OnSend(size_t server);
+
+    // The reply to an RPC sent with OnSend arrived, it failed, or the client
+    // cancelled it (the latency is then a lower bound, still worth counting:
+    // a replica that is always cancelled must not look unmeasured).
+    // @param latency Time since the RPC was sent
+    // @param failed The RPC returned an error; counted as a very slow reply
+    void OnReply(size_t server, std::chrono::nanoseconds latency, bool failed);
+
+    // Positions in `replicas`, fastest expected replica first.
+    std::vector<size_t> Rank(const std::vector<size_t>& replicas) const;
+
+    // How long to wait for a server before hedging: its estimated p95
+    // latency (average plus two mean deviations), at least the floor.
+    std::chrono::nanoseconds HedgeDelay(size_t server) const;
+
+private:
+    struct Replica {
+        mutable std::mutex mutex;
+        double ewma_ns = 0;             // 0 until the first sample
+        double deviation_ns = 0;        // Smoothed |sample - ewma|
+        int64_t outstanding = 0;
+        Clock::time_point last_sample;
+    };
+
+    std::unique_ptr<Replica[]> replicas_;
+    std::chrono::nanoseconds min_hedge_delay_;
+
+    // Weight of a new sample in the moving averages (1/8, as for TCP's SRTT)
+    static constexpr double kAlpha = 0.125;
+
+    // Latency charged for a failed RPC
+    static constexpr std::chrono::milliseconds kFailurePenalty{1000};
+
+    // A replica not measured for this long is re-measured on the next read
+    static constexpr std::chrono::milliseconds kStaleAfter{1000};
+};
+
+} // namespace kvstore
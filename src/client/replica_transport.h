@@ -0,0 +1,42 @@
+// Per-replica transport for single-key ABD operations that don't go out as
+// their own unary RPC (batched by ABDCoalescer, or framed on one long-lived
+// stream by ABDStreamTransport). Each operation reports its reply through a
+// completion callback, exactly once.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <grpcpp/grpcpp.h>
+
+#include "kvstore.pb.h"
+
+namespace kvstore {
+
+class ABDReplicaTransport {
+public:
+    using ReadDone = std::function<void(const grpc::Status&, const ABDReadResponse&)>;
+    using WriteDone = std::function<void(const grpc::Status&, const ABDWriteResponse&)>;
+
+    virtual ~ABDReplicaTransport() = default;
+
+    // Send a read; `done` runs once with the reply (or an error status).
+    // @param key Key to read
+    // @param timestamp Client timestamp sent with the read
+    // @param value_limit Largest value to return inline (0 = no limit); a
+    //                    larger one comes back with value_omitted set
+    // @param done Completion, called from a gRPC thread (or inline on failure)
+    virtual void Read(const std::string& key, int64_t timestamp, int64_t value_limit,
+                      ReadDone done) = 0;
+
+    // Send a write; `done` runs once with the reply (or an error status).
+    // @param key Key to write
+    // @param value Value to write
+    // @param timestamp Timestamp for the write
+    // @param done Completion, called from a gRPC thread (or inline on failure)
+    virtual void Write(const std::string& key, const std::string& value, int64_t timestamp,
+                       WriteDone done) = 0;
+};
+
+} // namespace kvstore
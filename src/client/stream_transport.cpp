@@ -0,0 +1,216 @@
+// ABD streaming transport implementation.
+
+#include "stream_transport.h"
+#include "../common/logging.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+
+namespace kvstore {
+
+namespace {
+
+// How long the destructor waits for in-flight frames before cancelling
+constexpr std::chrono::milliseconds kShutdownGrace{200};
+
+} // namespace
+
+// One Stream call. Owns itself from Start() until gRPC reports OnDone; the
+// transport also holds a reference so it can send on it and shut it down.
+class ABDStreamTransport::Session final
+    : public grpc::ClientBidiReactor<ABDStreamRequest, ABDStreamResponse> {
+public:
+    explicit Session(std::shared_ptr<ABDService::Stub> stub) : stub_(std::move(stub)) {}
+
+    // Open the stream. A read is always outstanding so replies (and the
+    // end of the stream) are noticed as soon as they arrive.
+    void Start(std::shared_ptr<Session> self) {
+        self_ = std::move(self);
+        stub_->async()->Stream(&context_, this);
+        StartRead(&reply_);
+        StartCall();
+    }
+
+    // Queue a frame for sending.
+    // @return false if the stream has broken; `frame` and `done` are then untouched
+    bool Send(ABDStreamRequest& frame, FrameDone& done) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (broken_ || closing_) {
+            return false;
+        }
+        pending_.emplace(frame.tag(), std::move(done));
+        outgoing_.push_back(std::move(frame));
+        if (!writing_) {
+            writing_ = true;
+            StartWrite(&outgoing_.front());
+        }
+        return true;
+    }
+
+    // Half-close once queued frames are written, wait up to `grace` for the
+    // server to answer them, then cancel whatever is left.
+    void Shutdown(std::chrono::milliseconds grace) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        MaybeWritesDoneLocked();
+        if (!done_cv_.wait_for(lock, grace, [this] { return done_; })) {
+            lock.unlock();
+            context_.TryCancel();
+            lock.lock();
+            done_cv_.wait(lock, [this] { return done_; });
+        }
+    }
+
+    void OnWriteDone(bool ok) override {
+        if (!ok) {
+            // The stream is dead; make sure the read side ends too
+            context_.TryCancel();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        outgoing_.pop_front();
+        if (!ok) {
+            broken_ = true;
+            outgoing_.clear();
+        }
+        if (!outgoing_.empty()) {
+            StartWrite(&outgoing_.front());
+            return;
+        }
+        writing_ = false;
+        MaybeWritesDoneLocked();
+    }
+
+    void OnReadDone(bool ok) override {
+        if (!ok) {
+            FailPending(grpc::Status(grpc::StatusCode::UNAVAILABLE, "stream closed"));
+            return;
+        }
+        FrameDone done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = pending_.find(reply_.tag());
+            if (it != pending_.end()) {
+                done = std::move(it->second);
+                pending_.erase(it);
+            }
+        }
+        if (done) {
+            done(grpc::Status::OK, reply_);
+        } else {
+            LOG_WARN_EVERY(1000, "[CLIENT] Stream reply with unknown tag " << reply_.tag());
+        }
+        StartRead(&reply_);
+    }
+
+    void OnDone(const grpc::Status& status) override {
+        FailPending(status.ok() ? grpc::Status(grpc::StatusCode::UNAVAILABLE, "stream closed")
+                                : status);
+        std::shared_ptr<Session> self;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+            self = std::move(self_);
+        }
+        done_cv_.notify_all();
+        // `self` may be the last reference; it is released after the lock
+    }
+
+private:
+    std::shared_ptr<ABDService::Stub> stub_;   // Keeps the channel alive
+    grpc::ClientContext context_;
+    ABDStreamResponse reply_;                  // Only touched by the read chain
+    std::shared_ptr<Session> self_;            // Released in OnDone
+
+    std::mutex mutex_;                         // Protects the fields below
+    std::condition_variable done_cv_;
+    std::unordered_map<uint64_t, FrameDone> pending_;
+    std::deque<ABDStreamRequest> outgoing_;    // front() is being written while writing_
+    bool writing_ = false;
+    bool closing_ = false;
+    bool writes_done_ = false;
+    bool broken_ = false;
+    bool done_ = false;
+
+    void MaybeWritesDoneLocked() {
+        if (closing_ && !writing_ && !writes_done_ && !broken_) {
+            writes_done_ = true;
+            StartWritesDone();
+        }
+    }
+
+    // Complete every unanswered frame with `status`; later sends are refused.
+    void FailPending(const grpc::Status& status) {
+        std::unordered_map<uint64_t, FrameDone> failed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            broken_ = true;
+            failed.swap(pending_);
+        }
+        ABDStreamResponse empty;
+        for (auto& entry : failed) {
+            entry.second(status, empty);
+        }
+    }
+};
+
+ABDStreamTransport::ABDStreamTransport(StubFn get_stub) : get_stub_(std::move(get_stub)) {
+}
+
+ABDStreamTransport::~ABDStreamTransport() {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session = std::move(session_);
+    }
+    if (session) {
+        session->Shutdown(kShutdownGrace);
+    }
+}
+
+void ABDStreamTransport::Read(const std::string& key, int64_t timestamp, int64_t value_limit,
+                              ReadDone done) {
+    ABDStreamRequest frame;
+    auto* read = frame.mutable_read();
+    read->set_key(key);
+    read->set_timestamp(timestamp);
+    read->set_value_limit(value_limit);
+    Submit(std::move(frame),
+        [done = std::move(done)](const grpc::Status& status, const ABDStreamResponse& reply) {
+            done(status, reply.read());
+        });
+}
+
+void ABDStreamTransport::Write(const std::string& key, const std::string& value,
+                               int64_t timestamp, WriteDone done) {
+    ABDStreamRequest frame;
+    auto* write = frame.mutable_write();
+    write->set_key(key);
+    write->set_value(value);
+    write->set_timestamp(timestamp);
+    Submit(std::move(frame),
+        [done = std::move(done)](const grpc::Status& status, const ABDStreamResponse& reply) {
+            done(status, reply.write());
+        });
+}
+
+void ABDStreamTransport::Submit(ABDStreamRequest frame, FrameDone done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frame.set_tag(next_tag_++);
+        if (session_ && session_->Send(frame, done)) {
+            return;
+        }
+        // No stream yet, or it broke: open a new one for this and later frames
+        session_ = std::make_shared<Session>(get_stub_());
+        session_->Start(session_);
+        if (session_->Send(frame, done)) {
+            return;
+        }
+    }
+    ABDStreamResponse empty;
+    done(grpc::Status(grpc::StatusCode::UNAVAILABLE, "stream closed"), empty);
+}
+
+} // namespace kvstore
@@ -0,0 +1,60 @@
+// Bidirectional-streaming transport for the ABD protocol.
+// One long-lived ABDService.Stream call per replica carries every read and
+// write this client sends to it as a tagged frame. Replies are matched to
+// their operation by tag, so they may come back in any order. This avoids
+// per-RPC call setup for high-rate clients. A broken stream fails the
+// operations in flight on it; the next operation opens a fresh stream.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <grpcpp/grpcpp.h>
+
+#include "kvstore.grpc.pb.h"
+#include "kvstore.pb.h"
+#include "replica_transport.h"
+
+namespace kvstore {
+
+class ABDStreamTransport final : public ABDReplicaTransport {
+public:
+    using StubFn = std::function<std::shared_ptr<ABDService::Stub>()>;
+
+    // @param get_stub Returns the stub for this transport's replica
+    explicit ABDStreamTransport(StubFn get_stub);
+
+    // Half-closes the stream and gives in-flight frames a moment to be
+    // answered before cancelling it.
+    ~ABDStreamTransport() override;
+
+    ABDStreamTransport(const ABDStreamTransport&) = delete;
+    ABDStreamTransport& operator=(const ABDStreamTransport&) = delete;
+
+    // Send a read frame; `done` runs once with the tagged reply.
+    void Read(const std::string& key, int64_t timestamp, int64_t value_limit,
+              ReadDone done) override;
+
+    // Send a write frame; `done` runs once with the tagged reply.
+    void Write(const std::string& key, const std::string& value, int64_t timestamp,
+               WriteDone done) override;
+
+private:
+    class Session;
+    using FrameDone = std::function<void(const grpc::Status&, const ABDStreamResponse&)>;
+
+    StubFn get_stub_;
+
+    std::mutex mutex_;                  // Protects session_ and next_tag_
+    std::shared_ptr<Session> session_;  // Current stream; replaced once broken
+    uint64_t next_tag_ = 1;
+
+    // Tag a frame and send it on the current stream, opening a new one if
+    // the current stream has broken.
+    void Submit(ABDStreamRequest frame, FrameDone done);
+};
+
+} // namespace kvstore
@@ -0,0 +1,56 @@
+// Counting replacement of the global operator new, for --profile.
+// Linked only into the binaries that take --profile (see the Makefile), so
+// everything else keeps the standard operator new. Allocations go to malloc as
+// they would anyway; while profiling is off the only extra work is the check
+// of the enabled flag. The aligned forms are left to the library, and memory
+// that gRPC's C core takes with malloc directly is not seen.
+
+#include <cstdlib>
+#include <new>
+#include "profiler.h"
+
+namespace {
+
+void* Allocate(std::size_t size) {
+    kvstore::profile::internal::CountAllocation(size);
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        void* p = std::malloc(size);
+        if (p != nullptr) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* AllocateNoThrow(std::size_t size) noexcept {
+    try {
+        return Allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+struct MarkLinked {
+    MarkLinked() { kvstore::profile::internal::alloc_hook_linked = true; }
+} mark_linked;
+
+} // namespace
+
+void* operator new(std::size_t size) { return Allocate(size); }
+void* operator new[](std::size_t size) { return Allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return AllocateNoThrow(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return AllocateNoThrow(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
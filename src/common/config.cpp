@@ -8,13 +8,67 @@
 
 namespace kvstore {
 
+namespace {
+
+// Find a boolean field ("name":true / "name":false) in whitespace-free JSON.
+// @return true if the field was present
+bool ParseBoolField(const std::string& content, const std::string& name, bool& out) {
+    size_t pos = content.find("\"" + name + "\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    size_t val_start = content.find(':', pos) + 1;
+    out = content.compare(val_start, 4, "true") == 0;
+    return true;
+}
+
+// Find an integer field ("name":123) in whitespace-free JSON.
+// @return true if the field was present
+bool ParseIntField(const std::string& content, const std::string& name, int32_t& out) {
+    size_t pos = content.find("\"" + name + "\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    size_t val_start = content.find(':', pos) + 1;
+    size_t val_end = content.find_first_of(",}", val_start);
+    out = std::stoi(content.substr(val_start, val_end - val_start));
+    return true;
+}
+
+// Find a string field ("name":"text") in whitespace-free JSON.
+// @return true if the field was present
+bool ParseStringField(const std::string& content, const std::string& name, std::string& out) {
+    size_t pos = content.find("\"" + name + "\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    size_t val_start = content.find('"', content.find(':', pos)) + 1;
+    size_t val_end = content.find('"', val_start);
+    out = content.substr(val_start, val_end - val_start);
+    return true;
+}
+
+} // namespace
+
 Config::Config() 
     : protocol_(ProtocolType::ABD)
     , read_quorum_(0)
     , write_quorum_(0)
     , num_replicas_(0)
     , server_id_(0)
-    , port_(0) {
+    , port_(0)
+    , use_connection_pool_(true)
+    , coalesce_window_us_(0)
+    , coalesce_max_batch_(64)
+    , transport_(TransportType::UNARY)
+    , lock_lease_ms_(30000)
+    , virtual_nodes_(64)
+    , read_cache_entries_(0)
+    , large_value_bytes_(1 << 20)
+    , compress_above_bytes_(0)
+    , adaptive_reads_(false)
+    , hedge_min_us_(500)
+    , conditional_writes_(false) {
 }
 
 Config::~Config() {
@@ -124,9 +178,56 @@ bool Config::LoadFromFile(const std::string& filename) {
         num_replicas_ = std::stoi(content.substr(val_start, val_end - val_start));
     }
     
+    // Parse optional client connection pool flag (defaults to enabled)
+    ParseBoolField(content, "connection_pool", use_connection_pool_);
+    
+    // Parse optional request coalescing knobs (window 0 = disabled)
+    ParseIntField(content, "coalesce_window_us", coalesce_window_us_);
+    ParseIntField(content, "coalesce_max_batch", coalesce_max_batch_);
+    
+    // Parse optional blocking-protocol lock lease
+    ParseIntField(content, "lock_lease_ms", lock_lease_ms_);
+    
+    // Parse optional hash ring size (only used when num_replicas < servers)
+    ParseIntField(content, "virtual_nodes", virtual_nodes_);
+    
+    // Parse optional ABD client read cache size (0 = no cache)
+    ParseIntField(content, "read_cache_entries", read_cache_entries_);
+    
+    // Parse optional ABD large-value handling: chunking and gzip thresholds
+    ParseIntField(content, "large_value_bytes", large_value_bytes_);
+    ParseIntField(content, "compress_above_bytes", compress_above_bytes_);
+    
+    // Parse optional ABD replica selection: read the fastest R replicas and hedge
+    ParseBoolField(content, "adaptive_reads", adaptive_reads_);
+    ParseIntField(content, "hedge_min_us", hedge_min_us_);
+    
+    // Parse optional ABD multi-writer mode: writes are compare-and-set on the timestamp
+    ParseBoolField(content, "conditional_writes", conditional_writes_);
+    
+    // Parse optional ABD transport: "transport":"unary" (default) or "stream"
+    std::string transport_str;
+    if (ParseStringField(content, "transport", transport_str)) {
+        if (transport_str == "stream") {
+            transport_ = TransportType::STREAM;
+        } else if (transport_str == "unary") {
+            transport_ = TransportType::UNARY;
+        } else {
+            std::cerr << "Error: Unknown transport: " << transport_str << std::endl;
+            return false;
+        }
+    }
+    
     return Validate();
 }
 
+size_t Config::GetReplicaSetSize() const {
+    if (num_replicas_ > 0 && static_cast<size_t>(num_replicas_) < servers_.size()) {
+        return static_cast<size_t>(num_replicas_);
+    }
+    return servers_.size();
+}
+
 ServerInfo Config::GetServer(int32_t id) const {
     for (const auto& server : servers_) {
         if (server.id == id) {
@@ -149,18 +250,48 @@ bool Config::Validate() const {
         return false;
     }
     
-    // Warn if num_replicas doesn't match actual server count
-    if (num_replicas_ > 0 && static_cast<size_t>(num_replicas_) != servers_.size()) {
-        std::cerr << "Warning: num_replicas doesn't match number of servers" << std::endl;
+    // Fewer replicas than servers partitions the keys; more can't be placed
+    if (num_replicas_ > 0 && static_cast<size_t>(num_replicas_) > servers_.size()) {
+        std::cerr << "Error: num_replicas exceeds number of servers" << std::endl;
+        return false;
+    }
+    if (virtual_nodes_ <= 0) {
+        std::cerr << "Error: Invalid virtual_nodes" << std::endl;
+        return false;
     }
     
     // Warn if quorum sizes don't guarantee consistency
-    // For linearizability, we need R + W > N (where N is number of servers)
-    int32_t n = static_cast<int32_t>(servers_.size());
+    // For linearizability, we need R + W > N (where N is the replica set size)
+    int32_t n = static_cast<int32_t>(GetReplicaSetSize());
     if (read_quorum_ + write_quorum_ <= n) {
         std::cerr << "Warning: Quorum sizes may not guarantee consistency" << std::endl;
     }
     
+    if (coalesce_window_us_ < 0 || coalesce_max_batch_ <= 0) {
+        std::cerr << "Error: Invalid coalescing settings" << std::endl;
+        return false;
+    }
+    
+    if (lock_lease_ms_ <= 0) {
+        std::cerr << "Error: Invalid lock lease" << std::endl;
+        return false;
+    }
+    
+    if (read_cache_entries_ < 0) {
+        std::cerr << "Error: Invalid read cache size" << std::endl;
+        return false;
+    }
+    
+    if (large_value_bytes_ < 0 || compress_above_bytes_ < 0) {
+        std::cerr << "Error: Invalid large value settings" << std::endl;
+        return false;
+    }
+    
+    if (hedge_min_us_ < 0) {
+        std::cerr << "Error: Invalid hedge_min_us" << std::endl;
+        return false;
+    }
+    
     return true;
 }
 
@@ -32,12 +32,20 @@ enum class ProtocolType {
     BLOCKING
 };
 
+// Client transport for ABD operations.
+// UNARY: one RPC per operation per replica (optionally coalesced into batches)
+// STREAM: tagged frames on one long-lived bidirectional stream per replica
+enum class TransportType {
+    UNARY,
+    STREAM
+};
+
 // Configuration manager for the key-value store.
 // Loads configuration from JSON files and provides access to:
 // - Server list and addresses
 // - Protocol type (ABD or Blocking)
 // - Quorum sizes (read quorum R, write quorum W)
-// - Number of replicas
+// - Number of replicas per key, and the hash ring that picks them
 class Config {
 public:
     Config();
@@ -55,8 +63,25 @@ public:
     int32_t GetReadQuorum() const { return read_quorum_; }
     int32_t GetWriteQuorum() const { return write_quorum_; }
     int32_t GetNumReplicas() const { return num_replicas_; }
+    int32_t GetVirtualNodes() const { return virtual_nodes_; }
+    int32_t GetReadCacheEntries() const { return read_cache_entries_; }
+    int32_t GetLargeValueBytes() const { return large_value_bytes_; }
+    int32_t GetCompressAboveBytes() const { return compress_above_bytes_; }
+    bool UseAdaptiveReads() const { return adaptive_reads_; }
+    int32_t GetHedgeMinUs() const { return hedge_min_us_; }
+    bool UseConditionalWrites() const { return conditional_writes_; }
+    
+    // Servers each key is stored on (N): num_replicas when it is set and
+    // smaller than the server list, otherwise every server. Quorums are
+    // taken out of these N.
+    size_t GetReplicaSetSize() const;
     int32_t GetServerId() const { return server_id_; }
     int32_t GetPort() const { return port_; }
+    bool UseConnectionPool() const { return use_connection_pool_; }
+    int32_t GetCoalesceWindowUs() const { return coalesce_window_us_; }
+    int32_t GetCoalesceMaxBatch() const { return coalesce_max_batch_; }
+    TransportType GetTransport() const { return transport_; }
+    int32_t GetLockLeaseMs() const { return lock_lease_ms_; }
     
     // Setters (mainly for testing or programmatic configuration)
     void SetServers(const std::vector<ServerInfo>& servers) { servers_ = servers; }
@@ -64,8 +89,20 @@ public:
     void SetReadQuorum(int32_t r) { read_quorum_ = r; }
     void SetWriteQuorum(int32_t w) { write_quorum_ = w; }
     void SetNumReplicas(int32_t n) { num_replicas_ = n; }
+    void SetVirtualNodes(int32_t n) { virtual_nodes_ = n; }
+    void SetReadCacheEntries(int32_t n) { read_cache_entries_ = n; }
+    void SetLargeValueBytes(int32_t bytes) { large_value_bytes_ = bytes; }
+    void SetCompressAboveBytes(int32_t bytes) { compress_above_bytes_ = bytes; }
+    void SetAdaptiveReads(bool enabled) { adaptive_reads_ = enabled; }
+    void SetHedgeMinUs(int32_t us) { hedge_min_us_ = us; }
+    void SetConditionalWrites(bool enabled) { conditional_writes_ = enabled; }
     void SetServerId(int32_t id) { server_id_ = id; }
     void SetPort(int32_t port) { port_ = port; }
+    void SetUseConnectionPool(bool enabled) { use_connection_pool_ = enabled; }
+    void SetCoalesceWindowUs(int32_t us) { coalesce_window_us_ = us; }
+    void SetCoalesceMaxBatch(int32_t n) { coalesce_max_batch_ = n; }
+    void SetTransport(TransportType transport) { transport_ = transport; }
+    void SetLockLeaseMs(int32_t ms) { lock_lease_ms_ = ms; }
     
     // Validate the configuration.
     // Checks that servers are configured, quorums are valid, etc.
@@ -77,9 +114,21 @@ private:
     ProtocolType protocol_;            // Which protocol to use (ABD or Blocking)
     int32_t read_quorum_;              // Number of servers needed for a read (R)
     int32_t write_quorum_;             // Number of servers needed for a write (W)
-    int32_t num_replicas_;            // Total number of replicas
+    int32_t num_replicas_;             // Replicas per key (0 = every server)
     int32_t server_id_;                // This server's ID (if running as server)
     int32_t port_;                    // Port to listen on (if running as server)
+    bool use_connection_pool_;         // Reuse channels/stubs across operations
+    int32_t coalesce_window_us_;       // Client batching window in microseconds (0 = off)
+    int32_t coalesce_max_batch_;       // Flush a batch early once it has this many ops
+    TransportType transport_;          // How ABD clients reach the replicas
+    int32_t lock_lease_ms_;            // Blocking lock lease, renewed while an operation runs
+    int32_t virtual_nodes_;            // Hash ring points per server (when partitioned)
+    int32_t read_cache_entries_;       // ABD client read cache capacity (0 = off)
+    int32_t large_value_bytes_;        // ABD values above this are sent in chunks (0 = never)
+    int32_t compress_above_bytes_;     // ABD client gzips values above this (0 = never)
+    bool adaptive_reads_;              // ABD reads go to the R fastest replicas, hedged
+    int32_t hedge_min_us_;             // Shortest wait before a read is hedged
+    bool conditional_writes_;          // ABD writes keep the client's timestamp (WriteIfNewer)
 };
 
 } // namespace kvstore
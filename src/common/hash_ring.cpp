@@ -0,0 +1,109 @@
+// Consistent-hash ring implementation.
+
+#include "hash_ring.h"
+#include <algorithm>
+#include <string>
+
+namespace kvstore {
+
+HashRing::HashRing(const std::vector<ServerInfo>& servers, int32_t replicas, int32_t virtual_nodes)
+    : num_servers_(servers.size()),
+      replicas_(replicas <= 0 ? servers.size()
+                              : std::min(static_cast<size_t>(replicas), servers.size())) {
+    if (!Partitioned()) {
+        return;
+    }
+    // Points are placed by server id rather than list position, so
+    // reordering the config doesn't move data
+    points_.reserve(servers.size() * static_cast<size_t>(virtual_nodes));
+    for (size_t i = 0; i < servers.size(); i++) {
+        for (int32_t v = 0; v < virtual_nodes; v++) {
+            std::string point = std::to_string(servers[i].id) + "#" + std::to_string(v);
+            points_.emplace_back(Hash(point), static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(points_.begin(), points_.end());
+}
+
+std::vector<size_t> HashRing::ReplicasFor(std::string_view key) const {
+    if (!Partitioned()) {
+        return AllServers();
+    }
+    auto start = std::lower_bound(points_.begin(), points_.end(),
+                                  std::make_pair(Hash(key), uint32_t{0}));
+    std::vector<size_t> replicas = ReplicasFrom(static_cast<size_t>(start - points_.begin()));
+    std::sort(replicas.begin(), replicas.end());
+    return replicas;
+}
+
+std::vector<size_t> HashRing::ReplicasFrom(size_t first) const {
+    std::vector<size_t> replicas;
+    replicas.reserve(replicas_);
+    for (size_t step = 0; step < points_.size() && replicas.size() < replicas_; step++) {
+        size_t server = points_[(first + step) % points_.size()].second;
+        if (std::find(replicas.begin(), replicas.end(), server) == replicas.end()) {
+            replicas.push_back(server);
+        }
+    }
+    return replicas;
+}
+
+std::vector<HashRing::Range> HashRing::RangesOf(size_t server) const {
+    if (!Partitioned()) {
+        return {Range{0, 0}};
+    }
+    // Keys hashing into (point i-1, point i] start their walk at point i
+    // (a hash past the last point wraps to point 0)
+    std::vector<Range> ranges;
+    bool all = true;
+    for (size_t i = 0; i < points_.size(); i++) {
+        std::vector<size_t> replicas = ReplicasFrom(i);
+        if (std::find(replicas.begin(), replicas.end(), server) == replicas.end()) {
+            all = false;
+            continue;
+        }
+        uint64_t start = points_[(i + points_.size() - 1) % points_.size()].first;
+        uint64_t end = points_[i].first;
+        if (start == end) {
+            continue;   // Two points at one position: the arc is empty
+        }
+        if (!ranges.empty() && ranges.back().end == start) {
+            ranges.back().end = end;
+        } else {
+            ranges.push_back({start, end});
+        }
+    }
+    if (all) {
+        return {Range{0, 0}};
+    }
+    // The last arc may continue into the first one across the wrap
+    if (ranges.size() > 1 && ranges.back().end == ranges.front().start) {
+        ranges.front().start = ranges.back().start;
+        ranges.pop_back();
+    }
+    return ranges;
+}
+
+std::vector<size_t> HashRing::AllServers() const {
+    std::vector<size_t> servers(num_servers_);
+    for (size_t i = 0; i < num_servers_; i++) {
+        servers[i] = i;
+    }
+    return servers;
+}
+
+uint64_t HashRing::Hash(std::string_view data) {
+    // FNV-1a, finished with the splitmix64 mixer so nearby inputs
+    // ("0#1", "0#2", ...) land far apart on the ring
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    h += 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+} // namespace kvstore
@@ -0,0 +1,73 @@
+// Consistent-hash ring that partitions keys over the cluster.
+// Every server owns a number of virtual nodes: points on a 64-bit ring placed
+// by hashing its id. A key's replica set is the first N distinct servers
+// found walking clockwise from the key's hash, so each server stores about
+// N/servers of the data, and adding or removing a server only moves the keys
+// next to its points. When N covers every server the ring is bypassed and
+// every key lives everywhere (the unpartitioned layout).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "config.h"
+
+namespace kvstore {
+
+class HashRing {
+public:
+    // An arc of the ring: hashes h with start < h <= end, wrapping past the
+    // top when end < start. start == end is the whole ring.
+    struct Range {
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // @param servers Every server in the cluster
+    // @param replicas Replica set size N (<= 0, or more than the servers, means all of them)
+    // @param virtual_nodes Ring points per server
+    HashRing(const std::vector<ServerInfo>& servers, int32_t replicas, int32_t virtual_nodes);
+
+    // The servers storing a key, as ascending indices into the server list.
+    // The order is the same for every key, which the blocking client relies
+    // on to take locks without deadlock.
+    std::vector<size_t> ReplicasFor(std::string_view key) const;
+
+    // The arcs whose keys a server stores (adjacent arcs merged), so that a
+    // key is in one of them exactly when ReplicasFor(key) contains `server`.
+    std::vector<Range> RangesOf(size_t server) const;
+
+    // Whether a hash lies on an arc.
+    static bool Contains(const Range& range, uint64_t hash) {
+        if (range.start < range.end) {
+            return hash > range.start && hash <= range.end;
+        }
+        return range.start == range.end || hash > range.start || hash <= range.end;
+    }
+
+    // Indices of every server, in order.
+    std::vector<size_t> AllServers() const;
+
+    // Replica set size N.
+    size_t ReplicationFactor() const { return replicas_; }
+
+    // Whether keys are spread over subsets of the servers.
+    bool Partitioned() const { return replicas_ < num_servers_; }
+
+    // Stable 64-bit hash used to place keys and virtual nodes (the same in
+    // every process, unlike std::hash).
+    static uint64_t Hash(std::string_view data);
+
+private:
+    size_t num_servers_;
+    size_t replicas_;
+    std::vector<std::pair<uint64_t, uint32_t>> points_;   // (position, server index), sorted
+
+    // Replica set of the keys just before point `first`, unsorted.
+    std::vector<size_t> ReplicasFrom(size_t first) const;
+};
+
+} // namespace kvstore
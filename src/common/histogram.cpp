@@ -0,0 +1,54 @@
+// Latency histogram implementation.
+
+#include "histogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace kvstore {
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::Reset() {
+    counts_.fill(0);
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+int64_t LatencyHistogram::Percentile(double q) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    q = std::min(std::max(q, 0.0), 1.0);
+    // Rank of the requested value, 1-based (nearest-rank definition)
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            return static_cast<int64_t>(std::min(BucketUpperBound(i), max_));
+        }
+    }
+    return static_cast<int64_t>(max_);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < kLinear) {
+        return index;
+    }
+    size_t shift = (index - kLinear) / kSubBuckets + 1;
+    uint64_t sub = (index - kLinear) % kSubBuckets + kSubBuckets;
+    if (shift >= 57) {
+        return UINT64_MAX;         // Top bucket's bound doesn't fit; max_ caps it anyway
+    }
+    return ((sub + 1) << shift) - 1;
+}
+
+} // namespace kvstore
@@ -0,0 +1,66 @@
+// HDR-style latency histogram with log-linear buckets.
+// Values below 128 get a bucket each; above that every power of two is split
+// into 64 equal buckets, so any recorded value is reported to within 1/64
+// (~1.6%) of itself. Memory is fixed (about 29 KB) no matter how long a run
+// lasts, and recording is a couple of shifts and an increment with no lock.
+// Give each thread its own histogram and Merge() them when reporting.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace kvstore {
+
+class LatencyHistogram {
+public:
+    // Record one value (negative values count as 0).
+    void Record(int64_t value) {
+        uint64_t v = value < 0 ? 0 : static_cast<uint64_t>(value);
+        counts_[BucketIndex(v)]++;
+        count_++;
+        sum_ += v;
+        if (v > max_) {
+            max_ = v;
+        }
+    }
+
+    // Add every value recorded in `other`.
+    void Merge(const LatencyHistogram& other);
+
+    // Forget everything recorded.
+    void Reset();
+
+    // Value at quantile `q` (0.0 - 1.0): the upper bound of the bucket holding
+    // it, capped at the largest value recorded. 0 for an empty histogram.
+    int64_t Percentile(double q) const;
+
+    uint64_t Count() const { return count_; }
+    int64_t Max() const { return static_cast<int64_t>(max_); }
+    double Mean() const { return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_; }
+
+private:
+    static constexpr int kLinearBits = 7;                    // Exact buckets below 128
+    static constexpr uint64_t kLinear = 1ull << kLinearBits;
+    static constexpr uint64_t kSubBuckets = kLinear / 2;     // Buckets per power of two above
+    static constexpr size_t kNumBuckets = kLinear + (64 - kLinearBits) * kSubBuckets;
+
+    std::array<uint64_t, kNumBuckets> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+
+    static size_t BucketIndex(uint64_t v) {
+        if (v < kLinear) {
+            return static_cast<size_t>(v);
+        }
+        int shift = 63 - __builtin_clzll(v) - (kLinearBits - 1);   // v >> shift is in [64, 128)
+        return kLinear + (shift - 1) * kSubBuckets + ((v >> shift) - kSubBuckets);
+    }
+
+    // Largest value that lands in bucket `index`.
+    static uint64_t BucketUpperBound(size_t index);
+};
+
+} // namespace kvstore
@@ -0,0 +1,137 @@
+// Hybrid logical clock (HLC) timestamps.
+// A timestamp packs {physical, logical, writer} into one 64-bit integer:
+//
+//   | physical: 42 bits (ms since 2020-01-01) | logical: 10 bits | writer: 12 bits |
+//
+// so comparing two timestamps as integers compares the fields in that order.
+// The physical part follows the wall clock, the logical counter orders events
+// within one millisecond (or while the clock lags a timestamp seen from
+// elsewhere), and the writer id breaks the remaining ties: timestamps from
+// different writers are never equal. The top bit stays clear until 2089, so
+// timestamps remain positive int64 values.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace kvstore {
+
+namespace hlc {
+
+constexpr int kWriterBits = 12;
+constexpr int kLogicalBits = 10;
+constexpr uint64_t kWriterMask = (1ull << kWriterBits) - 1;
+constexpr uint64_t kLogicalMask = (1ull << kLogicalBits) - 1;
+
+// Start of the physical field, in Unix milliseconds
+constexpr int64_t kEpochMs = 1577836800000;     // 2020-01-01T00:00:00Z
+
+// Writer ids: clients use the lower half, servers the upper half.
+constexpr uint32_t kServerWriterBase = 1u << (kWriterBits - 1);
+constexpr int32_t kMaxClientId = static_cast<int32_t>(kServerWriterBase) - 1;
+
+// Client ids are used as writer ids unchanged, so they must be unique among
+// the clients of a cluster and no larger than kMaxClientId.
+inline bool ValidClientId(int32_t client_id) {
+    return client_id >= 0 && client_id <= kMaxClientId;
+}
+
+// @throws std::out_of_range unless ValidClientId(client_id)
+inline uint32_t ClientWriterId(int32_t client_id) {
+    if (!ValidClientId(client_id)) {
+        throw std::out_of_range("client id " + std::to_string(client_id) + " is outside 0.." +
+                                std::to_string(kMaxClientId));
+    }
+    return static_cast<uint32_t>(client_id);
+}
+
+inline uint32_t ServerWriterId(int32_t server_id) {
+    return kServerWriterBase | (static_cast<uint32_t>(server_id) & (kServerWriterBase - 1));
+}
+
+inline int64_t Pack(int64_t physical, uint64_t logical, uint32_t writer) {
+    return static_cast<int64_t>((static_cast<uint64_t>(physical) << (kLogicalBits + kWriterBits)) |
+                                ((logical & kLogicalMask) << kWriterBits) |
+                                (writer & kWriterMask));
+}
+
+inline int64_t Physical(int64_t ts) {
+    return static_cast<int64_t>(static_cast<uint64_t>(ts) >> (kLogicalBits + kWriterBits));
+}
+
+inline uint64_t Logical(int64_t ts) {
+    return (static_cast<uint64_t>(ts) >> kWriterBits) & kLogicalMask;
+}
+
+inline uint32_t Writer(int64_t ts) {
+    return static_cast<uint32_t>(static_cast<uint64_t>(ts) & kWriterMask);
+}
+
+// Current wall clock in the physical field's units.
+inline int64_t WallPhysical() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now).count() - kEpochMs;
+}
+
+} // namespace hlc
+
+// Lock-free HLC for one writer. All methods are safe to call concurrently.
+class HybridClock {
+public:
+    // @param writer_id Id stamped into every timestamp (see hlc::ClientWriterId
+    //                  / hlc::ServerWriterId); must be unique among writers
+    explicit HybridClock(uint32_t writer_id)
+        : writer_(writer_id & hlc::kWriterMask), last_(hlc::Pack(hlc::WallPhysical(), 0, writer_)) {}
+
+    // A new timestamp, greater than every timestamp this clock has issued or observed.
+    int64_t Now() { return After(0); }
+
+    // A new timestamp greater than `ts` and than everything issued or observed.
+    int64_t After(int64_t ts) {
+        int64_t last = last_.load(std::memory_order_relaxed);
+        int64_t next;
+        do {
+            next = Successor(last > ts ? last : ts);
+        } while (!last_.compare_exchange_weak(last, next, std::memory_order_relaxed));
+        return next;
+    }
+
+    // Merge a timestamp seen from elsewhere, so later ones order after it.
+    void Observe(int64_t ts) {
+        int64_t last = last_.load(std::memory_order_relaxed);
+        while (ts > last && !last_.compare_exchange_weak(last, ts, std::memory_order_relaxed)) {
+        }
+    }
+
+    // The largest timestamp issued or observed so far.
+    int64_t Last() const { return last_.load(std::memory_order_relaxed); }
+
+private:
+    uint32_t writer_;
+    std::atomic<int64_t> last_;
+
+    // Smallest timestamp of ours above `floor`: the wall clock if it has moved
+    // past floor's millisecond, otherwise floor's millisecond with the next
+    // logical count (spilling into the next millisecond when it runs out).
+    int64_t Successor(int64_t floor) const {
+        int64_t physical = hlc::WallPhysical();
+        int64_t floor_physical = hlc::Physical(floor);
+        if (physical > floor_physical) {
+            return hlc::Pack(physical, 0, writer_);
+        }
+        uint64_t logical = hlc::Logical(floor);
+        if (hlc::Writer(floor) >= writer_) {
+            logical++;          // Same (physical, logical) with our id would not be larger
+        }
+        if (logical > hlc::kLogicalMask) {
+            return hlc::Pack(floor_physical + 1, 0, writer_);
+        }
+        return hlc::Pack(floor_physical, logical, writer_);
+    }
+};
+
+} // namespace kvstore
@@ -0,0 +1,165 @@
+// Asynchronous logger implementation.
+// The ring buffer is a bounded multi-producer queue: each cell carries a
+// sequence number, producers claim a position with a CAS on enqueue_pos_ and
+// publish the cell by bumping its sequence; the single writer thread consumes
+// cells in order.
+
+#include "logging.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "utils.h"
+
+namespace kvstore {
+
+namespace {
+
+const char* LevelTag(LogLevel level) {
+    switch (level) {
+        case LogLevel::DEBUG: return "[DEBUG] ";
+        case LogLevel::INFO:  return "[INFO] ";
+        case LogLevel::WARN:  return "[WARN] ";
+        case LogLevel::ERROR: return "[ERROR] ";
+        default:              return "";
+    }
+}
+
+} // namespace
+
+bool ParseLogLevel(const std::string& name, LogLevel& level) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (lower == "debug") {
+        level = LogLevel::DEBUG;
+    } else if (lower == "info") {
+        level = LogLevel::INFO;
+    } else if (lower == "warn" || lower == "warning") {
+        level = LogLevel::WARN;
+    } else if (lower == "error") {
+        level = LogLevel::ERROR;
+    } else if (lower == "off" || lower == "none") {
+        level = LogLevel::OFF;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Logger& Logger::Instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : cells_(new Cell[CAPACITY]),
+      mask_(CAPACITY - 1),
+      level_(static_cast<int>(LogLevel::INFO)) {
+    for (size_t i = 0; i < CAPACITY; i++) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    const char* env = std::getenv("KVSTORE_LOG_LEVEL");
+    LogLevel level;
+    if (env != nullptr && ParseLogLevel(env, level)) {
+        SetLevel(level);
+    }
+    writer_ = std::thread(&Logger::WriterLoop, this);
+}
+
+Logger::~Logger() {
+    stop_.store(true);
+    wake_cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void Logger::Submit(LogLevel level, std::string message) {
+    uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells_[pos & mask_];
+        uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            // Cell is free for this position - try to claim it
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Buffer is full; drop rather than stall the caller
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->level = level;
+    cell->message = std::move(message);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    // Errors are rare and usually precede an exit; don't let them sit in the buffer
+    if (level >= LogLevel::ERROR) {
+        wake_cv_.notify_one();
+    }
+}
+
+size_t Logger::Drain() {
+    std::string batch;
+    size_t written = 0;
+    uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = cells_[pos & mask_];
+        uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (seq != pos + 1) {
+            break;  // Empty, or the producer hasn't finished writing this cell
+        }
+        batch += LevelTag(cell.level);
+        batch += cell.message;
+        batch += '\n';
+        cell.message.clear();
+        cell.sequence.store(pos + CAPACITY, std::memory_order_release);
+        pos++;
+        written++;
+    }
+    dequeue_pos_.store(pos, std::memory_order_release);
+    if (!batch.empty()) {
+        std::cerr.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        std::cerr.flush();
+    }
+    return written;
+}
+
+void Logger::WriterLoop() {
+    while (!stop_.load()) {
+        if (Drain() == 0) {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+    Drain();
+}
+
+void Logger::Flush() {
+    uint64_t target = enqueue_pos_.load(std::memory_order_acquire);
+    wake_cv_.notify_one();
+    while (dequeue_pos_.load(std::memory_order_acquire) < target && !stop_.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool LogRateLimiter::Allow(uint64_t& suppressed) {
+    int64_t now = GetCurrentTimestamp();
+    int64_t next = next_allowed_ms_.load(std::memory_order_relaxed);
+    if (now < next ||
+        !next_allowed_ms_.compare_exchange_strong(next, now + interval_ms_, std::memory_order_relaxed)) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace kvstore
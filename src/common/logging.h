@@ -0,0 +1,166 @@
+// Leveled, asynchronous logging.
+// Log statements format their message only if the level is enabled and then
+// push it into a lock-free ring buffer; a background thread does the actual
+// write to stderr. DEBUG statements compile to nothing unless the build
+// defines KVSTORE_ENABLE_DEBUG_LOG (make DEBUG_LOG=1), so per-request tracing
+// costs nothing in normal builds.
+//
+// Usage:
+//   LOG_INFO("Server " << id << " started");
+//   LOG_WARN_EVERY(1000, "Only got " << n << " responses");  // at most once per second
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace kvstore {
+
+enum class LogLevel {
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3,
+    OFF = 4
+};
+
+// Parse a level name ("debug", "info", "warn", "error", "off"; any case).
+// @param name Level name
+// @param level Output parameter for the parsed level
+// @return true if the name was recognised
+bool ParseLogLevel(const std::string& name, LogLevel& level);
+
+// Process-wide logger. The level starts at INFO, or at the value of the
+// KVSTORE_LOG_LEVEL environment variable if set.
+class Logger {
+public:
+    static Logger& Instance();
+
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void SetLevel(LogLevel level) { level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+    LogLevel GetLevel() const { return static_cast<LogLevel>(level_.load(std::memory_order_relaxed)); }
+
+    // Whether messages at this level are currently written.
+    bool Enabled(LogLevel level) const {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    // Queue a formatted message for the background writer. Never blocks; if
+    // the ring buffer is full the message is dropped and counted.
+    // @param level Message level
+    // @param message Formatted message text (moved into the buffer)
+    void Submit(LogLevel level, std::string message);
+
+    // Block until every message queued so far has been written.
+    void Flush();
+
+    // Number of messages dropped because the ring buffer was full.
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    Logger();
+
+    // One ring buffer cell. `sequence` tells producers and the consumer
+    // whose turn it is (bounded MPMC queue, used here with one consumer).
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        LogLevel level;
+        std::string message;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    uint64_t mask_;
+    alignas(64) std::atomic<uint64_t> enqueue_pos_{0};
+    alignas(64) std::atomic<uint64_t> dequeue_pos_{0};   // Only advanced by the writer thread
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<int> level_;
+
+    std::atomic<bool> stop_{false};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::thread writer_;
+
+    // Writer thread: drain the buffer, then sleep briefly.
+    void WriterLoop();
+
+    // Write out everything currently queued.
+    // @return Number of messages written
+    size_t Drain();
+
+    static constexpr size_t CAPACITY = 8192;             // Ring buffer cells (power of two)
+};
+
+// Per-call-site limiter used by the *_EVERY macros.
+class LogRateLimiter {
+public:
+    // @param interval_ms Minimum time between two messages from this site
+    explicit LogRateLimiter(int64_t interval_ms) : interval_ms_(interval_ms) {}
+
+    // Whether a message may be written now. Exactly one caller wins per interval.
+    // @param suppressed Output parameter: messages skipped since the last one written
+    bool Allow(uint64_t& suppressed);
+
+private:
+    int64_t interval_ms_;
+    std::atomic<int64_t> next_allowed_ms_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+} // namespace kvstore
+
+#define KV_LOG_AT(level, expr)                                                  \
+    do {                                                                        \
+        ::kvstore::Logger& kv_logger_ = ::kvstore::Logger::Instance();          \
+        if (kv_logger_.Enabled(level)) {                                        \
+            std::ostringstream kv_log_stream_;                                  \
+            kv_log_stream_ << expr;                                             \
+            kv_logger_.Submit(level, kv_log_stream_.str());                     \
+        }                                                                       \
+    } while (0)
+
+#define KV_LOG_EVERY(level, interval_ms, expr)                                  \
+    do {                                                                        \
+        if (::kvstore::Logger::Instance().Enabled(level)) {                     \
+            static ::kvstore::LogRateLimiter kv_log_limiter_(interval_ms);      \
+            uint64_t kv_log_suppressed_ = 0;                                    \
+            if (kv_log_limiter_.Allow(kv_log_suppressed_)) {                    \
+                if (kv_log_suppressed_ > 0) {                                   \
+                    KV_LOG_AT(level, expr << " (" << kv_log_suppressed_         \
+                                          << " similar messages suppressed)");  \
+                } else {                                                        \
+                    KV_LOG_AT(level, expr);                                     \
+                }                                                               \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+#ifdef KVSTORE_ENABLE_DEBUG_LOG
+#define LOG_DEBUG(expr) KV_LOG_AT(::kvstore::LogLevel::DEBUG, expr)
+#else
+// Never executed; keeps variables that are only logged "used" so the
+// compiler doesn't warn, and is removed entirely by the optimizer.
+#define LOG_DEBUG(expr)                                                         \
+    do {                                                                        \
+        if (false) {                                                            \
+            std::ostringstream kv_log_stream_;                                  \
+            kv_log_stream_ << expr;                                             \
+        }                                                                       \
+    } while (0)
+#endif
+
+#define LOG_INFO(expr) KV_LOG_AT(::kvstore::LogLevel::INFO, expr)
+#define LOG_WARN(expr) KV_LOG_AT(::kvstore::LogLevel::WARN, expr)
+#define LOG_ERROR(expr) KV_LOG_AT(::kvstore::LogLevel::ERROR, expr)
+
+#define LOG_WARN_EVERY(interval_ms, expr) KV_LOG_EVERY(::kvstore::LogLevel::WARN, interval_ms, expr)
+#define LOG_ERROR_EVERY(interval_ms, expr) KV_LOG_EVERY(::kvstore::LogLevel::ERROR, interval_ms, expr)
@@ -0,0 +1,34 @@
+// Read-only memory mapping of a whole file.
+// Used to load snapshots and replay log segments without copying them
+// through a read() buffer first.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace kvstore {
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file for sequential reading. An empty file maps to empty data.
+    // @param path File to map
+    // @return false if the file could not be opened or mapped
+    bool Open(const std::string& path);
+
+    // Contents of the mapped file (empty before Open).
+    std::string_view Data() const { return std::string_view(data_, size_); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace kvstore
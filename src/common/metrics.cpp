@@ -0,0 +1,114 @@
+// Server metrics implementation.
+
+#include "metrics.h"
+#include <cstdio>
+#include <utility>
+
+namespace kvstore {
+
+uint64_t Counter::Value() const {
+    uint64_t total = 0;
+    for (const auto& cell : cells_) {
+        total += cell.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+LogHistogram::Snapshot LogHistogram::Read() const {
+    Snapshot snapshot;
+    for (const auto& stripe : stripes_) {
+        for (size_t b = 0; b < kBuckets; b++) {
+            uint64_t n = stripe.buckets[b].load(std::memory_order_relaxed);
+            snapshot.buckets[b] += n;
+            snapshot.count += n;
+        }
+        snapshot.sum += stripe.sum.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+RpcMetrics::RpcMetrics(std::vector<std::string> methods)
+    : methods_(std::move(methods)), metrics_(new RpcMetric[methods_.size()]) {
+}
+
+void RpcMetrics::Export(PrometheusText& out) const {
+    for (size_t m = 0; m < methods_.size(); m++) {
+        std::string labels = "method=\"" + methods_[m] + "\"";
+        // Started is read after the histogram, so a call can't look finished before it started
+        LogHistogram::Snapshot latency = metrics_[m].latency_ns.Read();
+        uint64_t started = metrics_[m].started.Value();
+        out.AddCounter("kvstore_rpc_started_total", "RPCs received", labels, started);
+        out.AddGauge("kvstore_rpc_in_flight", "RPCs started but not yet answered", labels,
+                     started > latency.count ? static_cast<double>(started - latency.count) : 0.0);
+        out.AddHistogram("kvstore_rpc_duration_seconds", "Time from receiving an RPC to answering it",
+                         labels, latency, 1e-9);
+    }
+}
+
+namespace {
+
+std::string FormatNumber(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+    return buf;
+}
+
+// `name{labels}`, or just `name` with no labels
+std::string Series(const std::string& name, const std::string& labels) {
+    return labels.empty() ? name : name + "{" + labels + "}";
+}
+
+} // namespace
+
+PrometheusText::Family& PrometheusText::FamilyFor(const std::string& name, const std::string& help,
+                                                  const char* type) {
+    for (auto& family : families_) {
+        if (family.name == name) {
+            return family;
+        }
+    }
+    families_.push_back({name, help, type, ""});
+    return families_.back();
+}
+
+void PrometheusText::AddCounter(const std::string& name, const std::string& help,
+                                const std::string& labels, uint64_t value) {
+    FamilyFor(name, help, "counter").samples += Series(name, labels) + " " + std::to_string(value) + "\n";
+}
+
+void PrometheusText::AddGauge(const std::string& name, const std::string& help,
+                              const std::string& labels, double value) {
+    FamilyFor(name, help, "gauge").samples += Series(name, labels) + " " + FormatNumber(value) + "\n";
+}
+
+void PrometheusText::AddHistogram(const std::string& name, const std::string& help,
+                                  const std::string& labels, const LogHistogram::Snapshot& snapshot,
+                                  double unit_seconds) {
+    std::string& samples = FamilyFor(name, help, "histogram").samples;
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    // Buckets are cumulative; the last one is open-ended, so it is only +Inf.
+    // Every series gets every bound so they can be summed over labels.
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b + 1 < LogHistogram::kBuckets; b++) {
+        cumulative += snapshot.buckets[b];
+        double le = static_cast<double>(LogHistogram::BucketUpperBound(b)) * unit_seconds;
+        samples += name + "_bucket{" + prefix + "le=\"" + FormatNumber(le) + "\"} " +
+                   std::to_string(cumulative) + "\n";
+    }
+    samples += name + "_bucket{" + prefix + "le=\"+Inf\"} " + std::to_string(snapshot.count) + "\n";
+    samples += Series(name + "_sum", labels) + " " +
+               FormatNumber(static_cast<double>(snapshot.sum) * unit_seconds) + "\n";
+    samples += Series(name + "_count", labels) + " " + std::to_string(snapshot.count) + "\n";
+}
+
+std::string PrometheusText::Render() const {
+    std::string text;
+    for (const auto& family : families_) {
+        text += "# HELP " + family.name + " " + family.help + "\n";
+        text += "# TYPE " + family.name + " " + family.type + "\n";
+        text += family.samples;
+    }
+    return text;
+}
+
+} // namespace kvstore
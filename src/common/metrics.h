@@ -0,0 +1,167 @@
+// Server metrics cheap enough to stay on under full load.
+// Counters and histograms are striped: each thread adds into one of
+// kMetricStripes cache-line-aligned cells (picked once per thread), so a
+// recording is a relaxed fetch_add on a line no other core is usually writing,
+// and nothing takes a lock. Reading sums the stripes, which is only done when
+// the metrics are scraped.
+// PrometheusText renders a scrape in the Prometheus text exposition format.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kvstore {
+
+constexpr size_t kMetricStripes = 16;
+
+namespace internal {
+inline std::atomic<size_t> next_metric_stripe{0};
+
+// Stripe of the calling thread (threads are dealt stripes round-robin).
+inline size_t MetricStripe() {
+    thread_local size_t stripe =
+        next_metric_stripe.fetch_add(1, std::memory_order_relaxed) % kMetricStripes;
+    return stripe;
+}
+} // namespace internal
+
+// A monotonically increasing count.
+class Counter {
+public:
+    void Add(uint64_t n = 1) {
+        cells_[internal::MetricStripe()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const;
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Cell, kMetricStripes> cells_;
+};
+
+// Histogram with one bucket per power of two: bucket 0 holds 0, bucket b
+// holds [2^(b-1), 2^b). Values past the last bucket land in it. Units are the
+// caller's (the servers record nanoseconds).
+class LogHistogram {
+public:
+    static constexpr size_t kBuckets = 40;      // 2^39 ns is about 9 minutes
+
+    struct Snapshot {
+        std::array<uint64_t, kBuckets> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+    };
+
+    void Record(uint64_t value) {
+        size_t bucket = value == 0 ? 0 : static_cast<size_t>(64 - __builtin_clzll(value));
+        Stripe& stripe = stripes_[internal::MetricStripe()];
+        stripe.buckets[bucket < kBuckets ? bucket : kBuckets - 1].fetch_add(1, std::memory_order_relaxed);
+        stripe.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Sum of every stripe (not atomic as a whole: a recording in flight may
+    // show in the buckets but not yet in the sum).
+    Snapshot Read() const;
+
+    // Largest value bucket b holds (its Prometheus "le" bound).
+    static uint64_t BucketUpperBound(size_t bucket) {
+        return bucket == 0 ? 0 : (1ull << bucket) - 1;
+    }
+
+private:
+    struct alignas(64) Stripe {
+        std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+        std::atomic<uint64_t> sum{0};
+    };
+    std::array<Stripe, kMetricStripes> stripes_;
+};
+
+// Calls and latency of one RPC method.
+struct RpcMetric {
+    using Clock = std::chrono::steady_clock;
+
+    Counter started;
+    LogHistogram latency_ns;                // One entry per finished call
+
+    Clock::time_point Begin() {
+        started.Add();
+        return Clock::now();
+    }
+
+    void End(Clock::time_point start) {
+        latency_ns.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+    }
+};
+
+// Times the enclosing scope as one call of an RPC method.
+class ScopedRpcTimer {
+public:
+    explicit ScopedRpcTimer(RpcMetric& metric) : metric_(metric), start_(metric.Begin()) {}
+    ~ScopedRpcTimer() { metric_.End(start_); }
+
+    ScopedRpcTimer(const ScopedRpcTimer&) = delete;
+    ScopedRpcTimer& operator=(const ScopedRpcTimer&) = delete;
+
+private:
+    RpcMetric& metric_;
+    RpcMetric::Clock::time_point start_;
+};
+
+class PrometheusText;
+
+// The RpcMetric of every method of a service, indexed by the server's own
+// method enum.
+class RpcMetrics {
+public:
+    // @param methods Method names, in the order of the server's enum
+    explicit RpcMetrics(std::vector<std::string> methods);
+
+    RpcMetric& operator[](size_t method) { return metrics_[method]; }
+
+    // Add started / in-flight / latency series for every method.
+    void Export(PrometheusText& out) const;
+
+private:
+    std::vector<std::string> methods_;
+    std::unique_ptr<RpcMetric[]> metrics_;
+};
+
+// One scrape in the Prometheus text format. Series may be added in any order;
+// each metric family is written once, with its HELP and TYPE lines.
+class PrometheusText {
+public:
+    // @param labels Label list without braces (`method="Read"`), or empty
+    void AddCounter(const std::string& name, const std::string& help, const std::string& labels,
+                    uint64_t value);
+    void AddGauge(const std::string& name, const std::string& help, const std::string& labels,
+                  double value);
+
+    // A histogram recorded in units of `unit_seconds` seconds, reported in seconds.
+    void AddHistogram(const std::string& name, const std::string& help, const std::string& labels,
+                      const LogHistogram::Snapshot& snapshot, double unit_seconds);
+
+    std::string Render() const;
+
+private:
+    struct Family {
+        std::string name;
+        std::string help;
+        const char* type;
+        std::string samples;
+    };
+    std::vector<Family> families_;
+
+    Family& FamilyFor(const std::string& name, const std::string& help, const char* type);
+};
+
+} // namespace kvstore
@@ -0,0 +1,88 @@
+// Optional per-phase timing of client operations.
+// A benchmark thread installs a PhaseTrace with SetThreadPhaseTrace(); the
+// clients then time each protocol phase of the operations that thread runs
+// into it. With no trace installed a ScopedPhase costs one thread-local load.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace kvstore {
+
+enum class Phase {
+    ABD_PROBE,          // ABD cached read: check the cached timestamp with a read quorum
+    ABD_QUERY,          // ABD read phase 1: collect values from a read quorum
+    ABD_WRITE_BACK,     // ABD read phase 2: write the max value back (may be skipped)
+    ABD_WRITE,          // ABD write: store at a write quorum
+    LOCK,               // Blocking: acquire the quorum's locks (reads get the value with them)
+    WRITE,              // Blocking: write to the locked servers, releasing their locks
+    UNLOCK,             // Blocking: release the locks (reads, or locks a write left behind)
+    COUNT
+};
+
+constexpr size_t kNumPhases = static_cast<size_t>(Phase::COUNT);
+
+// Display name of a phase ("abd_query", "lock", ...).
+inline const char* PhaseName(Phase phase) {
+    switch (phase) {
+        case Phase::ABD_PROBE: return "abd_probe";
+        case Phase::ABD_QUERY: return "abd_query";
+        case Phase::ABD_WRITE_BACK: return "abd_write_back";
+        case Phase::ABD_WRITE: return "abd_write";
+        case Phase::LOCK: return "lock";
+        case Phase::WRITE: return "write";
+        case Phase::UNLOCK: return "unlock";
+        case Phase::COUNT: break;
+    }
+    return "unknown";
+}
+
+// Time spent in each phase by the last operation(s) since Reset().
+// A phase an operation didn't go through stays at -1.
+struct PhaseTrace {
+    std::array<int64_t, kNumPhases> us;
+
+    PhaseTrace() { Reset(); }
+    void Reset() { us.fill(-1); }
+};
+
+namespace internal {
+inline thread_local PhaseTrace* current_phase_trace = nullptr;
+} // namespace internal
+
+// Set (or with nullptr, clear) the trace phases on this thread are timed into.
+inline void SetThreadPhaseTrace(PhaseTrace* trace) {
+    internal::current_phase_trace = trace;
+}
+
+// Times the enclosing scope as one phase of the current operation.
+class ScopedPhase {
+public:
+    explicit ScopedPhase(Phase phase) : trace_(internal::current_phase_trace), phase_(phase) {
+        if (trace_ != nullptr) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedPhase() {
+        if (trace_ != nullptr) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start_).count();
+            int64_t& slot = trace_->us[static_cast<size_t>(phase_)];
+            slot = slot < 0 ? elapsed : slot + elapsed;
+        }
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    PhaseTrace* trace_;
+    Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace kvstore
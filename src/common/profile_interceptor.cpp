@@ -0,0 +1,132 @@
+// Profiling interceptor implementation.
+
+#include "profile_interceptor.h"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <google/protobuf/message_lite.h>
+#include <grpcpp/support/client_interceptor.h>
+#include <grpcpp/support/server_interceptor.h>
+#include "profiler.h"
+
+namespace kvstore {
+namespace profile {
+
+namespace {
+
+using grpc::experimental::InterceptionHookPoints;
+using grpc::experimental::InterceptorBatchMethods;
+
+bool IsKvstoreMethod(const char* method) {
+    return method != nullptr && std::strncmp(method, "/kvstore.", 9) == 0;
+}
+
+// Time a parse of the received message's bytes into a fresh message.
+void TimeDeserialize(InterceptorBatchMethods* methods) {
+    const auto* message = static_cast<const google::protobuf::MessageLite*>(methods->GetRecvMessage());
+    if (message == nullptr) {
+        return;
+    }
+    PauseAllocationCounting pause;
+    std::string bytes = message->SerializeAsString();
+    std::unique_ptr<google::protobuf::MessageLite> copy(message->New());
+    uint64_t start = Cycles();
+    copy->ParseFromString(bytes);
+    Record(DESERIALIZE, Cycles() - start);
+}
+
+// Serialize the outgoing message now, timing it.
+void TimeSerialize(InterceptorBatchMethods* methods) {
+    uint64_t start = Cycles();
+    methods->GetSerializedSendMessage();
+    Record(SERIALIZE, Cycles() - start);
+}
+
+class ServerProfileInterceptor : public grpc::experimental::Interceptor {
+public:
+    void Intercept(InterceptorBatchMethods* methods) override {
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::POST_RECV_MESSAGE)) {
+            TimeDeserialize(methods);
+            thread_ = std::this_thread::get_id();
+            allocations_ = ThreadAllocations();
+            handler_start_ = Cycles();
+        }
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_MESSAGE) &&
+            handler_start_ != 0) {
+            Record(HANDLER, Cycles() - handler_start_);
+            TimeSerialize(methods);
+            // A handler that finished on another thread can't be charged its allocations
+            if (std::this_thread::get_id() == thread_) {
+                RecordRequest(allocations_);
+            } else {
+                RecordRequest(ThreadAllocations());
+            }
+            handler_start_ = 0;
+        }
+        methods->Proceed();
+    }
+
+private:
+    std::thread::id thread_;
+    AllocationMark allocations_;
+    uint64_t handler_start_ = 0;
+};
+
+class ServerProfileFactory : public grpc::experimental::ServerInterceptorFactoryInterface {
+public:
+    grpc::experimental::Interceptor* CreateServerInterceptor(grpc::experimental::ServerRpcInfo* info) override {
+        if (info->type() != grpc::experimental::ServerRpcInfo::Type::UNARY || !IsKvstoreMethod(info->method())) {
+            return nullptr;
+        }
+        PauseAllocationCounting pause;
+        return new ServerProfileInterceptor();
+    }
+};
+
+class ClientProfileInterceptor : public grpc::experimental::Interceptor {
+public:
+    void Intercept(InterceptorBatchMethods* methods) override {
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_MESSAGE)) {
+            TimeSerialize(methods);
+            sent_ = Cycles();
+        }
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::POST_RECV_MESSAGE) && sent_ != 0) {
+            Record(ROUND_TRIP, Cycles() - sent_);
+            TimeDeserialize(methods);
+        }
+        methods->Proceed();
+    }
+
+private:
+    uint64_t sent_ = 0;
+};
+
+class ClientProfileFactory : public grpc::experimental::ClientInterceptorFactoryInterface {
+public:
+    grpc::experimental::Interceptor* CreateClientInterceptor(grpc::experimental::ClientRpcInfo* info) override {
+        if (info->type() != grpc::experimental::ClientRpcInfo::Type::UNARY || !IsKvstoreMethod(info->method())) {
+            return nullptr;
+        }
+        PauseAllocationCounting pause;
+        return new ClientProfileInterceptor();
+    }
+};
+
+} // namespace
+
+void AddServerProfiling(grpc::ServerBuilder& builder) {
+    std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> creators;
+    creators.push_back(std::make_unique<ServerProfileFactory>());
+    builder.experimental().SetInterceptorCreators(std::move(creators));
+}
+
+void RegisterClientProfiling() {
+    // gRPC keeps using the factory for the rest of the process
+    static ClientProfileFactory factory;
+    grpc::experimental::RegisterGlobalClientInterceptorFactory(&factory);
+}
+
+} // namespace profile
+} // namespace kvstore
@@ -0,0 +1,26 @@
+// gRPC interceptors that feed the profiler (profiler.h) with the per-request
+// stages gRPC itself runs: parsing, the handler (or, on a client, the round
+// trip) and serialization. Only unary calls of the kvstore services are
+// timed.
+//
+// gRPC parses a request before any interceptor sees it, so the deserialize
+// stage times a parse of the same bytes into a fresh message. Serialization is
+// timed exactly: the interceptor asks for the serialized message, which makes
+// gRPC serialize it right there instead of later.
+
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+namespace kvstore {
+namespace profile {
+
+// Time every unary kvstore call a server handles. Call before BuildAndStart.
+void AddServerProfiling(grpc::ServerBuilder& builder);
+
+// Time every unary kvstore call this process makes, on every channel. Call
+// once, before the first channel is created.
+void RegisterClientProfiling();
+
+} // namespace profile
+} // namespace kvstore
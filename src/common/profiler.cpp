@@ -0,0 +1,212 @@
+// Profiling implementation.
+
+#include "profiler.h"
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <utility>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef KVSTORE_GPERFTOOLS
+#include <gperftools/profiler.h>
+#endif
+
+namespace kvstore {
+namespace profile {
+
+namespace internal {
+std::atomic<bool> enabled{false};
+bool alloc_hook_linked = false;
+std::array<LogHistogram, STAGE_COUNT> stage_cycles;
+Counter process_allocations;
+Counter process_allocated_bytes;
+thread_local uint64_t thread_allocations = 0;
+thread_local uint64_t thread_allocated_bytes = 0;
+thread_local bool thread_paused = false;
+} // namespace internal
+
+namespace {
+
+double cycles_per_ns = 1.0;
+Counter requests;
+Counter request_allocations;
+Counter request_allocated_bytes;
+
+// A value with 2^(b-1) <= v < 2^b is reported as the bucket's upper bound,
+// so percentiles are within a factor of two.
+uint64_t Percentile(const LogHistogram::Snapshot& h, double p) {
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(h.count));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < LogHistogram::kBuckets; b++) {
+        seen += h.buckets[b];
+        if (seen > rank) {
+            return LogHistogram::BucketUpperBound(b);
+        }
+    }
+    return LogHistogram::BucketUpperBound(LogHistogram::kBuckets - 1);
+}
+
+LogHistogram::Snapshot Difference(const LogHistogram::Snapshot& a, const LogHistogram::Snapshot& b) {
+    LogHistogram::Snapshot d;
+    for (size_t i = 0; i < LogHistogram::kBuckets; i++) {
+        d.buckets[i] = b.buckets[i] - a.buckets[i];
+    }
+    d.count = b.count - a.count;
+    d.sum = b.sum - a.sum;
+    return d;
+}
+
+sigset_t SignalSet(bool stop_signals) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR2);
+    if (stop_signals) {
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+    }
+    return set;
+}
+
+} // namespace
+
+const char* StageName(Stage stage) {
+    switch (stage) {
+        case DESERIALIZE: return "deserialize";
+        case HANDLER: return "handler";
+        case LOCK_WAIT: return "lock wait";
+        case STORE_OP: return "store op";
+        case SERIALIZE: return "serialize";
+        case ROUND_TRIP: return "round trip";
+        default: return "unknown";
+    }
+}
+
+void Enable() {
+#if defined(__x86_64__) || defined(__i386__)
+    auto start = std::chrono::steady_clock::now();
+    uint64_t start_cycles = Cycles();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t cycles = Cycles() - start_cycles;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    cycles_per_ns = static_cast<double>(cycles) / static_cast<double>(ns.count());
+#endif
+    internal::enabled.store(true, std::memory_order_relaxed);
+}
+
+void RecordRequest(const AllocationMark& start) {
+    AllocationMark now = ThreadAllocations();
+    requests.Add();
+    request_allocations.Add(now.count - start.count);
+    request_allocated_bytes.Add(now.bytes - start.bytes);
+}
+
+Totals Capture() {
+    Totals totals;
+    totals.at = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < STAGE_COUNT; s++) {
+        totals.stages[s] = internal::stage_cycles[s].Read();
+    }
+    totals.requests = requests.Value();
+    totals.request_allocations = request_allocations.Value();
+    totals.request_allocated_bytes = request_allocated_bytes.Value();
+    totals.process_allocations = internal::process_allocations.Value();
+    totals.process_allocated_bytes = internal::process_allocated_bytes.Value();
+    return totals;
+}
+
+void PrintReport(const std::string& title, const Totals& since, const Totals& until, std::ostream& out) {
+    uint64_t requests = until.requests - since.requests;
+    double per_request = requests > 0 ? 1.0 / static_cast<double>(requests) : 0.0;
+    double seconds = std::chrono::duration<double>(until.at - since.at).count();
+    auto ns = [](double cycles) { return cycles / cycles_per_ns; };
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%s: %llu requests in %.1f s", title.c_str(),
+                  static_cast<unsigned long long>(requests), seconds);
+    out << line << std::endl;
+    out << "  stage             calls  calls/req   mean ns    p50 ns    p99 ns    ns/req" << std::endl;
+    for (size_t s = 0; s < STAGE_COUNT; s++) {
+        LogHistogram::Snapshot h = Difference(since.stages[s], until.stages[s]);
+        if (h.count == 0) {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "  %-13s %9llu %10.2f %9.0f %9.0f %9.0f %9.0f",
+                      StageName(static_cast<Stage>(s)), static_cast<unsigned long long>(h.count),
+                      static_cast<double>(h.count) * per_request,
+                      ns(static_cast<double>(h.sum) / static_cast<double>(h.count)),
+                      ns(static_cast<double>(Percentile(h, 0.5))), ns(static_cast<double>(Percentile(h, 0.99))),
+                      ns(static_cast<double>(h.sum)) * per_request);
+        out << line << std::endl;
+    }
+    if (!internal::alloc_hook_linked) {
+        out << "  allocations: not counted (no allocation hook in this binary)" << std::endl;
+    } else {
+        std::snprintf(line, sizeof(line), "  allocations/req: %.1f (%.0f bytes) on the request's thread, "
+                      "%.1f (%.0f bytes) process-wide",
+                      static_cast<double>(until.request_allocations - since.request_allocations) * per_request,
+                      static_cast<double>(until.request_allocated_bytes - since.request_allocated_bytes) * per_request,
+                      static_cast<double>(until.process_allocations - since.process_allocations) * per_request,
+                      static_cast<double>(until.process_allocated_bytes - since.process_allocated_bytes) * per_request);
+        out << line << std::endl;
+    }
+    out << "  (percentiles are power-of-two bucket bounds; deserialize is timed by re-parsing the message, "
+           "since gRPC parses it before any hook runs)" << std::endl;
+}
+
+void BlockSignals(bool stop_signals) {
+    sigset_t set = SignalSet(stop_signals);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+SignalWindows::SignalWindows(std::function<void()> on_stop) : on_stop_(std::move(on_stop)) {
+    thread_ = std::thread(&SignalWindows::Run, this);
+}
+
+SignalWindows::~SignalWindows() {
+    stop_.store(true);
+    pthread_kill(thread_.native_handle(), SIGUSR2);
+    thread_.join();
+}
+
+void SignalWindows::Run() {
+    sigset_t set = SignalSet(on_stop_ != nullptr);
+    bool open = false;
+    int windows = 0;
+    Totals start;
+    while (true) {
+        int received = 0;
+        if (sigwait(&set, &received) != 0 || stop_.load()) {
+            break;
+        }
+        if (received != SIGUSR2) {
+            on_stop_();
+            break;
+        }
+        if (!open) {
+            start = Capture();
+            windows++;
+#ifdef KVSTORE_GPERFTOOLS
+            std::string path = "kvstore-" + std::to_string(getpid()) + "-" + std::to_string(windows) + ".prof";
+            ProfilerStart(path.c_str());
+            std::cerr << "Profile window " << windows << " opened (CPU profile: " << path << ")" << std::endl;
+#else
+            std::cerr << "Profile window " << windows << " opened" << std::endl;
+#endif
+        } else {
+#ifdef KVSTORE_GPERFTOOLS
+            ProfilerStop();
+#endif
+            PrintReport("Profile window " + std::to_string(windows), start, Capture(), std::cerr);
+        }
+        open = !open;
+    }
+#ifdef KVSTORE_GPERFTOOLS
+    if (open) {
+        ProfilerStop();
+    }
+#endif
+}
+
+} // namespace profile
+} // namespace kvstore
@@ -0,0 +1,182 @@
+// Hot-path profiling for --profile (abd_server, blocking_server and
+// evaluate_performance).
+// A request is split into stages, each timed with the CPU's timestamp counter
+// (rdtsc, calibrated against steady_clock when profiling is enabled) and
+// recorded into a striped histogram (metrics.h), so timing costs a few
+// nanoseconds and takes no lock. The gRPC interceptors in
+// profile_interceptor.h time deserialization, the handler and serialization
+// (a client times the round trip instead of the handler); the store times its
+// shard lock waits and the work done under the lock.
+//
+// Allocations are counted by replacing the global operator new
+// (alloc_hook.cpp, linked only into the profiling binaries): per request on
+// the thread that handles it, and process-wide.
+//
+// When profiling is off every hook is one relaxed load of a flag.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include "metrics.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace kvstore {
+namespace profile {
+
+enum Stage {
+    DESERIALIZE,        // Parsing the request (client: the response)
+    HANDLER,            // From the parsed request to the response being handed back
+    LOCK_WAIT,          // Taking a shard lock
+    STORE_OP,           // Work done under a shard lock
+    SERIALIZE,          // Serializing the response (client: the request)
+    ROUND_TRIP,         // Client only: request sent to response received
+    STAGE_COUNT
+};
+
+const char* StageName(Stage stage);
+
+namespace internal {
+extern std::atomic<bool> enabled;
+extern bool alloc_hook_linked;              // Set by alloc_hook.cpp
+extern std::array<LogHistogram, STAGE_COUNT> stage_cycles;
+extern Counter process_allocations;
+extern Counter process_allocated_bytes;
+extern thread_local uint64_t thread_allocations;
+extern thread_local uint64_t thread_allocated_bytes;
+extern thread_local bool thread_paused;
+
+// Called by the allocation hook for every operator new.
+inline void CountAllocation(size_t size) {
+    if (enabled.load(std::memory_order_relaxed) && !thread_paused) {
+        thread_allocations++;
+        thread_allocated_bytes += size;
+        process_allocations.Add();
+        process_allocated_bytes.Add(size);
+    }
+}
+} // namespace internal
+
+inline bool Enabled() {
+    return internal::enabled.load(std::memory_order_relaxed);
+}
+
+// Timestamp counter (steady_clock nanoseconds where there is no rdtsc).
+inline uint64_t Cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Calibrate the counter and start recording. Call once, before the threads
+// that make requests are started.
+void Enable();
+
+inline void Record(Stage stage, uint64_t cycles) {
+    internal::stage_cycles[stage].Record(cycles);
+}
+
+// Times the enclosing scope as one pass through a stage.
+class ScopedStage {
+public:
+    explicit ScopedStage(Stage stage) : stage_(stage), start_(Enabled() ? Cycles() : 0) {}
+    ~ScopedStage() {
+        if (start_ != 0) {
+            Record(stage_, Cycles() - start_);
+        }
+    }
+
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+
+private:
+    Stage stage_;
+    uint64_t start_;
+};
+
+// Allocations made by the calling thread so far.
+struct AllocationMark {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+inline AllocationMark ThreadAllocations() {
+    return {internal::thread_allocations, internal::thread_allocated_bytes};
+}
+
+// Keeps the profiler's own allocations on this thread out of the counts.
+class PauseAllocationCounting {
+public:
+    PauseAllocationCounting() : was_paused_(internal::thread_paused) { internal::thread_paused = true; }
+    ~PauseAllocationCounting() { internal::thread_paused = was_paused_; }
+
+    PauseAllocationCounting(const PauseAllocationCounting&) = delete;
+    PauseAllocationCounting& operator=(const PauseAllocationCounting&) = delete;
+
+private:
+    bool was_paused_;
+};
+
+// Count one finished request, charging it the calling thread's allocations
+// since `start`.
+void RecordRequest(const AllocationMark& start);
+
+// Everything recorded up to a point, so a window can be reported as the
+// difference of two of these.
+struct Totals {
+    std::chrono::steady_clock::time_point at;
+    std::array<LogHistogram::Snapshot, STAGE_COUNT> stages;
+    uint64_t requests = 0;
+    uint64_t request_allocations = 0;
+    uint64_t request_allocated_bytes = 0;
+    uint64_t process_allocations = 0;
+    uint64_t process_allocated_bytes = 0;
+};
+
+Totals Capture();
+
+// Print the per-stage breakdown of what was recorded between two captures.
+// @param title First line of the table
+void PrintReport(const std::string& title, const Totals& since, const Totals& until, std::ostream& out);
+
+// Block SIGUSR2 (and with `stop_signals`, SIGINT and SIGTERM) in the calling
+// thread and every thread it starts afterwards, so only SignalWindows sees
+// them. Call before any other thread is started.
+void BlockSignals(bool stop_signals);
+
+// Sampling windows: each SIGUSR2 opens or closes a window, and closing one
+// prints the breakdown of just that window to stderr. Built with
+// `make GPERFTOOLS=1`, the gperftools CPU profiler runs for the length of each
+// window (kvstore-<pid>-<n>.prof). Delivered by sigwait on a thread of its own.
+class SignalWindows {
+public:
+    // @param on_stop Called once on SIGINT or SIGTERM (null: those are not handled)
+    explicit SignalWindows(std::function<void()> on_stop = nullptr);
+    ~SignalWindows();
+
+    SignalWindows(const SignalWindows&) = delete;
+    SignalWindows& operator=(const SignalWindows&) = delete;
+
+private:
+    std::function<void()> on_stop_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+
+    void Run();
+};
+
+} // namespace profile
+} // namespace kvstore
@@ -0,0 +1,39 @@
+// Paces a stream of bytes to a fixed rate.
+// Used by background transfers (range migration) so they take a bounded
+// share of the network and disk and foreground requests keep their latency.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+namespace kvstore {
+
+// Not thread-safe: one limiter paces one sender.
+class RateLimiter {
+public:
+    // @param bytes_per_second Rate cap (<= 0 disables pacing)
+    explicit RateLimiter(int64_t bytes_per_second)
+        : rate_(bytes_per_second), start_(std::chrono::steady_clock::now()) {}
+
+    // Account for `bytes` about to be sent, sleeping until sending them
+    // keeps the average since construction at or below the cap.
+    void Acquire(size_t bytes) {
+        if (rate_ <= 0) {
+            return;
+        }
+        sent_ += bytes;
+        auto due = start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(sent_) / static_cast<double>(rate_)));
+        std::this_thread::sleep_until(due);
+    }
+
+private:
+    int64_t rate_;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t sent_ = 0;
+};
+
+} // namespace kvstore
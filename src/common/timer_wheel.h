@@ -0,0 +1,97 @@
+// Hashed timing wheel for large numbers of coarse timers.
+// Time is cut into fixed ticks, and a timer lives in the slot of the tick it
+// expires on (ticks wrap around the wheel, so a slot can hold timers for
+// several laps). Scheduling is O(1), and advancing the wheel by one tick only
+// looks at one slot, so cost doesn't grow with the number of pending timers the
+// way a sorted map or a heap does. Timers can't be cancelled; holders check on
+// expiry whether the timer still matters. Not thread-safe.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace kvstore {
+
+template <typename T>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // @param tick Timer granularity; timers fire up to one tick late
+    // @param num_slots Wheel size (rounded up to a power of two); one lap of
+    //                  the wheel is num_slots * tick
+    TimerWheel(Clock::duration tick, size_t num_slots)
+        : tick_(tick), start_(Clock::now()) {
+        size_t slots = 1;
+        while (slots < num_slots) {
+            slots <<= 1;
+        }
+        slots_.resize(slots);
+        mask_ = slots - 1;
+    }
+
+    // Add a timer. A deadline that has already passed fires on the next Advance().
+    void Schedule(Clock::time_point deadline, T item) {
+        uint64_t tick = TickOf(deadline + tick_ - Clock::duration(1));     // Round up
+        tick = std::max(tick, current_tick_ + 1);
+        slots_[tick & mask_].push_back({tick, std::move(item)});
+        size_++;
+    }
+
+    // Move out every timer due at or before `now`.
+    // @param expired Receives the due items (appended)
+    void Advance(Clock::time_point now, std::vector<T>& expired) {
+        uint64_t target = TickOf(now);
+        if (target <= current_tick_) {
+            return;
+        }
+        // After a long gap, one visit per slot covers every lap
+        uint64_t steps = std::min<uint64_t>(target - current_tick_, slots_.size());
+        for (uint64_t step = 1; step <= steps; step++) {
+            auto& slot = slots_[(current_tick_ + step) & mask_];
+            auto keep = slot.begin();
+            for (auto it = slot.begin(); it != slot.end(); ++it) {
+                if (it->tick <= target) {
+                    expired.push_back(std::move(it->item));
+                    size_--;
+                } else {
+                    *keep++ = std::move(*it);       // Due on a later lap
+                }
+            }
+            slot.erase(keep, slot.end());
+        }
+        current_tick_ = target;
+    }
+
+    // When the next tick ends - the earliest time Advance() can expire anything.
+    Clock::time_point NextTick() const {
+        return start_ + tick_ * static_cast<Clock::rep>(current_tick_ + 1);
+    }
+
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+
+private:
+    struct Timer {
+        uint64_t tick;          // Absolute tick the timer expires on
+        T item;
+    };
+
+    Clock::duration tick_;
+    Clock::time_point start_;
+    std::vector<std::vector<Timer>> slots_;
+    size_t mask_ = 0;
+    uint64_t current_tick_ = 0;     // Every tick up to this one has been processed
+    size_t size_ = 0;
+
+    uint64_t TickOf(Clock::time_point t) const {
+        return t <= start_ ? 0 : static_cast<uint64_t>((t - start_) / tick_);
+    }
+};
+
+} // namespace kvstore
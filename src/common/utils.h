@@ -1,5 +1,5 @@
-// Provides helper functions for timestamps and address formatting.
-// Timestamps are used to ensure linearizability in both protocols.
+// Provides helper functions for wall-clock time and address formatting.
+// Key-value timestamps come from the hybrid logical clock in hlc.h.
 
 #pragma once
 
@@ -10,30 +10,13 @@
 namespace kvstore {
 
 // Get the current system time as milliseconds since epoch.
-// Used for generating timestamps for key-value operations.
+// Used for log lines and lock grant times.
 inline int64_t GetCurrentTimestamp() {
     auto now = std::chrono::system_clock::now();
     auto duration = now.time_since_epoch();
     return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
 }
 
-// Timestamp generator that ensures unique, monotonically increasing timestamps.
-// If multiple operations happen in the same millisecond, this adds a sequence
-// number to ensure uniqueness. This is needed for maintaining ordering
-class TimestampGenerator {
-public:
-    TimestampGenerator();
-    
-    // Generate a unique timestamp.
-    // Combines current time with a sequence number for uniqueness.
-    // @return Unique timestamp value
-    int64_t Generate();
-    
-private:
-    int64_t last_timestamp_;  // Last timestamp we generated
-    int32_t sequence_;        // Sequence number for same-millisecond events
-};
-
 // Parse a server address string in "host:port" format.
 // @param address Address string to parse
 // @param host Output parameter for hostname/IP
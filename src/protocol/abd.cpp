@@ -4,36 +4,60 @@
 
 #include "abd.h"
 #include <algorithm>
-#include <chrono>
+#include "../common/hash_ring.h"
 
 namespace kvstore {
 
-ABDProtocol::ABDProtocol() : last_timestamp_(0) {
+ABDProtocol::ABDProtocol(int32_t server_id) : clock_(hlc::ServerWriterId(server_id)) {
 }
 
 ABDProtocol::~ABDProtocol() {
 }
 
-ABDProtocol::ReadResult ABDProtocol::Read(const std::string& key, int64_t /* client_timestamp */) { // NOLINT(readability-named-parameter)
-    std::lock_guard<std::mutex> lock(mutex_);
-    
+void ABDProtocol::SetVersionRetention(const VersionRetention& retention) {
+    versions_ = retention;
+    versions_.max_versions = std::min(versions_.max_versions, VersionChain::kMaxVersions);
+}
+
+bool ABDProtocol::EnableDurability(const DurabilityOptions& options) {
+    auto engine = std::make_unique<DurabilityEngine>(options, store_);
+    bool opened = engine->Open([this](std::string_view key, std::string_view value,
+                                      int64_t timestamp) {
+        store_.Update(key, [&](ShardedStore::Entry& entry) {
+            entry.SetValue(value);
+            entry.timestamp = timestamp;
+        });
+        // Keep new timestamps above everything recovered
+        clock_.Observe(timestamp);
+    });
+    if (!opened) {
+        return false;
+    }
+    durability_ = std::move(engine);
+    // Snapshots load straight into the store, so build the tree from what is there
+    store_.ForEach([this](std::string_view key, const ShardedStore::Entry& entry) {
+        tree_.Update(HashRing::Hash(key), 0, entry.timestamp);
+        index_.Insert(key);
+    });
+    return true;
+}
+
+ABDProtocol::ReadResult ABDProtocol::Read(const std::string& key, int64_t /* client_timestamp */, // NOLINT(readability-named-parameter)
+                                           size_t value_limit) {
     ReadResult result;
-    result.success = false;
+    result.success = true;
     result.timestamp = 0;
     
-    // Look up the key in our store
-    auto it = store_.find(key);
-    if (it != store_.end()) {
-        // If the key exists - return its value and timestamp
-        result.value = it->second.value;
-        result.timestamp = it->second.timestamp;
-        result.success = true;
-    } else {
-        // If the key doesn't exist - return empty value with timestamp 0
-        result.value = "";
-        result.timestamp = 0;
-        result.success = true;
-    }
+    // Look up the key in our store. If the key doesn't exist we return an
+    // empty value with timestamp 0. Reads only take the shard's shared lock.
+    store_.Read(key, [&](const ShardedStore::Entry& entry) {
+        result.timestamp = entry.timestamp;
+        if (value_limit > 0 && entry.value.size() > value_limit) {
+            result.omitted = true;
+            return;
+        }
+        result.value = entry.value;
+    });
     
     // Note: We return our stored value regardless of the client's timestamp.
     // The client-side ABD algorithm handles selecting the maximum timestamp
@@ -41,68 +65,297 @@ ABDProtocol::ReadResult ABDProtocol::Read(const std::string& key, int64_t /* cli
     return result;
 }
 
+ABDProtocol::ReadResult ABDProtocol::ReadAt(const std::string& key, int64_t read_timestamp) {
+    // Writes this server stamps itself (sent without a timestamp) order after
+    // the snapshot from now on. Writes carry their writer's timestamp, so
+    // the snapshot holds every write completed before read_timestamp was
+    // taken; one still in flight may land on either side of it
+    clock_.Observe(read_timestamp);
+    ReadResult result{"", 0, true};
+    store_.Read(key, [&](const ShardedStore::Entry& entry) { VersionAt(entry, read_timestamp, result); });
+    return result;
+}
+
 ABDProtocol::WriteResult ABDProtocol::Write(const std::string& key, 
                                              const std::string& value, 
                                              int64_t client_timestamp) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
     WriteResult result;
     result.success = false;
     
-    // Generate a new server timestamp
-    int64_t server_timestamp = GenerateTimestamp();
-    
-    // Use the maximum of client and server timestamps
-    // This ensures that timestamps are always increasing, even if a client
-    // sends an old timestamp
-    int64_t final_timestamp = std::max(client_timestamp, server_timestamp);
-    
-    // Update the store with the new value and timestamp
-    // We always accept the write (even if client timestamp is old) to keep
-    // the implementation simple. In a strict ABD implementation, we could
-    // reject writes with timestamps that are too old.
-    store_[key] = ValueEntry(value, final_timestamp);
-    result.success = true;
+    // Update the store with the new value under the writer's timestamp. The
+    // check runs under the shard lock, so a key always holds the value with
+    // the highest timestamp it was sent, whatever order writes arrive in. An
+    // older write is not applied: it is answered with accepted false and the
+    // key's newer timestamp, so the writer can retry above it.
+    // With durability on, the write is logged under the same lock so log
+    // order matches apply order, and acknowledged once the log has it.
+    uint64_t lsn = 0;
+    uint64_t key_hash = HashRing::Hash(key);
+    bool inserted = false;
+    int64_t final_timestamp = store_.Update(key, [&](ShardedStore::Entry& entry) {
+        int64_t ts = WriteTimestamp(client_timestamp);
+        if (ts < entry.timestamp) {
+            result.accepted = false;
+            return entry.timestamp;
+        }
+        if (ts == entry.timestamp) {
+            return ts;      // This write arriving again (or a read's write-back)
+        }
+        if (durability_) {
+            lsn = durability_->Log(key, value, ts);
+        }
+        tree_.Update(key_hash, entry.timestamp, ts);
+        inserted = entry.timestamp == 0;
+        Supersede(entry, ts);
+        entry.SetValue(value);
+        entry.timestamp = ts;
+        return ts;
+    });
+    // New keys join the ordered index outside the shard lock
+    if (inserted) {
+        index_.Insert(key);
+    }
+    result.success = !durability_ || durability_->Sync(lsn);
     result.timestamp = final_timestamp;
     
     return result;
 }
 
-int64_t ABDProtocol::GetTimestamp(const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
+ABDProtocol::WriteResult ABDProtocol::WriteIfNewer(const std::string& key, const std::string& value,
+                                                    int64_t timestamp) {
+    WriteResult result{true, 0};
+    uint64_t lsn = 0;
+    bool inserted = false;
+    store_.Update(key, [&](ShardedStore::Entry& entry) {
+        // Server-stamped writes to this key must order after this one
+        clock_.Observe(timestamp);
+        if (timestamp <= entry.timestamp || timestamp <= 0) {
+            result.accepted = timestamp == entry.timestamp && timestamp > 0;
+            result.timestamp = entry.timestamp;
+            return;
+        }
+        if (durability_) {
+            lsn = durability_->Log(key, value, timestamp);
+        }
+        tree_.Update(HashRing::Hash(key), entry.timestamp, timestamp);
+        inserted = entry.timestamp == 0;
+        Supersede(entry, timestamp);
+        entry.SetValue(value);
+        entry.timestamp = timestamp;
+        result.timestamp = timestamp;
+    });
+    if (inserted) {
+        index_.Insert(key);
+    }
+    if (lsn != 0) {
+        result.success = durability_->Sync(lsn);
+    }
+    return result;
+}
+
+std::vector<ABDProtocol::ReadResult> ABDProtocol::MultiRead(
+        const std::vector<std::string_view>& keys, const std::vector<size_t>& value_limits) const {
+    std::vector<ReadResult> results(keys.size(), ReadResult{"", 0, true});
+    store_.ReadBatch(keys.size(), [&](size_t i) { return keys[i]; },
+        [&](size_t i, const ShardedStore::Entry* entry) {
+            if (entry == nullptr) {
+                return;
+            }
+            results[i].timestamp = entry->timestamp;
+            // As in Read, a value over the limit is never copied
+            size_t limit = value_limits.empty() ? 0 : value_limits[i];
+            if (limit > 0 && entry->value.size() > limit) {
+                results[i].omitted = true;
+                return;
+            }
+            results[i].value = entry->value;
+        });
+    return results;
+}
+
+std::vector<ABDProtocol::WriteResult> ABDProtocol::MultiWrite(const std::vector<WriteOp>& writes) {
+    std::vector<WriteResult> results(writes.size(), WriteResult{true, 0});
+    std::vector<size_t> inserted;
+    uint64_t last_lsn = 0;
+    store_.UpdateBatch(writes.size(), [&](size_t i) { return writes[i].key; },
+        [&](size_t i, ShardedStore::Entry& entry) {
+            // Same rule as Write, applied under the shard lock
+            int64_t ts = WriteTimestamp(writes[i].client_timestamp);
+            results[i].timestamp = ts;
+            if (ts < entry.timestamp) {
+                results[i].accepted = false;
+                results[i].timestamp = entry.timestamp;
+                return;
+            }
+            if (ts == entry.timestamp) {
+                return;
+            }
+            if (durability_) {
+                last_lsn = std::max(last_lsn, durability_->Log(writes[i].key, writes[i].value, ts));
+            }
+            tree_.Update(HashRing::Hash(writes[i].key), entry.timestamp, ts);
+            if (entry.timestamp == 0) {
+                inserted.push_back(i);
+            }
+            Supersede(entry, ts);
+            entry.SetValue(writes[i].value);
+            entry.timestamp = ts;
+        });
+    for (size_t i : inserted) {
+        index_.Insert(writes[i].key);
+    }
+    // One sync covers the whole batch
+    if (durability_ && !durability_->Sync(last_lsn)) {
+        for (auto& result : results) {
+            result.success = false;
+        }
+    }
+    return results;
+}
+
+std::vector<ABDProtocol::StoredEntry> ABDProtocol::CollectShard(
+        size_t shard, const std::function<bool(std::string_view key)>& match,
+        int64_t min_timestamp) const {
+    std::vector<StoredEntry> entries;
+    store_.ForEachInShard(shard, [&](std::string_view key, const ShardedStore::Entry& entry) {
+        // A key that was never written (timestamp 0) is skipped with min_timestamp 0
+        if (entry.timestamp > min_timestamp && match(key)) {
+            entries.push_back({std::string(key), std::string(entry.value), entry.timestamp});
+        }
+    });
+    return entries;
+}
+
+ABDProtocol::MergeResult ABDProtocol::Merge(const std::vector<WriteOp>& entries) {
+    MergeResult result{true, 0};
+    std::vector<size_t> inserted;
+    uint64_t last_lsn = 0;
+    store_.UpdateBatch(entries.size(), [&](size_t i) { return entries[i].key; },
+        [&](size_t i, ShardedStore::Entry& entry) {
+            int64_t ts = entries[i].client_timestamp;
+            // Observed under the lock, so a write to this key can't be
+            // stamped below a version merged just before it
+            clock_.Observe(ts);
+            if (ts <= entry.timestamp) {
+                return;
+            }
+            if (durability_) {
+                last_lsn = std::max(last_lsn, durability_->Log(entries[i].key, entries[i].value, ts));
+            }
+            tree_.Update(HashRing::Hash(entries[i].key), entry.timestamp, ts);
+            if (entry.timestamp == 0) {
+                inserted.push_back(i);
+            }
+            Supersede(entry, ts);
+            entry.SetValue(entries[i].value);
+            entry.timestamp = ts;
+            result.applied++;
+        });
+    for (size_t i : inserted) {
+        index_.Insert(entries[i].key);
+    }
+    if (durability_ && last_lsn != 0) {
+        result.success = durability_->Sync(last_lsn);
+    }
+    return result;
+}
+
+std::vector<ABDProtocol::StoredEntry> ABDProtocol::Scan(std::string_view start, std::string_view end,
+                                                        size_t limit, size_t max_bytes,
+                                                        int64_t read_timestamp, bool& more, bool& too_old) {
+    // One key past the limit tells whether there are more
+    std::vector<std::string> keys = index_.Range(start, end, limit + 1);
+    more = keys.size() > limit;
+    keys.resize(std::min(keys.size(), limit));
     
-    auto it = store_.find(key);
-    if (it != store_.end()) {
-        return it->second.timestamp;
+    too_old = false;
+    if (read_timestamp != 0) {
+        clock_.Observe(read_timestamp);     // As in ReadAt
+    }
+    std::vector<StoredEntry> entries(keys.size());
+    store_.ReadBatch(keys.size(), [&](size_t i) { return std::string_view(keys[i]); },
+        [&](size_t i, const ShardedStore::Entry* entry) {
+            entries[i].key = keys[i];
+            if (entry == nullptr) {
+                return;
+            }
+            if (read_timestamp == 0) {
+                entries[i].value = entry->value;
+                entries[i].timestamp = entry->timestamp;
+                return;
+            }
+            ReadResult version{"", 0, true};
+            VersionAt(*entry, read_timestamp, version);
+            too_old |= version.too_old;
+            entries[i].value = std::move(version.value);
+            entries[i].timestamp = version.timestamp;
+        });
+    size_t bytes = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        bytes += entries[i].key.size() + entries[i].value.size();
+        if (bytes > max_bytes && i > 0) {
+            entries.resize(i);
+            more = true;
+            break;
+        }
     }
-    return 0;
+    return entries;
+}
+
+int64_t ABDProtocol::GetTimestamp(const std::string& key) const {
+    int64_t timestamp = 0;
+    store_.Read(key, [&](const ShardedStore::Entry& entry) { timestamp = entry.timestamp; });
+    return timestamp;
 }
 
 std::string ABDProtocol::GetValue(const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = store_.find(key);
-    if (it != store_.end()) {
-        return it->second.value;
+    std::string value;
+    store_.Read(key, [&](const ShardedStore::Entry& entry) { value = entry.value; });
+    return value;
+}
+
+int64_t ABDProtocol::WriteTimestamp(int64_t client_timestamp) {
+    if (client_timestamp <= 0) {
+        return clock_.Now();
     }
-    return "";
+    // Keeps timestamps this server generates above every write it has seen
+    clock_.Observe(client_timestamp);
+    return client_timestamp;
 }
 
-int64_t ABDProtocol::GenerateTimestamp() {
-    // Generate a monotonically increasing timestamp
-    // This ensures that every operation gets a unique, ordered timestamp
-    auto now = std::chrono::system_clock::now();
-    auto duration = now.time_since_epoch();
-    int64_t current = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-    
-    // Ensure timestamp is always increasing
-    if (current > last_timestamp_) {
-        last_timestamp_ = current;
-    } else {
-        last_timestamp_++;  // Increment if clock went backwards
+void ABDProtocol::Supersede(ShardedStore::Entry& entry, int64_t timestamp) {
+    if (entry.timestamp == 0) {
+        // A key created here: its chain has seen every version
+        entry.versions.MarkComplete();
+        return;
+    }
+    if (versions_.retention.count() > 0) {
+        int64_t horizon = hlc::Pack(std::max<int64_t>(hlc::Physical(timestamp) - versions_.retention.count(), 0), 0, 0);
+        entry.versions.Compact(entry.timestamp, horizon, *entry.slab);
+    }
+    // The value's bytes move into the chain; SetValue then fills what comes back
+    entry.versions.Push(entry.timestamp, entry.value, versions_.max_versions);
+}
+
+void ABDProtocol::VersionAt(const ShardedStore::Entry& entry, int64_t read_timestamp, ReadResult& result) {
+    if (entry.timestamp <= read_timestamp) {
+        result.value = entry.value;
+        result.timestamp = entry.timestamp;
+        return;
+    }
+    const VersionChain::Version* version = nullptr;
+    switch (entry.versions.Find(read_timestamp, version)) {
+        case VersionChain::Lookup::kFound:
+            result.value = version->value;
+            result.timestamp = version->timestamp;
+            break;
+        case VersionChain::Lookup::kNotStored:
+            break;
+        case VersionChain::Lookup::kTooOld:
+            result.success = false;
+            result.too_old = true;
+            break;
     }
-    
-    return last_timestamp_;
 }
 
 }
@@ -1,35 +1,65 @@
 // This implements the ABD protocol for server-side storage.
 #pragma once
 
+#include <chrono>
 #include <string>
-#include <map>
-#include <mutex>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <functional>
 #include <cstdint>
+#include <memory>
+#include "durability.h"
+#include "../common/hlc.h"
+#include "merkle_tree.h"
+#include "ordered_index.h"
+#include "sharded_store.h"
 
 namespace kvstore {
 
+// How much history ABD keeps for snapshot reads (ReadAt).
+struct VersionRetention {
+    size_t max_versions = 4;                        // Superseded versions per key (0 = none)
+    std::chrono::milliseconds retention{10000};     // Drop a version superseded longer ago (0 = never)
+};
 
 // Each server maintains its own in-memory key-value store with timestamps.
 // The client-side logic (in abd_client_impl.cpp) implements the full ABD algorithm
 // including the two-phase read and write operations.
 class ABDProtocol {
 public:
-    ABDProtocol();
+    // @param server_id This server's id, used as the tiebreak in its timestamps
+    explicit ABDProtocol(int32_t server_id = 0);
     ~ABDProtocol();
     
+    // Make the store durable: recover it from `options.dir` (latest snapshot
+    // plus log tail), then log every write before acknowledging it. Must be
+    // called before the first request.
+    // @param options Data directory, sync policy and snapshot threshold
+    // @return false if the data directory could not be recovered
+    bool EnableDurability(const DurabilityOptions& options);
+    
+    // Set how many superseded versions each key keeps, and for how long.
+    // Must be called before the first request; versions are not logged, so
+    // recovered keys start without history.
+    void SetVersionRetention(const VersionRetention& retention);
+    
     // Result of a read operation.
     // Contains the value, its timestamp, and whether the operation succeeded.
     struct ReadResult {
         std::string value;      // The stored value (empty if key doesn't exist)
         int64_t timestamp;      // Timestamp associated with this value
         bool success;           // Whether the read operation succeeded
+        bool omitted = false;   // Value left out for being over the read's value limit
+        bool too_old = false;   // ReadAt: the version asked for is no longer kept
     };
     
     // Result of a write operation.
-    // Contains success status and the final timestamp assigned to the value.
+    // Contains success status and the timestamp the key now holds.
     struct WriteResult {
         bool success;           // Whether the write operation succeeded
-        int64_t timestamp;      // Final timestamp assigned to the value
+        int64_t timestamp;      // The write's timestamp, or the key's newer one if not accepted
+        bool accepted = true;   // False if the key had a newer timestamp (the write was not applied)
     };
     
     // Read the value for a key.
@@ -38,19 +68,126 @@ public:
     // @param key The key to read
     // @param client_timestamp Client's timestamp (used for ordering, but server
     //                         returns its own stored value regardless)
+    // @param value_limit Leave out (and don't copy) a value larger than this
+    //                    and set `omitted` instead; 0 = no limit
     // @return ReadResult containing value, timestamp, and success status
-    ReadResult Read(const std::string& key, int64_t client_timestamp);
+    ReadResult Read(const std::string& key, int64_t client_timestamp, size_t value_limit = 0);
+    
+    // Read the version of a key that was current at a timestamp: the newest
+    // one at or below it, from the key's version chain if it has been
+    // overwritten since. Writes are stored under their writer's timestamp,
+    // so the version holds every write completed before read_timestamp was
+    // taken; one that was still in flight may show up on a repeated read.
+    // @param key The key to read
+    // @param read_timestamp Snapshot timestamp
+    // @return The version (timestamp 0 if the key didn't exist then), or
+    //         success false and too_old if that version was dropped
+    ReadResult ReadAt(const std::string& key, int64_t read_timestamp);
     
     // Write a value for a key.
-    // The server accepts the write and assigns a timestamp that is at least
-    // as large as the client's timestamp. This ensures monotonicity.
+    // The value is stored under the client's timestamp if that is newer than
+    // the key's, so every replica ends up with the value of the highest
+    // timestamp. An older write is not applied and comes back with accepted
+    // false and the key's timestamp, for the client to retry above it; the
+    // same timestamp again (a retry or a read's write-back) is accepted.
     // @param key The key to write
     // @param value The value to store
-    // @param client_timestamp Client's timestamp for this write
-    // @return WriteResult containing success status and final timestamp
+    // @param client_timestamp Client's timestamp for this write (0 = stamp it here)
+    // @return WriteResult containing success status, accepted and the timestamp
     WriteResult Write(const std::string& key, const std::string& value, int64_t client_timestamp);
     
-    // Get the current timestamp for a key (for debugging).
+    // Write a value under the client's own timestamp, but only if no newer
+    // one is stored: a compare-and-set against the key's timestamp, which the
+    // shard entry already holds, so the check is one comparison under the
+    // shard lock. A timestamp equal to the stored one is the same write
+    // arriving again and is accepted without being applied twice.
+    // @param key The key to write
+    // @param value The value to store
+    // @param timestamp The write's timestamp, chosen by the client
+    // @return accepted and the timestamp stored, or accepted false with the
+    //         key's newer timestamp
+    WriteResult WriteIfNewer(const std::string& key, const std::string& value, int64_t timestamp);
+    
+    // One write of a batch. The views must stay valid for the MultiWrite call.
+    struct WriteOp {
+        std::string_view key;
+        std::string_view value;
+        int64_t client_timestamp;
+    };
+    
+    // Read a batch of keys, taking each shard lock once for the whole batch.
+    // @param keys Keys to read (repeats allowed)
+    // @param value_limits Per key, as Read's value_limit (0 = no limit);
+    //                     empty for no limits at all
+    // @return One ReadResult per key, in the same order
+    std::vector<ReadResult> MultiRead(const std::vector<std::string_view>& keys,
+                                      const std::vector<size_t>& value_limits = {}) const;
+    
+    // Write a batch of values, taking each shard lock once for the whole batch.
+    // Each write gets the same timestamp rule and result as Write; repeated keys are
+    // applied in batch order, so the last one wins.
+    // @param writes Writes to apply
+    // @return One WriteResult per write, in the same order
+    std::vector<WriteResult> MultiWrite(const std::vector<WriteOp>& writes);
+    
+    // A stored key as copied out for migration.
+    struct StoredEntry {
+        std::string key;
+        std::string value;
+        int64_t timestamp;
+    };
+    
+    // Result of merging migrated entries.
+    struct MergeResult {
+        bool success;           // False if the log could not be synced
+        size_t applied;         // Entries newer than what was stored
+    };
+    
+    // Read the keys in [start, end) in key order, up to `limit` of them, from
+    // the ordered index and the shards.
+    // @param end Upper bound, exclusive; empty = no bound
+    // @param max_bytes Stop once the keys and values passed this many bytes
+    //                  (after at least one entry)
+    // @param read_timestamp Read each key as ReadAt would (0 = current
+    //                       versions); keys that didn't exist then have timestamp 0
+    // @param more Set to whether keys were left out for the limits
+    // @param too_old Set if a key's version at read_timestamp was dropped
+    std::vector<StoredEntry> Scan(std::string_view start, std::string_view end, size_t limit,
+                                  size_t max_bytes, int64_t read_timestamp, bool& more,
+                                  bool& too_old);
+    
+    // Number of store shards, for scanning one shard at a time.
+    size_t NumShards() const { return store_.NumShards(); }
+    
+    // Shard holding a key (for routing requests to the shard's owner thread).
+    size_t ShardOf(std::string_view key) const { return store_.ShardOf(key); }
+    
+    // Store size and shard lock contention, for the metrics endpoint.
+    ShardedStore::Stats GetStoreStats() const { return store_.GetStats(); }
+    
+    // Merkle tree of every stored version, kept up to date by every write
+    // and merge (compared with peers for anti-entropy).
+    const MerkleTree& GetMerkleTree() const { return tree_; }
+    
+    // Copy out the entries of one shard that match a filter and are newer
+    // than `min_timestamp`. Only the shard's shared lock is held, and only
+    // for the copy.
+    // @param shard Shard to scan, below NumShards()
+    // @param match Called with each key; true to include it
+    // @param min_timestamp Skip entries at or below this timestamp
+    // @return The matching entries, in no particular order
+    std::vector<StoredEntry> CollectShard(size_t shard,
+                                          const std::function<bool(std::string_view key)>& match,
+                                          int64_t min_timestamp) const;
+    
+    // Merge entries copied from another server: each replaces the stored
+    // value only if its timestamp is larger, keeping that timestamp (the
+    // same max rule the ABD client applies to read replies).
+    // @param entries Entries to merge; client_timestamp is the entry's timestamp
+    // @return Whether the merge is durable, and how many entries were newer
+    MergeResult Merge(const std::vector<WriteOp>& entries);
+    
+    // Get the current timestamp for a key (served as ReadTimestamp).
     // @param key The key to check
     // @return Timestamp of the key, or 0 if key doesn't exist
     int64_t GetTimestamp(const std::string& key) const;
@@ -61,24 +198,26 @@ public:
     std::string GetValue(const std::string& key) const;
 
 private:
-    // Internal storage entry for a key-value pair.
-    // Stores both the value and its timestamp.
-    struct ValueEntry {
-        std::string value;      // The actual value
-        int64_t timestamp;      // Timestamp for ordering
-        
-        ValueEntry() : timestamp(0) {}
-        ValueEntry(const std::string& v, int64_t ts) : value(v), timestamp(ts) {}
-    };
+    ShardedStore store_;                          // Sharded in-memory key-value store
+    HybridClock clock_;                           // Source of server-side timestamps
+    MerkleTree tree_;                             // Digest of the store, by ring hash
+    OrderedIndex index_;                          // Every key, in order, for Scan
+    std::unique_ptr<DurabilityEngine> durability_; // Null unless durability is enabled
+    VersionRetention versions_;                   // History kept for ReadAt
+    
+    // Timestamp to store a write under: the writer's HLC timestamp as given,
+    // so writers decide the order. A write sent without one (0) is stamped
+    // from this server's clock.
+    // @param client_timestamp Timestamp chosen by the writer
+    // @return The timestamp the write is ordered by
+    int64_t WriteTimestamp(int64_t client_timestamp);
     
-    mutable std::mutex mutex_;                    // Protects the store from concurrent access
-    std::map<std::string, ValueEntry> store_;      // In-memory key-value store
-    int64_t last_timestamp_;                      // Last timestamp generated (for monotonicity)
+    // Move an entry's current version into its chain before it is replaced
+    // by the version stamped `timestamp` (under the shard lock).
+    void Supersede(ShardedStore::Entry& entry, int64_t timestamp);
     
-    // Generate a new timestamp that is strictly greater than all previous timestamps.
-    // This ensures we can always order operations correctly.
-    // @return New monotonically increasing timestamp
-    int64_t GenerateTimestamp();
+    // Fill `result` with the version of `entry` current at `read_timestamp`.
+    static void VersionAt(const ShardedStore::Entry& entry, int64_t read_timestamp, ReadResult& result);
 };
 
 } // namespace kvstore
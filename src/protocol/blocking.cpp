@@ -3,102 +3,279 @@
 
 #include "blocking.h"
 #include "../common/utils.h"
+#include "../common/logging.h"
 #include <algorithm>
 #include <chrono>
 
 namespace kvstore {
 
-BlockingProtocol::BlockingProtocol() : last_timestamp_(0) {
+namespace {
+
+// Timer wheel size: one lap is 4096 reaper ticks (~41 s), longer than the
+// default lease, so most timers fire on their first pass
+constexpr size_t kTimerSlots = 4096;
+
+} // namespace
+
+BlockingProtocol::BlockingProtocol(int32_t server_id)
+    : clock_(hlc::ServerWriterId(server_id)), next_waiter_id_(1), timers_(REAPER_TICK, kTimerSlots),
+      reaper_(&BlockingProtocol::ReapLoop, this) {
 }
 
 BlockingProtocol::~BlockingProtocol() {
+    {
+        std::lock_guard<std::mutex> lock(reaper_mutex_);
+        stop_reaper_ = true;
+    }
+    reaper_cv_.notify_all();
+    reaper_.join();
 }
 
 BlockingProtocol::LockResult BlockingProtocol::AcquireLock(const std::string& key, 
                                                            int32_t client_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    LockResult result;
-    result.granted = false;
-    result.timestamp = kvstore::GetCurrentTimestamp();
-    
-    // Check if the key is already locked
-    auto lock_it = locks_.find(key);
-    if (lock_it != locks_.end()) {
-        // Key is locked - check if we should grant the lock anyway
-        
-        // Check if the lock has timed out (client may have crashed)
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            now - lock_it->second.acquired_at).count();
+    // Without a wait the answer is always given inline
+    LockResult result{false, 0};
+    AcquireLock(key, client_id, DEFAULT_LOCK_LEASE, std::chrono::milliseconds(0),
+                [&result](const LockResult& r) { result = r; });
+    return result;
+}
+
+void BlockingProtocol::AcquireLock(const std::string& key, int32_t client_id,
+                                   std::chrono::milliseconds lease,
+                                   std::chrono::milliseconds max_wait, LockDone done) {
+    lease = ClampLease(lease);
+    max_wait = std::min(max_wait, MAX_LOCK_WAIT);
+    std::vector<Waker> wakes;
+    enum class Outcome { GRANTED, DENIED, PARKED };
+    Outcome outcome = store_.Update(key, [&](ShardedStore::Entry& entry) {
+        auto now = Clock::now();
+        if (entry.lock_owner >= 0 && entry.lock_expires_at <= now) {
+            // The holder's lease ran out before the reaper got to it - assume
+            // the client crashed. The longest waiter takes the lock over; with
+            // nobody waiting, this client does.
+            entry.lock_owner = -1;
+            HandOff(key, entry, now, wakes);
+        }
         
-        if (elapsed > LOCK_TIMEOUT_SECONDS) {
-            // Lock timed out - assume previous client crashed, steal the lock
-            locks_.erase(lock_it);
-            locks_[key] = LockEntry(client_id);
-            result.granted = true;
-            result.timestamp = kvstore::GetCurrentTimestamp();
-        } else if (lock_it->second.owner_id == client_id) {
-            // Same client already has the lock (re-entrant lock)
-            result.granted = true;
-            result.timestamp = kvstore::GetCurrentTimestamp();
-        } else {
-            // Lock is held by another client and hasn't timed out
-            // This is the "blocking" behavior - client must wait
-            result.granted = false;
-            result.timestamp = kvstore::GetCurrentTimestamp();
+        if (entry.lock_owner < 0 || entry.lock_owner == client_id) {
+            // Key is not locked, or this client already has the lock
+            // (re-entrant lock) - grant it for a fresh lease
+            GrantLock(key, entry, client_id, lease, now);
+            return Outcome::GRANTED;
+        }
+        // The lock is held by another client - this is the "blocking"
+        // behavior, the client must wait (or give up at once)
+        if (max_wait.count() <= 0) {
+            return Outcome::DENIED;
         }
+        uint64_t id = next_waiter_id_.fetch_add(1, std::memory_order_relaxed);
+        if (!entry.lock_waiters) {
+            entry.lock_waiters = std::make_unique<std::deque<ShardedStore::LockWaiter>>();
+        }
+        entry.lock_waiters->push_back({id, client_id, lease, [done = std::move(done)](bool granted) {
+            done(LockResult{granted, kvstore::GetCurrentTimestamp()});
+        }});
+        ScheduleTimer(now + max_wait, LockTimer{LockTimer::WAIT, key, id});
+        return Outcome::PARKED;
+    });
+    
+    for (auto& wake : wakes) {
+        wake(true);
+    }
+    if (outcome == Outcome::GRANTED) {
+        grants_.Add();
+    } else if (outcome == Outcome::DENIED) {
+        denies_.Add();
     } else {
-        // Key is not locked - grant the lock to this client
-        locks_[key] = LockEntry(client_id);
-        result.granted = true;
-        result.timestamp = kvstore::GetCurrentTimestamp();
+        parked_.Add();
+    }
+    if (outcome != Outcome::PARKED) {
+        done(LockResult{outcome == Outcome::GRANTED, kvstore::GetCurrentTimestamp()});
     }
-    
-    return result;
+}
+
+bool BlockingProtocol::RenewLock(const std::string& key, int32_t client_id,
+                                 std::chrono::milliseconds lease) {
+    lease = ClampLease(lease);
+    bool renewed = false;
+    store_.UpdateExisting(key, [&](ShardedStore::Entry& entry) {
+        auto now = Clock::now();
+        // A lease that already ran out can't be renewed, even if the reaper
+        // hasn't taken the lock back yet - the client must assume it lost it
+        if (entry.lock_owner == client_id && entry.lock_expires_at > now) {
+            GrantLock(key, entry, client_id, lease, now);
+            renewed = true;
+        }
+    });
+    return renewed;
 }
 
 bool BlockingProtocol::ReleaseLock(const std::string& key, int32_t client_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto lock_it = locks_.find(key);
+    bool released = false;
+    std::vector<Waker> granted;
+    std::vector<Waker> withdrawn;
+    store_.UpdateExisting(key, [&](ShardedStore::Entry& entry) {
+        released = ReleaseHeld(key, entry, client_id, granted, withdrawn);
+    });
+    for (auto& wake : withdrawn) {
+        wake(false);
+    }
+    for (auto& wake : granted) {
+        wake(true);
+    }
+    return released;
+}
+
+bool BlockingProtocol::ReleaseHeld(const std::string& key, ShardedStore::Entry& entry,
+                                   int32_t client_id, std::vector<Waker>& granted,
+                                   std::vector<Waker>& withdrawn) {
+    bool released = false;
+    // Withdraw requests this client still has waiting for the lock
+    if (entry.lock_waiters) {
+        auto& waiters = *entry.lock_waiters;
+        for (auto it = waiters.begin(); it != waiters.end();) {
+            if (it->client_id == client_id) {
+                withdrawn.push_back(std::move(it->wake));
+                it = waiters.erase(it);
+                released = true;
+            } else {
+                ++it;
+            }
+        }
+    }
     // Only release if this client actually holds the lock
-    if (lock_it != locks_.end() && lock_it->second.owner_id == client_id) {
-        locks_.erase(lock_it);
-        return true;
+    if (entry.lock_owner == client_id) {
+        entry.lock_owner = -1;
+        released = true;
+        HandOff(key, entry, Clock::now(), granted);
+    }
+    if (entry.lock_waiters && entry.lock_waiters->empty()) {
+        entry.lock_waiters.reset();
+    }
+    return released;
+}
+
+std::chrono::milliseconds BlockingProtocol::ClampLease(std::chrono::milliseconds lease) {
+    if (lease.count() <= 0) {
+        return DEFAULT_LOCK_LEASE;
+    }
+    return std::min(lease, MAX_LOCK_LEASE);
+}
+
+void BlockingProtocol::ScheduleTimer(Clock::time_point deadline, LockTimer timer) {
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(reaper_mutex_);
+        was_empty = timers_.Empty();
+        timers_.Schedule(deadline, std::move(timer));
+    }
+    if (was_empty) {
+        reaper_cv_.notify_one();    // Otherwise the reaper is already ticking
+    }
+}
+
+void BlockingProtocol::GrantLock(const std::string& key, ShardedStore::Entry& entry,
+                                 int32_t client_id, std::chrono::milliseconds lease,
+                                 Clock::time_point now) {
+    entry.lock_owner = client_id;
+    entry.lock_expires_at = now + lease;
+    ScheduleTimer(entry.lock_expires_at, LockTimer{LockTimer::LEASE, key, 0});
+}
+
+void BlockingProtocol::HandOff(const std::string& key, ShardedStore::Entry& entry,
+                               Clock::time_point now, std::vector<Waker>& wakes) {
+    if (!entry.lock_waiters || entry.lock_waiters->empty()) {
+        return;
+    }
+    ShardedStore::LockWaiter next = std::move(entry.lock_waiters->front());
+    entry.lock_waiters->pop_front();
+    GrantLock(key, entry, next.client_id, next.lease, now);
+    wakes.push_back(std::move(next.wake));
+    grants_.Add();
+}
+
+void BlockingProtocol::ReapLoop() {
+    std::unique_lock<std::mutex> lock(reaper_mutex_);
+    while (!stop_reaper_) {
+        if (timers_.Empty()) {
+            reaper_cv_.wait(lock);
+            continue;
+        }
+        auto now = Clock::now();
+        if (now < timers_.NextTick()) {
+            reaper_cv_.wait_until(lock, timers_.NextTick());
+            continue;
+        }
+        std::vector<LockTimer> expired;
+        timers_.Advance(now, expired);
+        lock.unlock();
+        for (const auto& timer : expired) {
+            Expire(timer);
+        }
+        lock.lock();
+    }
+}
+
+void BlockingProtocol::Expire(const LockTimer& timer) {
+    Waker timed_out;
+    std::vector<Waker> granted;
+    int32_t expired_owner = -1;
+    store_.UpdateExisting(timer.key, [&](ShardedStore::Entry& entry) {
+        auto now = Clock::now();
+        if (timer.kind == LockTimer::LEASE) {
+            // Released, renewed or re-granted since - the lease still runs
+            if (entry.lock_owner < 0 || entry.lock_expires_at > now) {
+                return;
+            }
+            expired_owner = entry.lock_owner;
+            entry.lock_owner = -1;
+            HandOff(timer.key, entry, now, granted);
+        } else if (entry.lock_waiters) {
+            // A request granted or withdrawn in the meantime is no longer queued
+            auto& waiters = *entry.lock_waiters;
+            auto it = std::find_if(waiters.begin(), waiters.end(),
+                [&](const ShardedStore::LockWaiter& w) { return w.id == timer.waiter_id; });
+            if (it != waiters.end()) {
+                timed_out = std::move(it->wake);
+                waiters.erase(it);
+            }
+        }
+        if (entry.lock_waiters && entry.lock_waiters->empty()) {
+            entry.lock_waiters.reset();
+        }
+    });
+    if (expired_owner >= 0) {
+        lease_expiries_.Add();
+        LOG_INFO("[BLOCKING] Lease of client " << expired_owner << " on key '" << timer.key
+                 << "' expired" << (granted.empty() ? "" : " - lock handed to next waiter"));
+    }
+    if (timed_out) {
+        wait_timeouts_.Add();
+        timed_out(false);
+    }
+    for (auto& wake : granted) {
+        wake(true);
     }
-    
-    return false;
 }
 
 BlockingProtocol::ReadResult BlockingProtocol::Read(const std::string& key, 
                                                     int32_t client_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
     ReadResult result;
     result.success = false;
     result.timestamp = 0;
     
-    // Verify that this client holds the lock
-    auto lock_it = locks_.find(key);
-    if (lock_it == locks_.end() || lock_it->second.owner_id != client_id) {
-        // Client doesn't have the lock - reject the read
-        result.success = false;
-        return result;
-    }
-    
-    // Client has the lock - perform the read
-    auto it = store_.find(key);
-    if (it != store_.end()) {
-        result.value = it->second.value;
-        result.timestamp = it->second.timestamp;
-        result.success = true;
-    } else {
-        // Key doesn't exist
-        result.value = "";
-        result.timestamp = 0;
+    // A locked key always exists in the store, so a missing key means
+    // the client doesn't have the lock - reject the read
+    store_.Read(key, [&](const ShardedStore::Entry& entry) {
+        if (entry.lock_owner != client_id) {
+            return;
+        }
+        // Client has the lock - perform the read
+        // (a key that was only ever locked has an empty value and timestamp 0)
+        result.value = entry.value;
+        result.timestamp = entry.timestamp;
         result.success = true;
-    }
+    });
     
     return result;
 }
@@ -107,80 +284,123 @@ BlockingProtocol::WriteResult BlockingProtocol::Write(const std::string& key,
                                                      const std::string& value, 
                                                      int64_t client_timestamp, 
                                                      int32_t client_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
     WriteResult result;
     result.success = false;
+    result.timestamp = 0;
     
-    // Verify that this client holds the lock
-    auto lock_it = locks_.find(key);
-    if (lock_it == locks_.end() || lock_it->second.owner_id != client_id) {
-        // Client doesn't have the lock - reject the write
-        result.success = false;
-        return result;
-    }
-    
-    // Client has the lock - perform the write
-    int64_t server_timestamp = GenerateTimestamp();
-    
-    // Use maximum of client and server timestamps (same as ABD)
-    int64_t final_timestamp = std::max(client_timestamp, server_timestamp);
-    
-    store_[key] = ValueEntry(value, final_timestamp);
-    result.success = true;
-    result.timestamp = final_timestamp;
+    store_.UpdateExisting(key, [&](ShardedStore::Entry& entry) {
+        // Verify that this client holds the lock
+        if (entry.lock_owner != client_id) {
+            // Client doesn't have the lock - reject the write
+            return;
+        }
+        
+        // Client has the lock - perform the write
+        // Use maximum of client and server timestamps (see GenerateTimestamp)
+        int64_t final_timestamp = GenerateTimestamp(client_timestamp);
+        entry.SetValue(value);
+        entry.timestamp = final_timestamp;
+        result.success = true;
+        result.timestamp = final_timestamp;
+    });
     
     return result;
 }
 
-int64_t BlockingProtocol::GetTimestamp(const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
+void BlockingProtocol::LockAndRead(const std::string& key, int32_t client_id,
+                                   std::chrono::milliseconds lease,
+                                   std::chrono::milliseconds max_wait, LockReadDone done) {
+    AcquireLock(key, client_id, lease, max_wait,
+        [this, key, client_id, done = std::move(done)](const LockResult& lock) {
+            if (!lock.granted) {
+                done(lock, ReadResult{"", 0, false});
+                return;
+            }
+            // Nobody else can write the key while this client holds its lock,
+            // so reading right after the grant is as good as reading with it.
+            // The read only fails if the lease ran out in between.
+            ReadResult read = Read(key, client_id);
+            done(LockResult{read.success, lock.timestamp}, std::move(read));
+        });
+}
+
+BlockingProtocol::WriteResult BlockingProtocol::WriteAndUnlock(const std::string& key,
+                                                              const std::string& value,
+                                                              int64_t client_timestamp,
+                                                              int32_t client_id) {
+    WriteResult result;
+    result.success = false;
+    result.timestamp = 0;
+    std::vector<Waker> granted;
+    std::vector<Waker> withdrawn;
     
-    auto it = store_.find(key);
-    if (it != store_.end()) {
-        return it->second.timestamp;
+    store_.UpdateExisting(key, [&](ShardedStore::Entry& entry) {
+        // Verify that this client holds the lock
+        if (entry.lock_owner != client_id) {
+            return;
+        }
+        int64_t final_timestamp = GenerateTimestamp(client_timestamp);
+        entry.SetValue(value);
+        entry.timestamp = final_timestamp;
+        result.success = true;
+        result.timestamp = final_timestamp;
+        ReleaseHeld(key, entry, client_id, granted, withdrawn);
+    });
+    for (auto& wake : withdrawn) {
+        wake(false);
+    }
+    for (auto& wake : granted) {
+        wake(true);
     }
-    return 0;
+    return result;
+}
+
+BlockingProtocol::LockStats BlockingProtocol::GetLockStats() const {
+    LockStats stats;
+    auto now = Clock::now();
+    store_.ForEach([&](std::string_view, const ShardedStore::Entry& entry) {
+        // A lock whose lease ran out is free even if the reaper hasn't cleared it yet
+        if (entry.lock_owner >= 0 && entry.lock_expires_at > now) {
+            stats.held++;
+        }
+        if (entry.lock_waiters) {
+            stats.waiting += entry.lock_waiters->size();
+        }
+    });
+    stats.grants = grants_.Value();
+    stats.denies = denies_.Value();
+    stats.parked = parked_.Value();
+    stats.wait_timeouts = wait_timeouts_.Value();
+    stats.lease_expiries = lease_expiries_.Value();
+    return stats;
+}
+
+int64_t BlockingProtocol::GetTimestamp(const std::string& key) const {
+    int64_t timestamp = 0;
+    store_.Read(key, [&](const ShardedStore::Entry& entry) { timestamp = entry.timestamp; });
+    return timestamp;
 }
 
 std::string BlockingProtocol::GetValue(const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = store_.find(key);
-    if (it != store_.end()) {
-        return it->second.value;
-    }
-    return "";
+    std::string value;
+    store_.Read(key, [&](const ShardedStore::Entry& entry) { value = entry.value; });
+    return value;
 }
 
 bool BlockingProtocol::IsLocked(const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return locks_.find(key) != locks_.end();
+    return GetLockOwner(key) >= 0;
 }
 
 int32_t BlockingProtocol::GetLockOwner(const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto lock_it = locks_.find(key);
-    if (lock_it != locks_.end()) {
-        return lock_it->second.owner_id;
-    }
-    return -1;  // No lock held
+    int32_t owner = -1;  // No lock held
+    store_.Read(key, [&](const ShardedStore::Entry& entry) { owner = entry.lock_owner; });
+    return owner;
 }
 
-int64_t BlockingProtocol::GenerateTimestamp() {
-    // Generate monotonically increasing timestamp (same logic as ABD)
-    auto now = std::chrono::system_clock::now();
-    auto duration = now.time_since_epoch();
-    int64_t current = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-    
-    if (current > last_timestamp_) {
-        last_timestamp_ = current;
-    } else {
-        last_timestamp_++;
-    }
-    
-    return last_timestamp_;
+int64_t BlockingProtocol::GenerateTimestamp(int64_t client_timestamp) {
+    int64_t ts = std::max(client_timestamp, clock_.Now());
+    clock_.Observe(ts);
+    return ts;
 }
 
 }
@@ -5,21 +5,32 @@
 #pragma once
 
 #include <string>
-#include <map>
-#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "sharded_store.h"
+#include "../common/hlc.h"
+#include "../common/timer_wheel.h"
 
 namespace kvstore {
 
 // Blocking Protocol implementation for server-side storage.
 // Each server maintains:
 // - An in-memory key-value store (like ABD)
-// - A lock table tracking which client holds each lock
-// Clients must acquire locks before reading or writing.
+// - Which client holds each key's lock, kept inline with the key's value
+// - A FIFO queue of lock requests waiting for each held lock
+// Clients must acquire locks before reading or writing. A lock is a lease:
+// unless its holder renews it, a reaper thread takes it back when the lease
+// runs out, so a crashed client blocks a key for at most one lease.
 class BlockingProtocol {
 public:
-    BlockingProtocol();
+    // @param server_id This server's id, used as the tiebreak in its timestamps
+    explicit BlockingProtocol(int32_t server_id = 0);
     ~BlockingProtocol();
     
     // Result of a lock acquisition attempt.
@@ -28,6 +39,9 @@ public:
         int64_t timestamp;      // Server timestamp (for ordering)
     };
     
+    // Completion for a lock request that may wait; runs exactly once.
+    using LockDone = std::function<void(const LockResult&)>;
+    
     // Result of a read operation.
     struct ReadResult {
         std::string value;      // The stored value
@@ -41,21 +55,48 @@ public:
         int64_t timestamp;     // Final timestamp assigned to the value
     };
     
-    // Attempt to acquire a lock for a key.
+    // Attempt to acquire a lock for a key, with the default lease.
     // The lock is granted if:
     // - The key is not currently locked, OR
-    // - The current lock has timed out, OR
-    // - The same client already holds the lock (re-entrant)
+    // - The current holder's lease has run out, OR
+    // - The same client already holds the lock (re-entrant; extends the lease)
     // @param key The key to lock
     // @param client_id Unique identifier for the client requesting the lock
     // @return LockResult indicating if lock was granted
     LockResult AcquireLock(const std::string& key, int32_t client_id);
     
-    // Release a lock for a key.
-    // Only succeeds if the calling client actually holds the lock.
+    // Acquire a lock, queueing behind the current holder instead of failing.
+    // Same rules as above, but a request for a lock held by another client
+    // joins the key's FIFO wait queue. It is answered with granted=true when
+    // the lock is handed over (by ReleaseLock or lease expiry), or with
+    // granted=false once `max_wait` has passed. `done` runs on this thread if
+    // the request is answered at once, otherwise on the releasing request's
+    // thread or the reaper thread; never while a store lock is held.
+    // @param key The key to lock
+    // @param client_id Unique identifier for the client requesting the lock
+    // @param lease How long the lock is held unless renewed, counted from
+    //              the grant (0 = DEFAULT_LOCK_LEASE, capped at MAX_LOCK_LEASE)
+    // @param max_wait How long the request may wait (capped at MAX_LOCK_WAIT;
+    //                 0 answers at once, like the overload above)
+    // @param done Called with the outcome
+    void AcquireLock(const std::string& key, int32_t client_id, std::chrono::milliseconds lease,
+                     std::chrono::milliseconds max_wait, LockDone done);
+    
+    // Extend the lease on a lock the client holds.
+    // @param key The locked key
+    // @param client_id ID of the client holding the lock
+    // @param lease New lease, counted from now (same limits as AcquireLock)
+    // @return true if renewed, false if the client doesn't hold the lock
+    //         (never had it, or its lease already ran out)
+    bool RenewLock(const std::string& key, int32_t client_id, std::chrono::milliseconds lease);
+    
+    // Release a lock for a key, handing it to the next waiter if there is one.
+    // Succeeds if the calling client holds the lock, or if it has a request
+    // waiting for it - that request is withdrawn (answered granted=false), so
+    // a client that gave up on a server can never be granted a lock later.
     // @param key The key to unlock
     // @param client_id ID of the client releasing the lock
-    // @return true if lock was released, false if client didn't hold the lock
+    // @return true if lock was released or a wait withdrawn, false otherwise
     bool ReleaseLock(const std::string& key, int32_t client_id);
     
     // Read the value for a key.
@@ -75,49 +116,131 @@ public:
     WriteResult Write(const std::string& key, const std::string& value, 
                      int64_t client_timestamp, int32_t client_id);
     
+    // Completion for LockAndRead; runs exactly once. The read result is only
+    // meaningful if the lock was granted.
+    using LockReadDone = std::function<void(const LockResult&, ReadResult)>;
+    
+    // Acquire a lock (waiting like AcquireLock) and read the value under it,
+    // saving the client a round trip.
+    // @param key The key to lock and read
+    // @param client_id Unique identifier for the client requesting the lock
+    // @param lease Lease to hold the lock with (as for AcquireLock)
+    // @param max_wait How long the request may wait (as for AcquireLock)
+    // @param done Called with the outcome and, if granted, the value read
+    void LockAndRead(const std::string& key, int32_t client_id, std::chrono::milliseconds lease,
+                     std::chrono::milliseconds max_wait, LockReadDone done);
+    
+    // Write a value and release the lock in one step, handing the lock to
+    // the next waiter. Nothing happens unless the client holds the lock.
+    // @param key The key to write
+    // @param value The value to store
+    // @param client_timestamp Client's timestamp for this write
+    // @param client_id ID of the client performing the write
+    // @return WriteResult containing success status and final timestamp
+    WriteResult WriteAndUnlock(const std::string& key, const std::string& value,
+                               int64_t client_timestamp, int32_t client_id);
+    
+    // Lock counts since the server started, plus the current lock table
+    // occupancy, for the metrics endpoint.
+    struct LockStats {
+        uint64_t grants = 0;            // Locks granted, at once or by hand-off to a waiter
+        uint64_t denies = 0;            // Requests that found the lock held and asked not to wait
+        uint64_t parked = 0;            // Requests queued behind a holder
+        uint64_t wait_timeouts = 0;     // Queued requests whose wait ran out
+        uint64_t lease_expiries = 0;    // Locks taken back from a holder whose lease ran out
+        size_t held = 0;                // Keys locked now
+        size_t waiting = 0;             // Requests queued now
+    };
+    
+    // Walks the whole store (one shard at a time) for the occupancy figures.
+    LockStats GetLockStats() const;
+    
+    // Store size and shard lock contention, for the metrics endpoint.
+    ShardedStore::Stats GetStoreStats() const { return store_.GetStats(); }
+    
+    // Shard holding a key (for routing requests to the shard's owner thread).
+    size_t ShardOf(std::string_view key) const { return store_.ShardOf(key); }
+    
     // Utility methods for debugging/testing
     int64_t GetTimestamp(const std::string& key) const;
     std::string GetValue(const std::string& key) const;
     bool IsLocked(const std::string& key) const;
     int32_t GetLockOwner(const std::string& key) const;
+    
+    // Lease for clients that don't ask for one: a lock not released or
+    // renewed within this time is considered abandoned (client crashed)
+    static constexpr std::chrono::milliseconds DEFAULT_LOCK_LEASE{30000};
+    
+    // Longest lease a client may ask for
+    static constexpr std::chrono::milliseconds MAX_LOCK_LEASE{300000};
+    
+    // Longest a lock request may wait in a queue
+    static constexpr std::chrono::milliseconds MAX_LOCK_WAIT{10000};
+    
+    // Granularity of lease expiry and wait timeouts
+    static constexpr std::chrono::milliseconds REAPER_TICK{10};
 
 private:
-    // Internal storage entry for a key-value pair.
-    struct ValueEntry {
-        std::string value;
-        int64_t timestamp;
-        
-        ValueEntry() : timestamp(0) {}
-        ValueEntry(const std::string& v, int64_t ts) : value(v), timestamp(ts) {}
-    };
+    using Clock = std::chrono::steady_clock;
+    using Waker = std::function<void(bool)>;
     
-    // Lock entry tracking who holds a lock and when it was acquired.
-    struct LockEntry {
-        int32_t owner_id;       // ID of the client holding the lock
-        std::chrono::steady_clock::time_point acquired_at;  // When lock was acquired
-        
-        // Default constructor (required for std::map)
-        LockEntry()
-            : owner_id(-1),
-              acquired_at(std::chrono::steady_clock::now()) {}
-        
-        // Constructor for creating a lock for a specific client
-        LockEntry(int32_t id)
-            : owner_id(id),
-              acquired_at(std::chrono::steady_clock::now()) {}
+    // A lease expiry or wait timeout for the reaper. Neither is cancelled
+    // when the lock is released or the wait ends; the reaper checks whether
+    // it still applies when it fires.
+    struct LockTimer {
+        enum Kind { LEASE, WAIT } kind;
+        std::string key;
+        uint64_t waiter_id;             // WAIT only
     };
     
-    mutable std::mutex mutex_;                    // Protects store and locks
-    std::map<std::string, ValueEntry> store_;      // Key-value store
-    std::map<std::string, LockEntry> locks_;       // Lock table
-    int64_t last_timestamp_;                      // Last timestamp generated
+    ShardedStore store_;                          // Values and lock state, sharded by key
+    HybridClock clock_;                           // Source of server-side timestamps
+    std::atomic<uint64_t> next_waiter_id_;        // Source of LockWaiter ids
+    Counter grants_;                              // LockStats counters
+    Counter denies_;
+    Counter parked_;
+    Counter wait_timeouts_;
+    Counter lease_expiries_;
+    
+    // Pending timers. reaper_mutex_ is taken inside shard locks, so the
+    // reaper drops it before touching the store.
+    std::mutex reaper_mutex_;
+    std::condition_variable reaper_cv_;
+    TimerWheel<LockTimer> timers_;
+    bool stop_reaper_ = false;
+    std::thread reaper_;
+    
+    // Timestamp to store a write under: the larger of the client's timestamp
+    // and a new one from this server's clock. Unlike ABD, where the writer's
+    // timestamp is stored as given, a blocking write happens under the key's
+    // lock, so the server may stamp it; the lock already orders the writes.
+    int64_t GenerateTimestamp(int64_t client_timestamp);
+    
+    static std::chrono::milliseconds ClampLease(std::chrono::milliseconds lease);
+    
+    // Hand a timer to the reaper.
+    void ScheduleTimer(Clock::time_point deadline, LockTimer timer);
+    
+    // Make `client_id` the holder of an entry's lock for `lease`.
+    void GrantLock(const std::string& key, ShardedStore::Entry& entry, int32_t client_id,
+                   std::chrono::milliseconds lease, Clock::time_point now);
+    
+    // Release the lock if `client_id` holds it and withdraw its waiting requests.
+    // @param granted Receives the completion of the waiter handed the lock
+    // @param withdrawn Receives the completions of the withdrawn requests
+    // @return true if anything was released or withdrawn
+    bool ReleaseHeld(const std::string& key, ShardedStore::Entry& entry, int32_t client_id,
+                     std::vector<Waker>& granted, std::vector<Waker>& withdrawn);
     
-    // Generate a new monotonically increasing timestamp.
-    int64_t GenerateTimestamp();
+    // Give an unlocked key's lock to the first waiter, if any.
+    // @param wakes Receives the waiter's completion, to run after the shard
+    //              lock is dropped
+    void HandOff(const std::string& key, ShardedStore::Entry& entry, Clock::time_point now,
+                 std::vector<Waker>& wakes);
     
-    // Lock timeout: if a lock is held for more than this many seconds,
-    // it's considered abandoned and can be overtaken by another client
-    static constexpr int LOCK_TIMEOUT_SECONDS = 30;
+    // Take back locks whose lease ran out and answer waits that timed out.
+    void ReapLoop();
+    void Expire(const LockTimer& timer);
 };
 
 }
@@ -0,0 +1,260 @@
+// Durability engine implementation: snapshot files and the snapshot thread.
+
+#include "durability.h"
+#include "../common/logging.h"
+#include "../common/mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace kvstore {
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'K', 'V', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr size_t kSnapshotHeader = 16;      // magic + u64 first_wal_seq
+constexpr size_t kSnapshotTrailer = 12;     // u64 count + u32 crc
+constexpr size_t kEntryFixed = 16;          // u32 key_len + u32 value_len + i64 timestamp
+
+// Snapshot writes are handed to the kernel in chunks of this size
+constexpr size_t kWriteChunk = 1 << 20;
+
+// How often the snapshot thread checks the log size
+constexpr std::chrono::seconds kSnapshotCheckInterval{1};
+
+template <typename T>
+void Put(std::string& out, T v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+T Get(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Buffered, checksummed sequential writer for a new file.
+class FileWriter {
+public:
+    explicit FileWriter(const std::string& path)
+        : fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) {
+        ok_ = fd_ >= 0;
+    }
+
+    ~FileWriter() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    std::string& Buffer() { return buffer_; }
+
+    // Write out the buffer once it is large enough (or always, if `force`).
+    void Flush(bool force = false) {
+        if (!ok_ || (!force && buffer_.size() < kWriteChunk)) {
+            return;
+        }
+        crc_ = Crc32(crc_, buffer_.data(), buffer_.size());
+        size_t written = 0;
+        while (written < buffer_.size()) {
+            ssize_t n = ::write(fd_, buffer_.data() + written, buffer_.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                ok_ = false;
+                return;
+            }
+            written += static_cast<size_t>(n);
+        }
+        buffer_.clear();
+    }
+
+    // Append the checksum of everything written, then sync and close.
+    bool Finish() {
+        Flush(true);
+        Put<uint32_t>(buffer_, crc_);
+        Flush(true);
+        ok_ = ok_ && fdatasync(fd_) == 0;
+        ok_ = ok_ && ::close(fd_) == 0;
+        fd_ = -1;
+        return ok_;
+    }
+
+private:
+    int fd_;
+    bool ok_;
+    std::string buffer_;
+    uint32_t crc_ = 0;
+};
+
+void SyncDirectory(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+DurabilityEngine::DurabilityEngine(DurabilityOptions options, const ShardedStore& store)
+    : options_(std::move(options)), store_(store) {
+}
+
+DurabilityEngine::~DurabilityEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (snapshotter_.joinable()) {
+        snapshotter_.join();
+    }
+    wal_.reset();       // Writes and syncs the buffered tail
+}
+
+bool DurabilityEngine::Open(const ApplyFn& apply) {
+    std::error_code ec;
+    std::filesystem::create_directories(options_.dir, ec);
+    if (ec) {
+        LOG_ERROR("[DURABILITY] Cannot create " << options_.dir << ": " << ec.message());
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t first_wal_seq = 0;
+    if (!LoadSnapshot(apply, first_wal_seq)) {
+        return false;
+    }
+    uint64_t last_seq = 0;
+    if (!WriteAheadLog::Replay(options_.dir, first_wal_seq, apply, last_seq)) {
+        return false;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("[DURABILITY] Recovered " << store_.Size() << " keys from " << options_.dir
+             << " in " << elapsed << " ms");
+
+    // Never append to a segment that may end in a torn record
+    wal_ = std::make_unique<WriteAheadLog>(options_.dir, options_.sync, options_.sync_interval);
+    if (!wal_->Open(std::max(last_seq, first_wal_seq) + 1)) {
+        return false;
+    }
+    snapshotter_ = std::thread(&DurabilityEngine::SnapshotLoop, this);
+    return true;
+}
+
+bool DurabilityEngine::Snapshot() {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    uint64_t first_wal_seq = wal_->Rotate();
+    if (!WriteSnapshot(first_wal_seq)) {
+        return false;
+    }
+    wal_->RemoveSegmentsBefore(first_wal_seq);
+    return true;
+}
+
+void DurabilityEngine::SnapshotLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, kSnapshotCheckInterval, [this] { return stop_; })) {
+        uint64_t logged = wal_->BytesSinceRotate();
+        if (logged == 0 || logged < options_.snapshot_bytes) {
+            continue;
+        }
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        bool ok = Snapshot();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (ok) {
+            LOG_INFO("[DURABILITY] Snapshot of " << store_.Size() << " keys took "
+                     << elapsed << " ms");
+        } else {
+            LOG_ERROR("[DURABILITY] Snapshot to " << SnapshotPath() << " failed");
+        }
+        lock.lock();
+    }
+}
+
+bool DurabilityEngine::WriteSnapshot(uint64_t first_wal_seq) {
+    std::string tmp_path = SnapshotPath() + ".tmp";
+    FileWriter writer(tmp_path);
+    std::string& out = writer.Buffer();
+    out.append(kSnapshotMagic, sizeof(kSnapshotMagic));
+    Put<uint64_t>(out, first_wal_seq);
+
+    uint64_t count = 0;
+    store_.ForEach([&](std::string_view key, const ShardedStore::Entry& entry) {
+        Put<uint32_t>(out, static_cast<uint32_t>(key.size()));
+        Put<uint32_t>(out, static_cast<uint32_t>(entry.value.size()));
+        Put<int64_t>(out, entry.timestamp);
+        out.append(key);
+        out.append(entry.value);
+        count++;
+        writer.Flush();
+    });
+    Put<uint64_t>(out, count);
+
+    if (!writer.Finish()) {
+        LOG_ERROR("[DURABILITY] Cannot write " << tmp_path << ": " << std::strerror(errno));
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, SnapshotPath(), ec);
+    if (ec) {
+        LOG_ERROR("[DURABILITY] Cannot install " << SnapshotPath() << ": " << ec.message());
+        return false;
+    }
+    SyncDirectory(options_.dir);
+    return true;
+}
+
+bool DurabilityEngine::LoadSnapshot(const ApplyFn& apply, uint64_t& first_wal_seq) {
+    first_wal_seq = 0;
+    if (!std::filesystem::exists(SnapshotPath())) {
+        return true;        // Fresh data directory
+    }
+    MappedFile file;
+    if (!file.Open(SnapshotPath())) {
+        LOG_ERROR("[DURABILITY] Cannot map " << SnapshotPath());
+        return false;
+    }
+
+    // Snapshots are installed by rename, so a bad one means real corruption:
+    // refuse to start rather than silently come up with partial data.
+    std::string_view data = file.Data();
+    if (data.size() < kSnapshotHeader + kSnapshotTrailer ||
+        std::memcmp(data.data(), kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+        Crc32(0, data.data(), data.size() - 4) != Get<uint32_t>(data.data() + data.size() - 4)) {
+        LOG_ERROR("[DURABILITY] " << SnapshotPath() << " is corrupt");
+        return false;
+    }
+    first_wal_seq = Get<uint64_t>(data.data() + 8);
+    uint64_t count = Get<uint64_t>(data.data() + data.size() - kSnapshotTrailer);
+
+    size_t pos = kSnapshotHeader;
+    size_t end = data.size() - kSnapshotTrailer;
+    for (uint64_t i = 0; i < count; i++) {
+        if (end - pos < kEntryFixed) {
+            LOG_ERROR("[DURABILITY] " << SnapshotPath() << " is truncated");
+            return false;
+        }
+        uint32_t key_len = Get<uint32_t>(data.data() + pos);
+        uint32_t value_len = Get<uint32_t>(data.data() + pos + 4);
+        int64_t timestamp = Get<int64_t>(data.data() + pos + 8);
+        pos += kEntryFixed;
+        if (end - pos < static_cast<size_t>(key_len) + value_len) {
+            LOG_ERROR("[DURABILITY] " << SnapshotPath() << " is truncated");
+            return false;
+        }
+        apply(data.substr(pos, key_len), data.substr(pos + key_len, value_len), timestamp);
+        pos += key_len + value_len;
+    }
+    return true;
+}
+
+} // namespace kvstore
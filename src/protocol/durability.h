@@ -0,0 +1,97 @@
+// Optional durability for the ABD server's store.
+// Every write is appended to a group-committed write-ahead log. A background
+// thread periodically snapshots the shard tables and retires the log
+// segments the snapshot covers, so restart only replays the log tail.
+//
+// Snapshots are fuzzy: the WAL is rotated first, then the shards are copied
+// one at a time while writes continue. Every write logged before the
+// rotation is already applied when its shard is copied (logging happens
+// under the shard lock), and every later write is in the new segments, so
+// loading the snapshot and replaying the new segments in order reproduces
+// the last value written to each key.
+//
+// Snapshot layout (little-endian):
+//   "KVSNAP01" | u64 first_wal_seq
+//   count x (u32 key_len | u32 value_len | i64 timestamp | key | value)
+//   u64 count | u32 crc32(everything before)
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "sharded_store.h"
+#include "wal.h"
+
+namespace kvstore {
+
+struct DurabilityOptions {
+    std::string dir;                                      // Data directory (created if missing)
+    WalSyncPolicy sync = WalSyncPolicy::BATCH;            // When log records reach the disk
+    std::chrono::milliseconds sync_interval{10};          // Flush period for INTERVAL / NONE
+    uint64_t snapshot_bytes = 64ull << 20;                // Log growth that triggers a snapshot
+};
+
+class DurabilityEngine {
+public:
+    using ApplyFn = WriteAheadLog::ApplyFn;
+
+    // @param options Data directory, sync policy and snapshot threshold
+    // @param store Store that snapshots are taken of
+    DurabilityEngine(DurabilityOptions options, const ShardedStore& store);
+
+    // Stops the snapshot thread and syncs the log.
+    ~DurabilityEngine();
+
+    DurabilityEngine(const DurabilityEngine&) = delete;
+    DurabilityEngine& operator=(const DurabilityEngine&) = delete;
+
+    // Recover the latest snapshot (memory-mapped) and replay the log tail,
+    // then start logging to a fresh segment.
+    // @param apply Called for every recovered key-value pair, in order
+    // @return false if the data directory or a snapshot could not be read
+    bool Open(const ApplyFn& apply);
+
+    // Log one write. Must be called while the key's shard lock is held so
+    // that log order matches apply order for the key.
+    // @return Log sequence number to pass to Sync
+    uint64_t Log(std::string_view key, std::string_view value, int64_t timestamp) {
+        return wal_->Append(key, value, timestamp);
+    }
+
+    // Wait until a logged write is durable (see WalSyncPolicy).
+    // Call without holding any store lock.
+    // @return false if the log could not be written
+    bool Sync(uint64_t lsn) { return wal_->Sync(lsn); }
+
+    // Take a snapshot now and retire the log segments it covers.
+    // @return false if the snapshot could not be written
+    bool Snapshot();
+
+private:
+    DurabilityOptions options_;
+    const ShardedStore& store_;
+    std::unique_ptr<WriteAheadLog> wal_;
+
+    std::mutex snapshot_mutex_;             // Serializes snapshots
+    std::mutex mutex_;                      // Protects stop_
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread snapshotter_;
+
+    // Snapshot thread: snapshots whenever the log has grown past snapshot_bytes.
+    void SnapshotLoop();
+
+    bool WriteSnapshot(uint64_t first_wal_seq);
+    bool LoadSnapshot(const ApplyFn& apply, uint64_t& first_wal_seq);
+
+    std::string SnapshotPath() const { return options_.dir + "/snapshot"; }
+};
+
+} // namespace kvstore
@@ -0,0 +1,30 @@
+// Merkle tree implementation.
+
+#include "merkle_tree.h"
+
+namespace kvstore {
+
+MerkleTree::MerkleTree() : leaves_(new std::atomic<uint64_t>[kLeaves]) {
+    for (size_t i = 0; i < kLeaves; i++) {
+        leaves_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t MerkleTree::NodesAt(size_t level) {
+    size_t nodes = 1;
+    for (size_t i = 0; i < level; i++) {
+        nodes *= kFanout;
+    }
+    return nodes;
+}
+
+std::vector<uint64_t> MerkleTree::Level(size_t level) const {
+    std::vector<uint64_t> nodes(NodesAt(level), 0);
+    size_t leaves_per_node = kLeaves / nodes.size();
+    for (size_t i = 0; i < kLeaves; i++) {
+        nodes[i / leaves_per_node] ^= leaves_[i].load(std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+} // namespace kvstore
@@ -0,0 +1,68 @@
+// Merkle tree over the consistent-hash ring, for anti-entropy between ABD
+// replicas. Every stored entry contributes a 64-bit digest of its key and
+// timestamp to the leaf its ring hash falls in (the top 12 bits, so 4096
+// leaves), and a node's hash is the XOR of every digest below it. XOR lets a
+// write update its leaf in place - take out the old version's digest, put in
+// the new one - with one atomic operation and no lock; inner nodes are folded
+// from the leaves only when a peer asks for them. Two servers holding the same
+// versions of the same keys have equal trees, whatever order the writes
+// reached them in.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace kvstore {
+
+class MerkleTree {
+public:
+    static constexpr size_t kFanout = 16;
+    static constexpr size_t kDepth = 3;                 // Levels below the root
+    static constexpr size_t kLeaves = 4096;             // kFanout^kDepth
+    static constexpr int kLeafShift = 52;               // Ring hash bits below a leaf's index
+
+    MerkleTree();
+    MerkleTree(const MerkleTree&) = delete;
+    MerkleTree& operator=(const MerkleTree&) = delete;
+
+    // Number of nodes on a level (0 = the root, kDepth = the leaves).
+    static size_t NodesAt(size_t level);
+
+    // Leaf holding a key with this ring hash (HashRing::Hash).
+    static size_t LeafOf(uint64_t key_hash) { return static_cast<size_t>(key_hash >> kLeafShift); }
+
+    // An entry changed version. Call under the lock that orders the key's
+    // writes, so the digest taken out is the one that was put in.
+    // @param key_hash Ring hash of the key
+    // @param old_timestamp Timestamp it was stored under (0 = not stored)
+    // @param new_timestamp Timestamp it is stored under now
+    void Update(uint64_t key_hash, int64_t old_timestamp, int64_t new_timestamp) {
+        uint64_t delta = Digest(key_hash, old_timestamp) ^ Digest(key_hash, new_timestamp);
+        leaves_[LeafOf(key_hash)].fetch_xor(delta, std::memory_order_relaxed);
+    }
+
+    // Hashes of every node on a level, folded from the current leaves.
+    std::vector<uint64_t> Level(size_t level) const;
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> leaves_;
+
+    // Digest of one version of a key; an absent key (timestamp 0) adds nothing.
+    static uint64_t Digest(uint64_t key_hash, int64_t timestamp) {
+        if (timestamp == 0) {
+            return 0;
+        }
+        // splitmix64 finish, so versions of nearby keys don't cancel out
+        uint64_t z = key_hash ^ (static_cast<uint64_t>(timestamp) * 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+} // namespace kvstore
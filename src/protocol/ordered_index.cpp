@@ -0,0 +1,138 @@
+// Ordered key index implementation.
+
+#include "ordered_index.h"
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+namespace kvstore {
+
+OrderedIndex::OrderedIndex() {
+    leaves_.push_back(std::make_unique<Leaf>());
+    root_ = leaves_.back().get();
+}
+
+OrderedIndex::~OrderedIndex() = default;
+
+bool OrderedIndex::Insert(std::string_view key) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    Split split;
+    if (!InsertInto(root_, key, split)) {
+        return false;
+    }
+    size_++;
+    if (split.right != nullptr) {
+        // The root split: grow the tree by a level
+        inners_.push_back(std::make_unique<Inner>());
+        Inner* root = inners_.back().get();
+        root->keys[0] = std::move(split.separator);
+        root->children[0] = root_;
+        root->children[1] = split.right;
+        root->count = 1;
+        root_ = root;
+    }
+    return true;
+}
+
+bool OrderedIndex::InsertInto(Node* node, std::string_view key, Split& split) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        auto begin = leaf->keys.begin();
+        auto pos = std::lower_bound(begin, begin + leaf->count, key,
+            [](const std::string& a, std::string_view b) { return a < b; });
+        if (pos != begin + leaf->count && *pos == key) {
+            return false;
+        }
+        std::move_backward(pos, begin + leaf->count, begin + leaf->count + 1);
+        *pos = std::string(key);
+        leaf->count++;
+        if (leaf->count <= kLeafKeys) {
+            return true;
+        }
+        // Move the upper half to a new leaf after this one
+        leaves_.push_back(std::make_unique<Leaf>());
+        Leaf* right = leaves_.back().get();
+        size_t keep = leaf->count / 2;
+        std::move(begin + keep, begin + leaf->count, right->keys.begin());
+        right->count = leaf->count - keep;
+        leaf->count = keep;
+        right->next = leaf->next;
+        leaf->next = right;
+        split.separator = right->keys[0];
+        split.right = right;
+        return true;
+    }
+    
+    Inner* inner = static_cast<Inner*>(node);
+    auto begin = inner->keys.begin();
+    size_t child = static_cast<size_t>(std::upper_bound(begin, begin + inner->count, key,
+        [](std::string_view a, const std::string& b) { return a < b; }) - begin);
+    Split below;
+    if (!InsertInto(inner->children[child], key, below)) {
+        return false;
+    }
+    if (below.right == nullptr) {
+        return true;
+    }
+    std::move_backward(begin + child, begin + inner->count, begin + inner->count + 1);
+    inner->keys[child] = std::move(below.separator);
+    std::copy_backward(inner->children.begin() + child + 1, inner->children.begin() + inner->count + 1,
+                       inner->children.begin() + inner->count + 2);
+    inner->children[child + 1] = below.right;
+    inner->count++;
+    if (inner->count <= kInnerKeys) {
+        return true;
+    }
+    // Keys left of the middle stay, the middle one moves up, the rest go right
+    inners_.push_back(std::make_unique<Inner>());
+    Inner* right = inners_.back().get();
+    size_t middle = inner->count / 2;
+    std::move(begin + middle + 1, begin + inner->count, right->keys.begin());
+    std::copy(inner->children.begin() + middle + 1, inner->children.begin() + inner->count + 1,
+              right->children.begin());
+    right->count = inner->count - middle - 1;
+    split.separator = std::move(inner->keys[middle]);
+    split.right = right;
+    inner->count = middle;
+    return true;
+}
+
+const OrderedIndex::Leaf* OrderedIndex::FindLeaf(std::string_view key) const {
+    const Node* node = root_;
+    while (!node->leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        auto begin = inner->keys.begin();
+        size_t child = static_cast<size_t>(std::upper_bound(begin, begin + inner->count, key,
+            [](std::string_view a, const std::string& b) { return a < b; }) - begin);
+        node = inner->children[child];
+    }
+    return static_cast<const Leaf*>(node);
+}
+
+std::vector<std::string> OrderedIndex::Range(std::string_view start, std::string_view end,
+                                             size_t limit) const {
+    std::vector<std::string> keys;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const Leaf* leaf = FindLeaf(start);
+    auto begin = leaf->keys.begin();
+    size_t i = static_cast<size_t>(std::lower_bound(begin, begin + leaf->count, start,
+        [](const std::string& a, std::string_view b) { return a < b; }) - begin);
+    while (leaf != nullptr && keys.size() < limit) {
+        for (; i < leaf->count && keys.size() < limit; i++) {
+            if (!end.empty() && leaf->keys[i] >= end) {
+                return keys;
+            }
+            keys.push_back(leaf->keys[i]);
+        }
+        leaf = leaf->next;
+        i = 0;
+    }
+    return keys;
+}
+
+size_t OrderedIndex::Size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return size_;
+}
+
+} // namespace kvstore
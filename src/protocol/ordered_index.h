@@ -0,0 +1,81 @@
+// Ordered index of the keys in a ShardedStore, for range scans.
+// The hash shards answer point lookups; this B+-tree only keeps the keys in
+// order. Keys sit in sorted arrays of up to 64 per leaf page (std::string
+// keeps short keys inline), and leaves are chained, so a scan reads pages
+// front to back instead of chasing one pointer per key as a red-black tree
+// would. Keys are never removed, like in the store.
+//
+// One reader/writer lock guards the tree. Only a write that adds a new key
+// takes it exclusively; scans share it.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kvstore {
+
+class OrderedIndex {
+public:
+    OrderedIndex();
+    ~OrderedIndex();
+
+    OrderedIndex(const OrderedIndex&) = delete;
+    OrderedIndex& operator=(const OrderedIndex&) = delete;
+
+    // Add a key.
+    // @return false if it was already there
+    bool Insert(std::string_view key);
+
+    // Keys in [start, end), ascending.
+    // @param end Upper bound, exclusive; empty = no bound
+    // @param limit Return at most this many keys
+    std::vector<std::string> Range(std::string_view start, std::string_view end, size_t limit) const;
+
+    // Number of keys.
+    size_t Size() const;
+
+private:
+    static constexpr size_t kLeafKeys = 64;
+    static constexpr size_t kInnerKeys = 64;
+
+    // Arrays have room for one key too many: a node is split right after
+    // the insert that overfills it.
+    struct Node {
+        bool leaf;
+        size_t count = 0;
+        explicit Node(bool is_leaf) : leaf(is_leaf) {}
+    };
+    struct Leaf : Node {
+        std::array<std::string, kLeafKeys + 1> keys;
+        Leaf* next = nullptr;
+        Leaf() : Node(true) {}
+    };
+    struct Inner : Node {
+        std::array<std::string, kInnerKeys + 1> keys;     // keys[i] is the smallest key under children[i + 1]
+        std::array<Node*, kInnerKeys + 2> children{};
+        Inner() : Node(false) {}
+    };
+
+    // A node split in two: the separator and the new right half.
+    struct Split {
+        std::string separator;
+        Node* right = nullptr;
+    };
+
+    mutable std::shared_mutex mutex_;
+    Node* root_;
+    size_t size_ = 0;
+    std::vector<std::unique_ptr<Leaf>> leaves_;     // Own every node
+    std::vector<std::unique_ptr<Inner>> inners_;
+
+    bool InsertInto(Node* node, std::string_view key, Split& split);
+    const Leaf* FindLeaf(std::string_view key) const;
+};
+
+} // namespace kvstore
@@ -0,0 +1,248 @@
+// Segment file implementation.
+
+#include "segment.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace kvstore {
+
+namespace {
+
+constexpr char kSegmentMagic[8] = {'K', 'V', 'S', 'E', 'G', '0', '0', '1'};
+constexpr char kFooterMagic[8] = {'K', 'V', 'S', 'E', 'G', 'E', 'N', 'D'};
+constexpr size_t kBlockHeader = 12;         // u32 payload_len + u32 entry_count + u32 crc
+constexpr size_t kEntryFixed = 16;          // u32 key_len + u32 value_len + i64 timestamp
+constexpr size_t kIndexFixed = 16;          // u64 offset + u32 entry_count + u32 first_key_len
+constexpr size_t kFooter = 36;              // 3 x u64 + u32 crc + magic
+
+template <typename T>
+void Put(std::string& out, T v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+void PutAt(std::string& out, size_t pos, T v) {
+    std::memcpy(&out[pos], &v, sizeof(v));
+}
+
+template <typename T>
+T Get(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+} // namespace
+
+SegmentWriter::SegmentWriter(std::string path) : path_(std::move(path)), tmp_path_(path_ + ".tmp") {
+}
+
+SegmentWriter::~SegmentWriter() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    if (!finished_) {
+        ::unlink(tmp_path_.c_str());
+    }
+}
+
+bool SegmentWriter::Open() {
+    fd_ = ::open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        return Fail("cannot create " + tmp_path_ + ": " + std::strerror(errno));
+    }
+    buffer_.append(kSegmentMagic, sizeof(kSegmentMagic));
+    return Flush();
+}
+
+bool SegmentWriter::Add(std::string_view key, std::string_view value, int64_t timestamp) {
+    if (fd_ < 0) {
+        return Fail("segment is not open");
+    }
+    if (entries_ > 0 && key <= last_key_) {
+        return Fail("keys out of order at '" + std::string(key) + "'");
+    }
+    if (block_entries_ == 0) {
+        index_.push_back({offset_, 0, std::string(key)});
+        buffer_.append(kBlockHeader, '\0');
+    }
+    Put<uint32_t>(buffer_, static_cast<uint32_t>(key.size()));
+    Put<uint32_t>(buffer_, static_cast<uint32_t>(value.size()));
+    Put<int64_t>(buffer_, timestamp);
+    buffer_.append(key);
+    buffer_.append(value);
+    block_entries_++;
+    entries_++;
+    last_key_.assign(key);
+    return buffer_.size() - kBlockHeader < kBlockBytes || CloseBlock();
+}
+
+bool SegmentWriter::CloseBlock() {
+    size_t payload = buffer_.size() - kBlockHeader;
+    PutAt<uint32_t>(buffer_, 0, static_cast<uint32_t>(payload));
+    PutAt<uint32_t>(buffer_, 4, block_entries_);
+    PutAt<uint32_t>(buffer_, 8, Crc32(0, buffer_.data() + kBlockHeader, payload));
+    index_.back().entries = block_entries_;
+    block_entries_ = 0;
+    return Flush();
+}
+
+bool SegmentWriter::Finish() {
+    if (fd_ < 0) {
+        return Fail("segment is not open");
+    }
+    if (block_entries_ > 0 && !CloseBlock()) {
+        return false;
+    }
+    uint64_t index_offset = offset_;
+    for (const auto& entry : index_) {
+        Put<uint64_t>(buffer_, entry.offset);
+        Put<uint32_t>(buffer_, entry.entries);
+        Put<uint32_t>(buffer_, static_cast<uint32_t>(entry.first_key.size()));
+        buffer_.append(entry.first_key);
+    }
+    Put<uint64_t>(buffer_, index_offset);
+    Put<uint64_t>(buffer_, index_.size());
+    Put<uint64_t>(buffer_, entries_);
+    Put<uint32_t>(buffer_, Crc32(0, buffer_.data(), buffer_.size()));
+    buffer_.append(kFooterMagic, sizeof(kFooterMagic));
+    if (!Flush()) {
+        return false;
+    }
+    if (fdatasync(fd_) != 0 || ::close(fd_) != 0) {
+        fd_ = -1;
+        return Fail("cannot sync " + tmp_path_ + ": " + std::strerror(errno));
+    }
+    fd_ = -1;
+    if (std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+        return Fail("cannot rename to " + path_ + ": " + std::strerror(errno));
+    }
+    finished_ = true;
+    return true;
+}
+
+bool SegmentWriter::Flush() {
+    size_t written = 0;
+    while (written < buffer_.size()) {
+        ssize_t n = ::write(fd_, buffer_.data() + written, buffer_.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return Fail("cannot write " + tmp_path_ + ": " + std::strerror(errno));
+        }
+        written += static_cast<size_t>(n);
+    }
+    offset_ += buffer_.size();
+    buffer_.clear();
+    return true;
+}
+
+bool SegmentWriter::Fail(const std::string& message) {
+    if (error_.empty()) {
+        error_ = message;
+    }
+    return false;
+}
+
+bool SegmentReader::Open(const std::string& path, std::string& error) {
+    if (!file_.Open(path)) {
+        error = "cannot map " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::string_view data = file_.Data();
+    if (data.size() < sizeof(kSegmentMagic) + kFooter ||
+        std::memcmp(data.data(), kSegmentMagic, sizeof(kSegmentMagic)) != 0 ||
+        std::memcmp(data.data() + data.size() - sizeof(kFooterMagic), kFooterMagic, sizeof(kFooterMagic)) != 0) {
+        error = path + " is not a segment file";
+        return false;
+    }
+    const char* footer = data.data() + data.size() - kFooter;
+    uint64_t index_offset = Get<uint64_t>(footer);
+    uint64_t block_count = Get<uint64_t>(footer + 8);
+    entries_ = Get<uint64_t>(footer + 16);
+    size_t index_end = data.size() - kFooter;
+    if (index_offset < sizeof(kSegmentMagic) || index_offset > index_end ||
+        Crc32(0, data.data() + index_offset, index_end + 24 - index_offset) != Get<uint32_t>(footer + 24)) {
+        error = path + ": index is corrupt";
+        return false;
+    }
+
+    // Blocks are only checked when they are read, so opening stays cheap
+    blocks_.clear();
+    size_t pos = index_offset;
+    for (uint64_t i = 0; i < block_count; i++) {
+        if (index_end - pos < kIndexFixed) {
+            error = path + ": index is truncated";
+            return false;
+        }
+        uint64_t offset = Get<uint64_t>(data.data() + pos);
+        uint32_t entries = Get<uint32_t>(data.data() + pos + 8);
+        uint32_t key_len = Get<uint32_t>(data.data() + pos + 12);
+        pos += kIndexFixed;
+        if (index_end - pos < key_len || offset < sizeof(kSegmentMagic) || offset > index_offset ||
+            index_offset - offset < kBlockHeader) {
+            error = path + ": index is truncated";
+            return false;
+        }
+        uint32_t payload_len = Get<uint32_t>(data.data() + offset);
+        if (index_offset - offset - kBlockHeader < payload_len ||
+            Get<uint32_t>(data.data() + offset + 4) != entries) {
+            error = path + ": block " + std::to_string(i) + " doesn't match the index";
+            return false;
+        }
+        blocks_.push_back({data.substr(offset + kBlockHeader, payload_len), entries,
+                           Get<uint32_t>(data.data() + offset + 8), data.substr(pos, key_len)});
+        pos += key_len;
+    }
+    return true;
+}
+
+bool SegmentReader::ForEachInBlock(size_t block, const EntryFn& fn) const {
+    const Block& b = blocks_[block];
+    if (Crc32(0, b.payload.data(), b.payload.size()) != b.crc) {
+        return false;
+    }
+    size_t pos = 0;
+    for (uint32_t i = 0; i < b.entries; i++) {
+        if (b.payload.size() - pos < kEntryFixed) {
+            return false;
+        }
+        uint32_t key_len = Get<uint32_t>(b.payload.data() + pos);
+        uint32_t value_len = Get<uint32_t>(b.payload.data() + pos + 4);
+        int64_t timestamp = Get<int64_t>(b.payload.data() + pos + 8);
+        pos += kEntryFixed;
+        if (b.payload.size() - pos < static_cast<size_t>(key_len) + value_len) {
+            return false;
+        }
+        fn(b.payload.substr(pos, key_len), b.payload.substr(pos + key_len, value_len), timestamp);
+        pos += key_len + value_len;
+    }
+    return true;
+}
+
+bool SegmentReader::Find(std::string_view key, std::string& value, int64_t& timestamp) const {
+    // The last block whose first key is at or below `key`
+    auto after = std::upper_bound(blocks_.begin(), blocks_.end(), key,
+        [](std::string_view k, const Block& b) { return k < b.first_key; });
+    if (after == blocks_.begin()) {
+        return false;
+    }
+    bool found = false;
+    ForEachInBlock(static_cast<size_t>(after - blocks_.begin()) - 1,
+        [&](std::string_view k, std::string_view v, int64_t ts) {
+            if (!found && k == key) {
+                value.assign(v);
+                timestamp = ts;
+                found = true;
+            }
+        });
+    return found;
+}
+
+} // namespace kvstore
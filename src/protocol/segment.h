@@ -0,0 +1,125 @@
+// Segment files: sorted, checksummed key-value files for bulk loads and
+// backups (ABD ImportSegment / ExportSegment and the bulk tool).
+// Entries are written in strictly increasing key order and grouped into
+// blocks of about kBlockBytes, each with its own CRC, so a reader can check
+// and use blocks independently: a server maps the file and merges its blocks
+// from several threads straight out of the mapping, without copying them.
+// An index of every block's first key sits in a footer, so one key can be
+// found with a binary search and a single block scan.
+//
+// Layout (little-endian):
+//   "KVSEG001"
+//   blocks: u32 payload_len | u32 entry_count | u32 crc32(payload) | payload
+//     payload = entry_count x (u32 key_len | u32 value_len | i64 timestamp | key | value)
+//   index: block_count x (u64 block_offset | u32 entry_count | u32 first_key_len | first_key)
+//   footer: u64 index_offset | u64 block_count | u64 entry_count |
+//           u32 crc32(index + the three fields) | "KVSEGEND"
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "wal.h"
+#include "../common/mapped_file.h"
+
+namespace kvstore {
+
+class SegmentWriter {
+public:
+    // Target payload size of a block
+    static constexpr size_t kBlockBytes = 64 << 10;
+
+    // @param path Segment to create; written as path.tmp and renamed by Finish
+    explicit SegmentWriter(std::string path);
+
+    // Removes the temporary file unless Finish succeeded.
+    ~SegmentWriter();
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    // @return false if the file could not be created (see Error)
+    bool Open();
+
+    // Append an entry.
+    // @return false if the key is not above the previous one or the write failed
+    bool Add(std::string_view key, std::string_view value, int64_t timestamp);
+
+    // Write the last block and the index, sync, and rename into place.
+    // @return false if anything failed (see Error)
+    bool Finish();
+
+    const std::string& Error() const { return error_; }
+    uint64_t Entries() const { return entries_; }
+    uint64_t Bytes() const { return offset_ + buffer_.size(); }
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint32_t entries;
+        std::string first_key;
+    };
+
+    std::string path_;
+    std::string tmp_path_;
+    int fd_ = -1;
+    bool finished_ = false;
+    std::string error_;
+
+    std::string buffer_;                // The block being filled, header first
+    uint32_t block_entries_ = 0;
+    uint64_t offset_ = 0;               // File bytes written so far
+    uint64_t entries_ = 0;
+    std::string last_key_;
+    std::vector<IndexEntry> index_;
+
+    // Fill in the current block's header and write the block out; the next
+    // Add starts a new one.
+    bool CloseBlock();
+
+    // Write out and clear buffer_.
+    bool Flush();
+
+    bool Fail(const std::string& message);
+};
+
+class SegmentReader {
+public:
+    using EntryFn = WriteAheadLog::ApplyFn;
+
+    // Map a segment and check its footer and index.
+    // @param error Set to why the segment can't be used
+    bool Open(const std::string& path, std::string& error);
+
+    size_t NumBlocks() const { return blocks_.size(); }
+    uint64_t NumEntries() const { return entries_; }
+
+    // First key of a block (its index entry).
+    std::string_view FirstKey(size_t block) const { return blocks_[block].first_key; }
+
+    // Check a block's CRC and visit its entries in key order. The views
+    // point into the mapping and stay valid while the reader is open.
+    // @return false if the block is corrupt (on a CRC mismatch fn is not called)
+    bool ForEachInBlock(size_t block, const EntryFn& fn) const;
+
+    // Look up one key.
+    // @return true if the segment has it
+    bool Find(std::string_view key, std::string& value, int64_t& timestamp) const;
+
+private:
+    struct Block {
+        std::string_view payload;
+        uint32_t entries;
+        uint32_t crc;
+        std::string_view first_key;
+    };
+
+    MappedFile file_;
+    std::vector<Block> blocks_;
+    uint64_t entries_ = 0;
+};
+
+} // namespace kvstore
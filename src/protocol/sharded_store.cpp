@@ -0,0 +1,130 @@
+// Sharded storage engine implementation.
+
+#include "sharded_store.h"
+#include <utility>
+
+namespace kvstore {
+
+namespace {
+
+// Round up to the next power of two (minimum 1).
+size_t RoundUpPow2(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+} // namespace
+
+ShardedStore::ShardedStore(size_t num_shards)
+    : shards_(RoundUpPow2(num_shards == 0 ? 1 : num_shards)),
+      shard_mask_(shards_.size() - 1) {
+}
+
+uint64_t ShardedStore::Hash(std::string_view key) {
+    // std::hash may be weak in the low bits; finish with a 64-bit mixer
+    // (splitmix64) so both the shard and the slot bits are well spread.
+    uint64_t h = std::hash<std::string_view>{}(key);
+    h += 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+const ShardedStore::Slot* ShardedStore::Shard::Find(std::string_view key, uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (!slot.used) {
+            return nullptr;     // Tables never fill up, so probing always ends
+        }
+        if (slot.hash == hash && slot.key == key) {
+            return &slot;
+        }
+    }
+}
+
+ShardedStore::Slot* ShardedStore::Shard::Find(std::string_view key, uint64_t hash) {
+    return const_cast<Slot*>(static_cast<const Shard*>(this)->Find(key, hash));
+}
+
+ShardedStore::Slot& ShardedStore::Shard::FindOrInsert(std::string_view key, uint64_t hash) {
+    // Keep the load factor at or below 3/4
+    if ((count + 1) * 4 > slots.size() * 3) {
+        Grow();
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (!slot.used) {
+            slot.used = true;
+            slot.hash = hash;
+            slot.key.Assign(key, slab);
+            slot.entry.slab = &slab;
+            count++;
+            return slot;
+        }
+        if (slot.hash == hash && slot.key == key) {
+            return slot;
+        }
+    }
+}
+
+void ShardedStore::Shard::Grow() {
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (auto& slot : old) {
+        if (!slot.used) {
+            continue;
+        }
+        size_t i = slot.hash & mask;
+        while (slots[i].used) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = std::move(slot);
+    }
+}
+
+void ShardedStore::ForEach(const std::function<void(std::string_view, const Entry&)>& fn) const {
+    for (size_t s = 0; s < shards_.size(); s++) {
+        ForEachInShard(s, fn);
+    }
+}
+
+void ShardedStore::ForEachInShard(size_t shard_index,
+                                  const std::function<void(std::string_view, const Entry&)>& fn) const {
+    const Shard& shard = shards_[shard_index];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    for (const auto& slot : shard.slots) {
+        if (slot.used) {
+            fn(slot.key, slot.entry);
+        }
+    }
+}
+
+size_t ShardedStore::Size() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        total += shard.count;
+    }
+    return total;
+}
+
+ShardedStore::Stats ShardedStore::GetStats() const {
+    Stats stats;
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        stats.keys += shard.count;
+        stats.stored_bytes += shard.slab.StoredBytes();
+        stats.table_bytes += shard.slots.size() * sizeof(Slot) + shard.slab.PageBytes();
+    }
+    stats.lock_acquisitions = lock_acquisitions_.Value();
+    stats.lock_wait_ns = lock_wait_ns_.Read();
+    return stats;
+}
+
+} // namespace kvstore
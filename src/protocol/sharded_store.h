@@ -0,0 +1,273 @@
+// Sharded, lock-striped storage engine shared by the ABD and blocking servers.
+// Keys are spread over a fixed number of shards by hash. Each shard is an
+// open-addressing (linear probing) hash table guarded by its own reader/writer
+// lock, so requests for different keys rarely contend and reads of the same
+// shard run in parallel.
+//
+// Keys and values are stored in a per-shard slab (value_slab.h): short ones
+// inline in the slot, longer ones in size-classed chunks, so a write rarely
+// touches the general-purpose allocator.
+//
+// Keys are never removed: a lock release just clears the inline lock fields,
+// and a key that was only locked looks the same as a missing key (empty value,
+// timestamp 0). That keeps the tables free of tombstones.
+//
+// Every shard lock is first tried without blocking; only when that fails is
+// the wait timed, so the uncontended path pays one counter increment.
+// With --profile every acquisition and the work done under it are also timed
+// as the profiler's lock wait and store op stages.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "value_slab.h"
+#include "version_chain.h"
+#include "../common/metrics.h"
+#include "../common/profiler.h"
+
+namespace kvstore {
+
+class ShardedStore {
+public:
+    // A lock request parked until the key's lock is handed to it.
+    struct LockWaiter {
+        uint64_t id;                        // Unique per parked request
+        int32_t client_id;                  // Client that asked for the lock
+        std::chrono::milliseconds lease;    // Lease to grant it with
+        std::function<void(bool granted)> wake;  // Completes the parked request
+    };
+
+    // One stored key. Lock fields are only used by the blocking protocol.
+    struct Entry {
+        SlabString value;                   // The stored value
+        int64_t timestamp = 0;              // Timestamp for ordering
+        int32_t lock_owner = -1;            // Client holding the lock (-1 = unlocked)
+        std::chrono::steady_clock::time_point lock_expires_at;   // When the holder's lease runs out
+        std::unique_ptr<std::deque<LockWaiter>> lock_waiters;    // FIFO; null when nobody waits
+        VersionChain versions;              // Superseded versions; only kept by ABD
+        ValueSlab* slab = nullptr;          // The shard's slab, which holds value's bytes
+
+        void SetValue(std::string_view new_value) { value.Assign(new_value, *slab); }
+    };
+
+    // @param num_shards Number of independent shards (rounded up to a power of two)
+    explicit ShardedStore(size_t num_shards = DEFAULT_SHARDS);
+
+    ShardedStore(const ShardedStore&) = delete;
+    ShardedStore& operator=(const ShardedStore&) = delete;
+
+    // Look up a key under the shard's shared lock.
+    // @param key The key to look up
+    // @param fn Called as fn(const Entry&) if the key exists
+    // @return true if the key exists
+    template <typename Fn>
+    bool Read(std::string_view key, Fn&& fn) const {
+        uint64_t hash = Hash(key);
+        const Shard& shard = ShardFor(hash);
+        auto lock = LockShard<std::shared_lock<std::shared_mutex>>(shard);
+        profile::ScopedStage op(profile::STORE_OP);
+        const Slot* slot = shard.Find(key, hash);
+        if (slot == nullptr) {
+            return false;
+        }
+        fn(slot->entry);
+        return true;
+    }
+
+    // Modify a key under the shard's exclusive lock, inserting it if missing.
+    // @param key The key to modify
+    // @param fn Called as fn(Entry&); its return value is passed through
+    template <typename Fn>
+    auto Update(std::string_view key, Fn&& fn) -> decltype(fn(std::declval<Entry&>())) {
+        uint64_t hash = Hash(key);
+        Shard& shard = ShardFor(hash);
+        auto lock = LockShard<std::unique_lock<std::shared_mutex>>(shard);
+        profile::ScopedStage op(profile::STORE_OP);
+        return fn(shard.FindOrInsert(key, hash).entry);
+    }
+
+    // Modify a key under the shard's exclusive lock without inserting it.
+    // @param key The key to modify
+    // @param fn Called as fn(Entry&) if the key exists
+    // @return true if the key exists
+    template <typename Fn>
+    bool UpdateExisting(std::string_view key, Fn&& fn) {
+        uint64_t hash = Hash(key);
+        Shard& shard = ShardFor(hash);
+        auto lock = LockShard<std::unique_lock<std::shared_mutex>>(shard);
+        profile::ScopedStage op(profile::STORE_OP);
+        Slot* slot = shard.Find(key, hash);
+        if (slot == nullptr) {
+            return false;
+        }
+        fn(slot->entry);
+        return true;
+    }
+
+    // Look up a batch of keys, taking each shard's shared lock once.
+    // Keys in the same shard are visited in batch order.
+    // @param count Number of keys in the batch
+    // @param key_at Called as key_at(i) to get the i-th key (string or string_view)
+    // @param fn Called as fn(i, const Entry*) for every key; nullptr if missing
+    template <typename KeyFn, typename Fn>
+    void ReadBatch(size_t count, KeyFn&& key_at, Fn&& fn) const {
+        std::vector<uint64_t> hashes;
+        std::vector<size_t> order = GroupByShard(count, key_at, hashes);
+        for (size_t start = 0; start < order.size();) {
+            const Shard& shard = ShardFor(hashes[order[start]]);
+            auto lock = LockShard<std::shared_lock<std::shared_mutex>>(shard);
+            profile::ScopedStage op(profile::STORE_OP);
+            size_t end = start;
+            for (; end < order.size() && &ShardFor(hashes[order[end]]) == &shard; end++) {
+                size_t i = order[end];
+                const Slot* slot = shard.Find(key_at(i), hashes[i]);
+                fn(i, slot != nullptr ? &slot->entry : nullptr);
+            }
+            start = end;
+        }
+    }
+
+    // Modify a batch of keys, inserting missing ones and taking each shard's
+    // exclusive lock once. Keys in the same shard (and so repeated keys) are
+    // applied in batch order.
+    // @param count Number of keys in the batch
+    // @param key_at Called as key_at(i) to get the i-th key (string or string_view)
+    // @param fn Called as fn(i, Entry&) for every key
+    template <typename KeyFn, typename Fn>
+    void UpdateBatch(size_t count, KeyFn&& key_at, Fn&& fn) {
+        std::vector<uint64_t> hashes;
+        std::vector<size_t> order = GroupByShard(count, key_at, hashes);
+        for (size_t start = 0; start < order.size();) {
+            Shard& shard = ShardFor(hashes[order[start]]);
+            auto lock = LockShard<std::unique_lock<std::shared_mutex>>(shard);
+            profile::ScopedStage op(profile::STORE_OP);
+            size_t end = start;
+            for (; end < order.size() && &ShardFor(hashes[order[end]]) == &shard; end++) {
+                size_t i = order[end];
+                fn(i, shard.FindOrInsert(key_at(i), hashes[i]).entry);
+            }
+            start = end;
+        }
+    }
+
+    // Visit every key, one shard at a time (each shard under its shared lock).
+    // @param fn Called as fn(std::string_view key, const Entry&)
+    void ForEach(const std::function<void(std::string_view, const Entry&)>& fn) const;
+
+    // Visit the keys of one shard under its shared lock, so a long scan can
+    // let go of the store between shards.
+    // @param shard_index Shard to visit, below NumShards()
+    // @param fn Called as fn(std::string_view key, const Entry&)
+    void ForEachInShard(size_t shard_index,
+                        const std::function<void(std::string_view, const Entry&)>& fn) const;
+
+    // Number of keys stored across all shards.
+    size_t Size() const;
+
+    size_t NumShards() const { return shards_.size(); }
+    
+    // Shard a key is stored in, below NumShards().
+    size_t ShardOf(std::string_view key) const { return ShardIndex(Hash(key)); }
+
+    // Size and lock contention figures for the metrics endpoint.
+    struct Stats {
+        size_t keys = 0;
+        size_t stored_bytes = 0;            // Key and value bytes
+        size_t table_bytes = 0;             // Slot arrays plus slab pages (values over 4 KB not included)
+        uint64_t lock_acquisitions = 0;     // Shard locks taken by the Read / Update family
+        LogHistogram::Snapshot lock_wait_ns;    // Waits of the acquisitions that found the lock taken
+    };
+
+    // Walks every shard under its shared lock.
+    Stats GetStats() const;
+
+    static constexpr size_t DEFAULT_SHARDS = 64;
+
+private:
+    struct Slot {
+        bool used = false;
+        uint64_t hash = 0;
+        SlabString key;
+        Entry entry;
+    };
+
+    // Aligned so neighbouring shards' locks don't share a cache line.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        ValueSlab slab;                     // Key and value bytes; outlives the slots
+        std::vector<Slot> slots;            // Capacity is always a power of two
+        size_t count = 0;
+
+        Shard() : slots(INITIAL_CAPACITY) {}
+
+        const Slot* Find(std::string_view key, uint64_t hash) const;
+        Slot* Find(std::string_view key, uint64_t hash);
+        Slot& FindOrInsert(std::string_view key, uint64_t hash);
+        void Grow();
+    };
+
+    std::vector<Shard> shards_;
+    size_t shard_mask_;
+    mutable Counter lock_acquisitions_;
+    mutable LogHistogram lock_wait_ns_;
+
+    // Take a shard's lock (Lock is std::shared_lock or std::unique_lock),
+    // timing the wait if it is held.
+    template <typename Lock>
+    Lock LockShard(const Shard& shard) const {
+        profile::ScopedStage wait(profile::LOCK_WAIT);
+        Lock lock(shard.mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            lock_wait_ns_.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count()));
+        }
+        lock_acquisitions_.Add();
+        return lock;
+    }
+
+    static uint64_t Hash(std::string_view key);
+
+    size_t ShardIndex(uint64_t hash) const { return (hash >> 48) & shard_mask_; }
+
+    // Hash every key of a batch and return the batch indices ordered by
+    // shard (stable, so batch order is kept within a shard).
+    template <typename KeyFn>
+    std::vector<size_t> GroupByShard(size_t count, KeyFn& key_at, std::vector<uint64_t>& hashes) const {
+        // Counting sort by shard index
+        hashes.resize(count);
+        std::vector<size_t> offsets(shards_.size() + 1, 0);
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = Hash(key_at(i));
+            offsets[ShardIndex(hashes[i]) + 1]++;
+        }
+        for (size_t s = 1; s < offsets.size(); s++) {
+            offsets[s] += offsets[s - 1];
+        }
+        std::vector<size_t> order(count);
+        for (size_t i = 0; i < count; i++) {
+            order[offsets[ShardIndex(hashes[i])]++] = i;
+        }
+        return order;
+    }
+
+    // Shard choice uses the high hash bits; slot choice inside a shard uses
+    // the low bits, so the two stay independent.
+    const Shard& ShardFor(uint64_t hash) const { return shards_[ShardIndex(hash)]; }
+    Shard& ShardFor(uint64_t hash) { return shards_[ShardIndex(hash)]; }
+
+    static constexpr size_t INITIAL_CAPACITY = 16;
+};
+
+} // namespace kvstore
@@ -0,0 +1,87 @@
+// Slab storage implementation.
+
+#include "value_slab.h"
+#include <algorithm>
+
+namespace kvstore {
+
+constexpr std::array<size_t, ValueSlab::kNumClasses> ValueSlab::kClassSizes;
+
+uint8_t ValueSlab::ClassFor(size_t size) {
+    if (size > kMaxChunk) {
+        return kLargeClass;
+    }
+    auto it = std::lower_bound(kClassSizes.begin(), kClassSizes.end(), size);
+    return static_cast<uint8_t>(it - kClassSizes.begin());
+}
+
+char* ValueSlab::Allocate(uint8_t size_class) {
+    ClassState& state = classes_[size_class];
+    if (state.free != nullptr) {
+        FreeChunk* chunk = state.free;
+        state.free = chunk->next;
+        return reinterpret_cast<char*>(chunk);
+    }
+    size_t chunk_size = kClassSizes[size_class];
+    if (state.bump == nullptr || state.bump + chunk_size > state.end) {
+        // Left uninitialized so untouched chunks don't count towards RSS
+        pages_.emplace_back(new char[kPageSize]);
+        state.bump = pages_.back().get();
+        state.end = state.bump + kPageSize / chunk_size * chunk_size;
+    }
+    char* chunk = state.bump;
+    state.bump += chunk_size;
+    return chunk;
+}
+
+void ValueSlab::Free(char* chunk, uint8_t size_class) {
+    ClassState& state = classes_[size_class];
+    auto* node = reinterpret_cast<FreeChunk*>(chunk);
+    node->next = state.free;
+    state.free = node;
+}
+
+void SlabString::Assign(std::string_view value, ValueSlab& slab) {
+    size_t size = value.size();
+    slab.stored_bytes_ += size;
+    slab.stored_bytes_ -= size_;
+    if (!IsInline()) {
+        // Overwrite in place while the new value uses at least half the chunk
+        size_t capacity = size_class_ == ValueSlab::kLargeClass ? size_
+                                                                : ValueSlab::ClassSize(size_class_);
+        if (size <= capacity && size > capacity / 2) {
+            std::memmove(Heap(), value.data(), size);
+            size_ = static_cast<uint32_t>(size);
+            return;
+        }
+    }
+
+    // `value` may point into the old chunk, so copy before releasing it
+    char* old_chunk = IsInline() ? nullptr : Heap();
+    uint8_t old_class = size_class_;
+    if (size <= kInlineCapacity) {
+        std::memmove(buf_, value.data(), size);
+        size_class_ = kInlineClass;
+    } else {
+        uint8_t size_class = ValueSlab::ClassFor(size);
+        char* chunk = size_class == ValueSlab::kLargeClass ? new char[size] : slab.Allocate(size_class);
+        std::memcpy(chunk, value.data(), size);
+        SetHeap(chunk);
+        size_class_ = size_class;
+    }
+    size_ = static_cast<uint32_t>(size);
+    Release(old_chunk, old_class, slab);
+}
+
+void SlabString::Release(char* chunk, uint8_t size_class, ValueSlab& slab) {
+    if (chunk == nullptr) {
+        return;
+    }
+    if (size_class == ValueSlab::kLargeClass) {
+        delete[] chunk;
+    } else {
+        slab.Free(chunk, size_class);
+    }
+}
+
+} // namespace kvstore
@@ -0,0 +1,142 @@
+// Slab storage for the keys and values of a ShardedStore shard.
+// Strings of up to 11 bytes live inline in their 16-byte SlabString. Longer
+// ones up to 4 KB get a chunk from one of the shard's size classes (8-byte
+// steps up to 64, then four per power of two, so at most ~25% of a chunk goes
+// unused): chunks are carved from 64 KB pages and recycled through a per-class
+// free list, so there is no per-string allocator header, and an overwrite that
+// still fits the chunk reuses it in place. Anything larger goes to operator new.
+//
+// A shard's slab is only touched under the shard's exclusive lock, so it has
+// no locking of its own. Pages are kept until the slab is destroyed.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kvstore {
+
+class ValueSlab {
+public:
+    static constexpr size_t kNumClasses = 30;
+    static constexpr uint8_t kLargeClass = 0xFF;     // Not from the slab: operator new
+    static constexpr size_t kMaxChunk = 4096;
+    static constexpr size_t kPageSize = 64 * 1024;
+
+    ValueSlab() = default;
+    ValueSlab(const ValueSlab&) = delete;
+    ValueSlab& operator=(const ValueSlab&) = delete;
+
+    // Size class for a string of `size` bytes (kLargeClass above kMaxChunk).
+    static uint8_t ClassFor(size_t size);
+
+    // Chunk capacity of a size class (not kLargeClass).
+    static size_t ClassSize(uint8_t size_class) { return kClassSizes[size_class]; }
+
+    // Take a chunk of a size class (not kLargeClass).
+    char* Allocate(uint8_t size_class);
+
+    // Return a chunk taken with Allocate(size_class).
+    void Free(char* chunk, uint8_t size_class);
+
+    // Bytes of every string currently assigned through this slab (inline and large ones included).
+    size_t StoredBytes() const { return stored_bytes_; }
+
+    // Bytes of the pages chunks are carved from, used or not.
+    size_t PageBytes() const { return pages_.size() * kPageSize; }
+
+private:
+    friend class SlabString;        // Keeps stored_bytes_ up to date
+
+    static constexpr std::array<size_t, kNumClasses> kClassSizes = {
+        24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320,
+        384, 448, 512, 640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096};
+
+    struct FreeChunk {
+        FreeChunk* next;
+    };
+
+    struct ClassState {
+        FreeChunk* free = nullptr;          // Recycled chunks
+        char* bump = nullptr;               // Next unused chunk in the current page
+        char* end = nullptr;                // End of the current page's chunks
+    };
+
+    std::array<ClassState, kNumClasses> classes_{};
+    std::vector<std::unique_ptr<char[]>> pages_;
+    size_t stored_bytes_ = 0;
+};
+
+// A string whose out-of-line bytes come from a ValueSlab. The slab isn't
+// stored (that would cost 8 bytes per string), so Assign() takes it; it must
+// be the same slab every time. Moving swaps contents, so a moved-from string
+// holds what the target held.
+class SlabString {
+public:
+    static constexpr size_t kInlineCapacity = 11;
+
+    SlabString() = default;
+    ~SlabString() {
+        // Slab chunks go away with their pages; only large buffers are owned
+        if (size_class_ == ValueSlab::kLargeClass) {
+            delete[] Heap();
+        }
+    }
+
+    SlabString(const SlabString&) = delete;
+    SlabString& operator=(const SlabString&) = delete;
+    SlabString(SlabString&& other) noexcept { Swap(other); }
+    SlabString& operator=(SlabString&& other) noexcept {
+        Swap(other);
+        return *this;
+    }
+
+    // Replace the contents (`value` may point into this string).
+    void Assign(std::string_view value, ValueSlab& slab);
+
+    const char* data() const { return IsInline() ? buf_ : Heap(); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    operator std::string_view() const { return std::string_view(data(), size_); }
+
+    bool operator==(std::string_view other) const {
+        return size_ == other.size() && std::memcmp(data(), other.data(), size_) == 0;
+    }
+
+private:
+    static constexpr uint8_t kInlineClass = 0xFE;
+
+    char buf_[kInlineCapacity] = {};    // Inline bytes, or the chunk pointer (unaligned)
+    uint8_t size_class_ = kInlineClass;
+    uint32_t size_ = 0;
+
+    bool IsInline() const { return size_class_ == kInlineClass; }
+
+    char* Heap() const {
+        char* chunk;
+        std::memcpy(&chunk, buf_, sizeof(chunk));
+        return chunk;
+    }
+
+    void SetHeap(char* chunk) { std::memcpy(buf_, &chunk, sizeof(chunk)); }
+
+    // Give back a chunk of the given class (no-op for nullptr).
+    static void Release(char* chunk, uint8_t size_class, ValueSlab& slab);
+
+    void Swap(SlabString& other) noexcept {
+        std::swap(buf_, other.buf_);
+        std::swap(size_class_, other.size_class_);
+        std::swap(size_, other.size_);
+    }
+};
+
+static_assert(sizeof(SlabString) == 16, "SlabString should stay two words");
+
+} // namespace kvstore
@@ -0,0 +1,63 @@
+// Version chain implementation.
+
+#include "version_chain.h"
+#include <algorithm>
+#include <utility>
+
+namespace kvstore {
+
+void VersionChain::Push(int64_t timestamp, SlabString& value, size_t capacity) {
+    capacity = std::min(capacity, kMaxVersions);
+    if (capacity == 0) {
+        complete_ = false;
+        return;
+    }
+    if (!versions_) {
+        versions_.reset(new Version[capacity]);
+        capacity_ = static_cast<uint8_t>(capacity);
+    }
+    Version* slot;
+    if (count_ == capacity_) {
+        // Reuse the oldest version's slot; its bytes go back to the caller
+        slot = &At(0);
+        head_ = static_cast<uint8_t>((head_ + 1) % capacity_);
+        complete_ = false;
+    } else {
+        slot = &At(count_);
+        count_++;
+    }
+    slot->timestamp = timestamp;
+    std::swap(slot->value, value);
+}
+
+void VersionChain::Compact(int64_t current_timestamp, int64_t horizon, ValueSlab& slab) {
+    // A version stays visible until its successor is written
+    while (count_ > 0) {
+        int64_t superseded_at = count_ > 1 ? At(1).timestamp : current_timestamp;
+        if (superseded_at >= horizon) {
+            break;
+        }
+        DropOldest(slab);
+    }
+}
+
+VersionChain::Lookup VersionChain::Find(int64_t timestamp, const Version*& version) const {
+    for (size_t i = count_; i > 0; i--) {
+        if (At(i - 1).timestamp <= timestamp) {
+            version = &At(i - 1);
+            return Lookup::kFound;
+        }
+    }
+    return complete_ ? Lookup::kNotStored : Lookup::kTooOld;
+}
+
+void VersionChain::DropOldest(ValueSlab& slab) {
+    Version& oldest = At(0);
+    oldest.value.Assign({}, slab);
+    oldest.timestamp = 0;
+    head_ = static_cast<uint8_t>((head_ + 1) % capacity_);
+    count_--;
+    complete_ = false;
+}
+
+} // namespace kvstore
@@ -0,0 +1,81 @@
+// Bounded chain of a key's superseded versions, for snapshot reads (ABD).
+// An overwritten value is not copied into the chain: its SlabString is
+// swapped into a ring of version slots, and the slot's previous contents
+// (the version the ring evicts, if it is full) are handed back for the new
+// value to reuse. The ring is allocated once per key, on its first
+// overwrite, at the store's version limit; after that keeping history costs
+// no allocations beyond the slab chunks the values already take.
+//
+// Versions are dropped oldest first, when the ring is full or once they have
+// been superseded for longer than the retention (Compact). A chain remembers
+// whether it still reaches back to the key's first version, so a read below
+// its oldest version can tell "the key didn't exist yet" from "too old".
+//
+// Like the entry it belongs to, a chain is only touched under its shard's lock.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "value_slab.h"
+
+namespace kvstore {
+
+class VersionChain {
+public:
+    static constexpr size_t kMaxVersions = 255;
+
+    struct Version {
+        int64_t timestamp = 0;
+        SlabString value;
+    };
+
+    // Outcome of looking up the version current at a timestamp
+    enum class Lookup {
+        kFound,         // A kept version was current then
+        kNotStored,     // The key didn't exist yet
+        kTooOld,        // That version was dropped (or never kept)
+    };
+
+    VersionChain() = default;
+
+    // Keep the version an overwrite is replacing. Its bytes move into the
+    // chain; `value` gets back the evicted version's bytes (or nothing),
+    // which the caller then overwrites.
+    // @param timestamp Timestamp of the version being replaced
+    // @param value The entry's value, about to be overwritten
+    // @param capacity Most versions to keep, at most kMaxVersions
+    void Push(int64_t timestamp, SlabString& value, size_t capacity);
+
+    // Drop the versions that stopped being current before `horizon`.
+    // @param current_timestamp Timestamp of the entry's current version
+    // @param horizon Oldest timestamp snapshot reads must still see
+    void Compact(int64_t current_timestamp, int64_t horizon, ValueSlab& slab);
+
+    // Find the newest version at or below `timestamp`. Only asked about
+    // timestamps below the entry's current version.
+    // @param version Set on kFound
+    Lookup Find(int64_t timestamp, const Version*& version) const;
+
+    // The key was created with this chain tracking it, so until a version
+    // is dropped the chain holds its whole history.
+    void MarkComplete() { complete_ = true; }
+
+    size_t Size() const { return count_; }
+
+private:
+    std::unique_ptr<Version[]> versions_;   // Ring, oldest at head_; null until the first Push
+    uint8_t capacity_ = 0;
+    uint8_t head_ = 0;
+    uint8_t count_ = 0;
+    bool complete_ = false;                 // No version older than the ring's was ever stored
+
+    Version& At(size_t i) { return versions_[(head_ + i) % capacity_]; }
+    const Version& At(size_t i) const { return versions_[(head_ + i) % capacity_]; }
+
+    // Forget the oldest version, giving back its bytes.
+    void DropOldest(ValueSlab& slab);
+};
+
+} // namespace kvstore
@@ -0,0 +1,340 @@
+// Write-ahead log implementation.
+
+#include "wal.h"
+#include "../common/logging.h"
+#include "../common/mapped_file.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace kvstore {
+
+namespace {
+
+constexpr size_t kHeaderSize = 8;           // u32 payload_len + u32 crc
+constexpr size_t kPayloadFixed = 12;        // i64 timestamp + u32 key_len
+
+// Wake the flusher early once this much is buffered (INTERVAL / NONE)
+constexpr size_t kEagerFlushBytes = 1 << 20;
+
+std::array<uint32_t, 256> MakeCrcTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+void PutU32(std::string& out, uint32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void PutI64(std::string& out, int64_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+T Get(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Create (or truncate) a segment and make its directory entry durable.
+int CreateSegment(const std::string& dir, uint64_t seq) {
+    std::string path = WriteAheadLog::SegmentPath(dir, seq);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("[WAL] Cannot create " << path << ": " << std::strerror(errno));
+        return -1;
+    }
+    int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        ::close(dir_fd);
+    }
+    return fd;
+}
+
+// Parse a segment file name; returns false for anything else in the directory.
+bool ParseSegmentName(const std::string& name, uint64_t& seq) {
+    unsigned long long value = 0;
+    char tail = 0;
+    if (std::sscanf(name.c_str(), "wal-%llu.lo%c", &value, &tail) != 2 || tail != 'g' ||
+        name.size() != std::string("wal-.log").size() + 20) {
+        return false;
+    }
+    seq = value;
+    return true;
+}
+
+} // namespace
+
+bool ParseWalSyncPolicy(const std::string& name, WalSyncPolicy& policy) {
+    if (name == "batch") {
+        policy = WalSyncPolicy::BATCH;
+    } else if (name == "interval") {
+        policy = WalSyncPolicy::INTERVAL;
+    } else if (name == "none") {
+        policy = WalSyncPolicy::NONE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint32_t Crc32(uint32_t crc, const void* data, size_t size) {
+    static const std::array<uint32_t, 256> table = MakeCrcTable();
+    const auto* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+WriteAheadLog::WriteAheadLog(std::string dir, WalSyncPolicy policy,
+                             std::chrono::milliseconds sync_interval)
+    : dir_(std::move(dir)), policy_(policy), sync_interval_(sync_interval) {
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+std::string WriteAheadLog::SegmentPath(const std::string& dir, uint64_t seq) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "wal-%020llu.log", static_cast<unsigned long long>(seq));
+    return dir + "/" + name;
+}
+
+bool WriteAheadLog::Replay(const std::string& dir, uint64_t first_seq, const ApplyFn& apply,
+                           uint64_t& last_seq) {
+    std::vector<uint64_t> segments;
+    std::error_code ec;
+    for (const auto& file : std::filesystem::directory_iterator(dir, ec)) {
+        uint64_t seq = 0;
+        if (ParseSegmentName(file.path().filename().string(), seq)) {
+            segments.push_back(seq);
+        }
+    }
+    if (ec) {
+        LOG_ERROR("[WAL] Cannot list " << dir << ": " << ec.message());
+        return false;
+    }
+    std::sort(segments.begin(), segments.end());
+    last_seq = segments.empty() ? 0 : segments.back();
+
+    for (uint64_t seq : segments) {
+        if (seq < first_seq) {
+            continue;
+        }
+        MappedFile file;
+        std::string path = SegmentPath(dir, seq);
+        if (!file.Open(path)) {
+            LOG_ERROR("[WAL] Cannot map " << path);
+            return false;
+        }
+        std::string_view data = file.Data();
+        size_t pos = 0;
+        size_t records = 0;
+        while (data.size() - pos >= kHeaderSize) {
+            uint32_t len = Get<uint32_t>(data.data() + pos);
+            uint32_t crc = Get<uint32_t>(data.data() + pos + 4);
+            if (len < kPayloadFixed || data.size() - pos - kHeaderSize < len) {
+                break;
+            }
+            const char* payload = data.data() + pos + kHeaderSize;
+            if (Crc32(0, payload, len) != crc) {
+                break;
+            }
+            int64_t timestamp = Get<int64_t>(payload);
+            uint32_t key_len = Get<uint32_t>(payload + 8);
+            if (key_len > len - kPayloadFixed) {
+                break;
+            }
+            apply(std::string_view(payload + kPayloadFixed, key_len),
+                  std::string_view(payload + kPayloadFixed + key_len, len - kPayloadFixed - key_len),
+                  timestamp);
+            pos += kHeaderSize + len;
+            records++;
+        }
+        if (pos != data.size()) {
+            // A torn tail is expected after a crash (those writes were never acknowledged)
+            LOG_WARN("[WAL] " << path << ": dropped " << (data.size() - pos)
+                     << " trailing bytes after " << records << " records");
+        }
+    }
+    return true;
+}
+
+bool WriteAheadLog::Open(uint64_t seq) {
+    fd_ = CreateSegment(dir_, seq);
+    if (fd_ < 0) {
+        return false;
+    }
+    seq_ = seq;
+    flusher_ = std::thread(&WriteAheadLog::FlushLoop, this);
+    return true;
+}
+
+uint64_t WriteAheadLog::Append(std::string_view key, std::string_view value, int64_t timestamp) {
+    // Encode outside the lock; the lock only covers the copy into the buffer
+    thread_local std::string record;
+    record.clear();
+    uint32_t len = static_cast<uint32_t>(kPayloadFixed + key.size() + value.size());
+    PutU32(record, len);
+    PutU32(record, 0);
+    PutI64(record, timestamp);
+    PutU32(record, static_cast<uint32_t>(key.size()));
+    record.append(key.data(), key.size());
+    record.append(value.data(), value.size());
+    uint32_t crc = Crc32(0, record.data() + kHeaderSize, len);
+    std::memcpy(&record[4], &crc, sizeof(crc));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_.append(record);
+    bytes_since_rotate_ += record.size();
+    uint64_t lsn = next_lsn_++;
+    if (policy_ == WalSyncPolicy::BATCH || buffer_.size() >= kEagerFlushBytes) {
+        work_cv_.notify_one();
+    }
+    return lsn;
+}
+
+bool WriteAheadLog::Sync(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (policy_ != WalSyncPolicy::BATCH) {
+        return !failed_;
+    }
+    durable_cv_.wait(lock, [&] { return durable_lsn_ >= lsn || failed_; });
+    return durable_lsn_ >= lsn;
+}
+
+uint64_t WriteAheadLog::Rotate() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    rotate_requested_ = true;
+    work_cv_.notify_one();
+    durable_cv_.wait(lock, [&] { return !rotate_requested_; });
+    return seq_;
+}
+
+void WriteAheadLog::RemoveSegmentsBefore(uint64_t seq) {
+    std::error_code ec;
+    for (const auto& file : std::filesystem::directory_iterator(dir_, ec)) {
+        uint64_t file_seq = 0;
+        if (ParseSegmentName(file.path().filename().string(), file_seq) && file_seq < seq) {
+            std::filesystem::remove(file.path(), ec);
+        }
+    }
+}
+
+uint64_t WriteAheadLog::BytesSinceRotate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_since_rotate_;
+}
+
+bool WriteAheadLog::WriteAll(const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd_, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void WriteAheadLog::FlushLoop() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        auto has_work = [&] {
+            return stop_ || rotate_requested_ ||
+                   (policy_ == WalSyncPolicy::BATCH ? !buffer_.empty()
+                                                    : buffer_.size() >= kEagerFlushBytes);
+        };
+        if (policy_ == WalSyncPolicy::BATCH) {
+            work_cv_.wait(lock, has_work);
+        } else {
+            work_cv_.wait_for(lock, sync_interval_, has_work);
+        }
+
+        // Everything appended up to here goes out in this batch; with a
+        // rotation pending, anything appended later lands in the new segment.
+        bool rotate = rotate_requested_;
+        bool stopping = stop_;
+        batch.clear();
+        batch.swap(buffer_);
+        uint64_t last_lsn = next_lsn_ - 1;
+        uint64_t seq = seq_;
+        if (rotate) {
+            bytes_since_rotate_ = 0;
+        }
+        bool failed = failed_;
+        lock.unlock();
+
+        bool ok = !failed;
+        if (ok && !batch.empty()) {
+            ok = WriteAll(batch);
+        }
+        bool sync = policy_ != WalSyncPolicy::NONE || rotate || stopping;
+        if (ok && sync && (!batch.empty() || rotate || stopping)) {
+            ok = fdatasync(fd_) == 0;
+        }
+        if (ok && rotate) {
+            int fd = CreateSegment(dir_, seq + 1);
+            if (fd >= 0) {
+                ::close(fd_);
+                fd_ = fd;
+                seq++;
+            } else {
+                ok = false;
+            }
+        }
+
+        lock.lock();
+        if (!ok && !failed_) {
+            LOG_ERROR("[WAL] Write to " << SegmentPath(dir_, seq_) << " failed: "
+                      << std::strerror(errno) << "; further writes are not durable");
+            failed_ = true;
+        }
+        if (ok) {
+            durable_lsn_ = last_lsn;
+        }
+        if (rotate) {
+            seq_ = seq;
+            rotate_requested_ = false;
+        }
+        durable_cv_.notify_all();
+        if (stopping && buffer_.empty()) {
+            break;
+        }
+    }
+}
+
+} // namespace kvstore
@@ -0,0 +1,127 @@
+// Append-only write-ahead log with group commit.
+// Records are appended to an in-memory buffer by the writers; one flusher
+// thread writes whatever has accumulated with a single write() and, under
+// the BATCH policy, a single fdatasync() before waking every writer it
+// covered. Concurrent writers therefore share fsyncs instead of paying one
+// each. The log is split into numbered segment files (wal-<seq>.log) so a
+// snapshot can retire everything before a rotation point.
+//
+// Record layout (little-endian):
+//   u32 payload_len | u32 crc32(payload) | payload
+//   payload = i64 timestamp | u32 key_len | key | value
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace kvstore {
+
+// When appended records reach the disk.
+// BATCH: writers wait for an fsync covering their record (group commit)
+// INTERVAL: fsync every sync interval; writers don't wait
+// NONE: records are written every sync interval; the OS decides when to sync
+enum class WalSyncPolicy {
+    BATCH,
+    INTERVAL,
+    NONE
+};
+
+// Parse "batch", "interval" or "none".
+// @return false if the name is not recognised
+bool ParseWalSyncPolicy(const std::string& name, WalSyncPolicy& policy);
+
+// CRC-32 (IEEE) used for WAL records and snapshots.
+// @param crc Running CRC (0 to start)
+uint32_t Crc32(uint32_t crc, const void* data, size_t size);
+
+class WriteAheadLog {
+public:
+    using ApplyFn = std::function<void(std::string_view key, std::string_view value,
+                                       int64_t timestamp)>;
+
+    // @param dir Directory holding the segment files (must exist)
+    // @param policy When records are synced
+    // @param sync_interval Flush period for the INTERVAL and NONE policies
+    WriteAheadLog(std::string dir, WalSyncPolicy policy, std::chrono::milliseconds sync_interval);
+
+    // Writes and syncs everything still buffered, then stops the flusher.
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Replay segments numbered `first_seq` and up, in order, stopping a
+    // segment at its first torn or corrupt record.
+    // @param dir Directory holding the segment files
+    // @param first_seq Oldest segment to replay
+    // @param apply Called for every intact record, in log order
+    // @param last_seq Set to the highest segment number found (0 if none)
+    // @return false if a segment could not be read
+    static bool Replay(const std::string& dir, uint64_t first_seq, const ApplyFn& apply,
+                       uint64_t& last_seq);
+
+    // Start appending to a new segment and the flusher thread.
+    // @param seq Number of the segment to create
+    // @return false if the segment could not be created
+    bool Open(uint64_t seq);
+
+    // Buffer one record. Cheap enough to call under a store lock, which is
+    // how callers keep log order equal to apply order for each key.
+    // @return Log sequence number to pass to Sync
+    uint64_t Append(std::string_view key, std::string_view value, int64_t timestamp);
+
+    // Wait until the record `lsn` (and every earlier one) is durable under
+    // the sync policy. Returns at once for INTERVAL and NONE.
+    // @return false if the log could not be written
+    bool Sync(uint64_t lsn);
+
+    // Switch to a new segment. Every record appended before the call is
+    // written and synced to the old segment before this returns.
+    // @return Number of the new segment
+    uint64_t Rotate();
+
+    // Delete segments numbered below `seq` (after a snapshot covers them).
+    void RemoveSegmentsBefore(uint64_t seq);
+
+    // Bytes appended since the last rotation.
+    uint64_t BytesSinceRotate() const;
+
+    // Path of segment `seq` in `dir`.
+    static std::string SegmentPath(const std::string& dir, uint64_t seq);
+
+private:
+    std::string dir_;
+    WalSyncPolicy policy_;
+    std::chrono::milliseconds sync_interval_;
+
+    mutable std::mutex mutex_;              // Protects the fields below
+    std::condition_variable work_cv_;       // Wakes the flusher
+    std::condition_variable durable_cv_;    // Wakes writers waiting in Sync / Rotate
+    std::string buffer_;                    // Records not yet handed to the flusher
+    uint64_t next_lsn_ = 1;
+    uint64_t durable_lsn_ = 0;              // Highest record written (and synced, if BATCH)
+    uint64_t bytes_since_rotate_ = 0;
+    uint64_t seq_ = 0;                      // Segment currently appended to
+    bool rotate_requested_ = false;
+    bool failed_ = false;                   // A write or sync failed; the log is unusable
+    bool stop_ = false;
+
+    int fd_ = -1;                           // Only touched by the flusher once open
+    std::thread flusher_;
+
+    // Flusher thread: hands the buffer to the disk, one batch at a time.
+    void FlushLoop();
+
+    // Write a whole buffer to fd_.
+    bool WriteAll(const std::string& data);
+};
+
+} // namespace kvstore
@@ -1,6 +1,14 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <grpcpp/alarm.h>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/health_check_service_interface.h>
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
@@ -9,8 +17,19 @@
 #include "kvstore.pb.h"
 #include "kvstore.grpc.pb.h"
 #include "../protocol/abd.h"
+#include "../protocol/segment.h"
 #include "../common/config.h"
+#include "../common/hash_ring.h"
+#include "../common/rate_limiter.h"
 #include "../common/utils.h"
+#include "../common/logging.h"
+#include "../common/metrics.h"
+#include "../common/profile_interceptor.h"
+#include "../common/profiler.h"
+#include "anti_entropy.h"
+#include "async_server.h"
+#include "server_metrics.h"
+#include "server_tuning.h"
 
 using grpc::Server;
 using grpc::ServerBuilder;
@@ -21,75 +40,1001 @@ using kvstore::ABDReadRequest;
 using kvstore::ABDReadResponse;
 using kvstore::ABDWriteRequest;
 using kvstore::ABDWriteResponse;
+using kvstore::ABDWriteIfNewerResponse;
+using kvstore::ABDValueChunk;
+using kvstore::ABDReadTimestampRequest;
+using kvstore::ABDReadTimestampResponse;
+using kvstore::ABDReadAtRequest;
+using kvstore::ABDReadAtResponse;
+using kvstore::ABDMultiReadRequest;
+using kvstore::ABDMultiReadResponse;
+using kvstore::ABDMultiWriteRequest;
+using kvstore::ABDMultiWriteResponse;
+using kvstore::ABDStreamRequest;
+using kvstore::ABDStreamResponse;
+using kvstore::ABDScanRequest;
+using kvstore::ABDScanResponse;
+using kvstore::ABDMigrateRequest;
+using kvstore::ABDMigrateChunk;
+using kvstore::ABDPullRangeRequest;
+using kvstore::ABDPullRangeResponse;
+using kvstore::ABDMerkleRequest;
+using kvstore::ABDMerkleResponse;
+using kvstore::ABDRepairRequest;
+using kvstore::ABDRepairResponse;
+using kvstore::ABDImportSegmentRequest;
+using kvstore::ABDImportSegmentResponse;
+using kvstore::ABDExportSegmentRequest;
+using kvstore::ABDExportSegmentResponse;
+using kvstore::StatsRequest;
+using kvstore::StatsResponse;
+using kvstore::HashRing;
+
+// Methods the server times, in RpcMetrics order. Stream frames are timed one
+// by one, from arrival until the reply is queued.
+enum ABDMethod : size_t {
+    RPC_READ, RPC_WRITE, RPC_READ_TIMESTAMP, RPC_MULTI_READ, RPC_MULTI_WRITE,
+    RPC_READ_CHUNKED, RPC_WRITE_CHUNKED, RPC_STREAM_READ, RPC_STREAM_WRITE,
+    RPC_MIGRATE_RANGE, RPC_PULL_RANGE, RPC_MERKLE_NODES, RPC_REPAIR, RPC_SCAN,
+    RPC_READ_AT, RPC_IMPORT_SEGMENT, RPC_EXPORT_SEGMENT, RPC_WRITE_IF_NEWER
+};
+
+const std::vector<std::string> ABD_METHOD_NAMES = {
+    "Read", "Write", "ReadTimestamp", "MultiRead", "MultiWrite",
+    "ReadChunked", "WriteChunked", "Stream.Read", "Stream.Write",
+    "MigrateRange", "PullRange", "MerkleNodes", "Repair", "Scan",
+    "ReadAt", "ImportSegment", "ExportSegment", "WriteIfNewer"};
+
+// Server side of one ABDService.Stream call.
+// Each incoming frame is handed off to gRPC's executor (an alarm that expires
+// at once), so frames are applied concurrently and a slow one doesn't hold up
+// those behind it. Each is answered as soon as it has been applied, tagged
+// with the frame's tag; replies are queued because a reactor may only have
+// one write in flight. The stream finishes once the client half-closes and
+// every frame has been applied and its reply written.
+class ABDStreamReactor final
+    : public grpc::ServerBidiReactor<ABDStreamRequest, ABDStreamResponse> {
+public:
+    ABDStreamReactor(kvstore::ABDProtocol* protocol, kvstore::RpcMetrics* metrics)
+        : protocol_(protocol), metrics_(metrics) {
+        StartRead(&request_);
+    }
+    
+    void OnReadDone(bool ok) override {
+        bool finish = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ok) {
+                // Client half-closed (or the call broke); finish once replies drain
+                reads_done_ = true;
+                finish = FinishableLocked();
+            } else {
+                applying_++;
+            }
+        }
+        if (!ok) {
+            if (finish) {
+                FinishStream();
+            }
+            return;
+        }
+        
+        auto* frame = new Frame;
+        frame->request.Swap(&request_);
+        frame->alarm.Set(gpr_now(GPR_CLOCK_MONOTONIC), [this, frame](bool) {
+            Apply(frame->request);
+            delete frame;       // Allowed in the callback: the alarm is released after it returns
+        });
+        StartRead(&request_);
+    }
+    
+    void OnWriteDone(bool ok) override {
+        bool finish = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            replies_.pop_front();
+            if (!ok) {
+                // The client is gone; nothing more can be delivered
+                replies_.clear();
+                broken_ = true;
+            }
+            if (!replies_.empty()) {
+                StartWrite(&replies_.front());
+                return;
+            }
+            writing_ = false;
+            finish = FinishableLocked();
+        }
+        if (finish) {
+            FinishStream();
+        }
+    }
+    
+    void OnDone() override { delete this; }
+
+private:
+    // A frame being applied off the read chain.
+    struct Frame {
+        ABDStreamRequest request;
+        grpc::Alarm alarm;
+    };
+    
+    kvstore::ABDProtocol* protocol_;
+    kvstore::RpcMetrics* metrics_;
+    ABDStreamRequest request_;              // Only touched by the read chain
+    
+    std::mutex mutex_;                      // Protects the fields below
+    std::deque<ABDStreamResponse> replies_; // front() is being written while writing_
+    size_t applying_ = 0;                   // Frames read but not yet answered
+    bool writing_ = false;
+    bool reads_done_ = false;
+    bool broken_ = false;
+    bool finished_ = false;
+    
+    // Apply one frame and queue its reply (on an executor thread).
+    void Apply(const ABDStreamRequest& request) {
+        ABDStreamResponse response;
+        response.set_tag(request.tag());
+        if (request.has_read()) {
+            kvstore::ScopedRpcTimer timer((*metrics_)[RPC_STREAM_READ]);
+            const auto& read = request.read();
+            auto result = protocol_->Read(read.key(), read.timestamp(),
+                                          static_cast<size_t>(std::max<int64_t>(read.value_limit(), 0)));
+            auto* out = response.mutable_read();
+            out->set_value(std::move(result.value));
+            out->set_timestamp(result.timestamp);
+            out->set_success(result.success);
+            out->set_value_omitted(result.omitted);
+        } else if (request.has_write()) {
+            kvstore::ScopedRpcTimer timer((*metrics_)[RPC_STREAM_WRITE]);
+            const auto& write = request.write();
+            auto result = protocol_->Write(write.key(), write.value(), write.timestamp());
+            auto* out = response.mutable_write();
+            out->set_success(result.success);
+            out->set_timestamp(result.timestamp);
+            out->set_superseded(!result.accepted);
+        }
+        LOG_DEBUG("[SERVER] Stream frame tag=" << request.tag());
+        
+        bool finish = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            applying_--;
+            if (!broken_) {
+                // Once a write has failed nothing more can be delivered
+                replies_.push_back(std::move(response));
+                if (!writing_) {
+                    writing_ = true;
+                    StartWrite(&replies_.front());
+                }
+            }
+            finish = FinishableLocked();
+        }
+        if (finish) {
+            FinishStream();
+        }
+    }
+    
+    // Whether the stream can finish now; claims the Finish if so. Finish is
+    // called after dropping the lock, since OnDone may delete the reactor
+    // before Finish returns.
+    bool FinishableLocked() {
+        if (reads_done_ && applying_ == 0 && !writing_ && !finished_) {
+            finished_ = true;
+            return true;
+        }
+        return false;
+    }
+    
+    // broken_ no longer changes once the stream is finishable
+    void FinishStream() {
+        Finish(broken_ ? Status(grpc::StatusCode::UNAVAILABLE, "stream write failed") : Status::OK);
+    }
+};
 
 // gRPC service implementation for ABD protocol.
 // This class implements the ABDService interface defined in kvstore.proto.
-// It handles incoming read and write requests from clients.
-class ABDServiceImpl final : public ABDService::Service {
+// It handles incoming read and write requests from clients. Unary methods
+// use the synchronous API (with --async-cqs the hot ones are served from
+// async_server.h's queues instead, through the same handlers); the
+// bidirectional Stream method uses a callback reactor so a stream doesn't
+// pin a server thread.
+class ABDServiceImpl final : public ABDService::WithCallbackMethod_Stream<ABDService::Service> {
 public:
-    ABDServiceImpl() : protocol_(std::make_unique<kvstore::ABDProtocol>()) {}
+    // @param server_id This server's id (timestamp tiebreak)
+    // @param compress_above Gzip replies carrying more value bytes than this (0 = never)
+    ABDServiceImpl(int32_t server_id, size_t compress_above)
+        : protocol_(std::make_unique<kvstore::ABDProtocol>(server_id)),
+          compress_above_(compress_above), metrics_(ABD_METHOD_NAMES) {}
     
     // Handles a read request from a client.
     // The client sends a key and its timestamp. The server returns the
     // stored value and timestamp for that key (if it exists).
     Status Read(ServerContext* context, const ABDReadRequest* request,
                 ABDReadResponse* response) override {
-        std::string key = request->key();
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_READ]);
+        const std::string& key = request->key();
         int64_t client_timestamp = request->timestamp();
         
-        // Log incoming request
-        std::string peer = context->peer();
-        std::cout << "[SERVER] Read request from " << peer 
-                  << " for key='" << key << "' (client_ts=" << client_timestamp << ")" << std::endl;
+        LOG_DEBUG("[SERVER] Read request from " << context->peer() 
+                  << " for key='" << key << "' (client_ts=" << client_timestamp << ")");
         
-        auto result = protocol_->Read(key, client_timestamp);
+        auto result = protocol_->Read(key, client_timestamp, ValueLimit(*request));
         
-        response->set_value(result.value);
+        MaybeCompress(context, result.value.size());
+        response->set_value(std::move(result.value));
         response->set_timestamp(result.timestamp);
         response->set_success(result.success);
+        response->set_value_omitted(result.omitted);
         
-        std::cout << "[SERVER] Read response: value='" << result.value 
-                  << "', ts=" << result.timestamp << ", success=" << result.success << std::endl;
+        LOG_DEBUG("[SERVER] Read response: value_size=" << response->value().size()
+                  << ", ts=" << result.timestamp << ", success=" << result.success);
         
         return Status::OK;
     }
     
     // Handles a write request from a client.
-    // The client sends a key, value, and timestamp. The server stores
-    // the value with a timestamp that is at least as large as the client's
-    // timestamp (to ensure monotonicity).
+    // The client sends a key, value, and timestamp. The server stores the
+    // value under that timestamp if it is newer than the key's; otherwise
+    // it replies superseded, with the key's timestamp.
     Status Write(ServerContext* context, const ABDWriteRequest* request,
                  ABDWriteResponse* response) override {
-        std::string key = request->key();
-        std::string value = request->value();
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_WRITE]);
+        const std::string& key = request->key();
+        const std::string& value = request->value();
         int64_t client_timestamp = request->timestamp();
         
-        // Log incoming request
-        std::string peer = context->peer();
-        std::cout << "[SERVER] Write request from " << peer 
-                  << " for key='" << key << "' value='" << value 
-                  << "' (client_ts=" << client_timestamp << ")" << std::endl;
+        LOG_DEBUG("[SERVER] Write request from " << context->peer() 
+                  << " for key='" << key << "' value_size=" << value.size()
+                  << " (client_ts=" << client_timestamp << ")");
         
         auto result = protocol_->Write(key, value, client_timestamp);
         
         response->set_success(result.success);
         response->set_timestamp(result.timestamp);
+        response->set_superseded(!result.accepted);
+        
+        LOG_DEBUG("[SERVER] Write response: ts=" << result.timestamp 
+                  << ", success=" << result.success);
+        
+        return Status::OK;
+    }
+
+    // Handles a conditional write: stored under the client's timestamp unless
+    // the key already has a newer one, which is then returned instead.
+    Status WriteIfNewer(ServerContext* context, const ABDWriteRequest* request,
+                        ABDWriteIfNewerResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_WRITE_IF_NEWER]);
+        LOG_DEBUG("[SERVER] WriteIfNewer request from " << context->peer()
+                  << " for key='" << request->key() << "' (client_ts=" << request->timestamp() << ")");
+        auto result = protocol_->WriteIfNewer(request->key(), request->value(), request->timestamp());
+        response->set_success(result.success);
+        response->set_accepted(result.accepted);
+        response->set_timestamp(result.timestamp);
+        return Status::OK;
+    }
+
+    // Handles a timestamp-only read: the timestamp Read would return, without the value.
+    Status ReadTimestamp(ServerContext* context, const ABDReadTimestampRequest* request,
+                         ABDReadTimestampResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_READ_TIMESTAMP]);
+        LOG_DEBUG("[SERVER] ReadTimestamp request from " << context->peer()
+                  << " for key='" << request->key() << "'");
+        response->set_timestamp(protocol_->GetTimestamp(request->key()));
+        response->set_success(true);
+        return Status::OK;
+    }
+
+    // Handles a snapshot read: the version of the key current at the
+    // request's timestamp, from the key's history if it was overwritten since.
+    Status ReadAt(ServerContext* context, const ABDReadAtRequest* request,
+                  ABDReadAtResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_READ_AT]);
+        LOG_DEBUG("[SERVER] ReadAt request from " << context->peer()
+                  << " for key='" << request->key() << "' at ts=" << request->read_timestamp());
+        auto result = protocol_->ReadAt(request->key(), request->read_timestamp());
+        MaybeCompress(context, result.value.size());
+        response->set_value(std::move(result.value));
+        response->set_timestamp(result.timestamp);
+        response->set_success(result.success);
+        response->set_too_old(result.too_old);
+        return Status::OK;
+    }
+
+    // Handles a batched read: the server-side half of Read for every key
+    // in the request, answered in request order.
+    Status MultiRead(ServerContext* context, const ABDMultiReadRequest* request,
+                     ABDMultiReadResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_MULTI_READ]);
+        LOG_DEBUG("[SERVER] MultiRead request from " << context->peer() 
+                  << " for " << request->reads_size() << " keys");
         
-        std::cout << "[SERVER] Write response: ts=" << result.timestamp 
-                  << ", success=" << result.success << std::endl;
+        std::vector<std::string_view> keys;
+        std::vector<size_t> value_limits;
+        keys.reserve(request->reads_size());
+        value_limits.reserve(request->reads_size());
+        for (const auto& read : request->reads()) {
+            keys.push_back(read.key());
+            value_limits.push_back(ValueLimit(read));
+        }
+        
+        auto results = protocol_->MultiRead(keys, value_limits);
+        
+        response->mutable_results()->Reserve(static_cast<int>(results.size()));
+        size_t value_bytes = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            auto& result = results[i];
+            auto* out = response->add_results();
+            if (result.omitted) {
+                out->set_value_omitted(true);
+            } else {
+                value_bytes += result.value.size();
+                out->set_value(std::move(result.value));
+            }
+            out->set_timestamp(result.timestamp);
+            out->set_success(result.success);
+        }
+        MaybeCompress(context, value_bytes);
+        response->set_success(true);
+        
+        return Status::OK;
+    }
+    
+    // Streams one key's value in chunks (for values too large for one message).
+    Status ReadChunked(ServerContext* context, const ABDReadRequest* request,
+                       grpc::ServerWriter<ABDValueChunk>* writer) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_READ_CHUNKED]);
+        auto result = protocol_->Read(request->key(), request->timestamp());
+        LOG_DEBUG("[SERVER] ReadChunked request from " << context->peer() << " for key='"
+                  << request->key() << "' (value_size=" << result.value.size() << ")");
+        
+        MaybeCompress(context, result.value.size());
+        size_t offset = 0;
+        do {
+            ABDValueChunk chunk;
+            if (offset == 0) {
+                chunk.set_key(request->key());
+                chunk.set_timestamp(result.timestamp);
+                chunk.set_total_size(static_cast<int64_t>(result.value.size()));
+            }
+            size_t length = std::min(VALUE_CHUNK_BYTES, result.value.size() - offset);
+            chunk.set_data(result.value.data() + offset, length);
+            offset += length;
+            if (!writer->Write(chunk)) {
+                return Status(grpc::StatusCode::UNAVAILABLE, "value stream broke");
+            }
+        } while (offset < result.value.size());
+        return Status::OK;
+    }
+    
+    // Receives a value in chunks, then applies it like Write.
+    Status WriteChunked(ServerContext* context, grpc::ServerReader<ABDValueChunk>* reader,
+                        ABDWriteResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_WRITE_CHUNKED]);
+        ABDValueChunk chunk;
+        if (!reader->Read(&chunk)) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "empty value stream");
+        }
+        std::string key = chunk.key();
+        int64_t client_timestamp = chunk.timestamp();
+        size_t total_size = static_cast<size_t>(std::max<int64_t>(chunk.total_size(), 0));
+        // total_size comes from the client: reserve at most a bounded prefix
+        // and let the buffer grow only as chunks actually arrive
+        std::string value;
+        value.reserve(std::min(total_size, MAX_CHUNKED_RESERVE));
+        do {
+            if (chunk.data().size() > total_size - value.size()) {
+                return Status(grpc::StatusCode::INVALID_ARGUMENT, "value stream longer than its total_size");
+            }
+            value.append(chunk.data());
+        } while (value.size() < total_size && reader->Read(&chunk));
+        if (value.size() != total_size) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "value stream ended early");
+        }
+        
+        LOG_DEBUG("[SERVER] WriteChunked request from " << context->peer() << " for key='"
+                  << key << "' value_size=" << value.size() << " (client_ts=" << client_timestamp << ")");
+        
+        auto result = protocol_->Write(key, value, client_timestamp);
+        response->set_success(result.success);
+        response->set_timestamp(result.timestamp);
+        response->set_superseded(!result.accepted);
+        return Status::OK;
+    }
+    
+    // Handles a batched write: every write in the request is applied with
+    // the same timestamp rule as Write, and acknowledged in request order.
+    Status MultiWrite(ServerContext* context, const ABDMultiWriteRequest* request,
+                      ABDMultiWriteResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_MULTI_WRITE]);
+        LOG_DEBUG("[SERVER] MultiWrite request from " << context->peer() 
+                  << " for " << request->writes_size() << " keys");
+        
+        std::vector<kvstore::ABDProtocol::WriteOp> writes;
+        writes.reserve(request->writes_size());
+        for (const auto& write : request->writes()) {
+            writes.push_back({write.key(), write.value(), write.timestamp()});
+        }
+        
+        auto results = protocol_->MultiWrite(writes);
+        
+        response->mutable_results()->Reserve(static_cast<int>(results.size()));
+        bool all_ok = true;
+        for (const auto& result : results) {
+            auto* out = response->add_results();
+            out->set_success(result.success);
+            out->set_timestamp(result.timestamp);
+            out->set_superseded(!result.accepted);
+            all_ok = all_ok && result.success;
+        }
+        response->set_success(all_ok);
+        
+        return Status::OK;
+    }
+
+    // Opens a bidirectional stream of tagged read/write frames.
+    grpc::ServerBidiReactor<ABDStreamRequest, ABDStreamResponse>* Stream(
+            grpc::CallbackServerContext* context) override {
+        LOG_DEBUG("[SERVER] Stream opened by " << context->peer());
+        return new ABDStreamReactor(protocol_.get(), &metrics_);
+    }
+
+    // Returns one page of the keys in the requested range, in key order.
+    // Pages stop at the request's limit (at most SCAN_PAGE_KEYS) or once
+    // they carry SCAN_PAGE_BYTES of keys and values.
+    Status Scan(ServerContext* context, const ABDScanRequest* request,
+                ABDScanResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_SCAN]);
+        size_t limit = request->limit() > 0
+            ? std::min(static_cast<size_t>(request->limit()), SCAN_PAGE_KEYS)
+            : SCAN_PAGE_KEYS;
+        bool more = false;
+        bool too_old = false;
+        auto entries = protocol_->Scan(request->start_key(), request->end_key(), limit,
+                                       SCAN_PAGE_BYTES, request->read_timestamp(), more, too_old);
+        if (too_old) {
+            response->set_too_old(true);
+            response->set_success(false);
+            return Status::OK;
+        }
+        size_t value_bytes = 0;
+        response->mutable_entries()->Reserve(static_cast<int>(entries.size()));
+        for (auto& entry : entries) {
+            value_bytes += entry.value.size();
+            auto* out = response->add_entries();
+            out->set_key(std::move(entry.key));
+            out->set_value(std::move(entry.value));
+            out->set_timestamp(entry.timestamp);
+        }
+        response->set_more(more);
+        response->set_success(true);
+        MaybeCompress(context, value_bytes);
+        
+        LOG_DEBUG("[SERVER] Scan from '" << request->start_key() << "': " << entries.size()
+                  << " entries, more=" << more);
+        return Status::OK;
+    }
+
+    // Streams every entry in the requested hash ranges, in chunks of about
+    // chunk_bytes paced to rate_limit_bytes. Shards are scanned one at a time
+    // and a shard's matches are copied out before any of them is sent, so no
+    // store lock is held while the stream waits on the network or the pacer.
+    Status MigrateRange(ServerContext* context, const ABDMigrateRequest* request,
+                        grpc::ServerWriter<ABDMigrateChunk>* writer) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_MIGRATE_RANGE]);
+        std::vector<HashRing::Range> include = ToRanges(request->ranges());
+        std::vector<HashRing::Range> exclude = ToRanges(request->exclude());
+        auto match = [&](std::string_view key) {
+            uint64_t hash = HashRing::Hash(key);
+            auto contains = [hash](const HashRing::Range& range) { return HashRing::Contains(range, hash); };
+            return std::any_of(include.begin(), include.end(), contains) &&
+                   std::none_of(exclude.begin(), exclude.end(), contains);
+        };
+        size_t chunk_bytes = request->chunk_bytes() > 0
+            ? std::min(static_cast<size_t>(request->chunk_bytes()), MAX_MIGRATE_CHUNK_BYTES)
+            : MIGRATE_CHUNK_BYTES;
+        
+        LOG_INFO("[SERVER] MigrateRange to " << context->peer() << ": " << include.size()
+                 << " ranges, min_ts=" << request->min_timestamp()
+                 << ", rate_limit=" << request->rate_limit_bytes() << " B/s");
+        
+        kvstore::RateLimiter limiter(request->rate_limit_bytes());
+        ABDMigrateChunk chunk;
+        size_t pending_bytes = 0;
+        int64_t sent = 0;
+        auto flush = [&]() {
+            if (chunk.entries_size() == 0) {
+                return true;
+            }
+            limiter.Acquire(pending_bytes);
+            bool ok = writer->Write(chunk);
+            chunk.Clear();
+            pending_bytes = 0;
+            return ok;
+        };
+        for (size_t shard = 0; shard < protocol_->NumShards(); shard++) {
+            if (context->IsCancelled()) {
+                return Status(grpc::StatusCode::CANCELLED, "migration cancelled");
+            }
+            for (auto& entry : protocol_->CollectShard(shard, match, request->min_timestamp())) {
+                pending_bytes += entry.key.size() + entry.value.size() + sizeof(entry.timestamp);
+                auto* out = chunk.add_entries();
+                out->set_key(std::move(entry.key));
+                out->set_value(std::move(entry.value));
+                out->set_timestamp(entry.timestamp);
+                sent++;
+                if (pending_bytes >= chunk_bytes && !flush()) {
+                    return Status(grpc::StatusCode::UNAVAILABLE, "migration stream broke");
+                }
+            }
+        }
+        if (!flush()) {
+            return Status(grpc::StatusCode::UNAVAILABLE, "migration stream broke");
+        }
+        
+        LOG_INFO("[SERVER] MigrateRange to " << context->peer() << " done: " << sent << " entries");
+        return Status::OK;
+    }
+    
+    // Pulls a hash range from each listed source (MigrateRange) and merges
+    // the entries into the store by max timestamp. Sources are copied one
+    // after another, so the rate cap holds for the whole pull.
+    Status PullRange(ServerContext* context, const ABDPullRangeRequest* request,
+                     ABDPullRangeResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_PULL_RANGE]);
+        LOG_INFO("[SERVER] PullRange from " << request->sources_size() << " sources (asked by "
+                 << context->peer() << ")");
+        
+        int64_t received = 0;
+        int64_t applied = 0;
+        response->set_success(true);
+        for (const auto& source : request->sources()) {
+            std::string error;
+            if (!PullFrom(*PeerStub(source), request->range(), received, applied, error, context)) {
+                response->set_success(false);
+                response->set_error(source + ": " + error);
+                break;
+            }
+        }
+        response->set_received(received);
+        response->set_applied(applied);
         
+        LOG_INFO("[SERVER] PullRange " << (response->success() ? "done" : "failed") << ": "
+                 << received << " entries received, " << applied << " applied");
         return Status::OK;
     }
 
+    // Returns the hashes of the requested nodes of this server's Merkle tree.
+    Status MerkleNodes(ServerContext*, const ABDMerkleRequest* request,
+                       ABDMerkleResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_MERKLE_NODES]);
+        if (request->level() < 0 || static_cast<size_t>(request->level()) > kvstore::MerkleTree::kDepth) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "no such tree level");
+        }
+        std::vector<uint64_t> hashes = protocol_->GetMerkleTree().Level(static_cast<size_t>(request->level()));
+        for (uint32_t node : request->nodes()) {
+            if (node >= hashes.size()) {
+                return Status(grpc::StatusCode::INVALID_ARGUMENT, "no such tree node");
+            }
+            response->add_hashes(hashes[node]);
+        }
+        return Status::OK;
+    }
+    
+    // Compares this server's tree with the source's and pulls what differs.
+    Status Repair(ServerContext* context, const ABDRepairRequest* request,
+                  ABDRepairResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_REPAIR]);
+        LOG_INFO("[SERVER] Repair from " << request->source() << " (asked by " << context->peer() << ")");
+        RepairFrom(request->source(), request->rate_limit_bytes(), response);
+        return Status::OK;
+    }
+    
+    // Maps a segment file on this server and merges its entries into the
+    // store by max timestamp, as migration does. Worker threads take blocks
+    // one at a time and merge them straight out of the mapping. A corrupt
+    // block stops the import; what was merged before stays, and running the
+    // import again is harmless.
+    Status ImportSegment(ServerContext* context, const ABDImportSegmentRequest* request,
+                         ABDImportSegmentResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_IMPORT_SEGMENT]);
+        LOG_INFO("[SERVER] ImportSegment " << request->path() << " (asked by " << context->peer() << ")");
+        kvstore::SegmentReader segment;
+        std::string error;
+        std::string path;
+        if (!SegmentPath(request->path(), path, error) || !segment.Open(path, error)) {
+            response->set_error(error);
+            return Status::OK;
+        }
+        std::vector<HashRing::Range> ranges = ToRanges(request->ranges());
+        auto wanted = [&ranges](std::string_view key) {
+            uint64_t hash = HashRing::Hash(key);
+            return ranges.empty() || std::any_of(ranges.begin(), ranges.end(),
+                [hash](const HashRing::Range& range) { return HashRing::Contains(range, hash); });
+        };
+        size_t threads = request->threads() > 0 ? static_cast<size_t>(request->threads())
+                                                : std::max(1u, std::thread::hardware_concurrency());
+        threads = std::max<size_t>(1, std::min(threads, segment.NumBlocks()));
+        
+        std::atomic<size_t> next_block{0};
+        std::atomic<int64_t> received{0};
+        std::atomic<int64_t> applied{0};
+        std::atomic<bool> failed{false};
+        std::mutex error_mutex;
+        auto fail = [&](const std::string& message) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!failed.exchange(true)) {
+                error = message;
+            }
+        };
+        auto work = [&]() {
+            std::vector<kvstore::ABDProtocol::WriteOp> entries;
+            for (size_t block = next_block++; block < segment.NumBlocks() && !failed; block = next_block++) {
+                entries.clear();
+                bool intact = segment.ForEachInBlock(block,
+                    [&](std::string_view key, std::string_view value, int64_t timestamp) {
+                        if (wanted(key)) {
+                            entries.push_back({key, value, timestamp});
+                        }
+                    });
+                if (!intact) {
+                    fail(request->path() + ": block " + std::to_string(block) + " is corrupt");
+                    return;
+                }
+                auto result = protocol_->Merge(entries);
+                received += static_cast<int64_t>(entries.size());
+                applied += static_cast<int64_t>(result.applied);
+                if (!result.success) {
+                    fail("log sync failed");
+                    return;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < threads; i++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        
+        response->set_success(!failed);
+        response->set_error(error);
+        response->set_received(received);
+        response->set_applied(applied);
+        LOG_INFO("[SERVER] ImportSegment " << (failed ? "failed: " + error : std::string("done")) << ": "
+                 << received << " entries read with " << threads << " threads, " << applied << " applied");
+        return Status::OK;
+    }
+    
+    // Writes every key this server holds to a segment file on this server,
+    // in key order: the ordered index is read a page at a time, as Scan
+    // does, so the store is never copied out whole.
+    Status ExportSegment(ServerContext* context, const ABDExportSegmentRequest* request,
+                         ABDExportSegmentResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_EXPORT_SEGMENT]);
+        LOG_INFO("[SERVER] ExportSegment " << request->path() << " (asked by " << context->peer() << ")");
+        std::string path;
+        std::string error;
+        if (!SegmentPath(request->path(), path, error)) {
+            response->set_error(error);
+            return Status::OK;
+        }
+        kvstore::SegmentWriter writer(path);
+        bool ok = writer.Open();
+        std::string cursor;
+        bool more = true;
+        while (ok && more) {
+            bool too_old = false;
+            auto entries = protocol_->Scan(cursor, "", EXPORT_PAGE_KEYS, EXPORT_PAGE_BYTES, 0, more, too_old);
+            for (size_t i = 0; ok && i < entries.size(); i++) {
+                ok = writer.Add(entries[i].key, entries[i].value, entries[i].timestamp);
+            }
+            if (entries.empty()) {
+                break;
+            }
+            cursor = entries.back().key + '\0';
+        }
+        ok = ok && writer.Finish();
+        
+        response->set_success(ok);
+        response->set_error(writer.Error());
+        response->set_entries(static_cast<int64_t>(writer.Entries()));
+        response->set_bytes(static_cast<int64_t>(writer.Bytes()));
+        LOG_INFO("[SERVER] ExportSegment " << (ok ? "done" : "failed: " + writer.Error()) << ": "
+                 << writer.Entries() << " entries, " << writer.Bytes() << " bytes");
+        return Status::OK;
+    }
+    
+    // One anti-entropy round against a replica (see anti_entropy.h).
+    // @param source "host:port" of the replica
+    // @param rate_limit_bytes Bytes per second cap on the pull (0 = unlimited)
+    // @param response Filled in with the outcome
+    void RepairFrom(const std::string& source, int64_t rate_limit_bytes, ABDRepairResponse* response) {
+        auto stub = PeerStub(source);
+        std::vector<size_t> leaves;
+        Status status = kvstore::FindDifferingLeaves(protocol_->GetMerkleTree(), *stub, leaves);
+        response->set_differing_leaves(static_cast<int64_t>(leaves.size()));
+        response->set_success(status.ok());
+        if (!status.ok()) {
+            response->set_error(source + ": " + status.error_message());
+            LOG_WARN_EVERY(10000, "[SERVER] Repair from " << source << " failed: " << status.error_message());
+            return;
+        }
+        repairs_.Add();
+        differing_leaves_.Add(leaves.size());
+        if (leaves.empty()) {
+            return;
+        }
+        
+        ABDMigrateRequest range;
+        for (const auto& leaf_range : kvstore::LeafRanges(leaves)) {
+            auto* out = range.add_ranges();
+            out->set_start(leaf_range.start);
+            out->set_end(leaf_range.end);
+        }
+        range.set_rate_limit_bytes(rate_limit_bytes);
+        int64_t received = 0;
+        int64_t applied = 0;
+        std::string error;
+        if (!PullFrom(*stub, range, received, applied, error)) {
+            response->set_success(false);
+            response->set_error(source + ": " + error);
+        }
+        response->set_received(received);
+        response->set_applied(applied);
+        repaired_entries_.Add(static_cast<uint64_t>(applied));
+        LOG_INFO("[SERVER] Repair from " << source << ": " << leaves.size() << " leaves differ, "
+                 << received << " entries received, " << applied << " applied");
+    }
+
+    // Returns the metrics scrape (the same text as the HTTP endpoint).
+    Status Stats(ServerContext*, const StatsRequest*, StatsResponse* response) override {
+        response->set_prometheus_text(RenderMetrics());
+        return Status::OK;
+    }
+    
+    // Render every metric as Prometheus text.
+    std::string RenderMetrics() const {
+        kvstore::PrometheusText out;
+        metrics_.Export(out);
+        kvstore::ExportStoreStats(protocol_->GetStoreStats(), out);
+        out.AddCounter("kvstore_anti_entropy_repairs_total", "Merkle tree comparisons with a replica", "",
+                       repairs_.Value());
+        out.AddCounter("kvstore_anti_entropy_differing_leaves_total", "Tree leaves found to differ", "",
+                       differing_leaves_.Value());
+        out.AddCounter("kvstore_anti_entropy_applied_total", "Entries repaired from a replica", "",
+                       repaired_entries_.Value());
+        return out.Render();
+    }
+
+    // Set how much history is kept for snapshot reads.
+    void SetVersionRetention(const kvstore::VersionRetention& versions) {
+        protocol_->SetVersionRetention(versions);
+    }
+    
+    // Recover the store from disk and log writes from now on.
+    bool EnableDurability(const kvstore::DurabilityOptions& options) {
+        return protocol_->EnableDurability(options);
+    }
+    
+    // Directory ImportSegment and ExportSegment may use (empty = neither).
+    void SetSegmentDir(const std::string& dir) {
+        segment_dir_ = dir;
+    }
+    
+    // Take the hot unary methods off the sync server, to be served from the
+    // async queues instead (--async-cqs). Call before registering the service.
+    void MarkHotMethodsAsync() {
+        for (int method : {ASYNC_READ, ASYNC_WRITE, ASYNC_WRITE_IF_NEWER, ASYNC_MULTI_READ,
+                           ASYNC_READ_TIMESTAMP, ASYNC_READ_AT, ASYNC_MULTI_WRITE}) {
+            MarkMethodAsync(method);
+        }
+    }
+    
+    // Serve the methods MarkHotMethodsAsync took off the sync server, with
+    // the single-key ones routed by key.
+    void ServeAsync(kvstore::AsyncServer& async) {
+        ServeAsync(async, ASYNC_READ, &ABDServiceImpl::Read, RequestKey<ABDReadRequest>);
+        ServeAsync(async, ASYNC_WRITE, &ABDServiceImpl::Write, RequestKey<ABDWriteRequest>);
+        ServeAsync(async, ASYNC_WRITE_IF_NEWER, &ABDServiceImpl::WriteIfNewer, RequestKey<ABDWriteRequest>);
+        ServeAsync<ABDMultiReadRequest>(async, ASYNC_MULTI_READ, &ABDServiceImpl::MultiRead, nullptr);
+        ServeAsync(async, ASYNC_READ_TIMESTAMP, &ABDServiceImpl::ReadTimestamp,
+                   RequestKey<ABDReadTimestampRequest>);
+        ServeAsync(async, ASYNC_READ_AT, &ABDServiceImpl::ReadAt, RequestKey<ABDReadAtRequest>);
+        ServeAsync<ABDMultiWriteRequest>(async, ASYNC_MULTI_WRITE, &ABDServiceImpl::MultiWrite, nullptr);
+    }
+    
+    // Shard holding a key, for routing it to the shard's owner queue.
+    size_t ShardOf(std::string_view key) const {
+        return protocol_->ShardOf(key);
+    }
+
 private:
+    // ABDService method indices (proto order) of the methods served async
+    enum AsyncMethod : int {
+        ASYNC_READ = 0, ASYNC_WRITE = 1, ASYNC_WRITE_IF_NEWER = 2, ASYNC_MULTI_READ = 3,
+        ASYNC_READ_TIMESTAMP = 4, ASYNC_READ_AT = 5, ASYNC_MULTI_WRITE = 8
+    };
+    
+    // Key of a single-key request, for routing it.
+    template <typename Request>
+    static std::string_view RequestKey(const Request& request) {
+        return request.key();
+    }
+    
+    // Serve one method from the async queues through its sync handler.
+    // @param key_of Key to route calls by (nullptr for batches)
+    template <typename Request, typename Reply>
+    void ServeAsync(kvstore::AsyncServer& async, int method,
+                    Status (ABDServiceImpl::*handler)(ServerContext*, const Request*, Reply*),
+                    kvstore::AsyncServer::KeyFn<Request> key_of) {
+        async.Serve<Request, Reply>(
+            [this, method](ServerContext* context, Request* request, grpc::ServerAsyncResponseWriter<Reply>* writer,
+                           grpc::ServerCompletionQueue* cq, void* tag) {
+                RequestAsyncUnary(method, context, request, writer, cq, cq, tag);
+            },
+            [this, handler](ServerContext* context, const Request* request, Reply* reply) {
+                return (this->*handler)(context, request, reply);
+            },
+            std::move(key_of));
+    }
+    
+    // Map a segment name from a request to a file in the segment directory.
+    // Absolute names and names containing ".." are refused, so a client can
+    // only reach files inside that directory.
+    // @return false, with `error` set, if the name is refused
+    bool SegmentPath(const std::string& name, std::string& path, std::string& error) const {
+        if (segment_dir_.empty()) {
+            error = "segment files are disabled (start the server with --segment-dir)";
+            return false;
+        }
+        if (name.empty() || name.front() == '/' || name.find("..") != std::string::npos ||
+            name.find('\0') != std::string::npos) {
+            error = "segment name '" + name + "' must be relative to the segment directory, without ..";
+            return false;
+        }
+        path = segment_dir_ + "/" + name;
+        return true;
+    }
+    
+
     std::unique_ptr<kvstore::ABDProtocol> protocol_;  // ABD protocol implementation
+    size_t compress_above_;                             // Reply compression threshold (0 = off)
+    kvstore::RpcMetrics metrics_;                       // Calls and latency per ABDMethod
+    std::string segment_dir_;                           // Where segment files may be read and written
+    kvstore::Counter repairs_;                          // Successful tree comparisons
+    kvstore::Counter differing_leaves_;                 // Leaves they found to differ
+    kvstore::Counter repaired_entries_;                 // Entries they applied
+    
+    // Size of the chunks ReadChunked sends
+    static constexpr size_t VALUE_CHUNK_BYTES = 1 << 20;
+    // Most WriteChunked reserves up front from the client's total_size
+    static constexpr size_t MAX_CHUNKED_RESERVE = 16 * VALUE_CHUNK_BYTES;
+    
+    static size_t ValueLimit(const ABDReadRequest& request) {
+        return static_cast<size_t>(std::max<int64_t>(request.value_limit(), 0));
+    }
+    
+    // Gzip the reply if it carries enough value bytes to be worth it.
+    void MaybeCompress(ServerContext* context, size_t value_bytes) const {
+        if (compress_above_ > 0 && value_bytes > compress_above_) {
+            context->set_compression_algorithm(GRPC_COMPRESS_GZIP);
+        }
+    }
+    
+    // Most keys, and about the most bytes, in one Scan page
+    static constexpr size_t SCAN_PAGE_KEYS = 1000;
+    static constexpr size_t SCAN_PAGE_BYTES = 1 << 20;
+    
+    // Store pages ExportSegment reads at a time
+    static constexpr size_t EXPORT_PAGE_KEYS = 4096;
+    static constexpr size_t EXPORT_PAGE_BYTES = 4 << 20;
+    
+    // Migration chunk size unless the request asks for one (kept under
+    // gRPC's default 4 MB message limit)
+    static constexpr size_t MIGRATE_CHUNK_BYTES = 1 << 20;
+    static constexpr size_t MAX_MIGRATE_CHUNK_BYTES = 3 << 20;
+    
+    // Stub for another server. A single entry may be larger than a
+    // migration chunk (values are only chunked on the client path), so the
+    // receive limit is lifted.
+    static std::unique_ptr<ABDService::Stub> PeerStub(const std::string& address) {
+        grpc::ChannelArguments args;
+        args.SetMaxReceiveMessageSize(-1);
+        return ABDService::NewStub(grpc::CreateCustomChannel(
+            address, grpc::InsecureChannelCredentials(), args));
+    }
+    
+    // Stream a range from a source (MigrateRange) and merge it into the store.
+    // @param received, applied Incremented by the entries streamed / newer than ours
+    // @param error Set to why the pull failed
+    // @param caller Call the pull runs for; its deadline and cancellation end
+    //               the stream too (null = none)
+    // @return false if the stream failed or the merge could not be synced
+    bool PullFrom(ABDService::Stub& source, const ABDMigrateRequest& range,
+                  int64_t& received, int64_t& applied, std::string& error,
+                  const ServerContext* caller = nullptr) {
+        // A caller's deadline and cancellation carry over to the stream
+        std::unique_ptr<grpc::ClientContext> source_context =
+            caller ? grpc::ClientContext::FromServerContext(*caller) : std::make_unique<grpc::ClientContext>();
+        auto reader = source.MigrateRange(source_context.get(), range);
+        
+        ABDMigrateChunk chunk;
+        bool synced = true;
+        while (synced && reader->Read(&chunk)) {
+            std::vector<kvstore::ABDProtocol::WriteOp> entries;
+            entries.reserve(chunk.entries_size());
+            for (const auto& entry : chunk.entries()) {
+                entries.push_back({entry.key(), entry.value(), entry.timestamp()});
+            }
+            auto result = protocol_->Merge(entries);
+            received += chunk.entries_size();
+            applied += static_cast<int64_t>(result.applied);
+            synced = result.success;
+        }
+        if (!synced) {
+            source_context->TryCancel();
+        }
+        Status status = reader->Finish();
+        if (!synced || !status.ok()) {
+            error = synced ? status.error_message() : std::string("log sync failed");
+            return false;
+        }
+        return true;
+    }
+    
+    static std::vector<HashRing::Range> ToRanges(
+            const google::protobuf::RepeatedPtrField<kvstore::HashRange>& ranges) {
+        std::vector<HashRing::Range> out;
+        out.reserve(ranges.size());
+        for (const auto& range : ranges) {
+            out.push_back({range.start(), range.end()});
+        }
+        return out;
+    }
 };
 
 // Start and run the gRPC server.
 // @param server_address Address to bind to 
 // @param server_id Unique identifier for this server
-void RunServer(const std::string& server_address, int32_t server_id) {
-    ABDServiceImpl service;
+// @param durability Data directory and sync settings (empty dir = in-memory only)
+// @param compress_above Gzip replies carrying more value bytes than this (0 = never)
+// @param tuning Server thread model, message size and CPU settings
+// @param metrics_port Port for Prometheus scrapes (0 = Stats RPC only)
+// @param anti_entropy Peers and interval for background repair
+// @param versions History kept per key for snapshot reads
+// @param segment_dir Directory for ImportSegment / ExportSegment files (empty = refused)
+// @param profile Time request stages and count allocations (--profile)
+void RunServer(const std::string& server_address, int32_t server_id,
+               const kvstore::DurabilityOptions& durability, size_t compress_above,
+               const kvstore::ServerTuning& tuning, int32_t metrics_port,
+               const kvstore::AntiEntropyOptions& anti_entropy,
+               const kvstore::VersionRetention& versions, const std::string& segment_dir, bool profile) {
+    // Before any thread starts, so the profiling signals only reach the profiler's thread
+    if (profile) {
+        kvstore::profile::BlockSignals(true);
+        kvstore::profile::Enable();
+    }
+    kvstore::profile::Totals profile_start = kvstore::profile::Capture();
+    // Pin first so every thread the service and gRPC start inherits the CPUs
+    if (!kvstore::PinServerThreads(tuning)) {
+        return;
+    }
+    ABDServiceImpl service(server_id, compress_above);
+    service.SetVersionRetention(versions);
+    service.SetSegmentDir(segment_dir);
+    if (!durability.dir.empty()) {
+        if (!service.EnableDurability(durability)) {
+            std::cerr << "ERROR: Failed to recover data directory " << durability.dir << std::endl;
+            return;
+        }
+        std::cout << "  Data directory: " << durability.dir << std::endl;
+    }
+    if (!segment_dir.empty()) {
+        std::cout << "  Segment directory: " << segment_dir << std::endl;
+    }
     
     // Enable gRPC features
     grpc::EnableDefaultHealthCheckService(true);
@@ -98,7 +1043,17 @@ void RunServer(const std::string& server_address, int32_t server_id) {
     // Build and start the server
     ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+    if (tuning.async_cqs > 0) {
+        service.MarkHotMethodsAsync();
+    }
     builder.RegisterService(&service);
+    kvstore::ApplyServerTuning(tuning, builder);
+    if (profile) {
+        kvstore::profile::AddServerProfiling(builder);
+    }
+    // Declared before the server so its queues outlive it
+    kvstore::AsyncServer async(builder, tuning,
+                               [&service](std::string_view key) { return service.ShardOf(key); });
     
     std::unique_ptr<Server> server(builder.BuildAndStart());
     if (!server) {
@@ -106,13 +1061,46 @@ void RunServer(const std::string& server_address, int32_t server_id) {
         std::cerr << "  Check if port is already in use or if address is invalid" << std::endl;
         return;
     }
+    if (tuning.async_cqs > 0) {
+        service.ServeAsync(async);
+        async.Start();
+    }
     
     std::cout << " ABD Server successfully started and listening on " << server_address 
               << " (Server ID: " << server_id << ")" << std::endl;
+    std::cout << "  Threads: " << kvstore::DescribeServerTuning(tuning) << std::endl;
+    kvstore::MetricsHttpServer metrics([&service]() { return service.RenderMetrics(); });
+    if (metrics_port > 0) {
+        if (!metrics.Start(metrics_port)) {
+            server->Shutdown();
+            return;
+        }
+        std::cout << "  Metrics: http://0.0.0.0:" << metrics_port << "/metrics" << std::endl;
+    }
+    kvstore::AntiEntropyLoop anti_entropy_loop(anti_entropy.peers, anti_entropy.interval,
+        [&service, &anti_entropy](const std::string& peer) {
+            ABDRepairResponse response;
+            service.RepairFrom(peer, anti_entropy.rate_limit_bytes, &response);
+        });
+    if (anti_entropy.interval.count() > 0) {
+        anti_entropy_loop.Start();
+        std::cout << "  Anti-entropy: every " << anti_entropy.interval.count() << " ms with "
+                  << anti_entropy.peers.size() << " peers" << std::endl;
+    }
+    std::unique_ptr<kvstore::profile::SignalWindows> profile_windows;
+    if (profile) {
+        profile_windows = std::make_unique<kvstore::profile::SignalWindows>([&server]() { server->Shutdown(); });
+        std::cout << "  Profiling: on (SIGUSR2 opens or closes a window; SIGINT or SIGTERM stops the server"
+                  << " and prints the breakdown)" << std::endl;
+    }
     std::cout << "  Ready to accept connections..." << std::endl;
     
     // Block until server is shut down
     server->Wait();
+    async.Shutdown();
+    if (profile) {
+        kvstore::profile::PrintReport("Profile", profile_start, kvstore::profile::Capture(), std::cout);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -121,6 +1109,15 @@ int main(int argc, char** argv) {
     int32_t server_id = 0;
     int32_t port = 5001;
     std::string host = "0.0.0.0";
+    kvstore::DurabilityOptions durability;
+    size_t compress_above = 0;
+    int32_t metrics_port = 0;
+    kvstore::AntiEntropyOptions anti_entropy;
+    kvstore::VersionRetention versions;
+    std::string segment_dir;
+    bool profile = false;
+    kvstore::ServerTuning tuning;
+    std::string tuning_error;
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -133,9 +1130,54 @@ int main(int argc, char** argv) {
             port = std::stoi(argv[++i]);
         } else if (arg == "--host" && i + 1 < argc) {
             host = argv[++i];
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            kvstore::LogLevel level;
+            if (!kvstore::ParseLogLevel(argv[++i], level)) {
+                std::cerr << "Error: Unknown log level '" << argv[i] << "'" << std::endl;
+                return 1;
+            }
+            kvstore::Logger::Instance().SetLevel(level);
+        } else if (arg == "--data-dir" && i + 1 < argc) {
+            durability.dir = argv[++i];
+        } else if (arg == "--sync" && i + 1 < argc) {
+            if (!kvstore::ParseWalSyncPolicy(argv[++i], durability.sync)) {
+                std::cerr << "Error: --sync must be 'batch', 'interval' or 'none'" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--sync-interval-ms" && i + 1 < argc) {
+            durability.sync_interval = std::chrono::milliseconds(std::stoi(argv[++i]));
+        } else if (i + 1 < argc && kvstore::ParseServerTuningFlag(arg, argv[i + 1], tuning, tuning_error)) {
+            if (!tuning_error.empty()) {
+                std::cerr << "Error: " << tuning_error << std::endl;
+                return 1;
+            }
+            i++;
+        } else if (arg == "--compress-above-bytes" && i + 1 < argc) {
+            compress_above = static_cast<size_t>(std::stoll(argv[++i]));
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metrics_port = std::stoi(argv[++i]);
+        } else if (arg == "--snapshot-mb" && i + 1 < argc) {
+            durability.snapshot_bytes = static_cast<uint64_t>(std::stoll(argv[++i])) << 20;
+        } else if (arg == "--anti-entropy-ms" && i + 1 < argc) {
+            anti_entropy.interval = std::chrono::milliseconds(std::stoi(argv[++i]));
+        } else if (arg == "--anti-entropy-rate-mb" && i + 1 < argc) {
+            anti_entropy.rate_limit_bytes = std::stoll(argv[++i]) << 20;
+        } else if (arg == "--versions" && i + 1 < argc) {
+            versions.max_versions = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--version-retention-ms" && i + 1 < argc) {
+            versions.retention = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--segment-dir" && i + 1 < argc) {
+            segment_dir = argv[++i];
+        } else if (arg == "--profile") {
+            profile = true;
         }
     }
     
+    if (versions.max_versions > kvstore::VersionChain::kMaxVersions) {
+        std::cerr << "Error: --versions can be at most " << kvstore::VersionChain::kMaxVersions << std::endl;
+        return 1;
+    }
+    
     // Load configuration from file if provided
     kvstore::Config config;
     std::string config_hostname = "";
@@ -147,6 +1189,25 @@ int main(int argc, char** argv) {
         }
     }
     
+    // Background repair runs against every other server in the config, so
+    // each of them must hold every key
+    if (anti_entropy.interval.count() > 0) {
+        const auto& servers = config.GetServers();
+        if (config_file.empty() || servers.empty()) {
+            std::cerr << "Error: --anti-entropy-ms needs --config" << std::endl;
+            return 1;
+        }
+        if (config.GetNumReplicas() > 0 && static_cast<size_t>(config.GetNumReplicas()) < servers.size()) {
+            std::cerr << "Error: --anti-entropy-ms needs every key on every server (num_replicas)" << std::endl;
+            return 1;
+        }
+        for (const auto& server : servers) {
+            if (server.id != server_id) {
+                anti_entropy.peers.push_back(kvstore::FormatAddress(server.host, server.port));
+            }
+        }
+    }
+    
     // IMPORTANT: Always bind to 0.0.0.0 (all interfaces) so server can accept
     // connections from any network interface. The config hostname is only used
     // by clients to know where to connect - servers should listen on all interfaces.
@@ -161,7 +1222,8 @@ int main(int argc, char** argv) {
     }
     std::cout << "  Port: " << port << std::endl;
     
-    RunServer(bind_address, server_id);
+    RunServer(bind_address, server_id, durability, compress_above, tuning, metrics_port, anti_entropy,
+              versions, segment_dir, profile);
     
     return 0;
 }
@@ -0,0 +1,108 @@
+// Anti-entropy implementation.
+
+#include "anti_entropy.h"
+#include <limits>
+#include <utility>
+
+namespace kvstore {
+
+namespace {
+
+// Deadline for one MerkleNodes call
+constexpr std::chrono::seconds MERKLE_RPC_TIMEOUT{5};
+
+} // namespace
+
+grpc::Status FindDifferingLeaves(const MerkleTree& local, ABDService::Stub& peer,
+                                 std::vector<size_t>& leaves) {
+    leaves.clear();
+    std::vector<uint32_t> candidates = {0};
+    for (size_t level = 0; level <= MerkleTree::kDepth && !candidates.empty(); level++) {
+        ABDMerkleRequest request;
+        request.set_level(static_cast<int32_t>(level));
+        for (uint32_t node : candidates) {
+            request.add_nodes(node);
+        }
+        ABDMerkleResponse response;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + MERKLE_RPC_TIMEOUT);
+        grpc::Status status = peer.MerkleNodes(&context, request, &response);
+        if (!status.ok()) {
+            return status;
+        }
+        if (static_cast<size_t>(response.hashes_size()) != candidates.size()) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "MerkleNodes returned the wrong node count");
+        }
+        
+        // Our own hashes are folded only after the peer's are in, so the two
+        // are taken as close together as possible
+        std::vector<uint64_t> ours = local.Level(level);
+        std::vector<uint32_t> next;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (response.hashes(static_cast<int>(i)) == ours[candidates[i]]) {
+                continue;
+            }
+            if (level == MerkleTree::kDepth) {
+                leaves.push_back(candidates[i]);
+                continue;
+            }
+            for (uint32_t child = 0; child < MerkleTree::kFanout; child++) {
+                next.push_back(candidates[i] * static_cast<uint32_t>(MerkleTree::kFanout) + child);
+            }
+        }
+        candidates = std::move(next);
+    }
+    return grpc::Status::OK;
+}
+
+std::vector<HashRing::Range> LeafRanges(const std::vector<size_t>& leaves) {
+    // Leaf i holds hashes [i << kLeafShift, (i + 1) << kLeafShift); a ring
+    // range excludes its start, so it starts one below (wrapping for leaf 0)
+    std::vector<HashRing::Range> ranges;
+    for (size_t i = 0; i < leaves.size();) {
+        size_t last = i;
+        while (last + 1 < leaves.size() && leaves[last + 1] == leaves[last] + 1) {
+            last++;
+        }
+        uint64_t start = (static_cast<uint64_t>(leaves[i]) << MerkleTree::kLeafShift) - 1;
+        uint64_t end = leaves[last] + 1 == MerkleTree::kLeaves
+            ? std::numeric_limits<uint64_t>::max()
+            : (static_cast<uint64_t>(leaves[last] + 1) << MerkleTree::kLeafShift) - 1;
+        ranges.push_back({start, end});
+        i = last + 1;
+    }
+    return ranges;
+}
+
+AntiEntropyLoop::AntiEntropyLoop(std::vector<std::string> peers, std::chrono::milliseconds interval,
+                                 std::function<void(const std::string& peer)> repair)
+    : peers_(std::move(peers)), interval_(interval), repair_(std::move(repair)) {
+}
+
+AntiEntropyLoop::~AntiEntropyLoop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void AntiEntropyLoop::Start() {
+    thread_ = std::thread(&AntiEntropyLoop::Run, this);
+}
+
+void AntiEntropyLoop::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wake_.wait_for(lock, interval_, [this]() { return stop_; })) {
+        lock.unlock();
+        for (const auto& peer : peers_) {
+            repair_(peer);
+        }
+        lock.lock();
+    }
+}
+
+} // namespace kvstore
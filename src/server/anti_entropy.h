@@ -0,0 +1,74 @@
+// Anti-entropy between ABD replicas.
+// Each server keeps a Merkle tree of its store (src/protocol/merkle_tree.h).
+// To repair from a peer it walks both trees from the root, asking the peer
+// (MerkleNodes) only for the children of nodes whose hashes differ, and ends
+// with the leaves that differ. Their ring ranges are then pulled with
+// MigrateRange and merged by max timestamp, the way PullRange does. Replicas
+// that agree cost one round trip; otherwise the data sent is proportional to
+// the number of differing leaves, not to the size of the store.
+// Repair only pulls, so a pair of servers converges once each has repaired
+// from the other. The background loop does that every interval.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "kvstore.grpc.pb.h"
+#include "../common/hash_ring.h"
+#include "../protocol/merkle_tree.h"
+
+namespace kvstore {
+
+// Background repair settings (abd_server --anti-entropy-ms).
+struct AntiEntropyOptions {
+    std::vector<std::string> peers;             // "host:port" of every other replica
+    std::chrono::milliseconds interval{0};      // Time between rounds (0 = off)
+    int64_t rate_limit_bytes = 0;               // Cap on each pull (0 = unlimited)
+};
+
+// Compare the local tree with a peer's.
+// @param local This server's tree
+// @param peer Stub of the peer
+// @param leaves Set to the indices of the differing leaves, ascending
+// @return The first failed MerkleNodes status, or OK
+grpc::Status FindDifferingLeaves(const MerkleTree& local, ABDService::Stub& peer,
+                                 std::vector<size_t>& leaves);
+
+// Ring ranges covering a set of leaves, adjacent leaves joined into one range.
+// @param leaves Leaf indices, ascending
+std::vector<HashRing::Range> LeafRanges(const std::vector<size_t>& leaves);
+
+// Runs `repair(peer)` for every peer, one after another, once per interval
+// on its own thread.
+class AntiEntropyLoop {
+public:
+    AntiEntropyLoop(std::vector<std::string> peers, std::chrono::milliseconds interval,
+                    std::function<void(const std::string& peer)> repair);
+    ~AntiEntropyLoop();
+
+    AntiEntropyLoop(const AntiEntropyLoop&) = delete;
+    AntiEntropyLoop& operator=(const AntiEntropyLoop&) = delete;
+
+    void Start();
+
+private:
+    std::vector<std::string> peers_;
+    std::chrono::milliseconds interval_;
+    std::function<void(const std::string&)> repair_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    void Run();
+};
+
+} // namespace kvstore
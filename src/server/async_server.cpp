@@ -0,0 +1,106 @@
+// Asynchronous serving mode implementation.
+
+#include "async_server.h"
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
+#include <mutex>
+#include <grpcpp/alarm.h>
+#include "../common/logging.h"
+
+namespace kvstore {
+
+// Work handed to another queue's thread: an alarm that expires at once on
+// that queue, running the work when it comes out.
+class AsyncServer::HandOff final : public Tag {
+public:
+    // Must be called holding stop_mutex_ shared, with the queues running.
+    HandOff(grpc::ServerCompletionQueue* cq, std::function<void()> work) : work_(std::move(work)) {
+        alarm_.Set(cq, gpr_now(GPR_CLOCK_MONOTONIC), this);
+    }
+
+    void Proceed(bool) override {
+        work_();
+        delete this;
+    }
+
+private:
+    grpc::Alarm alarm_;
+    std::function<void()> work_;
+};
+
+AsyncServer::AsyncServer(grpc::ServerBuilder& builder, const ServerTuning& tuning,
+                         std::function<size_t(std::string_view)> shard_of)
+    : cpus_(tuning.cpus) {
+    for (int32_t i = 0; i < tuning.async_cqs; i++) {
+        queues_.push_back(builder.AddCompletionQueue());
+    }
+    if (tuning.shard_owners) {
+        shard_of_ = std::move(shard_of);
+    }
+}
+
+AsyncServer::~AsyncServer() {
+    Shutdown();
+}
+
+void AsyncServer::Start() {
+    for (size_t queue = 0; queue < queues_.size(); queue++) {
+        threads_.emplace_back(&AsyncServer::Poll, this, queue);
+    }
+}
+
+void AsyncServer::Shutdown() {
+    {
+        std::unique_lock<std::shared_mutex> lock(stop_mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    for (auto& queue : queues_) {
+        queue->Shutdown();
+    }
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    // Drain queues whose thread never started
+    void* tag = nullptr;
+    bool ok = false;
+    for (auto& queue : queues_) {
+        while (queue->Next(&tag, &ok)) {
+            static_cast<Tag*>(tag)->Proceed(ok);
+        }
+    }
+}
+
+void AsyncServer::RunOn(size_t queue, std::function<void()> work) {
+    {
+        std::shared_lock<std::shared_mutex> lock(stop_mutex_);
+        if (!stopping_) {
+            new HandOff(queues_[queue].get(), std::move(work));
+            return;
+        }
+    }
+    work();
+}
+
+void AsyncServer::Poll(size_t queue) {
+    if (!cpus_.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus_[queue % cpus_.size()], &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            LOG_WARN("[SERVER] Async queue " << queue << " not pinned: " << std::strerror(err));
+        }
+    }
+    void* tag = nullptr;
+    bool ok = false;
+    while (queues_[queue]->Next(&tag, &ok)) {
+        static_cast<Tag*>(tag)->Proceed(ok);
+    }
+}
+
+} // namespace kvstore
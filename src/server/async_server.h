@@ -0,0 +1,181 @@
+// Asynchronous serving mode shared by the ABD and Blocking servers.
+// With --async-cqs N the servers' hot unary methods are taken off gRPC's sync
+// thread pools and served from N completion queues of their own, each drained
+// by one thread (pinned to one of --cpus, round robin, when given). The
+// handlers are the services' ordinary methods, run inline on the queue's
+// thread, so the two modes share every line of request handling. Methods left
+// out (streams, migration, repair, ...) stay on the sync server.
+//
+// With shard ownership (--shard-owners 1) every store shard belongs to one
+// queue, and a single-key request that arrives on another queue is handed to
+// the owner's thread. A shard's lock and slab are then only touched by one
+// core, and slab pages, allocated on first write, come from that core's NUMA
+// node. Batched requests span shards and are served where they arrive.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "server_tuning.h"
+
+namespace kvstore {
+
+class AsyncServer {
+public:
+    // Issues the service's request for one method (Service::RequestAsyncUnary).
+    template <typename Request, typename Reply>
+    using RequestFn = std::function<void(grpc::ServerContext*, Request*, grpc::ServerAsyncResponseWriter<Reply>*,
+                                         grpc::ServerCompletionQueue*, void* tag)>;
+    // Handles one call, as the sync method would.
+    template <typename Request, typename Reply>
+    using HandlerFn = std::function<grpc::Status(grpc::ServerContext*, const Request*, Reply*)>;
+    // Key a request is routed by.
+    template <typename Request>
+    using KeyFn = std::function<std::string_view(const Request&)>;
+
+    // Adds the queues to the builder; call before BuildAndStart.
+    // @param tuning async_cqs, shard_owners and cpus are used
+    // @param shard_of Shard holding a key (used with shard_owners)
+    AsyncServer(grpc::ServerBuilder& builder, const ServerTuning& tuning,
+                std::function<size_t(std::string_view)> shard_of);
+
+    // Shuts the queues down and joins their threads (see Shutdown).
+    ~AsyncServer();
+
+    AsyncServer(const AsyncServer&) = delete;
+    AsyncServer& operator=(const AsyncServer&) = delete;
+
+    // Serve one unary method from every queue. Call after BuildAndStart
+    // and before Start; the method must have been marked async.
+    // @param request_fn Requests the method's next call on a queue
+    // @param handler Handles a call
+    // @param key_of Key to route a call by (nullptr = serve where it arrives)
+    template <typename Request, typename Reply>
+    void Serve(RequestFn<Request, Reply> request_fn, HandlerFn<Request, Reply> handler,
+               KeyFn<Request> key_of = nullptr);
+
+    // Start one thread per queue.
+    void Start();
+
+    // Stop accepting calls and join the threads. Call once the gRPC server
+    // has been shut down.
+    void Shutdown();
+
+    size_t NumQueues() const { return queues_.size(); }
+
+private:
+    // Something waiting on a queue: a call in progress or a hand-off.
+    struct Tag {
+        virtual ~Tag() = default;
+        // @param ok The event's status from CompletionQueue::Next
+        virtual void Proceed(bool ok) = 0;
+    };
+
+    template <typename Request, typename Reply>
+    struct Method {
+        RequestFn<Request, Reply> request;
+        HandlerFn<Request, Reply> handler;
+        KeyFn<Request> key_of;
+    };
+
+    template <typename Request, typename Reply> class UnaryCall;
+    class HandOff;
+
+    std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::vector<int> cpus_;                         // Threads are pinned round robin (empty = not pinned)
+    std::function<size_t(std::string_view)> shard_of_;  // Null unless shard ownership is on
+    std::vector<std::shared_ptr<void>> methods_;    // Keeps every Method alive
+
+    // Taken shared to put anything on a queue, exclusively to stop, so
+    // nothing reaches a queue after it has been shut down.
+    std::shared_mutex stop_mutex_;
+    bool stopping_ = false;
+
+    // Queue owning a key (only with shard ownership).
+    size_t OwnerOf(std::string_view key) const { return shard_of_(key) % queues_.size(); }
+
+    // Run `work` on a queue's thread (inline if the queues are stopping).
+    void RunOn(size_t queue, std::function<void()> work);
+
+    // Thread body: pin, then handle events until the queue is shut down.
+    void Poll(size_t queue);
+};
+
+// One call of a method on one queue. It asks for the call, handles it when
+// it arrives (first asking for the next one, so the queue always has one
+// waiting), and deletes itself once the reply has been sent.
+template <typename Request, typename Reply>
+class AsyncServer::UnaryCall final : public Tag {
+public:
+    // Asks for the method's next call on `queue`. Must be called holding
+    // stop_mutex_ shared, with the queues running.
+    UnaryCall(AsyncServer* server, const Method<Request, Reply>* method, size_t queue)
+        : server_(server), method_(method), queue_(queue), writer_(&context_) {
+        grpc::ServerCompletionQueue* cq = server_->queues_[queue_].get();
+        method_->request(&context_, &request_, &writer_, cq, this);
+    }
+
+    void Proceed(bool ok) override {
+        if (finished_ || !ok) {
+            delete this;                // Reply sent, or the server is shutting down
+            return;
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(server_->stop_mutex_);
+            if (!server_->stopping_) {
+                new UnaryCall(server_, method_, queue_);
+            }
+        }
+        if (server_->shard_of_ && method_->key_of) {
+            size_t owner = server_->OwnerOf(method_->key_of(request_));
+            if (owner != queue_) {
+                server_->RunOn(owner, [this]() { Handle(); });
+                return;
+            }
+        }
+        Handle();
+    }
+
+private:
+    AsyncServer* server_;
+    const Method<Request, Reply>* method_;
+    size_t queue_;                      // Where the call arrived; its events come back here
+    grpc::ServerContext context_;
+    Request request_;
+    grpc::ServerAsyncResponseWriter<Reply> writer_;
+    bool finished_ = false;
+
+    void Handle() {
+        Reply reply;
+        grpc::Status status = method_->handler(&context_, &request_, &reply);
+        std::shared_lock<std::shared_mutex> lock(server_->stop_mutex_);
+        if (server_->stopping_) {
+            lock.unlock();
+            delete this;                // The queues are gone; the call was cancelled
+            return;
+        }
+        finished_ = true;
+        writer_.Finish(reply, status, this);
+    }
+};
+
+template <typename Request, typename Reply>
+void AsyncServer::Serve(RequestFn<Request, Reply> request_fn, HandlerFn<Request, Reply> handler,
+                        KeyFn<Request> key_of) {
+    auto method = std::make_shared<Method<Request, Reply>>(
+        Method<Request, Reply>{std::move(request_fn), std::move(handler), std::move(key_of)});
+    methods_.push_back(method);
+    std::shared_lock<std::shared_mutex> lock(stop_mutex_);
+    for (size_t queue = 0; queue < queues_.size(); queue++) {
+        new UnaryCall<Request, Reply>(this, method.get(), queue);
+    }
+}
+
+} // namespace kvstore
@@ -1,7 +1,10 @@
 // This file implements the Blocking Protocol Server
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/health_check_service_interface.h>
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
@@ -11,6 +14,13 @@
 #include "../protocol/blocking.h"
 #include "../common/config.h"
 #include "../common/utils.h"
+#include "../common/logging.h"
+#include "../common/metrics.h"
+#include "../common/profile_interceptor.h"
+#include "../common/profiler.h"
+#include "async_server.h"
+#include "server_metrics.h"
+#include "server_tuning.h"
 
 using grpc::Server;
 using grpc::ServerBuilder;
@@ -25,37 +35,105 @@ using kvstore::BlockingWriteRequest;
 using kvstore::BlockingWriteResponse;
 using kvstore::BlockingUnlockRequest;
 using kvstore::BlockingUnlockResponse;
+using kvstore::BlockingRenewRequest;
+using kvstore::BlockingRenewResponse;
+using kvstore::BlockingLockReadResponse;
+using kvstore::StatsRequest;
+using kvstore::StatsResponse;
+
+// Methods the server times, in RpcMetrics order. A lock request that waits
+// is timed until it is answered, so its latency includes the wait.
+enum BlockingMethod : size_t {
+    RPC_ACQUIRE_LOCK, RPC_LOCK_AND_READ, RPC_READ, RPC_WRITE, RPC_WRITE_AND_UNLOCK,
+    RPC_RELEASE_LOCK, RPC_RENEW_LOCK
+};
+
+const std::vector<std::string> BLOCKING_METHOD_NAMES = {
+    "AcquireLock", "LockAndRead", "Read", "Write", "WriteAndUnlock", "ReleaseLock", "RenewLock"};
 
 // gRPC service implementation for Blocking protocol.
 // This class implements the BlockingService interface defined in kvstore.proto.
 // It handles lock acquisition, read, write, and lock release requests.
-class BlockingServiceImpl final : public BlockingService::Service {
+// AcquireLock and LockAndRead use the callback API so a request waiting for
+// a held lock is parked without occupying a server thread. The other unary
+// methods are synchronous, or with --async-cqs are served from
+// async_server.h's queues through the same handlers.
+class BlockingServiceImpl final
+    : public BlockingService::WithCallbackMethod_AcquireLock<
+          BlockingService::WithCallbackMethod_LockAndRead<BlockingService::Service>> {
 public:
-    BlockingServiceImpl() : protocol_(std::make_unique<kvstore::BlockingProtocol>()) {}
+    explicit BlockingServiceImpl(int32_t server_id)
+        : protocol_(std::make_unique<kvstore::BlockingProtocol>(server_id)),
+          metrics_(BLOCKING_METHOD_NAMES) {}
     
     // Handles a lock acquisition request.
     // Client requests a lock for a key. Server grants it if:
     // - Key is not locked, OR
-    // - Lock has timed out, OR
+    // - The holder's lease has run out, OR
     // - Same client already holds the lock
-    Status AcquireLock(ServerContext* context, const BlockingLockRequest* request,
-                      BlockingLockResponse* response) override {
-        std::string key = request->key();
+    // Otherwise the request waits (up to wait_ms) in the key's queue and is
+    // answered when the lock is handed to it or the wait runs out.
+    grpc::ServerUnaryReactor* AcquireLock(grpc::CallbackServerContext* context,
+                                          const BlockingLockRequest* request,
+                                          BlockingLockResponse* response) override {
+        const std::string& key = request->key();
         int32_t client_id = request->client_id();
         
-        std::string peer = context->peer();
-        std::cout << "[SERVER] AcquireLock request from " << peer 
-                  << " (client_id=" << client_id << ") for key='" << key << "'" << std::endl;
-        
-        auto result = protocol_->AcquireLock(key, client_id);
+        LOG_DEBUG("[SERVER] AcquireLock request from " << context->peer() 
+                  << " (client_id=" << client_id << ") for key='" << key
+                  << "' wait_ms=" << request->wait_ms() << " lease_ms=" << request->lease_ms());
         
-        response->set_granted(result.granted);
-        response->set_timestamp(result.timestamp);
+        grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+        kvstore::RpcMetric& metric = metrics_[RPC_ACQUIRE_LOCK];
+        auto start = metric.Begin();
+        protocol_->AcquireLock(key, client_id, std::chrono::milliseconds(request->lease_ms()),
+                               std::chrono::milliseconds(request->wait_ms()),
+            [reactor, response, &metric, start](const kvstore::BlockingProtocol::LockResult& result) {
+                response->set_granted(result.granted);
+                response->set_timestamp(result.timestamp);
+                
+                LOG_DEBUG("[SERVER] AcquireLock response: granted=" << result.granted 
+                          << ", ts=" << result.timestamp);
+                
+                metric.End(start);
+                reactor->Finish(Status::OK);
+            });
+        return reactor;
+    }
+    
+    // Handles a fused lock + read request.
+    // Same locking as AcquireLock; once the lock is granted the reply also
+    // carries the stored value and its timestamp.
+    grpc::ServerUnaryReactor* LockAndRead(grpc::CallbackServerContext* context,
+                                          const BlockingLockRequest* request,
+                                          BlockingLockReadResponse* response) override {
+        const std::string& key = request->key();
+        int32_t client_id = request->client_id();
         
-        std::cout << "[SERVER] AcquireLock response: granted=" << result.granted 
-                  << ", ts=" << result.timestamp << std::endl;
+        LOG_DEBUG("[SERVER] LockAndRead request from " << context->peer() 
+                  << " (client_id=" << client_id << ") for key='" << key
+                  << "' wait_ms=" << request->wait_ms() << " lease_ms=" << request->lease_ms());
         
-        return Status::OK;
+        grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+        kvstore::RpcMetric& metric = metrics_[RPC_LOCK_AND_READ];
+        auto start = metric.Begin();
+        protocol_->LockAndRead(key, client_id, std::chrono::milliseconds(request->lease_ms()),
+                               std::chrono::milliseconds(request->wait_ms()),
+            [reactor, response, &metric, start](const kvstore::BlockingProtocol::LockResult& lock,
+                                kvstore::BlockingProtocol::ReadResult read) {
+                response->set_granted(lock.granted);
+                response->set_timestamp(lock.timestamp);
+                response->set_value(std::move(read.value));
+                response->set_value_timestamp(read.timestamp);
+                
+                LOG_DEBUG("[SERVER] LockAndRead response: granted=" << lock.granted 
+                          << ", value_size=" << response->value().size()
+                          << ", value_ts=" << read.timestamp);
+                
+                metric.End(start);
+                reactor->Finish(Status::OK);
+            });
+        return reactor;
     }
     
     // Handles a read request.
@@ -63,21 +141,21 @@ public:
     // value and timestamp.
     Status Read(ServerContext* context, const BlockingReadRequest* request,
                 BlockingReadResponse* response) override {
-        std::string key = request->key();
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_READ]);
+        const std::string& key = request->key();
         int32_t client_id = request->client_id();
         
-        std::string peer = context->peer();
-        std::cout << "[SERVER] Read request from " << peer 
-                  << " (client_id=" << client_id << ") for key='" << key << "'" << std::endl;
+        LOG_DEBUG("[SERVER] Read request from " << context->peer() 
+                  << " (client_id=" << client_id << ") for key='" << key << "'");
         
         auto result = protocol_->Read(key, client_id);
         
-        response->set_value(result.value);
+        response->set_value(std::move(result.value));
         response->set_timestamp(result.timestamp);
         response->set_success(result.success);
         
-        std::cout << "[SERVER] Read response: value='" << result.value 
-                  << "', ts=" << result.timestamp << ", success=" << result.success << std::endl;
+        LOG_DEBUG("[SERVER] Read response: value_size=" << response->value().size()
+                  << ", ts=" << result.timestamp << ", success=" << result.success);
         
         return Status::OK;
     }
@@ -87,55 +165,192 @@ public:
     // with an appropriate timestamp.
     Status Write(ServerContext* context, const BlockingWriteRequest* request,
                  BlockingWriteResponse* response) override {
-        std::string key = request->key();
-        std::string value = request->value();
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_WRITE]);
+        const std::string& key = request->key();
+        const std::string& value = request->value();
         int64_t client_timestamp = request->timestamp();
         int32_t client_id = request->client_id();
         
-        std::string peer = context->peer();
-        std::cout << "[SERVER] Write request from " << peer 
+        LOG_DEBUG("[SERVER] Write request from " << context->peer() 
                   << " (client_id=" << client_id << ") for key='" << key 
-                  << "' value='" << value << "' (client_ts=" << client_timestamp << ")" << std::endl;
+                  << "' value_size=" << value.size() << " (client_ts=" << client_timestamp << ")");
         
         auto result = protocol_->Write(key, value, client_timestamp, client_id);
         
         response->set_success(result.success);
         response->set_timestamp(result.timestamp);
         
-        std::cout << "[SERVER] Write response: ts=" << result.timestamp 
-                  << ", success=" << result.success << std::endl;
+        LOG_DEBUG("[SERVER] Write response: ts=" << result.timestamp 
+                  << ", success=" << result.success);
+        
+        return Status::OK;
+    }
+    
+    // Handles a fused write + unlock request.
+    // Client must hold the lock for this key. Server stores the value and
+    // releases the lock, handing it to the next waiting client.
+    Status WriteAndUnlock(ServerContext* context, const BlockingWriteRequest* request,
+                          BlockingWriteResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_WRITE_AND_UNLOCK]);
+        const std::string& key = request->key();
+        const std::string& value = request->value();
+        int64_t client_timestamp = request->timestamp();
+        int32_t client_id = request->client_id();
+        
+        LOG_DEBUG("[SERVER] WriteAndUnlock request from " << context->peer() 
+                  << " (client_id=" << client_id << ") for key='" << key 
+                  << "' value_size=" << value.size() << " (client_ts=" << client_timestamp << ")");
+        
+        auto result = protocol_->WriteAndUnlock(key, value, client_timestamp, client_id);
+        
+        response->set_success(result.success);
+        response->set_timestamp(result.timestamp);
+        
+        LOG_DEBUG("[SERVER] WriteAndUnlock response: ts=" << result.timestamp 
+                  << ", success=" << result.success);
         
         return Status::OK;
     }
     
     // Handles a lock release request.
-    // Client releases the lock it holds for a key.
+    // Client releases the lock it holds for a key (or withdraws its queued
+    // request for it); the next queued request, if any, is granted the lock.
     Status ReleaseLock(ServerContext* context, const BlockingUnlockRequest* request,
                       BlockingUnlockResponse* response) override {
-        std::string key = request->key();
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_RELEASE_LOCK]);
+        const std::string& key = request->key();
         int32_t client_id = request->client_id();
         
-        std::string peer = context->peer();
-        std::cout << "[SERVER] ReleaseLock request from " << peer 
-                  << " (client_id=" << client_id << ") for key='" << key << "'" << std::endl;
+        LOG_DEBUG("[SERVER] ReleaseLock request from " << context->peer() 
+                  << " (client_id=" << client_id << ") for key='" << key << "'");
         
         bool success = protocol_->ReleaseLock(key, client_id);
         response->set_success(success);
         
-        std::cout << "[SERVER] ReleaseLock response: success=" << success << std::endl;
+        LOG_DEBUG("[SERVER] ReleaseLock response: success=" << success);
+        
+        return Status::OK;
+    }
+    
+    // Handles a lease renewal (heartbeat) request.
+    // Client extends the lease on a lock it still holds.
+    Status RenewLock(ServerContext* context, const BlockingRenewRequest* request,
+                     BlockingRenewResponse* response) override {
+        kvstore::ScopedRpcTimer timer(metrics_[RPC_RENEW_LOCK]);
+        const std::string& key = request->key();
+        int32_t client_id = request->client_id();
+        
+        LOG_DEBUG("[SERVER] RenewLock request from " << context->peer() 
+                  << " (client_id=" << client_id << ") for key='" << key
+                  << "' lease_ms=" << request->lease_ms());
+        
+        bool renewed = protocol_->RenewLock(key, client_id,
+                                            std::chrono::milliseconds(request->lease_ms()));
+        response->set_renewed(renewed);
+        
+        LOG_DEBUG("[SERVER] RenewLock response: renewed=" << renewed);
         
         return Status::OK;
     }
 
+    // Returns the metrics scrape (the same text as the HTTP endpoint).
+    Status Stats(ServerContext*, const StatsRequest*, StatsResponse* response) override {
+        response->set_prometheus_text(RenderMetrics());
+        return Status::OK;
+    }
+    
+    // Render every metric as Prometheus text.
+    std::string RenderMetrics() const {
+        kvstore::PrometheusText out;
+        metrics_.Export(out);
+        kvstore::ExportStoreStats(protocol_->GetStoreStats(), out);
+        
+        auto locks = protocol_->GetLockStats();
+        out.AddCounter("kvstore_lock_requests_total", "Lock requests by outcome", "outcome=\"granted\"",
+                       locks.grants);
+        out.AddCounter("kvstore_lock_requests_total", "Lock requests by outcome", "outcome=\"denied\"",
+                       locks.denies);
+        out.AddCounter("kvstore_lock_requests_total", "Lock requests by outcome", "outcome=\"queued\"",
+                       locks.parked);
+        out.AddCounter("kvstore_lock_requests_total", "Lock requests by outcome",
+                       "outcome=\"wait_timeout\"", locks.wait_timeouts);
+        out.AddCounter("kvstore_lock_lease_expiries_total", "Locks taken back after their lease ran out",
+                       "", locks.lease_expiries);
+        out.AddGauge("kvstore_locks_held", "Keys locked now", "", static_cast<double>(locks.held));
+        out.AddGauge("kvstore_lock_waiters", "Lock requests queued now", "",
+                     static_cast<double>(locks.waiting));
+        return out.Render();
+    }
+
+    // Take the unary methods that never wait for a lock off the sync server,
+    // to be served from the async queues instead (--async-cqs). Call before
+    // registering the service.
+    void MarkHotMethodsAsync() {
+        for (int method : {ASYNC_READ, ASYNC_WRITE, ASYNC_RELEASE_LOCK, ASYNC_RENEW_LOCK,
+                           ASYNC_WRITE_AND_UNLOCK}) {
+            MarkMethodAsync(method);
+        }
+    }
+    
+    // Serve the methods MarkHotMethodsAsync took off the sync server, routed by key.
+    void ServeAsync(kvstore::AsyncServer& async) {
+        ServeAsync(async, ASYNC_READ, &BlockingServiceImpl::Read);
+        ServeAsync(async, ASYNC_WRITE, &BlockingServiceImpl::Write);
+        ServeAsync(async, ASYNC_RELEASE_LOCK, &BlockingServiceImpl::ReleaseLock);
+        ServeAsync(async, ASYNC_RENEW_LOCK, &BlockingServiceImpl::RenewLock);
+        ServeAsync(async, ASYNC_WRITE_AND_UNLOCK, &BlockingServiceImpl::WriteAndUnlock);
+    }
+    
+    // Shard holding a key, for routing it to the shard's owner queue.
+    size_t ShardOf(std::string_view key) const {
+        return protocol_->ShardOf(key);
+    }
+
 private:
+    // BlockingService method indices (proto order) of the methods served async
+    enum AsyncMethod : int {
+        ASYNC_READ = 1, ASYNC_WRITE = 2, ASYNC_RELEASE_LOCK = 3, ASYNC_RENEW_LOCK = 4,
+        ASYNC_WRITE_AND_UNLOCK = 6
+    };
+    
+    // Serve one method from the async queues through its sync handler.
+    template <typename Request, typename Reply>
+    void ServeAsync(kvstore::AsyncServer& async, int method,
+                    Status (BlockingServiceImpl::*handler)(ServerContext*, const Request*, Reply*)) {
+        async.Serve<Request, Reply>(
+            [this, method](ServerContext* context, Request* request, grpc::ServerAsyncResponseWriter<Reply>* writer,
+                           grpc::ServerCompletionQueue* cq, void* tag) {
+                RequestAsyncUnary(method, context, request, writer, cq, cq, tag);
+            },
+            [this, handler](ServerContext* context, const Request* request, Reply* reply) {
+                return (this->*handler)(context, request, reply);
+            },
+            [](const Request& request) -> std::string_view { return request.key(); });
+    }
+    
     std::unique_ptr<kvstore::BlockingProtocol> protocol_;  // Blocking protocol implementation
+    kvstore::RpcMetrics metrics_;                           // Calls and latency per BlockingMethod
 };
 
 // Start and run the gRPC server.
 // @param server_address Address to bind to 
 // @param server_id Unique identifier for this server
-void RunServer(const std::string& server_address, int32_t server_id) {
-    BlockingServiceImpl service;
+// @param tuning Server thread model, message size and CPU settings
+// @param metrics_port Port for Prometheus scrapes (0 = Stats RPC only)
+// @param profile Time request stages and count allocations (--profile)
+void RunServer(const std::string& server_address, int32_t server_id,
+               const kvstore::ServerTuning& tuning, int32_t metrics_port, bool profile) {
+    // Before any thread starts, so the profiling signals only reach the profiler's thread
+    if (profile) {
+        kvstore::profile::BlockSignals(true);
+        kvstore::profile::Enable();
+    }
+    kvstore::profile::Totals profile_start = kvstore::profile::Capture();
+    // Pin first so every thread the service and gRPC start inherits the CPUs
+    if (!kvstore::PinServerThreads(tuning)) {
+        return;
+    }
+    BlockingServiceImpl service(server_id);
     
     // Enable gRPC features
     grpc::EnableDefaultHealthCheckService(true);
@@ -144,7 +359,17 @@ void RunServer(const std::string& server_address, int32_t server_id) {
     // Build and start the server
     ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+    if (tuning.async_cqs > 0) {
+        service.MarkHotMethodsAsync();
+    }
     builder.RegisterService(&service);
+    kvstore::ApplyServerTuning(tuning, builder);
+    if (profile) {
+        kvstore::profile::AddServerProfiling(builder);
+    }
+    // Declared before the server so its queues outlive it
+    kvstore::AsyncServer async(builder, tuning,
+                               [&service](std::string_view key) { return service.ShardOf(key); });
     
     std::unique_ptr<Server> server(builder.BuildAndStart());
     if (!server) {
@@ -152,13 +377,36 @@ void RunServer(const std::string& server_address, int32_t server_id) {
         std::cerr << "  Check if port is already in use or if address is invalid" << std::endl;
         return;
     }
+    if (tuning.async_cqs > 0) {
+        service.ServeAsync(async);
+        async.Start();
+    }
     
     std::cout << " Blocking Server successfully started and listening on " << server_address 
               << " (Server ID: " << server_id << ")" << std::endl;
+    std::cout << "  Threads: " << kvstore::DescribeServerTuning(tuning) << std::endl;
+    kvstore::MetricsHttpServer metrics([&service]() { return service.RenderMetrics(); });
+    if (metrics_port > 0) {
+        if (!metrics.Start(metrics_port)) {
+            server->Shutdown();
+            return;
+        }
+        std::cout << "  Metrics: http://0.0.0.0:" << metrics_port << "/metrics" << std::endl;
+    }
+    std::unique_ptr<kvstore::profile::SignalWindows> profile_windows;
+    if (profile) {
+        profile_windows = std::make_unique<kvstore::profile::SignalWindows>([&server]() { server->Shutdown(); });
+        std::cout << "  Profiling: on (SIGUSR2 opens or closes a window; SIGINT or SIGTERM stops the server"
+                  << " and prints the breakdown)" << std::endl;
+    }
     std::cout << "  Ready to accept connections..." << std::endl;
     
     // Block until server is shut down
     server->Wait();
+    async.Shutdown();
+    if (profile) {
+        kvstore::profile::PrintReport("Profile", profile_start, kvstore::profile::Capture(), std::cout);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -167,6 +415,10 @@ int main(int argc, char** argv) {
     int32_t server_id = 0;
     int32_t port = 5001;
     std::string host = "0.0.0.0";
+    int32_t metrics_port = 0;
+    bool profile = false;
+    kvstore::ServerTuning tuning;
+    std::string tuning_error;
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -179,6 +431,23 @@ int main(int argc, char** argv) {
             port = std::stoi(argv[++i]);
         } else if (arg == "--host" && i + 1 < argc) {
             host = argv[++i];
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metrics_port = std::stoi(argv[++i]);
+        } else if (i + 1 < argc && kvstore::ParseServerTuningFlag(arg, argv[i + 1], tuning, tuning_error)) {
+            if (!tuning_error.empty()) {
+                std::cerr << "Error: " << tuning_error << std::endl;
+                return 1;
+            }
+            i++;
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            kvstore::LogLevel level;
+            if (!kvstore::ParseLogLevel(argv[++i], level)) {
+                std::cerr << "Error: Unknown log level '" << argv[i] << "'" << std::endl;
+                return 1;
+            }
+            kvstore::Logger::Instance().SetLevel(level);
+        } else if (arg == "--profile") {
+            profile = true;
         }
     }
     
@@ -207,7 +476,7 @@ int main(int argc, char** argv) {
     }
     std::cout << "  Port: " << port << std::endl;
     
-    RunServer(bind_address, server_id);
+    RunServer(bind_address, server_id, tuning, metrics_port, profile);
     
     return 0;
 }
@@ -0,0 +1,112 @@
+// Server metrics export implementation.
+
+#include "server_metrics.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace kvstore {
+
+void ExportStoreStats(const ShardedStore::Stats& stats, PrometheusText& out) {
+    out.AddGauge("kvstore_store_keys", "Keys stored", "", static_cast<double>(stats.keys));
+    out.AddGauge("kvstore_store_bytes", "Key and value bytes stored", "",
+                 static_cast<double>(stats.stored_bytes));
+    out.AddGauge("kvstore_store_table_bytes", "Hash table slots and slab pages allocated", "",
+                 static_cast<double>(stats.table_bytes));
+    out.AddCounter("kvstore_shard_lock_acquisitions_total", "Shard locks taken", "",
+                   stats.lock_acquisitions);
+    out.AddHistogram("kvstore_shard_lock_wait_seconds",
+                     "Time spent waiting for a shard lock another request held", "",
+                     stats.lock_wait_ns, 1e-9);
+}
+
+MetricsHttpServer::MetricsHttpServer(std::function<std::string()> render)
+    : render_(std::move(render)) {
+}
+
+MetricsHttpServer::~MetricsHttpServer() {
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+    }
+}
+
+bool MetricsHttpServer::Start(int port) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "ERROR: metrics socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int on = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd_, 16) != 0) {
+        std::cerr << "ERROR: metrics port " << port << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    thread_ = std::thread(&MetricsHttpServer::Serve, this);
+    return true;
+}
+
+void MetricsHttpServer::Serve() {
+    while (!stop_) {
+        // Wake up now and then to notice stop_
+        pollfd pfd{listen_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        Answer(fd);
+        close(fd);
+    }
+}
+
+void MetricsHttpServer::Answer(int fd) {
+    // Only the request line matters; give a client that never sends it a second
+    timeval timeout{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n") == std::string::npos && request.size() < 8192) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string line = request.substr(0, request.find("\r\n"));
+    bool scrape = line.rfind("GET /metrics ", 0) == 0 || line.rfind("GET /metrics?", 0) == 0 ||
+                  line == "GET /metrics";
+    std::string body = scrape ? render_() : "not found\n";
+    std::string response = std::string(scrape ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 404 Not Found\r\n") +
+                           "Content-Type: text/plain; version=0.0.4\r\n" +
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                           "Connection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+} // namespace kvstore
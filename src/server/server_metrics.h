@@ -0,0 +1,47 @@
+// Metrics export shared by the ABD and Blocking servers.
+// Each server renders a scrape (its RPC metrics, the store's size and lock
+// contention, and its protocol's own figures) as Prometheus text. The text is
+// served by the Stats RPC and, with --metrics-port, on a plain HTTP port
+// (GET /metrics) so Prometheus can scrape the server directly.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include "../common/metrics.h"
+#include "../protocol/sharded_store.h"
+
+namespace kvstore {
+
+// Add the store size and shard lock contention series.
+void ExportStoreStats(const ShardedStore::Stats& stats, PrometheusText& out);
+
+// Minimal HTTP/1.0 server for Prometheus scrapes. One thread accepts
+// connections and answers them one at a time: GET /metrics gets the rendered
+// text, anything else a 404. Scrapes are rare, so nothing fancier is needed.
+class MetricsHttpServer {
+public:
+    // @param render Produces the scrape text; called on the server's thread
+    explicit MetricsHttpServer(std::function<std::string()> render);
+    ~MetricsHttpServer();
+
+    MetricsHttpServer(const MetricsHttpServer&) = delete;
+    MetricsHttpServer& operator=(const MetricsHttpServer&) = delete;
+
+    // Listen on 0.0.0.0:port and start serving.
+    // @return false if the port can't be bound
+    bool Start(int port);
+
+private:
+    std::function<std::string()> render_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+
+    void Serve();
+    void Answer(int fd);
+};
+
+} // namespace kvstore
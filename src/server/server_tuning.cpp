@@ -0,0 +1,159 @@
+// Server thread model and transport settings implementation.
+
+#include "server_tuning.h"
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <grpc/grpc.h>
+#include <grpcpp/resource_quota.h>
+
+namespace kvstore {
+
+namespace {
+
+bool ParseNonNegative(const std::string& text, int32_t& out) {
+    try {
+        size_t used = 0;
+        int value = std::stoi(text, &used);
+        if (used != text.size() || value < 0) {
+            return false;
+        }
+        out = value;
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+} // namespace
+
+bool ParseCpuList(const std::string& list, std::vector<int>& cpus) {
+    cpus.clear();
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        int32_t first = 0;
+        int32_t last = 0;
+        size_t dash = item.find('-');
+        if (dash == std::string::npos) {
+            if (!ParseNonNegative(item, first)) {
+                return false;
+            }
+            last = first;
+        } else if (!ParseNonNegative(item.substr(0, dash), first) ||
+                   !ParseNonNegative(item.substr(dash + 1), last) || last < first) {
+            return false;
+        }
+        if (last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return !cpus.empty();
+}
+
+bool ParseServerTuningFlag(const std::string& flag, const std::string& value,
+                           ServerTuning& tuning, std::string& error) {
+    int32_t* field = nullptr;
+    if (flag == "--cqs") {
+        field = &tuning.num_cqs;
+    } else if (flag == "--min-pollers") {
+        field = &tuning.min_pollers;
+    } else if (flag == "--max-pollers") {
+        field = &tuning.max_pollers;
+    } else if (flag == "--max-threads") {
+        field = &tuning.max_threads;
+    } else if (flag == "--max-message-mb") {
+        field = &tuning.max_message_mb;
+    } else if (flag == "--keepalive-ms") {
+        field = &tuning.keepalive_ms;
+    } else if (flag == "--async-cqs") {
+        field = &tuning.async_cqs;
+    } else if (flag == "--shard-owners") {
+        if (value != "0" && value != "1") {
+            error = "--shard-owners takes 0 or 1";
+        }
+        tuning.shard_owners = value == "1";
+        return true;
+    } else if (flag == "--cpus") {
+        if (!ParseCpuList(value, tuning.cpus)) {
+            error = "--cpus takes a list like 0-3,8";
+        }
+        return true;
+    } else {
+        return false;
+    }
+    if (!ParseNonNegative(value, *field)) {
+        error = flag + " takes a non-negative integer";
+    }
+    return true;
+}
+
+bool PinServerThreads(const ServerTuning& tuning) {
+    if (tuning.cpus.empty()) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : tuning.cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        std::cerr << "ERROR: Cannot pin server to the given CPUs: " << std::strerror(errno)
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ApplyServerTuning(const ServerTuning& tuning, grpc::ServerBuilder& builder) {
+    using Option = grpc::ServerBuilder::SyncServerOption;
+    if (tuning.num_cqs > 0) {
+        builder.SetSyncServerOption(Option::NUM_CQS, tuning.num_cqs);
+    }
+    if (tuning.min_pollers > 0) {
+        builder.SetSyncServerOption(Option::MIN_POLLERS, tuning.min_pollers);
+    }
+    if (tuning.max_pollers > 0) {
+        builder.SetSyncServerOption(Option::MAX_POLLERS, tuning.max_pollers);
+    }
+    if (tuning.max_threads > 0) {
+        grpc::ResourceQuota quota("server");
+        quota.SetMaxThreads(tuning.max_threads);
+        builder.SetResourceQuota(quota);
+    }
+    if (tuning.max_message_mb > 0) {
+        builder.SetMaxReceiveMessageSize(tuning.max_message_mb << 20);
+    }
+    if (tuning.keepalive_ms > 0) {
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, tuning.keepalive_ms);
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    }
+}
+
+std::string DescribeServerTuning(const ServerTuning& tuning) {
+    auto or_default = [](int32_t value) {
+        return value > 0 ? std::to_string(value) : std::string("default");
+    };
+    std::ostringstream out;
+    out << "cqs=" << or_default(tuning.num_cqs)
+        << " pollers=" << or_default(tuning.min_pollers) << ".." << or_default(tuning.max_pollers)
+        << " max_threads=" << or_default(tuning.max_threads) << " cpus=";
+    if (tuning.cpus.empty()) {
+        out << "any";
+    } else {
+        for (size_t i = 0; i < tuning.cpus.size(); i++) {
+            out << (i > 0 ? "," : "") << tuning.cpus[i];
+        }
+    }
+    if (tuning.async_cqs > 0) {
+        out << " async_cqs=" << tuning.async_cqs << (tuning.shard_owners ? " (shard owners)" : "");
+    }
+    return out.str();
+}
+
+} // namespace kvstore
@@ -0,0 +1,57 @@
+// Thread model and transport settings shared by the ABD and Blocking servers.
+// By default both servers use gRPC's synchronous server, which spreads calls
+// over several completion queues, each drained by a pool of polling threads.
+// These settings size that pool, cap the threads the server may create, tune
+// message sizes and keepalives, and can pin the whole server (the gRPC threads
+// and the protocol's own, e.g. the WAL writer) to a set of CPUs. async_cqs
+// switches the hot unary methods to the async server in async_server.h
+// instead. Everything left at its default keeps gRPC's behaviour.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+
+namespace kvstore {
+
+struct ServerTuning {
+    int32_t num_cqs = 0;            // Completion queues (0 = gRPC default: one per core)
+    int32_t min_pollers = 0;        // Polling threads kept per queue (0 = default)
+    int32_t max_pollers = 0;        // Polling threads allowed per queue (0 = default)
+    int32_t max_threads = 0;        // Cap on server threads (0 = no cap)
+    int32_t max_message_mb = 0;     // Largest request accepted (0 = gRPC's 4 MB)
+    int32_t keepalive_ms = 0;       // Ping idle clients this often (0 = off)
+    std::vector<int> cpus;          // CPUs to run on (empty = any)
+    int32_t async_cqs = 0;          // Async mode: queues, one thread each (0 = sync server only)
+    bool shard_owners = false;      // Async mode: serve each key on its shard's queue
+};
+
+// Parse a CPU list such as "0-3,8".
+// @return false if the list is malformed or empty
+bool ParseCpuList(const std::string& list, std::vector<int>& cpus);
+
+// Handle one of the tuning flags (--cqs, --min-pollers, --max-pollers,
+// --max-threads, --max-message-mb, --keepalive-ms, --cpus, --async-cqs,
+// --shard-owners).
+// @param flag Command line flag
+// @param value The argument following it
+// @param tuning Updated with the flag's value
+// @param error Set to a message if the flag is ours but its value is invalid
+// @return true if `flag` is a tuning flag (its value is then consumed)
+bool ParseServerTuningFlag(const std::string& flag, const std::string& value,
+                           ServerTuning& tuning, std::string& error);
+
+// Pin the calling thread (and so every thread it starts afterwards) to the
+// configured CPUs. Call before the service and the server are created.
+// @return false if the CPUs can't be used
+bool PinServerThreads(const ServerTuning& tuning);
+
+// Apply the thread, message size and keepalive settings to a builder.
+void ApplyServerTuning(const ServerTuning& tuning, grpc::ServerBuilder& builder);
+
+// One-line summary for the startup banner.
+std::string DescribeServerTuning(const ServerTuning& tuning);
+
+} // namespace kvstore
@@ -1,12 +1,32 @@
 // Correctness Tests for ABD Protocol
 
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <grpcpp/grpcpp.h>
+#include "kvstore.grpc.pb.h"
 #include "../src/client/abd_client.h"
+#include "../src/client/rebalancer.h"
+#include "../src/client/replica_stats.h"
 #include "../src/common/config.h"
+#include "../src/common/hash_ring.h"
+#include "../src/common/hlc.h"
+#include "../src/common/utils.h"
+#include "../src/protocol/abd.h"
+#include "../src/protocol/ordered_index.h"
+#include "../src/protocol/segment.h"
+#include "../src/protocol/wal.h"
 
 using namespace kvstore;
 
@@ -14,6 +34,12 @@ using namespace kvstore;
 int tests_passed = 0;
 int tests_failed = 0;
 
+// Every client in the run gets its own id, so no two share a writer id
+int32_t next_client_id() {
+    static int32_t next = 1;
+    return next++;
+}
+
 void assert_test(bool condition, const std::string& test_name) {
     if (condition) {
         std::cout << "PASS: " << test_name << std::endl;
@@ -183,14 +209,882 @@ void test_special_characters(ABDClient& client) {
     assert_test(read_value == value, "Special characters are preserved");
 }
 
+// Test 11: Batched MultiWrite / MultiRead
+void test_multi_read_write(ABDClient& client1, ABDClient& client2) {
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    for (int i = 0; i < 50; i++) {
+        keys.push_back("multi_key_" + std::to_string(i));
+        values.push_back("multi_value_" + std::to_string(i));
+    }
+    
+    bool write_ok = client1.MultiWrite(keys, values);
+    assert_test(write_ok, "MultiWrite succeeds");
+    
+    std::vector<std::string> read_values;
+    bool read_ok = client2.MultiRead(keys, read_values);
+    assert_test(read_ok, "MultiRead succeeds");
+    assert_test(read_values == values, "MultiRead returns every value in key order");
+    
+    // Batch results must agree with single-key reads and writes
+    client2.Write(keys[7], "single_value");
+    std::string single;
+    client1.MultiRead(keys, read_values);
+    client1.Read(keys[8], single);
+    assert_test(read_values.size() == keys.size() && read_values[7] == "single_value" &&
+                single == values[8], "MultiRead sees single-key writes");
+    
+    std::vector<std::string> empty;
+    assert_test(client1.MultiRead({}, empty) && empty.empty(), "Empty MultiRead succeeds");
+}
+
+// Test 12: Coalesced Operations
+// Many threads share one client with coalescing on, so their reads and
+// writes go out as batched RPCs. Every caller must still get its own result.
+void test_coalesced_operations(const Config& base_config) {
+    Config config = base_config;
+    config.SetCoalesceWindowUs(200);
+    ABDClient client(config, next_client_id());
+    
+    const int num_threads = 8;
+    std::vector<std::thread> threads;
+    std::vector<int> ok(num_threads, 0);
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            std::string key = "coalesce_key_" + std::to_string(t);
+            std::string value = "coalesce_value_" + std::to_string(t);
+            std::string read_value;
+            ok[t] = client.Write(key, value) && client.Read(key, read_value) &&
+                    read_value == value;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    
+    bool all_ok = std::all_of(ok.begin(), ok.end(), [](int v) { return v == 1; });
+    assert_test(all_ok, "Coalesced concurrent operations return their own results");
+}
+
+void test_stream_transport(const Config& base_config, ABDClient& unary_client) {
+    Config config = base_config;
+    config.SetTransport(TransportType::STREAM);
+    ABDClient client(config, next_client_id());
+    
+    const int num_threads = 8;
+    std::vector<std::thread> threads;
+    std::vector<int> ok(num_threads, 0);
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            std::string key = "stream_key_" + std::to_string(t);
+            std::string value = "stream_value_" + std::to_string(t);
+            std::string read_value;
+            ok[t] = client.Write(key, value) && client.Read(key, read_value) &&
+                    read_value == value;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    
+    bool all_ok = std::all_of(ok.begin(), ok.end(), [](int v) { return v == 1; });
+    assert_test(all_ok, "Streamed concurrent operations return their own results");
+    
+    // Writes over the stream are visible to a unary client
+    std::string value;
+    bool visible = unary_client.Read("stream_key_0", value) && value == "stream_value_0";
+    assert_test(visible, "Streamed write visible to unary client");
+}
+
+// Back-to-back writes from two clients land in the same millisecond; the
+// hybrid clock must still order each one after the last
+void test_timestamp_order(const Config& config, ABDClient& client1, ABDClient& client2) {
+    // Servers store the writer's timestamp and keep the newest write, in any arrival order
+    ABDProtocol store(0);
+    bool kept = store.Write("k", "new", 200).timestamp == 200 && store.Read("k", 0).value == "new" &&
+                store.Read("k", 0).timestamp == 200;
+    auto older = store.Write("k", "old", 100);
+    kept = kept && older.success && !older.accepted && older.timestamp == 200 &&
+           store.Read("k", 0).value == "new" && store.Write("k", "new", 200).accepted;
+    assert_test(kept, "Server keeps the writer's timestamp and reports an older write as superseded");
+    
+    std::string key = "hlc_key";
+    bool ordered = true;
+    bool increasing = true;
+    int64_t last_timestamp = 0;
+    for (int i = 0; i < 50; i++) {
+        ABDClient& writer = (i % 2 == 0) ? client1 : client2;
+        ABDClient& reader = (i % 2 == 0) ? client2 : client1;
+        std::string value = "hlc_value_" + std::to_string(i);
+        std::string read_value;
+        ordered = ordered && writer.Write(key, value) && reader.Read(key, read_value) &&
+                  read_value == value;
+        increasing = increasing && writer.GetCurrentTimestamp() > last_timestamp;
+        last_timestamp = writer.GetCurrentTimestamp();
+    }
+    assert_test(ordered, "Alternating same-millisecond writes read back in order");
+    assert_test(increasing, "Client timestamps order after every write seen");
+    
+    // Writer ids are the client ids, so they can't be out of range or shared
+    bool distinct = hlc::Writer(client1.SnapshotTimestamp()) != hlc::Writer(client2.SnapshotTimestamp());
+    bool rejected = false;
+    try {
+        ABDClient out_of_range(config, hlc::kMaxClientId + 1);
+    } catch (const std::out_of_range&) {
+        rejected = true;
+    }
+    assert_test(distinct && rejected, "Clients stamp their own id and reject ids past the writer field");
+}
+
+// A writer whose clock lags: every replica already holds the key under a
+// timestamp far ahead of the client's clock. The write must not be dropped;
+// the client retries above the newer timestamp until it is applied.
+void test_superseded_write(const Config& config, ABDClient& client) {
+    // Store the key on every replica under a timestamp a minute past `base`
+    auto plant = [&](int64_t base) {
+        int64_t ahead = hlc::Pack(hlc::Physical(base) + 60000, 0, hlc::ServerWriterId(0));
+        for (const auto& server : config.GetServers()) {
+            auto stub = ABDService::NewStub(grpc::CreateChannel(FormatAddress(server.host, server.port),
+                                                                grpc::InsecureChannelCredentials()));
+            grpc::ClientContext context;
+            ABDWriteRequest request;
+            request.set_key("lagging_key");
+            request.set_value("from_the_future");
+            request.set_timestamp(ahead);
+            ABDWriteResponse response;
+            if (!stub->Write(&context, request, &response).ok() || !response.success()) {
+                return int64_t{0};
+            }
+        }
+        return ahead;
+    };
+    int64_t ahead = plant(client.GetCurrentTimestamp());
+    std::string value;
+    bool applied = ahead > 0 && client.Write("lagging_key", "lagging_value") &&
+                   client.Read("lagging_key", value) && value == "lagging_value" &&
+                   client.GetCurrentTimestamp() > ahead;
+    assert_test(applied, "Write from a lagging clock is retried above the newer timestamp");
+    
+    ahead = plant(client.GetCurrentTimestamp());
+    std::vector<std::string> read_back;
+    bool batch = ahead > 0 && client.MultiWrite({"lagging_key"}, {"lagging_batch"}) &&
+                 client.MultiRead({"lagging_key"}, read_back) &&
+                 read_back == std::vector<std::string>{"lagging_batch"};
+    assert_test(batch, "Batched write from a lagging clock is retried above the newer timestamp");
+}
+
+// Adaptive reads: replicas are ranked by measured latency, and a read that
+// asks only the fastest R must still see every completed write
+void test_adaptive_reads(const Config& base_config, ABDClient& writer) {
+    ReplicaStats stats(3, std::chrono::microseconds(500));
+    for (int i = 0; i < 20; i++) {
+        for (size_t server = 0; server < 3; server++) {
+            stats.OnSend(server);
+            stats.OnReply(server, std::chrono::microseconds(server == 1 ? 5000 : 100 * (server + 1)), false);
+        }
+    }
+    std::vector<size_t> order = stats.Rank({1, 2, 0});
+    assert_test(order == std::vector<size_t>({2, 1, 0}), "Replicas are ranked fastest first");
+    bool floor = stats.HedgeDelay(0) == std::chrono::microseconds(500) &&
+                 stats.HedgeDelay(1) > std::chrono::microseconds(5000);
+    assert_test(floor, "Hedge delay is the latency estimate, at least the floor");
+    
+    Config config = base_config;
+    config.SetAdaptiveReads(true);
+    ABDClient client(config, next_client_id());
+    Config stream_config = config;
+    stream_config.SetTransport(TransportType::STREAM);
+    ABDClient stream_client(stream_config, next_client_id());
+    
+    // As in test_read_after_write, give each operation's last replica a
+    // moment to apply it: servers keep whichever write reaches them last
+    bool fresh = true;
+    std::string value;
+    for (int i = 0; i < 20; i++) {
+        std::string expected = "adaptive_value_" + std::to_string(i);
+        fresh = fresh && writer.Write("adaptive_key", expected);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        fresh = fresh && client.Read("adaptive_key", value) && value == expected;
+        fresh = fresh && stream_client.Read("adaptive_key", value) && value == expected;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    assert_test(fresh, "Adaptive reads see every completed write");
+}
+
+// Cached reads: a client with a read cache must keep returning its cached
+// value only while no newer write exists anywhere in a read quorum
+void test_read_cache(const Config& base_config, ABDClient& writer) {
+    Config config = base_config;
+    config.SetReadCacheEntries(16);
+    ABDClient client(config, next_client_id());
+    
+    std::string key = "cache_key";
+    std::string value;
+    bool ok = client.Write(key, "cache_value_1");
+    bool repeated = true;
+    for (int i = 0; i < 5; i++) {
+        repeated = repeated && client.Read(key, value) && value == "cache_value_1";
+    }
+    assert_test(ok && repeated, "Cached reads return the cached value");
+    
+    // Another client's write must be seen on the next read
+    writer.Write(key, "cache_value_2");
+    bool fresh = client.Read(key, value) && value == "cache_value_2";
+    fresh = fresh && client.Read(key, value) && value == "cache_value_2";
+    assert_test(fresh, "Cached read sees a newer write from another client");
+    
+    // More keys than the cache holds: evicted keys are read normally
+    bool evicted_ok = true;
+    for (int i = 0; i < 40; i++) {
+        std::string k = "cache_evict_" + std::to_string(i);
+        evicted_ok = evicted_ok && client.Write(k, "v" + std::to_string(i));
+    }
+    for (int i = 0; i < 40; i++) {
+        std::string k = "cache_evict_" + std::to_string(i);
+        evicted_ok = evicted_ok && client.Read(k, value) && value == "v" + std::to_string(i);
+    }
+    assert_test(evicted_ok, "Reads past the cache capacity stay correct");
+}
+
+// Values above large_value_bytes travel in chunks (this one is over gRPC's
+// 4 MB message limit); reads fetch them from a single replica
+void test_chunked_value(const Config& base_config, ABDClient& client1, ABDClient& client2) {
+    std::string key = "chunked_key";
+    std::string value(6 << 20, 'C');
+    for (size_t i = 0; i < value.size(); i += 4096) {
+        value[i] = static_cast<char>('a' + (i / 4096) % 26);
+    }
+    std::string read_value;
+    bool ok = client1.Write(key, value) && client2.Read(key, read_value) && read_value == value;
+    assert_test(ok, "Multi-megabyte value is written and read in chunks");
+    
+    // Phase 1 over the stream transport leaves the value out too
+    Config stream_config = base_config;
+    stream_config.SetTransport(TransportType::STREAM);
+    ABDClient stream_client(stream_config, next_client_id());
+    read_value.clear();
+    ok = stream_client.Read(key, read_value) && read_value == value;
+    assert_test(ok, "Chunked value is read over the stream transport");
+    
+    // Batched reads leave values over their limit out on the server too
+    ABDProtocol store(0);
+    store.Write("big", std::string(100, 'b'), 0);
+    store.Write("small", "s", 0);
+    auto limited = store.MultiRead({"big", "small"}, {10, 10});
+    ok = limited[0].omitted && limited[0].value.empty() && limited[0].timestamp > 0 &&
+         !limited[1].omitted && limited[1].value == "s";
+    assert_test(ok, "MultiRead omits values over their limit without copying them");
+    
+    // Gzipped on the wire
+    Config compress_config = base_config;
+    compress_config.SetCompressAboveBytes(1024);
+    ABDClient compress_client(compress_config, next_client_id());
+    std::string compressible(100000, 'z');
+    ok = compress_client.Write("compressed_key", compressible) &&
+         client2.Read("compressed_key", read_value) && read_value == compressible;
+    assert_test(ok, "Compressed write is stored intact");
+}
+
+// Every server answers Stats with Prometheus text covering its RPCs and store
+void test_stats(const Config& config, ABDClient& client) {
+    client.Write("stats_key", "stats_value");
+    const auto& server = config.GetServers()[0];
+    auto stub = ABDService::NewStub(grpc::CreateChannel(FormatAddress(server.host, server.port),
+                                                        grpc::InsecureChannelCredentials()));
+    grpc::ClientContext context;
+    StatsRequest request;
+    StatsResponse response;
+    bool ok = stub->Stats(&context, request, &response).ok();
+    const std::string& text = response.prometheus_text();
+    assert_test(ok && text.find("# TYPE kvstore_rpc_duration_seconds histogram") != std::string::npos &&
+                text.find("kvstore_rpc_duration_seconds_count{method=\"Write\"} 0\n") == std::string::npos &&
+                text.find("kvstore_store_keys ") != std::string::npos &&
+                text.find("kvstore_shard_lock_wait_seconds_count") != std::string::npos,
+                "Stats reports RPC latency and store size");
+}
+
+// Range scans: the ordered index keeps every key sorted through its page
+// splits, and a client scan returns a range in order across several pages
+void test_scan(ABDClient& client) {
+    OrderedIndex index;
+    std::vector<std::string> inserted;
+    for (int i = 0; i < 20000; i++) {
+        inserted.push_back("k" + std::to_string((i * 7919) % 20000));
+    }
+    bool fresh = true;
+    for (const auto& key : inserted) {
+        fresh = fresh && index.Insert(key);
+    }
+    std::sort(inserted.begin(), inserted.end());
+    std::vector<std::string> all = index.Range("", "", inserted.size() + 1);
+    std::vector<std::string> middle = index.Range("k5", "k6", 100000);
+    size_t in_middle = static_cast<size_t>(std::count_if(inserted.begin(), inserted.end(),
+        [](const std::string& key) { return key >= "k5" && key < "k6"; }));
+    assert_test(fresh && !index.Insert("k42") && all == inserted && middle.size() == in_middle &&
+                std::is_sorted(middle.begin(), middle.end()) && middle.front() == "k5",
+                "Ordered index returns sorted key ranges");
+    
+    // More keys than one server page holds
+    const int count = 1500;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    for (int i = 0; i < count; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "scan_key_%05d", i);
+        keys.push_back(key);
+        values.push_back("scan_value_" + std::to_string(i));
+    }
+    bool written = client.MultiWrite(keys, values);
+    client.Write(keys[10], "scan_value_newest");
+    values[10] = "scan_value_newest";
+    
+    std::vector<std::pair<std::string, std::string>> entries;
+    bool ok = client.Scan("scan_key_", "scan_key_~", count + 10, entries) &&
+              entries.size() == static_cast<size_t>(count);
+    for (int i = 0; ok && i < count; i++) {
+        ok = entries[i].first == keys[i] && entries[i].second == values[i];
+    }
+    assert_test(written && ok, "Scan returns a range in key order with the newest values");
+    
+    bool limited = client.Scan("scan_key_00100", "scan_key_00200", 10, entries) &&
+                   entries.size() == 10 && entries.front().first == "scan_key_00100";
+    limited = limited && client.Scan("scan_key_00100", "scan_key_00105", 1000, entries) &&
+              entries.size() == 5 && entries.back().first == "scan_key_00104";
+    assert_test(limited, "Scan stops at the limit and the end key");
+}
+
+// Snapshot reads: each server keeps a bounded chain of superseded versions,
+// and ReadAt / snapshot scans read the version current at a timestamp
+void test_snapshot_reads(ABDClient& client) {
+    ABDProtocol store(0);
+    store.SetVersionRetention({2, std::chrono::milliseconds(0)});
+    int64_t t1 = store.Write("k", "v1", 0).timestamp;
+    int64_t t2 = store.Write("k", "v2", 0).timestamp;
+    int64_t t3 = store.Write("k", "v3", 0).timestamp;
+    auto before = store.ReadAt("k", t1 - 1);
+    assert_test(before.success && before.timestamp == 0 && store.ReadAt("k", t1).value == "v1" &&
+                store.ReadAt("k", t3 - 1).value == "v2" && store.ReadAt("k", t3).value == "v3",
+                "Server ReadAt returns the version current at a timestamp");
+    
+    // The chain holds two versions, so a fourth write drops v1
+    int64_t t4 = store.Write("k", "v4", 0).timestamp;
+    auto dropped = store.ReadAt("k", t1);
+    assert_test(!dropped.success && dropped.too_old && store.ReadAt("k", t2).value == "v2" &&
+                store.ReadAt("k", t4).value == "v4",
+                "Server drops versions past the limit and reports reads of them as too old");
+    
+    // Writes after a snapshot read are stamped above it
+    int64_t snapshot = t4 + (int64_t(1) << 30);
+    store.ReadAt("k", snapshot);
+    assert_test(store.Write("k", "v5", 0).timestamp > snapshot && store.ReadAt("k", snapshot).value == "v4",
+                "Writes after a snapshot read don't change the snapshot");
+    
+    ABDProtocol aged(0);
+    aged.SetVersionRetention({4, std::chrono::milliseconds(1)});
+    int64_t a = aged.Write("k", "a", 0).timestamp;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    int64_t b = aged.Write("k", "b", 0).timestamp;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    aged.Write("k", "c", 0);
+    assert_test(aged.ReadAt("k", a).too_old && aged.ReadAt("k", b).value == "b",
+                "Server drops versions superseded longer ago than the retention");
+    
+    // Through the cluster (servers keep history by default)
+    // Fresh keys on every run
+    std::string prefix = "snapshot_" + std::to_string(client.GetCurrentTimestamp()) + "_";
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    for (int i = 0; i < 5; i++) {
+        keys.push_back(prefix + std::to_string(i));
+        values.push_back("before_" + std::to_string(i));
+    }
+    bool written = client.MultiWrite(keys, values);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    int64_t snap = client.SnapshotTimestamp();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    for (int i = 0; i < 5; i++) {
+        written = client.Write(keys[i], "after_" + std::to_string(i)) && written;
+    }
+    written = client.Write(prefix + "5", "after_5") && written;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    
+    std::string then;
+    std::string now;
+    std::string missing = "unset";
+    bool ok = client.ReadAt(keys[2], snap, then) && client.Read(keys[2], now) &&
+              client.ReadAt(prefix + "5", snap, missing);
+    assert_test(written && ok && then == "before_2" && now == "after_2" && missing.empty(),
+                "ReadAt reads a key as of a snapshot");
+    
+    std::vector<std::pair<std::string, std::string>> entries;
+    bool scanned = client.Scan(prefix, prefix + "~", 100, entries, snap) && entries.size() == 5;
+    for (int i = 0; scanned && i < 5; i++) {
+        scanned = entries[i].first == keys[i] && entries[i].second == values[i];
+    }
+    assert_test(scanned, "Scan at a snapshot returns the keys and values it had");
+}
+
+// Conditional writes: the server keeps the newest timestamp, and a client
+// that loses a write retries above the winner
+void test_conditional_writes(const Config& base_config) {
+    ABDProtocol store(0);
+    bool cas = store.WriteIfNewer("k", "a", 100).accepted && store.WriteIfNewer("k", "a", 100).accepted;
+    auto stale = store.WriteIfNewer("k", "b", 50);
+    auto newer = store.WriteIfNewer("k", "c", 200);
+    assert_test(cas && !stale.accepted && stale.timestamp == 100 && newer.accepted &&
+                store.Read("k", 0).value == "c" && store.Read("k", 0).timestamp == 200,
+                "WriteIfNewer applies only writes above the stored timestamp");
+    
+    Config config = base_config;
+    config.SetConditionalWrites(true);
+    ABDClient client1(config, next_client_id());
+    ABDClient client2(config, next_client_id());
+    ABDClient client3(config, next_client_id());
+    std::string key = "conditional_" + std::to_string(client1.GetCurrentTimestamp());
+    
+    // Another writer got a newer timestamp onto every server first
+    const auto& servers = config.GetServers();
+    int64_t ahead = hlc::Pack(hlc::WallPhysical() + 1000, 0, hlc::ClientWriterId(99));
+    bool seeded = true;
+    for (const auto& server : servers) {
+        auto stub = ABDService::NewStub(grpc::CreateChannel(
+            FormatAddress(server.host, server.port), grpc::InsecureChannelCredentials()));
+        grpc::ClientContext context;
+        ABDWriteRequest request;
+        request.set_key(key);
+        request.set_value("ahead");
+        request.set_timestamp(ahead);
+        ABDWriteIfNewerResponse response;
+        seeded = stub->WriteIfNewer(&context, request, &response).ok() && response.accepted() && seeded;
+    }
+    std::string value;
+    bool retried = seeded && client1.Write(key, "mine") && client2.Read(key, value) && value == "mine";
+    assert_test(retried, "A rejected conditional write retries above the newer timestamp");
+    
+    // Concurrent writers still converge on one value
+    std::string race = key + "_race";
+    std::vector<std::thread> writers;
+    ABDClient* clients[] = {&client1, &client2, &client3};
+    for (int i = 0; i < 3; i++) {
+        writers.emplace_back([&, i]() {
+            for (int j = 0; j < 10; j++) {
+                clients[i]->Write(race, "writer_" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    std::string v1, v2, v3;
+    bool agreed = client1.Read(race, v1) && client2.Read(race, v2) && client3.Read(race, v3) &&
+                  v1 == v2 && v2 == v3 && v1.compare(0, 7, "writer_") == 0;
+    assert_test(agreed, "Concurrent conditional writes converge on one value");
+}
+
+// Segment files: written sorted and checksummed, imported into every server
+// and exported back (servers and test share a filesystem here, and the
+// servers were started with --segment-dir segment_dir)
+void test_segments(const Config& config, ABDClient& client, const std::string& segment_dir) {
+    std::string prefix = "bulk_" + std::to_string(client.GetCurrentTimestamp()) + "_";
+    std::string name = "kvstore_test_" + std::to_string(client.GetCurrentTimestamp()) + ".seg";
+    std::string path = segment_dir + "/" + name;
+    std::error_code ec;
+    std::filesystem::create_directories(segment_dir, ec);
+    const int count = 5000;     // Several blocks
+    int64_t timestamp = client.GetCurrentTimestamp() + 1;
+    bool written;
+    {
+        SegmentWriter writer(path);
+        written = writer.Open();
+        for (int i = 0; written && i < count; i++) {
+            char key[64];
+            snprintf(key, sizeof(key), "%s%05d", prefix.c_str(), i);
+            written = writer.Add(key, std::string(20, 'a' + i % 26), timestamp);
+        }
+        written = written && !writer.Add(prefix, "out of order", timestamp) && writer.Finish();
+    }
+    SegmentReader segment;
+    std::string error;
+    std::string value;
+    int64_t found_ts = 0;
+    bool readable = segment.Open(path, error) && segment.NumEntries() == static_cast<uint64_t>(count) &&
+                    segment.NumBlocks() > 1 && segment.Find(prefix + "01234", value, found_ts) &&
+                    value == std::string(20, 'a' + 1234 % 26) && found_ts == timestamp &&
+                    !segment.Find(prefix + "99999", value, found_ts);
+    assert_test(written && readable, "Segment files keep sorted entries findable through the index");
+    
+    const auto& servers = config.GetServers();
+    bool imported = true;
+    for (const auto& server : servers) {
+        auto stub = ABDService::NewStub(grpc::CreateChannel(
+            FormatAddress(server.host, server.port), grpc::InsecureChannelCredentials()));
+        grpc::ClientContext context;
+        ABDImportSegmentRequest request;
+        request.set_path(name);
+        request.set_threads(2);
+        ABDImportSegmentResponse response;
+        imported = stub->ImportSegment(&context, request, &response).ok() && response.success() &&
+                   response.received() == count && response.applied() == count && imported;
+    }
+    std::string read;
+    bool visible = imported && client.Read(prefix + "04999", read) && read == std::string(20, 'a' + 4999 % 26);
+    assert_test(visible, "ImportSegment merges a segment into every server");
+    
+    std::string exported = path + ".export";
+    auto stub = ABDService::NewStub(grpc::CreateChannel(
+        FormatAddress(servers[1].host, servers[1].port), grpc::InsecureChannelCredentials()));
+    grpc::ClientContext context;
+    ABDExportSegmentRequest request;
+    request.set_path(name + ".export");
+    ABDExportSegmentResponse response;
+    SegmentReader backup;
+    bool ok = stub->ExportSegment(&context, request, &response).ok() && response.success() &&
+              backup.Open(exported, error) && backup.NumEntries() == static_cast<uint64_t>(response.entries()) &&
+              backup.Find(prefix + "02500", value, found_ts) && found_ts == timestamp;
+    assert_test(ok, "ExportSegment writes a server's keys to a segment");
+    std::remove(exported.c_str());
+    
+    // Names that would leave the segment directory are refused
+    bool refused = true;
+    for (const std::string& outside : {std::string("/etc/passwd"), "../" + name, "sub/../../" + name}) {
+        grpc::ClientContext import_context;
+        ABDImportSegmentRequest import_request;
+        import_request.set_path(outside);
+        ABDImportSegmentResponse import_response;
+        grpc::ClientContext export_context;
+        ABDExportSegmentRequest export_request;
+        export_request.set_path(outside);
+        ABDExportSegmentResponse export_response;
+        refused = stub->ImportSegment(&import_context, import_request, &import_response).ok() &&
+                  !import_response.success() && !import_response.error().empty() &&
+                  stub->ExportSegment(&export_context, export_request, &export_response).ok() &&
+                  !export_response.success() && refused;
+    }
+    assert_test(refused, "Segment names outside the segment directory are refused");
+    
+    // Flip one payload byte: the block's checksum catches it
+    bool caught = false;
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(100);
+        char byte = 0;
+        file.read(&byte, 1);
+        byte = static_cast<char>(byte ^ 0x5A);
+        file.seekp(100);
+        file.write(&byte, 1);
+    }
+    SegmentReader corrupt;
+    if (corrupt.Open(path, error)) {
+        caught = !corrupt.ForEachInBlock(0, [](std::string_view, std::string_view, int64_t) {});
+    }
+    assert_test(caught, "A corrupt segment block fails its checksum");
+    std::remove(path.c_str());
+}
+
+// Anti-entropy: a server that missed writes gets exactly those back by
+// comparing Merkle trees with a replica that has them
+void test_anti_entropy(const Config& config) {
+    const auto& servers = config.GetServers();
+    std::vector<std::unique_ptr<ABDService::Stub>> stubs;
+    for (size_t i = 0; i < 2; i++) {
+        stubs.push_back(ABDService::NewStub(grpc::CreateChannel(
+            FormatAddress(servers[i].host, servers[i].port), grpc::InsecureChannelCredentials())));
+    }
+    auto repair = [&](size_t target, size_t source) {
+        grpc::ClientContext context;
+        ABDRepairRequest request;
+        request.set_source(FormatAddress(servers[source].host, servers[source].port));
+        ABDRepairResponse response;
+        bool ok = stubs[target]->Repair(&context, request, &response).ok() && response.success();
+        return ok ? response : ABDRepairResponse();
+    };
+    
+    // Start from two servers that agree
+    bool synced = repair(1, 0).success() && repair(0, 1).success() && repair(1, 0).differing_leaves() == 0;
+    assert_test(synced, "Repair in both directions makes two servers agree");
+    
+    // Writes that only reach server 0
+    const int keys = 50;
+    bool written = true;
+    for (int i = 0; i < keys; i++) {
+        grpc::ClientContext context;
+        ABDWriteRequest request;
+        request.set_key("ae_key_" + std::to_string(i));
+        request.set_value("ae_value_" + std::to_string(i));
+        ABDWriteResponse response;
+        written = written && stubs[0]->Write(&context, request, &response).ok() && response.success();
+    }
+    ABDRepairResponse repaired = repair(1, 0);
+    assert_test(written && repaired.success() && repaired.differing_leaves() > 0 &&
+                repaired.differing_leaves() <= keys && repaired.applied() == keys,
+                "Repair pulls only the leaves holding missed writes");
+    
+    grpc::ClientContext context;
+    ABDReadRequest request;
+    request.set_key("ae_key_7");
+    ABDReadResponse response;
+    bool found = stubs[1]->Read(&context, request, &response).ok() && response.value() == "ae_value_7";
+    assert_test(found && repair(1, 0).differing_leaves() == 0, "Repaired server matches its replica");
+}
+
+// Durability: a server of its own, started by the test on a spare port with
+// --data-dir, is written past its snapshot threshold, killed and restarted.
+// The restart must recover the snapshot plus the log tail, dropping a torn
+// record at the end of the newest log segment.
+void test_durability(const Config& base_config, const std::string& server_binary) {
+    int32_t port = 0;
+    for (const auto& server : base_config.GetServers()) {
+        port = std::max(port, server.port);
+    }
+    port += 100;
+    std::string data_dir = (std::filesystem::temp_directory_path() /
+                            ("kvstore_durability_" + std::to_string(getpid()))).string();
+    std::filesystem::remove_all(data_dir);
+    
+    auto start_server = [&]() -> pid_t {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Keep the server's banner out of the test output
+            freopen("/dev/null", "w", stdout);
+            std::string port_arg = std::to_string(port);
+            execl(server_binary.c_str(), server_binary.c_str(), "--port", port_arg.c_str(), "--server-id", "0",
+                  "--data-dir", data_dir.c_str(), "--snapshot-mb", "1", "--log-level", "warn",
+                  static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        auto channel = grpc::CreateChannel(FormatAddress("127.0.0.1", port), grpc::InsecureChannelCredentials());
+        bool up = pid > 0 && channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(10));
+        return up ? pid : -1;
+    };
+    auto crash_server = [](pid_t pid) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    };
+    
+    pid_t pid = start_server();
+    if (pid < 0) {
+        std::cout << "SKIP: Durability needs " << server_binary << " to start on port " << port << std::endl;
+        return;
+    }
+    Config config = base_config;
+    config.SetServers({ServerInfo{0, "127.0.0.1", port}});
+    config.SetNumReplicas(1);
+    config.SetReadQuorum(1);
+    config.SetWriteQuorum(1);
+    
+    // 1.5 MB of values, past --snapshot-mb 1, then the last value after the snapshot
+    bool written = true;
+    {
+        ABDClient client(config, next_client_id());
+        const std::string big(64 * 1024, 'd');
+        for (int i = 0; i < 24; i++) {
+            written = client.Write("dur_key_" + std::to_string(i), big + std::to_string(i)) && written;
+        }
+        std::string snapshot = data_dir + "/snapshot";
+        for (int i = 0; i < 100 && !std::filesystem::exists(snapshot); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        bool rotated = std::filesystem::exists(snapshot) &&
+                       !std::filesystem::exists(WriteAheadLog::SegmentPath(data_dir, 1));
+        assert_test(written && rotated, "Durable server snapshots and retires the old log segment");
+        written = client.Write("dur_last", "before_crash_1") && client.Write("dur_last", "before_crash_2");
+    }
+    crash_server(pid);
+    
+    // Tear the newest segment after its last record (the second dur_last
+    // write): a header promising more payload than follows
+    uint64_t newest = 0;
+    for (const auto& file : std::filesystem::directory_iterator(data_dir)) {
+        std::string name = file.path().filename().string();
+        if (name.rfind("wal-", 0) == 0) {
+            newest = std::max<uint64_t>(newest, std::stoull(name.substr(4)));
+        }
+    }
+    {
+        std::ofstream segment(WriteAheadLog::SegmentPath(data_dir, newest), std::ios::binary | std::ios::app);
+        const char torn[] = {100, 0, 0, 0, 0x12, 0x34, 0x56, 0x78, 1, 2, 3};
+        segment.write(torn, sizeof(torn));
+    }
+    
+    pid = start_server();
+    bool recovered = false;
+    if (pid > 0) {
+        ABDClient client(config, next_client_id());
+        std::string last;
+        std::string first;
+        recovered = client.Read("dur_last", last) && last == "before_crash_2" &&
+                    client.Read("dur_key_0", first) && first == std::string(64 * 1024, 'd') + "0";
+        written = client.Write("dur_last", "after_restart") && written;
+        crash_server(pid);
+    }
+    assert_test(written && recovered, "Restarted server recovers the snapshot and a log tail with a torn record");
+    
+    pid = start_server();
+    bool later_kept = false;
+    if (pid > 0) {
+        ABDClient client(config, next_client_id());
+        std::string last;
+        later_kept = client.Read("dur_last", last) && last == "after_restart";
+        crash_server(pid);
+    }
+    assert_test(later_kept, "Writes after recovering a torn log survive the next restart");
+    std::filesystem::remove_all(data_dir);
+}
+
+// Partitioned layout: with num_replicas below the server count every key
+// must land on exactly that many servers, and the keys must spread out
+void test_partitioning(const Config& base_config) {
+    const auto& servers = base_config.GetServers();
+    if (servers.size() < 2) {
+        std::cout << "SKIP: Partitioning needs at least 2 servers" << std::endl;
+        return;
+    }
+    const int32_t replicas = static_cast<int32_t>(servers.size()) - 1;
+    Config config = base_config;
+    config.SetNumReplicas(replicas);
+    config.SetReadQuorum(1);
+    config.SetWriteQuorum(replicas);
+    ABDClient client(config, next_client_id());
+    
+    const int num_keys = 20;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    for (int i = 0; i < num_keys; i++) {
+        keys.push_back("ring_key_" + std::to_string(i));
+        values.push_back("ring_value_" + std::to_string(i));
+    }
+    bool written = true;
+    for (int i = 0; i < num_keys / 2; i++) {
+        written = client.Write(keys[i], values[i]) && written;
+    }
+    std::vector<std::string> batch_keys(keys.begin() + num_keys / 2, keys.end());
+    std::vector<std::string> batch_values(values.begin() + num_keys / 2, values.end());
+    written = client.MultiWrite(batch_keys, batch_values) && written;
+    
+    std::vector<std::string> read_back;
+    bool read_ok = client.MultiRead(keys, read_back) && read_back == values;
+    assert_test(written && read_ok, "Partitioned writes read back through the ring");
+    
+    // Ask each server alone which keys it holds
+    std::vector<int> copies(num_keys, 0);
+    bool some_server_partial = false;
+    for (const auto& server : servers) {
+        Config single = base_config;
+        single.SetServers({server});
+        single.SetNumReplicas(1);
+        single.SetReadQuorum(1);
+        single.SetWriteQuorum(1);
+        ABDClient reader(single, next_client_id());
+        int held = 0;
+        for (int i = 0; i < num_keys; i++) {
+            std::string value;
+            if (reader.Read(keys[i], value) && value == values[i]) {
+                copies[i]++;
+                held++;
+            }
+        }
+        some_server_partial = some_server_partial || held < num_keys;
+    }
+    bool exact = std::all_of(copies.begin(), copies.end(), [&](int c) { return c == replicas; });
+    assert_test(exact, "Each partitioned key is stored on num_replicas servers");
+    assert_test(some_server_partial, "Partitioned keys are spread over the servers");
+}
+
+// Online rebalancing: grow a 2-server layout (every key on both) to all
+// servers with 2 replicas per key. The new server must end up with exactly
+// the keys it owns, including a write made after the bulk copy.
+void test_rebalance(const Config& base_config) {
+    const auto& servers = base_config.GetServers();
+    if (servers.size() < 3) {
+        std::cout << "SKIP: Rebalancing needs at least 3 servers" << std::endl;
+        return;
+    }
+    Config from = base_config;
+    from.SetServers({servers[0], servers[1]});
+    from.SetNumReplicas(2);
+    from.SetReadQuorum(1);
+    from.SetWriteQuorum(2);
+    Config to = base_config;
+    to.SetNumReplicas(2);
+    to.SetReadQuorum(1);
+    to.SetWriteQuorum(2);
+    HashRing ring(to.GetServers(), to.GetNumReplicas(), to.GetVirtualNodes());
+    auto owns = [&](size_t server, const std::string& key) {
+        std::vector<size_t> replicas = ring.ReplicasFor(key);
+        return std::find(replicas.begin(), replicas.end(), server) != replicas.end();
+    };
+    const size_t added = servers.size() - 1;
+    
+    ABDClient old_client(from, next_client_id());
+    const int num_keys = 30;
+    std::vector<std::string> keys;
+    for (int i = 0; i < num_keys; i++) {
+        keys.push_back("rebalance_key_" + std::to_string(i));
+        old_client.Write(keys.back(), "rebalance_value_" + std::to_string(i));
+    }
+    // Written between the bulk copy and the switch, so only the catch-up pass moves it
+    std::string late_key;
+    for (int i = 0; late_key.empty(); i++) {
+        std::string candidate = "rebalance_late_" + std::to_string(i);
+        if (owns(added, candidate)) {
+            late_key = candidate;
+        }
+    }
+    keys.push_back(late_key);
+    
+    // A pull that can't finish within its deadline is retried, then the move
+    // is abandoned before the switch-over
+    Rebalancer::Options hurried;
+    hurried.pull_timeout_ms = 1;
+    hurried.pull_attempts = 2;
+    Rebalancer timed_out(from, to, hurried);
+    bool switched = false;
+    bool aborted = !timed_out.Run([&]() { return switched = true; });
+    assert_test(aborted && !switched && timed_out.GetStats().pulls == 2,
+                "Rebalance retries a timed-out pull, then aborts before switching over");
+    
+    Rebalancer rebalancer(from, to, Rebalancer::Options{});
+    bool ok = rebalancer.Run([&]() { return old_client.Write(late_key, "rebalance_value_late"); });
+    assert_test(ok, "Rebalance to the new layout succeeds");
+    
+    Config single = base_config;
+    single.SetServers({servers[added]});
+    single.SetNumReplicas(1);
+    single.SetReadQuorum(1);
+    single.SetWriteQuorum(1);
+    ABDClient added_reader(single, next_client_id());
+    bool exact = true;
+    for (const auto& key : keys) {
+        std::string value;
+        bool held = added_reader.Read(key, value) && !value.empty();
+        exact = exact && held == owns(added, key);
+    }
+    assert_test(exact, "New server holds exactly the keys it owns after rebalancing");
+    
+    ABDClient new_client(to, next_client_id());
+    bool readable = true;
+    for (int i = 0; i < num_keys; i++) {
+        std::string value;
+        readable = readable && new_client.Read(keys[i], value) &&
+                   value == "rebalance_value_" + std::to_string(i);
+    }
+    std::string late_value;
+    readable = readable && new_client.Read(late_key, late_value) && late_value == "rebalance_value_late";
+    assert_test(readable, "Rebalanced keys read back under the new layout");
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <config_file>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <config_file> [segment_dir]" << std::endl;
         std::cerr << "Example: " << argv[0] << " ../config/config_3servers.json" << std::endl;
         return 1;
     }
     
     std::string config_file = argv[1];
+    // The durability test starts its own server from next to this binary
+    std::string server_binary = (std::filesystem::path(argv[0]).parent_path() / "abd_server").string();
+    // The servers' --segment-dir, on a filesystem shared with the test
+    std::string segment_dir = argc > 2 ? argv[2] : "/tmp/kvstore_segments";
     Config config;
     
     if (!config.LoadFromFile(config_file)) {
@@ -203,9 +1097,9 @@ int main(int argc, char** argv) {
     std::cout << "Servers: " << config.GetServers().size() << std::endl;
     
     // Create clients
-    ABDClient client1(config);
-    ABDClient client2(config);
-    ABDClient client3(config);
+    ABDClient client1(config, next_client_id());
+    ABDClient client2(config, next_client_id());
+    ABDClient client3(config, next_client_id());
     
     // Run tests
     std::cout << "Running ABD Protocol correctness tests..." << std::endl;
@@ -220,6 +1114,23 @@ int main(int argc, char** argv) {
     test_special_characters(client1);
     test_read_after_write(client1, client2);
     test_concurrent_writes(client1, client2, client3);
+    test_timestamp_order(config, client1, client2);
+    test_superseded_write(config, client3);
+    test_multi_read_write(client1, client2);
+    test_coalesced_operations(config);
+    test_stream_transport(config, client2);
+    test_read_cache(config, client2);
+    test_adaptive_reads(config, client2);
+    test_chunked_value(config, client1, client2);
+    test_stats(config, client1);
+    test_scan(client1);
+    test_snapshot_reads(client1);
+    test_segments(config, client1, segment_dir);
+    test_conditional_writes(config);
+    test_anti_entropy(config);
+    test_durability(config, server_binary);
+    test_partitioning(config);
+    test_rebalance(config);
     
     // Print summary
     std::cout << std::endl;
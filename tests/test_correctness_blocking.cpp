@@ -1,12 +1,18 @@
 // Correctness Tests for Blocking Protocol
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <grpcpp/grpcpp.h>
+#include "kvstore.grpc.pb.h"
 #include "../src/client/blocking_client.h"
 #include "../src/common/config.h"
+#include "../src/common/utils.h"
 
 using namespace kvstore;
 
@@ -23,6 +29,71 @@ void assert_test(bool condition, const std::string& test_name) {
     }
 }
 
+// Stubs straight to each server, to drive the lock RPCs by hand
+std::vector<std::unique_ptr<BlockingService::Stub>> server_stubs(const Config& config) {
+    std::vector<std::unique_ptr<BlockingService::Stub>> stubs;
+    for (const auto& server : config.GetServers()) {
+        stubs.push_back(BlockingService::NewStub(grpc::CreateChannel(
+            FormatAddress(server.host, server.port), grpc::InsecureChannelCredentials())));
+    }
+    return stubs;
+}
+
+// Ask one server for a key's lock without queueing; true if granted
+bool acquire_lock(BlockingService::Stub& stub, const std::string& key, int32_t client_id, int32_t lease_ms) {
+    grpc::ClientContext context;
+    BlockingLockRequest request;
+    request.set_key(key);
+    request.set_client_id(client_id);
+    request.set_lease_ms(lease_ms);
+    BlockingLockResponse response;
+    return stub.AcquireLock(&context, request, &response).ok() && response.granted();
+}
+
+bool renew_lock(BlockingService::Stub& stub, const std::string& key, int32_t client_id, int32_t lease_ms) {
+    grpc::ClientContext context;
+    BlockingRenewRequest request;
+    request.set_key(key);
+    request.set_client_id(client_id);
+    request.set_lease_ms(lease_ms);
+    BlockingRenewResponse response;
+    return stub.RenewLock(&context, request, &response).ok() && response.renewed();
+}
+
+bool release_lock(BlockingService::Stub& stub, const std::string& key, int32_t client_id) {
+    grpc::ClientContext context;
+    BlockingUnlockRequest request;
+    request.set_key(key);
+    request.set_client_id(client_id);
+    BlockingUnlockResponse response;
+    return stub.ReleaseLock(&context, request, &response).ok() && response.success();
+}
+
+// LockAndRead on one server without queueing
+BlockingLockReadResponse lock_and_read(BlockingService::Stub& stub, const std::string& key, int32_t client_id) {
+    grpc::ClientContext context;
+    BlockingLockRequest request;
+    request.set_key(key);
+    request.set_client_id(client_id);
+    BlockingLockReadResponse response;
+    if (!stub.LockAndRead(&context, request, &response).ok()) {
+        response.set_granted(false);
+    }
+    return response;
+}
+
+// WriteAndUnlock on one server; true if the write was applied
+bool write_and_unlock(BlockingService::Stub& stub, const std::string& key, const std::string& value,
+                      int32_t client_id) {
+    grpc::ClientContext context;
+    BlockingWriteRequest request;
+    request.set_key(key);
+    request.set_value(value);
+    request.set_client_id(client_id);
+    BlockingWriteResponse response;
+    return stub.WriteAndUnlock(&context, request, &response).ok() && response.success();
+}
+
 // Test 1: Basic Write and Read
 void test_basic_write_read(BlockingClient& client) {
     std::string key = "test_key_1";
@@ -157,7 +228,39 @@ void test_concurrent_different_keys(BlockingClient& client1, BlockingClient& cli
     assert_test(read3 == value3, "Client3's write to key3 succeeded");
 }
 
-// Test 8: Empty Value
+// Test 8: Contended Key
+// Clients hammering one key queue for its locks instead of failing.
+void test_concurrent_same_key(BlockingClient& client1, BlockingClient& client2, BlockingClient& client3) {
+    std::string key = "contended_key";
+    const int writes_per_client = 50;
+    std::atomic<int> failed{0};
+    
+    auto writer = [&](BlockingClient& client, const std::string& prefix) {
+        for (int i = 0; i < writes_per_client; i++) {
+            if (!client.Write(key, prefix + std::to_string(i))) {
+                failed++;
+            }
+        }
+    };
+    std::thread t1(writer, std::ref(client1), "a");
+    std::thread t2(writer, std::ref(client2), "b");
+    std::thread t3(writer, std::ref(client3), "c");
+    
+    t1.join();
+    t2.join();
+    t3.join();
+    
+    std::string read_value;
+    bool read_ok = client1.Read(key, read_value);
+    std::string last = std::to_string(writes_per_client - 1);
+    
+    assert_test(failed == 0, "Concurrent writes to one key all acquire their locks");
+    assert_test(read_ok && (read_value == "a" + last || read_value == "b" + last ||
+                            read_value == "c" + last),
+                "Contended key holds one client's last write");
+}
+
+// Test 9: Empty Value
 void test_empty_value(BlockingClient& client) {
     std::string key = "empty_key";
     std::string empty_value = "";
@@ -169,7 +272,7 @@ void test_empty_value(BlockingClient& client) {
     assert_test(read_value == empty_value, "Empty value can be stored and retrieved");
 }
 
-// Test 9: Non-existent Key
+// Test 10: Non-existent Key
 void test_nonexistent_key(BlockingClient& client) {
     std::string key = "nonexistent_key_12345";
     std::string read_value;
@@ -179,6 +282,171 @@ void test_nonexistent_key(BlockingClient& client) {
     assert_test(read_value == "", "Read of non-existent key returns empty string");
 }
 
+// Test 11: Stats
+// Every server answers Stats with its lock counts and lock table occupancy
+void test_stats(const Config& config, BlockingClient& client) {
+    client.Write("stats_key", "stats_value");
+    const auto& server = config.GetServers()[0];
+    auto stub = BlockingService::NewStub(grpc::CreateChannel(FormatAddress(server.host, server.port),
+                                                             grpc::InsecureChannelCredentials()));
+    grpc::ClientContext context;
+    StatsRequest request;
+    StatsResponse response;
+    bool ok = stub->Stats(&context, request, &response).ok();
+    const std::string& text = response.prometheus_text();
+    assert_test(ok && text.find("kvstore_lock_requests_total{outcome=\"granted\"} ") != std::string::npos &&
+                text.find("kvstore_lock_requests_total{outcome=\"granted\"} 0\n") == std::string::npos &&
+                text.find("kvstore_locks_held ") != std::string::npos &&
+                text.find("kvstore_rpc_duration_seconds_count{method=\"LockAndRead\"}") != std::string::npos,
+                "Stats reports lock counts and RPC latency");
+}
+
+// Test 12: Partitioning
+// With num_replicas below the server count every key must land on exactly
+// that many servers, and the keys must spread out
+void test_partitioning(const Config& base_config) {
+    const auto& servers = base_config.GetServers();
+    if (servers.size() < 2) {
+        std::cout << "SKIP: Partitioning needs at least 2 servers" << std::endl;
+        return;
+    }
+    const int32_t replicas = static_cast<int32_t>(servers.size()) - 1;
+    Config config = base_config;
+    config.SetNumReplicas(replicas);
+    config.SetReadQuorum(replicas);
+    config.SetWriteQuorum(replicas);
+    BlockingClient client(config, 4);
+    
+    const int num_keys = 20;
+    bool round_trip = true;
+    for (int i = 0; i < num_keys; i++) {
+        std::string key = "ring_key_" + std::to_string(i);
+        std::string value = "ring_value_" + std::to_string(i);
+        std::string read_value;
+        round_trip = client.Write(key, value) && client.Read(key, read_value) &&
+                     read_value == value && round_trip;
+    }
+    assert_test(round_trip, "Partitioned writes read back through the ring");
+    
+    // Ask each server alone which keys it holds
+    std::vector<int> copies(num_keys, 0);
+    bool some_server_partial = false;
+    for (const auto& server : servers) {
+        Config single = base_config;
+        single.SetServers({server});
+        single.SetNumReplicas(1);
+        single.SetReadQuorum(1);
+        single.SetWriteQuorum(1);
+        BlockingClient reader(single, 5);
+        int held = 0;
+        for (int i = 0; i < num_keys; i++) {
+            std::string value;
+            if (reader.Read("ring_key_" + std::to_string(i), value) &&
+                value == "ring_value_" + std::to_string(i)) {
+                copies[i]++;
+                held++;
+            }
+        }
+        some_server_partial = some_server_partial || held < num_keys;
+    }
+    bool exact = std::all_of(copies.begin(), copies.end(), [&](int c) { return c == replicas; });
+    assert_test(exact, "Each partitioned key is stored on num_replicas servers");
+    assert_test(some_server_partial, "Partitioned keys are spread over the servers");
+}
+
+// Test 13: Lock Leases
+// A client that takes the lock and never releases it only keeps it for its
+// lease: it can renew it while the lease runs, not after, and then another
+// client gets the lock
+void test_lock_lease(const Config& base_config) {
+    const std::string key = "lease_key";
+    const int32_t holder = 10;
+    const int32_t lease_ms = 1000;
+    auto stubs = server_stubs(base_config);
+    
+    bool locked = true;
+    for (auto& stub : stubs) {
+        locked = acquire_lock(*stub, key, holder, lease_ms) && locked;
+    }
+    bool renewed = true;
+    for (auto& stub : stubs) {
+        renewed = renew_lock(*stub, key, holder, lease_ms) && renewed;
+    }
+    auto lease_start = std::chrono::steady_clock::now();
+    assert_test(locked && renewed, "Lock holder renews its lease before it runs out");
+    
+    // Each of B's lock requests may only queue for half of its own short
+    // lease, far less than what is left of the holder's
+    Config config = base_config;
+    config.SetLockLeaseMs(100);
+    BlockingClient other(config, 11);
+    assert_test(!other.Write(key, "taken_over"), "Another client can't take a lock while its lease runs");
+    
+    std::this_thread::sleep_until(lease_start + std::chrono::milliseconds(lease_ms + 200));
+    bool expired = true;
+    for (auto& stub : stubs) {
+        expired = !renew_lock(*stub, key, holder, lease_ms) && expired;
+    }
+    assert_test(expired, "Renewal fails once the lease has run out");
+    
+    std::string read_value;
+    bool taken = other.Write(key, "taken_over") && other.Read(key, read_value) &&
+                 read_value == "taken_over";
+    assert_test(taken, "Another client gets the lock once the holder's lease runs out");
+}
+
+// Test 14: Fused Lock Calls
+// LockAndRead returns the value read under the lock it takes; WriteAndUnlock
+// applies the write and releases that lock. Neither does anything for a
+// client that doesn't hold the lock.
+void test_fused_lock_calls(const Config& config, BlockingClient& client) {
+    const std::string key = "fused_key";
+    const int32_t fused = 20;
+    const int32_t holder = 21;
+    auto stubs = server_stubs(config);
+    client.Write(key, "before");
+    
+    // The newest value among the grants is the one written
+    bool granted = true;
+    BlockingLockReadResponse newest;
+    for (auto& stub : stubs) {
+        BlockingLockReadResponse response = lock_and_read(*stub, key, fused);
+        granted = granted && response.granted();
+        if (response.value_timestamp() > newest.value_timestamp()) {
+            newest = response;
+        }
+    }
+    assert_test(granted && newest.value() == "before", "LockAndRead grants the lock and reads under it");
+    
+    bool written = true;
+    for (auto& stub : stubs) {
+        written = write_and_unlock(*stub, key, "after", fused) && written;
+    }
+    // Both only succeed if WriteAndUnlock released every lock
+    bool released = true;
+    for (auto& stub : stubs) {
+        released = acquire_lock(*stub, key, holder, 0) && released;
+    }
+    assert_test(written && released, "WriteAndUnlock applies the write and releases the lock");
+    
+    // `holder` now has the lock everywhere
+    bool refused = true;
+    for (auto& stub : stubs) {
+        BlockingLockReadResponse response = lock_and_read(*stub, key, fused);
+        refused = refused && !response.granted() && response.value().empty();
+        refused = refused && !write_and_unlock(*stub, key, "intruder", fused);
+    }
+    bool still_held = true;
+    for (auto& stub : stubs) {
+        still_held = renew_lock(*stub, key, holder, 0) && still_held;
+        release_lock(*stub, key, holder);
+    }
+    std::string read_value;
+    bool unchanged = client.Read(key, read_value) && read_value == "after";
+    assert_test(refused && still_held && unchanged,
+                "Fused calls from a client without the lock neither read, write nor release it");
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
         std::cerr << "Usage: " << argv[0] << " <config_file>" << std::endl;
@@ -216,6 +484,11 @@ int main(int argc, char** argv) {
     test_read_after_write(client1, client2);
     test_lock_exclusion(client1, client2);
     test_concurrent_different_keys(client1, client2, client3);
+    test_concurrent_same_key(client1, client2, client3);
+    test_stats(config, client1);
+    test_partitioning(config);
+    test_lock_lease(config);
+    test_fused_lock_calls(config, client1);
     
     // Print summary
     std::cout << std::endl;